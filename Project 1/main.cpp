@@ -4,8 +4,49 @@
 #include <limits>
 #include <iomanip>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <functional>
+#include <future>
+#include <map>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cmath>
+#include <cerrno>
+#include <fcntl.h>
+#include "../fold/fold.h"
 #include <sqlite3.h>
 
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <conio.h>
+#include <io.h>
+#else
+#include <sys/socket.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <termios.h>
+#endif
+
 using namespace std;
 
 // Color codes
@@ -27,9 +68,6 @@ struct Product {
     double price;
 };
 
-// SQLite database pointer
-sqlite3* db = nullptr;
-
 // ------------------------
 // Input helpers
 // ------------------------
@@ -64,298 +102,4860 @@ double getDoubleInput(const string &prompt) {
 }
 
 // ------------------------
-// Fetch products from DB
+// Change Log (change-data capture)
+// ------------------------
+// Every committed insert/update/delete on the tracked tables is appended to a
+// segmented log in "<db>-changes/", one batch per transaction:
+//   T <seq> <unix time> <count>
+//   I <table> <rowid> {"column":value,...}         the inserted row
+//   U <table> <rowid> {"column":[old,new],...}     only the columns that changed
+//   D <table> <rowid> {"column":value,...}         the deleted row
+// Segments are named after the first transaction sequence they hold, so a
+// consumer that has read up to N can skip straight to the right segment.
+//
+// The sequence is kept in the database (change_log_seq) and taken inside the
+// writing transaction, and the batch is appended under a lock file held across
+// COMMIT, so several processes sharing one database get distinct sequence
+// numbers and append their batches in commit order. Segments are not fsynced:
+// a power cut can lose the last batches of transactions that did commit, and
+// change_log_seq then runs ahead of the log.
+const vector<string> CHANGE_TRACKED_TABLES = {"products"};
+const long long CHANGE_SEGMENT_BYTES = 4 * 1024 * 1024;
+
+struct ChangeRecord {
+    char op;
+    string table;
+    sqlite3_int64 rowid;
+    string values;                  // JSON object, as above
+};
+
+// A name written by a transaction, for the in-memory name index: the old
+// name goes away, the new one is added (an insert has no old name)
+struct NameChange {
+    bool hasOld = false;
+    bool hasNew = false;
+    string oldName;
+    string newName;
+};
+
+struct ChangeLog;
+
+// Rows touched by one connection's open transaction
+struct ChangeCapture {
+    sqlite3* conn;
+    ChangeLog* log;                 // the log of the database conn writes to
+    vector<ChangeRecord> pending;   // rows touched by the open transaction
+    vector<ChangeRecord> staged;    // handed over by the commit hook
+    long long pendingSeq = 0;       // taken by reserveChangeSeq before COMMIT
+    long long stagedSeq = 0;
+    vector<NameChange> pendingNames;
+    vector<NameChange> stagedNames;
+    function<void(vector<NameChange> &)> applyNames;   // set once the name index is loaded
+};
+
+// One per open database (in its DbContext); it owns the captures of the
+// connections that write to that database
+struct ChangeLog {
+    string dir;
+    long long lastSeq = 0;          // the last batch this process appended or found
+    string segmentPath;
+    long long segmentSize = 0;
+    mutex appendMutex;              // connections on other threads append too
+    int lockFd = -1;                // "<dir>/lock", locked by every process that appends
+    vector<unique_ptr<ChangeCapture>> captures;
+};
+
+string changeSegmentName(long long firstSeq) {
+    ostringstream name;
+    name << setw(20) << setfill('0') << firstSeq << ".log";
+    return name.str();
+}
+
+// Segments of a change-log directory, sorted by their first sequence number
+vector<pair<long long, string>> listChangeSegments(const string &dir) {
+    vector<pair<long long, string>> segments;
+    error_code ec;
+    for (auto &entry : filesystem::directory_iterator(dir, ec)) {
+        string file = entry.path().filename().string();
+        if (file.size() != 24 || file.compare(20, 4, ".log") != 0) continue;
+        segments.push_back({stoll(file.substr(0, 20)), entry.path().string()});
+    }
+    sort(segments.begin(), segments.end());
+    return segments;
+}
+
+// Taken before COMMIT and released once the batch is appended, so batches
+// from every thread and process reach the log in commit order
+void lockChangeLog(ChangeLog &log) {
+    log.appendMutex.lock();
+    if (log.lockFd < 0) return;
+#ifdef _WIN32
+    OVERLAPPED whole{};
+    LockFileEx(reinterpret_cast<HANDLE>(_get_osfhandle(log.lockFd)), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &whole);
+#else
+    while (flock(log.lockFd, LOCK_EX) != 0 && errno == EINTR) {}
+#endif
+}
+
+void unlockChangeLog(ChangeLog &log) {
+    if (log.lockFd >= 0) {
+#ifdef _WIN32
+        OVERLAPPED whole{};
+        UnlockFileEx(reinterpret_cast<HANDLE>(_get_osfhandle(log.lockFd)), 0, 1, 0, &whole);
+#else
+        flock(log.lockFd, LOCK_UN);
+#endif
+    }
+    log.appendMutex.unlock();
+}
+
+// Takes the next batch sequence inside the writing transaction, where the
+// database write lock orders it against every other process
+bool reserveChangeSeq(ChangeCapture &capture) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(capture.conn, "UPDATE change_log_seq SET seq = seq + 1 RETURNING seq;", -1, &stmt,
+                           nullptr) != SQLITE_OK)
+        return false;
+    bool ok = sqlite3_step(stmt) == SQLITE_ROW;
+    if (ok) capture.pendingSeq = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+// Called with the change log locked. A sequence that does not follow our last
+// one means another process appended in between (and may have started a new
+// segment), so only then is the directory read again.
+void appendChangeBatch(ChangeLog &log, long long seq, vector<ChangeRecord> &staged) {
+    if (seq != log.lastSeq + 1) {
+        auto segments = listChangeSegments(log.dir);
+        log.segmentPath = segments.empty() ? "" : segments.back().second;
+        error_code ec;
+        auto size = filesystem::file_size(log.segmentPath, ec);
+        log.segmentSize = ec ? 0 : (long long)size;
+    }
+    log.lastSeq = seq;
+    if (log.segmentPath.empty() || log.segmentSize >= CHANGE_SEGMENT_BYTES) {
+        log.segmentPath = log.dir + "/" + changeSegmentName(seq);
+        log.segmentSize = 0;
+    }
+
+    ostringstream batch;
+    batch << "T " << seq << " " << time(nullptr) << " " << staged.size() << "\n";
+    for (auto &c : staged)
+        batch << c.op << " " << c.table << " " << c.rowid << " " << c.values << "\n";
+    staged.clear();
+
+    // Flushed but not fsynced: the log is a feed, the database stays the source of truth
+    string text = batch.str();
+    ofstream out(log.segmentPath, ios::binary | ios::app);
+    out << text;
+    log.segmentSize += text.size();
+}
+
+string jsonEscape(const string &text) {
+    string out;
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    return out;
+}
+
+// A column value as JSON; blobs are written as hex strings
+string jsonValue(sqlite3_value* value) {
+    switch (sqlite3_value_type(value)) {
+        case SQLITE_INTEGER:
+            return to_string(sqlite3_value_int64(value));
+        case SQLITE_FLOAT: {
+            double number = sqlite3_value_double(value);
+            if (!isfinite(number)) return "null";
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.17g", number);
+            return buf;
+        }
+        case SQLITE_TEXT: {
+            const char* text = reinterpret_cast<const char*>(sqlite3_value_text(value));
+            return "\"" + jsonEscape(string(text, sqlite3_value_bytes(value))) + "\"";
+        }
+        case SQLITE_BLOB: {
+            const unsigned char* bytes = static_cast<const unsigned char*>(sqlite3_value_blob(value));
+            string hex = "\"";
+            char digits[3];
+            for (int i = 0, n = sqlite3_value_bytes(value); i < n; ++i) {
+                snprintf(digits, sizeof(digits), "%02x", bytes[i]);
+                hex += digits;
+            }
+            return hex + "\"";
+        }
+        default:
+            return "null";
+    }
+}
+
+bool sameValue(sqlite3_value* a, sqlite3_value* b) {
+    int type = sqlite3_value_type(a);
+    if (type != sqlite3_value_type(b)) return false;
+    if (type == SQLITE_NULL) return true;
+    if (type == SQLITE_INTEGER) return sqlite3_value_int64(a) == sqlite3_value_int64(b);
+    if (type == SQLITE_FLOAT) return sqlite3_value_double(a) == sqlite3_value_double(b);
+    const void* aBytes = sqlite3_value_blob(a);
+    const void* bBytes = sqlite3_value_blob(b);
+    int size = sqlite3_value_bytes(a);
+    return size == sqlite3_value_bytes(b) && (size == 0 || memcmp(aBytes, bBytes, size) == 0);
+}
+
+// row_changed(op, table, rowid, ...), called by the triggers below with
+// name/value pairs for an insert or delete and name/old/new triples for an
+// update; an update that changed nothing is left out
+void onRowChanged(sqlite3_context* fn, int argc, sqlite3_value** args) {
+    sqlite3_result_null(fn);
+    ChangeRecord record;
+    record.op = reinterpret_cast<const char*>(sqlite3_value_text(args[0]))[0];
+    record.table = reinterpret_cast<const char*>(sqlite3_value_text(args[1]));
+    record.rowid = sqlite3_value_int64(args[2]);
+    int step = record.op == 'U' ? 3 : 2;
+    for (int i = 3; i + step <= argc; i += step) {
+        if (step == 3 && sameValue(args[i + 1], args[i + 2])) continue;
+        record.values += record.values.empty() ? "{\"" : ",\"";
+        record.values += jsonEscape(reinterpret_cast<const char*>(sqlite3_value_text(args[i]))) + "\":";
+        record.values += step == 2 ? jsonValue(args[i + 1])
+                                   : "[" + jsonValue(args[i + 1]) + "," + jsonValue(args[i + 2]) + "]";
+    }
+    if (record.values.empty() && step == 3) return;
+    record.values += record.values.empty() ? "{}" : "}";
+    static_cast<ChangeCapture*>(sqlite3_user_data(fn))->pending.push_back(move(record));
+}
+
+// Temp triggers passing every column of a tracked table to row_changed
+string changeTriggers(sqlite3* conn, const string &table) {
+    sqlite3_stmt* info;
+    if (sqlite3_prepare_v2(conn, ("PRAGMA main.table_info(\"" + table + "\");").c_str(), -1, &info, nullptr) != SQLITE_OK)
+        return "";
+    string inserted, updated, deleted;
+    while (sqlite3_step(info) == SQLITE_ROW) {
+        string column = reinterpret_cast<const char*>(sqlite3_column_text(info, 1));
+        string name = ", '" + column + "', ", quoted = "\"" + column + "\"";
+        inserted += name + "new." + quoted;
+        updated += name + "old." + quoted + ", new." + quoted;
+        deleted += name + "old." + quoted;
+    }
+    sqlite3_finalize(info);
+    if (inserted.empty()) return "";
+
+    string trigger = "CREATE TEMP TRIGGER IF NOT EXISTS \"changes_" + table + "_";
+    string target = " ON main.\"" + table + "\" BEGIN SELECT row_changed(";
+    return trigger + "insert\" AFTER INSERT" + target + "'I', '" + table + "', new.rowid" + inserted + "); END;\n"
+         + trigger + "update\" AFTER UPDATE" + target + "'U', '" + table + "', new.rowid" + updated + "); END;\n"
+         + trigger + "delete\" AFTER DELETE" + target + "'D', '" + table + "', old.rowid" + deleted + "); END;\n";
+}
+
+bool createChangeTriggers(sqlite3* conn) {
+    for (auto &table : CHANGE_TRACKED_TABLES) {
+        string triggers = changeTriggers(conn, table);
+        if (triggers.empty() || sqlite3_exec(conn, triggers.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+            return false;
+    }
+    return true;
+}
+
+int onCommit(void* arg) {
+    ChangeCapture* capture = static_cast<ChangeCapture*>(arg);
+    capture->staged.insert(capture->staged.end(), capture->pending.begin(), capture->pending.end());
+    capture->pending.clear();
+    capture->stagedSeq = capture->pendingSeq;
+    capture->pendingSeq = 0;
+    capture->stagedNames.insert(capture->stagedNames.end(), capture->pendingNames.begin(), capture->pendingNames.end());
+    capture->pendingNames.clear();
+    return 0;
+}
+
+void onRollback(void* arg) {
+    ChangeCapture* capture = static_cast<ChangeCapture*>(arg);
+    capture->pending.clear();
+    capture->staged.clear();
+    capture->pendingSeq = capture->stagedSeq = 0;
+    capture->pendingNames.clear();
+    capture->stagedNames.clear();
+}
+
+// How much an open transaction had captured when a savepoint was taken, so a
+// ROLLBACK TO can drop what was captured after it
+struct ChangeMark {
+    size_t rows = 0;
+    size_t names = 0;
+};
+
+ChangeMark markChanges(const ChangeCapture* capture) {
+    ChangeMark mark;
+    if (!capture) return mark;
+    mark.rows = capture->pending.size();
+    mark.names = capture->pendingNames.size();
+    return mark;
+}
+
+void rewindChanges(ChangeCapture* capture, const ChangeMark &mark) {
+    if (!capture) return;
+    capture->pending.resize(min(mark.rows, capture->pending.size()));
+    capture->pendingNames.resize(min(mark.names, capture->pendingNames.size()));
+}
+
+// The commit hook runs before the commit is durable and must not touch the
+// connection, so the batch is written once the statement has finished and the
+// connection is back in autocommit mode (i.e. the commit went through).
+int onStatementDone(unsigned, void* arg, void*, void*) {
+    ChangeCapture* capture = static_cast<ChangeCapture*>(arg);
+    if (!sqlite3_get_autocommit(capture->conn)) return 0;
+    if (!capture->staged.empty()) appendChangeBatch(*capture->log, capture->stagedSeq, capture->staged);
+    if (!capture->stagedNames.empty() && capture->applyNames) capture->applyNames(capture->stagedNames);
+    capture->stagedNames.clear();
+    return 0;
+}
+
+// Hooks a connection into the change log; every writing connection needs
+// this, on the thread that owns the connection (it creates temp triggers)
+ChangeCapture* captureChanges(ChangeLog &log, sqlite3* conn) {
+    log.captures.push_back(make_unique<ChangeCapture>());
+    ChangeCapture* capture = log.captures.back().get();
+    capture->conn = conn;
+    capture->log = &log;
+    if (sqlite3_create_function(conn, "row_changed", -1, SQLITE_UTF8, capture, onRowChanged, nullptr, nullptr) != SQLITE_OK)
+        return nullptr;
+    if (!createChangeTriggers(conn)) return nullptr;
+    sqlite3_commit_hook(conn, onCommit, capture);
+    sqlite3_rollback_hook(conn, onRollback, capture);
+    sqlite3_trace_v2(conn, SQLITE_TRACE_PROFILE, onStatementDone, capture);
+    return capture;
+}
+
+// Opens the log directory and its lock file, and makes sure the database's
+// sequence is at least the last batch on disk (logs written before the
+// sequence moved into the database carry on from there)
+bool openChangeLog(ChangeLog &log, sqlite3* conn, const string &dbPath) {
+    log.dir = dbPath + "-changes";
+    error_code ec;
+    filesystem::create_directories(log.dir, ec);
+    if (log.lockFd >= 0) close(log.lockFd);
+    log.lockFd = open((log.dir + "/lock").c_str(), O_RDWR | O_CREAT, 0644);
+
+    // Resume from the last batch of the newest segment
+    auto segments = listChangeSegments(log.dir);
+    log.segmentPath.clear();
+    log.segmentSize = log.lastSeq = 0;
+    if (!segments.empty()) {
+        log.segmentPath = segments.back().second;
+        log.lastSeq = segments.back().first - 1;
+        ifstream in(log.segmentPath, ios::binary);
+        string line;
+        while (getline(in, line)) {
+            log.segmentSize += line.size() + 1;
+            if (line.size() > 2 && line[0] == 'T')
+                log.lastSeq = stoll(line.substr(2));
+        }
+    }
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_exec(conn, "CREATE TABLE IF NOT EXISTS change_log_seq (id INTEGER PRIMARY KEY CHECK (id = 1), "
+                           "seq INTEGER NOT NULL);", nullptr, nullptr, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, "INSERT INTO change_log_seq VALUES (1, ?) "
+                                 "ON CONFLICT (id) DO UPDATE SET seq = max(seq, excluded.seq);",
+                           -1, &stmt, nullptr) != SQLITE_OK)
+        return false;
+    sqlite3_bind_int64(stmt, 1, log.lastSeq);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok && log.lockFd >= 0;
+}
+
+// Drops the captures (their connections are closed by now) and the lock file
+void closeChangeLog(ChangeLog &log) {
+    log.captures.clear();
+    if (log.lockFd >= 0) close(log.lockFd);
+    log.lockFd = -1;
+}
+
+// Prints every batch with a sequence number greater than afterSeq
+void printChangesSince(const ChangeLog &log, long long afterSeq) {
+    auto segments = listChangeSegments(log.dir);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (i + 1 < segments.size() && segments[i + 1].first <= afterSeq + 1) continue;
+
+        ifstream in(segments[i].second, ios::binary);
+        string line;
+        bool printing = false;
+        while (getline(in, line)) {
+            if (line.size() > 2 && line[0] == 'T')
+                printing = stoll(line.substr(2)) > afterSeq;
+            if (printing) cout << line << "\n";
+        }
+    }
+}
+
+// ------------------------
+// Memory (allocator and page cache)
+// ------------------------
+// Installed before SQLite initializes, to keep the footprint small and flat
+// on low-RAM PCs:
+//  - small allocations come from size-class pools carved out of 64 KiB slabs
+//    (freed blocks are reused, never returned to the C heap); bigger ones go
+//    straight to malloc;
+//  - database pages live in one contiguous arena shared by every connection,
+//    backed by huge pages when HUGE_PAGES=1 and the system has them. Slots
+//    are carved at each cache's own size (page size plus SQLite's extra
+//    bytes) and freed slots are kept per size, so databases with different
+//    page sizes share it. Once the arena is used up, or the soft heap limit
+//    is reached, caches recycle their own least recently used pages instead
+//    of growing;
+//  - each connection gets a lookaside sized for its role.
+const int MEM_CLASSES = 6;
+const size_t MEM_CLASS_SIZES[MEM_CLASSES] = {32, 64, 128, 256, 512, 1024};
+const size_t MEM_SLAB_BYTES = 64 * 1024;
+const size_t PAGE_ARENA_BYTES = 8 << 20;
+const sqlite3_int64 SOFT_HEAP_LIMIT = 12 << 20;
+// Lookaside: 64 slots of 128 B (8 KiB) for readers and the maintenance
+// connection, 128 slots of 256 B (32 KiB) for the writer
+const int LOOKASIDE_READER_SLOT = 128, LOOKASIDE_READER_SLOTS = 64;
+const int LOOKASIDE_WRITER_SLOT = 256, LOOKASIDE_WRITER_SLOTS = 128;
+
+// Every block starts with its usable size, which xSize needs
+struct MemPool {
+    mutex lock;
+    void* freeList = nullptr;
+    char* slab = nullptr;
+    size_t slabLeft = 0;
+};
+
+MemPool memPools[MEM_CLASSES];
+atomic<long long> memInUse{0};
+atomic<long long> memPeak{0};
+atomic<long long> memReserved{0};   // slabs plus large blocks
+
+void noteMemory(long long delta) {
+    long long now = memInUse += delta;
+    long long peak = memPeak;
+    while (now > peak && !memPeak.compare_exchange_weak(peak, now)) {}
+}
+
+int memClass(size_t size) {
+    for (int c = 0; c < MEM_CLASSES; ++c)
+        if (size <= MEM_CLASS_SIZES[c]) return c;
+    return -1;
+}
+
+void* memMalloc(int bytes) {
+    size_t size = (size_t)bytes;
+    int c = memClass(size);
+    uint64_t* block;
+    if (c < 0) {
+        size = (size + 7) & ~(size_t)7;
+        block = static_cast<uint64_t*>(malloc(size + 8));
+        if (!block) return nullptr;
+        memReserved += size + 8;
+    } else {
+        MemPool &pool = memPools[c];
+        size = MEM_CLASS_SIZES[c];
+        lock_guard<mutex> lock(pool.lock);
+        if (pool.freeList) {
+            block = static_cast<uint64_t*>(pool.freeList);
+            pool.freeList = *reinterpret_cast<void**>(block + 1);
+        } else {
+            if (pool.slabLeft < size + 8) {
+                pool.slab = static_cast<char*>(malloc(MEM_SLAB_BYTES));
+                if (!pool.slab) return nullptr;
+                pool.slabLeft = MEM_SLAB_BYTES;
+                memReserved += MEM_SLAB_BYTES;
+            }
+            block = reinterpret_cast<uint64_t*>(pool.slab);
+            pool.slab += size + 8;
+            pool.slabLeft -= size + 8;
+        }
+    }
+    *block = size;
+    noteMemory((long long)size);
+    return block + 1;
+}
+
+void memFree(void* p) {
+    if (!p) return;
+    uint64_t* block = static_cast<uint64_t*>(p) - 1;
+    size_t size = *block;
+    noteMemory(-(long long)size);
+    int c = memClass(size);
+    if (c < 0) {
+        memReserved -= size + 8;
+        free(block);
+        return;
+    }
+    MemPool &pool = memPools[c];
+    lock_guard<mutex> lock(pool.lock);
+    *static_cast<void**>(p) = pool.freeList;
+    pool.freeList = block;
+}
+
+int memSize(void* p) {
+    return p ? (int)*(static_cast<uint64_t*>(p) - 1) : 0;
+}
+
+void* memRealloc(void* p, int bytes) {
+    if ((size_t)bytes <= (size_t)memSize(p) && memClass(bytes) == memClass(memSize(p))) return p;
+    void* moved = memMalloc(bytes);
+    if (moved && p) {
+        memcpy(moved, p, min(bytes, memSize(p)));
+        memFree(p);
+    }
+    return moved;
+}
+
+int memRoundup(int bytes) {
+    int c = memClass((size_t)bytes);
+    return c >= 0 ? (int)MEM_CLASS_SIZES[c] : (bytes + 7) & ~7;
+}
+
+int memInit(void*) { return SQLITE_OK; }
+void memShutdown(void*) {}
+
+// One page as handed to SQLite: this header, then the page, then its extra bytes
+struct ArenaPage {
+    sqlite3_pcache_page page;
+    unsigned key = 0;
+    unsigned slotSize = 0;      // arena bytes it takes, header included
+    bool pinned = false;
+    bool fromArena = false;
+    ArenaPage* lruPrev = nullptr;
+    ArenaPage* lruNext = nullptr;
+};
+
+struct PageArena {
+    mutex lock;
+    char* base = nullptr;
+    size_t bytes = 0;
+    size_t carved = 0;          // bytes handed out as slots so far; the rest is fresh
+    map<size_t, void*> freeSlots;   // by slot size
+    bool hugePages = false;
+    bool mapped = false;
+    atomic<long long> inUse{0};
+    atomic<long long> peak{0};
+    atomic<long long> fallbackPages{0};
+    atomic<long long> pageBytes{0};     // arena and fallback pages alike
+};
+
+struct PageCache {
+    int szPage = 0;
+    int szExtra = 0;
+    bool purgeable = false;
+    unsigned maxPages = 0;
+    unordered_map<unsigned, ArenaPage*> pages;
+    ArenaPage lru;              // sentinel: lru.lruNext is the oldest unpinned page
+    unsigned unpinned = 0;
+};
+
+PageArena pageArena;
+
+size_t pageSlotSize(int szPage, int szExtra) {
+    return (sizeof(ArenaPage) + szPage + szExtra + 15) & ~(size_t)15;
+}
+
+// Lazily maps the arena; untouched slots cost no resident memory
+bool mapPageArena() {
+    PageArena &a = pageArena;
+#ifndef _WIN32
+    const size_t hugePage = 2 << 20;
+    const char* huge = getenv("HUGE_PAGES");
+    if (huge && atoi(huge) == 1) {
+        a.bytes = (PAGE_ARENA_BYTES + hugePage - 1) & ~(hugePage - 1);
+        void* p = mmap(nullptr, a.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            a.base = static_cast<char*>(p);
+            a.hugePages = a.mapped = true;
+            return true;
+        }
+    }
+    a.bytes = PAGE_ARENA_BYTES;
+    void* p = mmap(nullptr, a.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) {
+        a.base = static_cast<char*>(p);
+        a.mapped = true;
+        return true;
+    }
+#endif
+    a.bytes = PAGE_ARENA_BYTES;
+    a.base = static_cast<char*>(malloc(a.bytes));
+    return a.base != nullptr;
+}
+
+long long pageCacheBytes() {
+    return pageArena.pageBytes;
+}
+
+// The soft heap limit covers both SQLite's heap and the page cache
+bool underMemoryPressure() {
+    sqlite3_int64 limit = sqlite3_soft_heap_limit64(-1);
+    return limit > 0 && memInUse + pageCacheBytes() >= limit;
+}
+
+ArenaPage* allocPage(PageCache* cache) {
+    size_t need = pageSlotSize(cache->szPage, cache->szExtra);
+    char* slot = nullptr;
+    {
+        PageArena &a = pageArena;
+        lock_guard<mutex> lock(a.lock);
+        if (a.base || mapPageArena()) {
+            void* &freeList = a.freeSlots[need];
+            if (freeList) {
+                slot = static_cast<char*>(freeList);
+                freeList = *reinterpret_cast<void**>(slot);
+            } else if (a.carved + need <= a.bytes) {
+                slot = a.base + a.carved;
+                a.carved += need;
+            }
+        }
+    }
+    if (!slot) return nullptr;
+
+    ArenaPage* p = new (slot) ArenaPage;
+    p->fromArena = true;
+    p->slotSize = (unsigned)need;
+    pageArena.pageBytes += need;
+    long long now = ++pageArena.inUse;
+    long long peak = pageArena.peak;
+    while (now > peak && !pageArena.peak.compare_exchange_weak(peak, now)) {}
+    p->page.pBuf = reinterpret_cast<char*>(p + 1);
+    p->page.pExtra = static_cast<char*>(p->page.pBuf) + cache->szPage;
+    return p;
+}
+
+// For pages SQLite cannot do without (createFlag 2) once the arena is full
+ArenaPage* allocFallbackPage(PageCache* cache) {
+    size_t need = sizeof(ArenaPage) + cache->szPage + cache->szExtra;
+    void* mem = malloc(need);
+    if (!mem) return nullptr;
+    ArenaPage* p = new (mem) ArenaPage;
+    p->slotSize = (unsigned)need;
+    pageArena.pageBytes += need;
+    p->page.pBuf = reinterpret_cast<char*>(p + 1);
+    p->page.pExtra = static_cast<char*>(p->page.pBuf) + cache->szPage;
+    pageArena.fallbackPages++;
+    return p;
+}
+
+void freePage(ArenaPage* p) {
+    pageArena.pageBytes -= p->slotSize;
+    if (!p->fromArena) {
+        pageArena.fallbackPages--;
+        free(p);
+        return;
+    }
+    pageArena.inUse--;
+    lock_guard<mutex> lock(pageArena.lock);
+    void* &freeList = pageArena.freeSlots[p->slotSize];
+    *reinterpret_cast<void**>(p) = freeList;
+    freeList = p;
+}
+
+void lruRemove(PageCache* cache, ArenaPage* p) {
+    p->lruPrev->lruNext = p->lruNext;
+    p->lruNext->lruPrev = p->lruPrev;
+    p->lruPrev = p->lruNext = nullptr;
+    cache->unpinned--;
+}
+
+void lruAppend(PageCache* cache, ArenaPage* p) {
+    p->lruPrev = cache->lru.lruPrev;
+    p->lruNext = &cache->lru;
+    cache->lru.lruPrev->lruNext = p;
+    cache->lru.lruPrev = p;
+    cache->unpinned++;
+}
+
+void discardPage(PageCache* cache, ArenaPage* p) {
+    if (p->lruNext) lruRemove(cache, p);
+    cache->pages.erase(p->key);
+    freePage(p);
+}
+
+// Takes the oldest unpinned page out of the cache for reuse
+ArenaPage* recyclePage(PageCache* cache) {
+    if (!cache->purgeable || cache->unpinned == 0) return nullptr;
+    ArenaPage* p = cache->lru.lruNext;
+    lruRemove(cache, p);
+    cache->pages.erase(p->key);
+    return p;
+}
+
+void trimCache(PageCache* cache, size_t keep) {
+    while (cache->purgeable && cache->unpinned > 0 && cache->pages.size() > keep)
+        discardPage(cache, cache->lru.lruNext);
+}
+
+int pcacheInit(void*) { return SQLITE_OK; }
+void pcacheShutdown(void*) {}
+
+sqlite3_pcache* pcacheCreate(int szPage, int szExtra, int purgeable) {
+    PageCache* cache = new PageCache;
+    cache->szPage = szPage;
+    cache->szExtra = szExtra;
+    cache->purgeable = purgeable != 0;
+    cache->lru.lruPrev = cache->lru.lruNext = &cache->lru;
+    return reinterpret_cast<sqlite3_pcache*>(cache);
+}
+
+void pcacheCachesize(sqlite3_pcache* pc, int pages) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    cache->maxPages = pages > 0 ? (unsigned)pages : 0;
+    if (cache->maxPages) trimCache(cache, cache->maxPages);
+}
+
+int pcachePagecount(sqlite3_pcache* pc) {
+    return (int)reinterpret_cast<PageCache*>(pc)->pages.size();
+}
+
+sqlite3_pcache_page* pcacheFetch(sqlite3_pcache* pc, unsigned key, int createFlag) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    auto it = cache->pages.find(key);
+    if (it != cache->pages.end()) {
+        ArenaPage* p = it->second;
+        if (p->lruNext) lruRemove(cache, p);
+        p->pinned = true;
+        return &p->page;
+    }
+    if (createFlag == 0) return nullptr;
+
+    // Full (or short on memory): reuse our own oldest page, or leave it to
+    // SQLite to spill dirty pages and ask again with createFlag 2
+    bool full = (cache->purgeable && cache->maxPages && cache->pages.size() >= cache->maxPages) ||
+                underMemoryPressure();
+    ArenaPage* p = full ? recyclePage(cache) : nullptr;
+    if (!p && full && createFlag == 1) return nullptr;
+    if (!p) p = allocPage(cache);
+    if (!p) p = recyclePage(cache);
+    if (!p && createFlag == 2) p = allocFallbackPage(cache);
+    if (!p) return nullptr;
+
+    p->key = key;
+    p->pinned = true;
+    memset(p->page.pExtra, 0, cache->szExtra);
+    cache->pages[key] = p;
+    return &p->page;
+}
+
+void pcacheUnpin(sqlite3_pcache* pc, sqlite3_pcache_page* page, int discard) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    ArenaPage* p = reinterpret_cast<ArenaPage*>(page);
+    p->pinned = false;
+    if (discard) {
+        discardPage(cache, p);
+        return;
+    }
+    // Pages of temporary and in-memory databases are the data; never recycle them
+    if (!cache->purgeable) return;
+    lruAppend(cache, p);
+    if (cache->maxPages) trimCache(cache, cache->maxPages);
+}
+
+void pcacheRekey(sqlite3_pcache* pc, sqlite3_pcache_page* page, unsigned oldKey, unsigned newKey) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    ArenaPage* p = reinterpret_cast<ArenaPage*>(page);
+    auto existing = cache->pages.find(newKey);
+    if (existing != cache->pages.end() && existing->second != p) discardPage(cache, existing->second);
+    cache->pages.erase(oldKey);
+    p->key = newKey;
+    cache->pages[newKey] = p;
+}
+
+// Drops every page numbered limit or above, pinned or not
+void pcacheTruncate(sqlite3_pcache* pc, unsigned limit) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    vector<ArenaPage*> doomed;
+    for (auto &entry : cache->pages)
+        if (entry.first >= limit) doomed.push_back(entry.second);
+    for (ArenaPage* p : doomed) discardPage(cache, p);
+}
+
+void pcacheDestroy(sqlite3_pcache* pc) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    for (auto &entry : cache->pages) freePage(entry.second);
+    delete cache;
+}
+
+void pcacheShrink(sqlite3_pcache* pc) {
+    trimCache(reinterpret_cast<PageCache*>(pc), 0);
+}
+
+// Must run before anything else touches SQLite (sqlite3_config refuses afterwards)
+bool configureSqliteMemory() {
+    static const sqlite3_mem_methods mem = {
+        memMalloc, memFree, memRealloc, memSize, memRoundup, memInit, memShutdown, nullptr};
+    static const sqlite3_pcache_methods2 pcache = {
+        1, nullptr, pcacheInit, pcacheShutdown, pcacheCreate, pcacheCachesize, pcachePagecount,
+        pcacheFetch, pcacheUnpin, pcacheRekey, pcacheTruncate, pcacheDestroy, pcacheShrink};
+    bool ok = sqlite3_config(SQLITE_CONFIG_MALLOC, &mem) == SQLITE_OK &&
+              sqlite3_config(SQLITE_CONFIG_PCACHE2, &pcache) == SQLITE_OK;
+    sqlite3_soft_heap_limit64(SOFT_HEAP_LIMIT);
+    return ok;
+}
+
+// Right after open, before the connection has allocated anything from it
+void configureLookaside(sqlite3* conn, int slotSize, int slots) {
+    sqlite3_db_config(conn, SQLITE_DBCONFIG_LOOKASIDE, nullptr, slotSize, slots);
+}
+
+// Resident set size now and at its peak, in KiB (0 where unsupported)
+void processMemory(long long &rssKb, long long &peakKb) {
+    rssKb = peakKb = 0;
+#ifndef _WIN32
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) rssKb = atoll(line.c_str() + 6);
+        if (line.compare(0, 6, "VmHWM:") == 0) peakKb = atoll(line.c_str() + 6);
+    }
+#endif
+}
+
+void printMemory() {
+    long long rssKb, peakKb;
+    processMemory(rssKb, peakKb);
+    cout << "memory          : SQLite heap " << memInUse / 1024 << " KiB (peak " << memPeak / 1024
+         << "), page cache " << pageArena.inUse + pageArena.fallbackPages << " pages, " << pageCacheBytes() / 1024
+         << " KiB (peak " << pageArena.peak << " pages" << (pageArena.hugePages ? ", huge pages" : "") << ")";
+    if (rssKb) cout << ", RSS " << rssKb / 1024 << " MiB (peak " << peakKb / 1024 << ")";
+    cout << "\n";
+}
+
+// ------------------------
+// I/O Accounting (shim VFS)
+// ------------------------
+// A VFS registered as the default at startup that wraps the platform one
+// (unix or win32). It counts reads, writes and syncs per kind of file, keeps
+// a latency histogram for each, and can inject faults for testing, set
+// through IO_FAULTS, e.g. IO_FAULTS=write=500,sync=20,delay=2000:
+//   write=N / sync=N  every Nth write / sync fails with an I/O error
+//   delay=US          sleeps that many microseconds before each write and sync
+//   cut=N             after N writes, writes and syncs "succeed" without
+//                     touching the disk, like a power cut (used by bench-recovery)
+// Only database, WAL and journal files are affected by faults.
+enum IoFileKind { IO_MAIN_DB, IO_WAL, IO_JOURNAL, IO_OTHER, IO_KINDS };
+enum IoOp { IO_READ, IO_WRITE, IO_SYNC, IO_OPS };
+const char* IO_KIND_NAMES[IO_KINDS] = {"main db", "WAL", "journal", "other"};
+const char* IO_OP_NAMES[IO_OPS] = {"read", "write", "sync"};
+const int IO_BUCKETS = 6;   // <10us, <100us, <1ms, <10ms, <100ms, slower
+const char* IO_BUCKET_NAMES[IO_BUCKETS] = {"<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms"};
+
+struct IoCounter {
+    atomic<long long> count{0};
+    atomic<long long> bytes{0};
+    atomic<long long> micros{0};
+    atomic<long long> buckets[IO_BUCKETS] = {};
+};
+
+// A plain copy of the counters, so callers can diff before/after an action
+struct IoTotals {
+    long long count[IO_KINDS][IO_OPS] = {};
+    long long bytes[IO_KINDS][IO_OPS] = {};
+    long long micros[IO_KINDS][IO_OPS] = {};
+    long long buckets[IO_KINDS][IO_OPS][IO_BUCKETS] = {};
+};
+
+struct IoFaults {
+    atomic<long long> failWriteEvery{0};
+    atomic<long long> failSyncEvery{0};
+    atomic<int> delayMicros{0};
+    atomic<long long> powerCutAfter{-1};
+    atomic<long long> writes{0};
+    atomic<long long> syncs{0};
+};
+
+IoCounter ioCounters[IO_KINDS][IO_OPS];
+IoFaults ioFaults;
+sqlite3_vfs* ioRealVfs = nullptr;
+sqlite3_vfs ioShimVfs;
+
+struct IoShimFile {
+    sqlite3_file base;
+    int kind;
+    sqlite3_file* real;     // allocated right behind this struct
+};
+
+sqlite3_file* realFile(sqlite3_file* f) { return reinterpret_cast<IoShimFile*>(f)->real; }
+
+void recordIo(sqlite3_file* f, IoOp op, long long bytes, chrono::steady_clock::time_point start) {
+    long long us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    IoCounter &c = ioCounters[reinterpret_cast<IoShimFile*>(f)->kind][op];
+    c.count++;
+    c.bytes += bytes;
+    c.micros += us;
+    int bucket = 0;
+    for (long long limit = 10; us >= limit && bucket < IO_BUCKETS - 1; limit *= 10) bucket++;
+    c.buckets[bucket]++;
+}
+
+// SQLITE_OK to go ahead, an error code to fail the call, or -1 to pretend it succeeded
+int ioFault(sqlite3_file* f, IoOp op) {
+    if (reinterpret_cast<IoShimFile*>(f)->kind == IO_OTHER) return SQLITE_OK;
+    long long n = op == IO_WRITE ? ++ioFaults.writes : ++ioFaults.syncs;
+    if (int delay = ioFaults.delayMicros) this_thread::sleep_for(chrono::microseconds(delay));
+    long long cut = ioFaults.powerCutAfter;
+    if (cut >= 0 && ioFaults.writes > cut) return -1;
+    long long every = op == IO_WRITE ? ioFaults.failWriteEvery : ioFaults.failSyncEvery;
+    if (every > 0 && n % every == 0) return op == IO_WRITE ? SQLITE_IOERR_WRITE : SQLITE_IOERR_FSYNC;
+    return SQLITE_OK;
+}
+
+int ioClose(sqlite3_file* f) {
+    int rc = realFile(f)->pMethods->xClose(realFile(f));
+    f->pMethods = nullptr;
+    return rc;
+}
+int ioRead(sqlite3_file* f, void* buf, int amount, sqlite3_int64 offset) {
+    auto start = chrono::steady_clock::now();
+    int rc = realFile(f)->pMethods->xRead(realFile(f), buf, amount, offset);
+    recordIo(f, IO_READ, amount, start);
+    return rc;
+}
+int ioWrite(sqlite3_file* f, const void* buf, int amount, sqlite3_int64 offset) {
+    auto start = chrono::steady_clock::now();
+    int rc = ioFault(f, IO_WRITE);
+    if (rc == SQLITE_OK) rc = realFile(f)->pMethods->xWrite(realFile(f), buf, amount, offset);
+    recordIo(f, IO_WRITE, amount, start);
+    return rc < 0 ? SQLITE_OK : rc;
+}
+int ioSync(sqlite3_file* f, int flags) {
+    auto start = chrono::steady_clock::now();
+    int rc = ioFault(f, IO_SYNC);
+    if (rc == SQLITE_OK) rc = realFile(f)->pMethods->xSync(realFile(f), flags);
+    recordIo(f, IO_SYNC, 0, start);
+    return rc < 0 ? SQLITE_OK : rc;
+}
+int ioTruncate(sqlite3_file* f, sqlite3_int64 size) {
+    if (ioFaults.powerCutAfter >= 0 && ioFaults.writes > ioFaults.powerCutAfter) return SQLITE_OK;
+    return realFile(f)->pMethods->xTruncate(realFile(f), size);
+}
+int ioFileSize(sqlite3_file* f, sqlite3_int64* size) { return realFile(f)->pMethods->xFileSize(realFile(f), size); }
+int ioLock(sqlite3_file* f, int level) { return realFile(f)->pMethods->xLock(realFile(f), level); }
+int ioUnlock(sqlite3_file* f, int level) { return realFile(f)->pMethods->xUnlock(realFile(f), level); }
+int ioCheckReservedLock(sqlite3_file* f, int* out) { return realFile(f)->pMethods->xCheckReservedLock(realFile(f), out); }
+int ioFileControl(sqlite3_file* f, int op, void* arg) { return realFile(f)->pMethods->xFileControl(realFile(f), op, arg); }
+int ioSectorSize(sqlite3_file* f) { return realFile(f)->pMethods->xSectorSize(realFile(f)); }
+int ioDeviceCharacteristics(sqlite3_file* f) { return realFile(f)->pMethods->xDeviceCharacteristics(realFile(f)); }
+int ioShmMap(sqlite3_file* f, int region, int size, int extend, void volatile** out) {
+    return realFile(f)->pMethods->xShmMap(realFile(f), region, size, extend, out);
+}
+int ioShmLock(sqlite3_file* f, int offset, int n, int flags) { return realFile(f)->pMethods->xShmLock(realFile(f), offset, n, flags); }
+void ioShmBarrier(sqlite3_file* f) { realFile(f)->pMethods->xShmBarrier(realFile(f)); }
+int ioShmUnmap(sqlite3_file* f, int deleteFlag) { return realFile(f)->pMethods->xShmUnmap(realFile(f), deleteFlag); }
+int ioFetch(sqlite3_file* f, sqlite3_int64 offset, int amount, void** out) {
+    return realFile(f)->pMethods->xFetch(realFile(f), offset, amount, out);
+}
+int ioUnfetch(sqlite3_file* f, sqlite3_int64 offset, void* p) { return realFile(f)->pMethods->xUnfetch(realFile(f), offset, p); }
+
+// One table per method version, so SQLite only calls what the real file has
+const sqlite3_io_methods ioShimMethods[3] = {
+    {1, ioClose, ioRead, ioWrite, ioTruncate, ioSync, ioFileSize, ioLock, ioUnlock, ioCheckReservedLock,
+     ioFileControl, ioSectorSize, ioDeviceCharacteristics, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+    {2, ioClose, ioRead, ioWrite, ioTruncate, ioSync, ioFileSize, ioLock, ioUnlock, ioCheckReservedLock,
+     ioFileControl, ioSectorSize, ioDeviceCharacteristics, ioShmMap, ioShmLock, ioShmBarrier, ioShmUnmap, nullptr, nullptr},
+    {3, ioClose, ioRead, ioWrite, ioTruncate, ioSync, ioFileSize, ioLock, ioUnlock, ioCheckReservedLock,
+     ioFileControl, ioSectorSize, ioDeviceCharacteristics, ioShmMap, ioShmLock, ioShmBarrier, ioShmUnmap, ioFetch, ioUnfetch},
+};
+
+int ioOpen(sqlite3_vfs*, const char* name, sqlite3_file* f, int flags, int* outFlags) {
+    IoShimFile* shim = reinterpret_cast<IoShimFile*>(f);
+    shim->real = reinterpret_cast<sqlite3_file*>(shim + 1);
+    shim->kind = flags & SQLITE_OPEN_MAIN_DB ? IO_MAIN_DB
+               : flags & SQLITE_OPEN_WAL ? IO_WAL
+               : flags & SQLITE_OPEN_MAIN_JOURNAL ? IO_JOURNAL : IO_OTHER;
+    int rc = ioRealVfs->xOpen(ioRealVfs, name, shim->real, flags, outFlags);
+    const sqlite3_io_methods* real = shim->real->pMethods;
+    f->pMethods = real ? &ioShimMethods[min(max(real->iVersion, 1), 3) - 1] : nullptr;
+    return rc;
+}
+int ioDelete(sqlite3_vfs*, const char* name, int syncDir) { return ioRealVfs->xDelete(ioRealVfs, name, syncDir); }
+int ioAccess(sqlite3_vfs*, const char* name, int flags, int* out) { return ioRealVfs->xAccess(ioRealVfs, name, flags, out); }
+int ioFullPathname(sqlite3_vfs*, const char* name, int size, char* out) {
+    return ioRealVfs->xFullPathname(ioRealVfs, name, size, out);
+}
+void* ioDlOpen(sqlite3_vfs*, const char* name) { return ioRealVfs->xDlOpen(ioRealVfs, name); }
+void ioDlError(sqlite3_vfs*, int size, char* out) { ioRealVfs->xDlError(ioRealVfs, size, out); }
+void (*ioDlSym(sqlite3_vfs*, void* handle, const char* symbol))(void) { return ioRealVfs->xDlSym(ioRealVfs, handle, symbol); }
+void ioDlClose(sqlite3_vfs*, void* handle) { ioRealVfs->xDlClose(ioRealVfs, handle); }
+int ioRandomness(sqlite3_vfs*, int size, char* out) { return ioRealVfs->xRandomness(ioRealVfs, size, out); }
+int ioSleep(sqlite3_vfs*, int micros) { return ioRealVfs->xSleep(ioRealVfs, micros); }
+int ioCurrentTime(sqlite3_vfs*, double* out) { return ioRealVfs->xCurrentTime(ioRealVfs, out); }
+int ioGetLastError(sqlite3_vfs*, int size, char* out) {
+    return ioRealVfs->xGetLastError ? ioRealVfs->xGetLastError(ioRealVfs, size, out) : 0;
+}
+int ioCurrentTimeInt64(sqlite3_vfs*, sqlite3_int64* out) { return ioRealVfs->xCurrentTimeInt64(ioRealVfs, out); }
+
+// Reads IO_FAULTS, e.g. "write=500,delay=2000"
+void parseIoFaults(const string &spec) {
+    stringstream in(spec);
+    string item;
+    while (getline(in, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == string::npos) continue;
+        string key = item.substr(0, eq);
+        long long value = atoll(item.c_str() + eq + 1);
+        if (key == "write") ioFaults.failWriteEvery = value;
+        else if (key == "sync") ioFaults.failSyncEvery = value;
+        else if (key == "delay") ioFaults.delayMicros = (int)value;
+        else if (key == "cut") ioFaults.powerCutAfter = value;
+    }
+}
+
+// Must run before the first connection is opened
+bool registerIoShim() {
+    ioRealVfs = sqlite3_vfs_find(nullptr);
+    if (!ioRealVfs) return false;
+    ioShimVfs = sqlite3_vfs{};
+    ioShimVfs.iVersion = 2;
+    ioShimVfs.szOsFile = (int)sizeof(IoShimFile) + ioRealVfs->szOsFile;
+    ioShimVfs.mxPathname = ioRealVfs->mxPathname;
+    ioShimVfs.zName = "iostat";
+    ioShimVfs.xOpen = ioOpen;
+    ioShimVfs.xDelete = ioDelete;
+    ioShimVfs.xAccess = ioAccess;
+    ioShimVfs.xFullPathname = ioFullPathname;
+    ioShimVfs.xDlOpen = ioDlOpen;
+    ioShimVfs.xDlError = ioDlError;
+    ioShimVfs.xDlSym = ioDlSym;
+    ioShimVfs.xDlClose = ioDlClose;
+    ioShimVfs.xRandomness = ioRandomness;
+    ioShimVfs.xSleep = ioSleep;
+    ioShimVfs.xCurrentTime = ioCurrentTime;
+    ioShimVfs.xGetLastError = ioGetLastError;
+    ioShimVfs.xCurrentTimeInt64 = ioCurrentTimeInt64;
+    if (const char* faults = getenv("IO_FAULTS")) parseIoFaults(faults);
+    return sqlite3_vfs_register(&ioShimVfs, 1) == SQLITE_OK;
+}
+
+IoTotals ioTotals() {
+    IoTotals t;
+    for (int k = 0; k < IO_KINDS; ++k)
+        for (int op = 0; op < IO_OPS; ++op) {
+            const IoCounter &c = ioCounters[k][op];
+            t.count[k][op] = c.count;
+            t.bytes[k][op] = c.bytes;
+            t.micros[k][op] = c.micros;
+            for (int b = 0; b < IO_BUCKETS; ++b) t.buckets[k][op][b] = c.buckets[b];
+        }
+    return t;
+}
+
+long long ioSyncsSince(const IoTotals &before) {
+    IoTotals now = ioTotals();
+    long long syncs = 0;
+    for (int k = 0; k < IO_KINDS; ++k) syncs += now.count[k][IO_SYNC] - before.count[k][IO_SYNC];
+    return syncs;
+}
+
+// Prints what happened since `before`: counts, volume and latency per file kind
+void printIoSince(const IoTotals &before) {
+    IoTotals now = ioTotals();
+    bool any = false;
+    for (int k = 0; k < IO_KINDS; ++k)
+        for (int op = 0; op < IO_OPS; ++op) {
+            long long n = now.count[k][op] - before.count[k][op];
+            if (n == 0) continue;
+            if (!any) cout << CYAN << "I/O: " << left << setw(9) << "file" << setw(7) << "op" << right
+                           << setw(8) << "count" << setw(11) << "KiB" << setw(10) << "avg us" << "  latency\n" << RESET;
+            any = true;
+            cout << "     " << left << setw(9) << IO_KIND_NAMES[k] << setw(7) << IO_OP_NAMES[op] << right
+                 << setw(8) << n << setw(11) << (now.bytes[k][op] - before.bytes[k][op]) / 1024
+                 << setw(10) << (now.micros[k][op] - before.micros[k][op]) / n << " ";
+            for (int b = 0; b < IO_BUCKETS; ++b) {
+                long long inBucket = now.buckets[k][op][b] - before.buckets[k][op][b];
+                if (inBucket) cout << " " << IO_BUCKET_NAMES[b] << ":" << inBucket;
+            }
+            cout << "\n";
+        }
+    if (!any) cout << CYAN << "I/O: none\n" << RESET;
+}
+
+// ------------------------
+// Name Collation (FOLD)
+// ------------------------
+// SQLite's NOCASE only folds ASCII, so "Ñ" never equals "ñ" and "Jose" never
+// finds "José". FOLD (fold/fold.h) compares text after folding case and
+// accents away.
+//
+// It is registered on every connection the program opens (as an auto
+// extension), and products.name is indexed under it, so lookups that ignore
+// case and accents are index searches. Other programs must register FOLD too
+// before they can write to products or check the database: the sqlite3 shell
+// loads it from fold_extension.cpp (see the README).
+
+int registerFold(sqlite3* conn, const char**, const sqlite3_api_routines*) {
+    return sqlite3_create_collation_v2(conn, "FOLD", SQLITE_UTF8, nullptr, foldCompare, nullptr);
+}
+
+// Must run before the first connection is opened
+void registerFoldCollation() {
+    sqlite3_auto_extension(reinterpret_cast<void (*)(void)>(registerFold));
+}
+
+// Where a prefix search under FOLD stops: every name that starts with prefix
+// (folded) sorts below prefix followed by the last code point
+string foldPrefixEnd(const string &prefix) {
+    return prefix + "\xF4\x8F\xBF\xBF";
+}
+
+// A WHERE condition for the rows whose column starts with the text bound to
+// its first parameter, under FOLD; the second takes foldPrefixEnd(text)
+string foldedPrefixMatch(const string &column) {
+    return column + " >= ? COLLATE FOLD AND " + column + " < ? COLLATE FOLD";
+}
+
+// A WHERE condition for the rows whose column holds the name bound to ?param,
+// under FOLD. Of several spellings the exact one wins, else the first row's,
+// so "maria" finds "Maria" but never changes "Maria" and "MARÍA" together.
+string foldedNameMatch(const string &table, const string &column, int param) {
+    string p = "?" + to_string(param);
+    return column + " = " + p + " COLLATE FOLD AND " + column + " = (SELECT " + column + " FROM " + table +
+           " WHERE " + column + " = " + p + " COLLATE FOLD ORDER BY " + column + " = " + p + " DESC, id LIMIT 1)";
+}
+
+// ------------------------
+// Write Queue (group commit)
+// ------------------------
+// All mutations go through one writer thread with its own connection. Callers
+// push an operation onto a lock-free stack and get a future back; the writer
+// takes everything queued every few milliseconds and commits it as a single
+// transaction, so concurrent writers share one fsync instead of fighting over
+// the write lock. Each operation runs under its own savepoint, so one failing
+// (e.g. on a UNIQUE conflict) does not undo the others.
+struct WriteOp {
+    function<bool(sqlite3*)> apply;         // returning false undoes just this operation
+    function<void(bool committed)> finish;
+    WriteOp* next = nullptr;
+};
+
+struct WriteQueue {
+    sqlite3* conn = nullptr;
+    ChangeCapture* capture = nullptr;
+    atomic<WriteOp*> head{nullptr};
+    atomic<size_t> queued{0};
+    atomic<bool> sleeping{false};
+    atomic<bool> running{false};
+    mutex wakeMutex;
+    condition_variable wake;
+    thread worker;
+    int windowMs = 2;
+    size_t lastBatch = 0;
+    atomic<long long> transactions{0};
+    atomic<long long> operations{0};
+};
+
+void pushWrite(WriteQueue &q, WriteOp* op) {
+    WriteOp* top = q.head.load();
+    do {
+        op->next = top;
+    } while (!q.head.compare_exchange_weak(top, op));
+    q.queued++;
+
+    // Only a writer that is actually asleep needs the mutex/condvar handshake
+    if (q.sleeping.load()) {
+        lock_guard<mutex> lock(q.wakeMutex);
+        q.wake.notify_one();
+    }
+}
+
+// fn(conn, result) fills in the result and returns false to undo its changes.
+// The future yields that result once the transaction has committed, or
+// `failed` if the transaction as a whole could not be committed.
+template <typename T, typename F>
+future<T> submitWrite(WriteQueue &q, F fn, T failed) {
+    auto result = make_shared<T>(failed);
+    auto done = make_shared<promise<T>>();
+    WriteOp* op = new WriteOp;
+    op->apply = [fn, result](sqlite3* conn) { return fn(conn, *result); };
+    op->finish = [result, done, failed](bool committed) { done->set_value(committed ? *result : failed); };
+    pushWrite(q, op);
+    return done->get_future();
+}
+
+void runWriteBatch(WriteQueue &q, vector<WriteOp*> &batch) {
+    bool began = sqlite3_exec(q.conn, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    for (size_t i = 0; i < batch.size() && began; ++i) {
+        ChangeMark mark = markChanges(q.capture);
+        sqlite3_exec(q.conn, "SAVEPOINT op;", nullptr, nullptr, nullptr);
+        if (!batch[i]->apply(q.conn)) {
+            sqlite3_exec(q.conn, "ROLLBACK TO op;", nullptr, nullptr, nullptr);
+            rewindChanges(q.capture, mark);
+        }
+        sqlite3_exec(q.conn, "RELEASE op;", nullptr, nullptr, nullptr);
+    }
+
+    // A transaction that changed tracked rows takes its sequence number and the
+    // change-log lock before COMMIT; the trace hook appends it as COMMIT finishes
+    bool logged = began && q.capture && !q.capture->pending.empty();
+    if (logged) lockChangeLog(*q.capture->log);
+    bool committed = began && (!logged || reserveChangeSeq(*q.capture)) &&
+                     sqlite3_exec(q.conn, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (began && !committed)
+        sqlite3_exec(q.conn, "ROLLBACK;", nullptr, nullptr, nullptr);
+    if (logged) unlockChangeLog(*q.capture->log);
+    q.transactions++;
+    q.operations += batch.size();
+
+    for (WriteOp* op : batch) {
+        op->finish(committed);
+        delete op;
+    }
+}
+
+void writerLoop(WriteQueue* q) {
+    while (true) {
+        if (!q->head.load()) {
+            if (!q->running) break;
+            unique_lock<mutex> lock(q->wakeMutex);
+            q->sleeping = true;
+            q->wake.wait(lock, [&] { return q->head.load() != nullptr || !q->running; });
+            q->sleeping = false;
+            continue;
+        }
+
+        // Once writers are seen to overlap, give them up to windowMs to join
+        // this transaction (as many as last time is enough); a lone writer
+        // such as the menu is committed straight away
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds(q->windowMs);
+        while (q->lastBatch > 1 && q->queued.load() < q->lastBatch && chrono::steady_clock::now() < deadline)
+            this_thread::sleep_for(chrono::microseconds(50));
+
+        // The stack is newest-first; reverse it so operations apply in order
+        vector<WriteOp*> batch;
+        for (WriteOp* op = q->head.exchange(nullptr); op; op = op->next)
+            batch.push_back(op);
+        reverse(batch.begin(), batch.end());
+        q->queued -= batch.size();
+        q->lastBatch = batch.size();
+        runWriteBatch(*q, batch);
+    }
+}
+
+bool startWriteQueue(WriteQueue &q, const string &path) {
+    if (sqlite3_open_v2(path.c_str(), &q.conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        sqlite3_close(q.conn);
+        q.conn = nullptr;
+        return false;
+    }
+    configureLookaside(q.conn, LOOKASIDE_WRITER_SLOT, LOOKASIDE_WRITER_SLOTS);
+    sqlite3_busy_timeout(q.conn, 5000);
+    q.running = true;
+    q.worker = thread(writerLoop, &q);
+    return true;
+}
+
+// Drains whatever is still queued, then stops the writer thread
+void stopWriteQueue(WriteQueue &q) {
+    if (!q.running) return;
+    {
+        lock_guard<mutex> lock(q.wakeMutex);
+        q.running = false;
+    }
+    q.wake.notify_one();
+    q.worker.join();
+    sqlite3_close(q.conn);
+    q.conn = nullptr;
+}
+
+// ------------------------
+// Database Context
+// ------------------------
+// Everything that talks to the database file: the write queue and one
+// read-only connection per reading thread, each with its own statement cache.
+// Functions take the context explicitly rather than sharing one connection, so
+// reports, exports and searches can run off the UI thread. Connections are
+// opened NOMUTEX since no two threads ever use the same one.
+struct ReadConnection {
+    sqlite3* conn = nullptr;
+    map<string, sqlite3_stmt*> statements;
+};
+
+struct DbContext {
+    string path;
+    ChangeLog changeLog;
+    WriteQueue writer;
+    mutex readersMutex;
+    map<thread::id, unique_ptr<ReadConnection>> readers;
+};
+
+void closeReadConnection(ReadConnection &rc) {
+    for (auto &entry : rc.statements) sqlite3_finalize(entry.second);
+    rc.statements.clear();
+    sqlite3_close(rc.conn);
+    rc.conn = nullptr;
+}
+
+// The calling thread's read connection, opened on first use
+ReadConnection* readConnection(DbContext &ctx) {
+    thread::id self = this_thread::get_id();
+    {
+        lock_guard<mutex> lock(ctx.readersMutex);
+        auto it = ctx.readers.find(self);
+        if (it != ctx.readers.end()) return it->second.get();
+    }
+
+    auto rc = make_unique<ReadConnection>();
+    if (sqlite3_open_v2(ctx.path.c_str(), &rc->conn, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        closeReadConnection(*rc);
+        return nullptr;
+    }
+    configureLookaside(rc->conn, LOOKASIDE_READER_SLOT, LOOKASIDE_READER_SLOTS);
+    sqlite3_busy_timeout(rc->conn, 5000);
+    lock_guard<mutex> lock(ctx.readersMutex);
+    return (ctx.readers[self] = move(rc)).get();
+}
+
+// A statement for sql on this thread's connection, prepared once and reset
+// for reuse. Callers must sqlite3_reset() it when done, or the connection
+// keeps reading from the snapshot it started on.
+sqlite3_stmt* readStatement(DbContext &ctx, const string &sql) {
+    ReadConnection* rc = readConnection(ctx);
+    if (!rc) return nullptr;
+
+    sqlite3_stmt* &stmt = rc->statements[sql];
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    } else if (sqlite3_prepare_v3(rc->conn, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        rc->statements.erase(sql);
+        return nullptr;
+    }
+    return stmt;
+}
+
+// Threads that exit before the context is closed give their connection back
+void releaseReadConnection(DbContext &ctx) {
+    unique_ptr<ReadConnection> rc;
+    {
+        lock_guard<mutex> lock(ctx.readersMutex);
+        auto it = ctx.readers.find(this_thread::get_id());
+        if (it == ctx.readers.end()) return;
+        rc = move(it->second);
+        ctx.readers.erase(it);
+    }
+    closeReadConnection(*rc);
+}
+
+// Creates the schema, switches to WAL so readers never block the writer (or
+// each other), and starts the writer with change capture attached.
+bool openDbContext(DbContext &ctx, const string &path, const char* schema, string &error) {
+    sqlite3* setup = nullptr;
+    if (sqlite3_open(path.c_str(), &setup) != SQLITE_OK) {
+        error = sqlite3_errmsg(setup);
+        sqlite3_close(setup);
+        return false;
+    }
+    sqlite3_busy_timeout(setup, 5000);      // another process may be opening it too
+    // Only takes effect before the first table exists; see Maintenance
+    sqlite3_exec(setup, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
+    char* errMsg = nullptr;
+    if (sqlite3_exec(setup, schema, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        error = errMsg;
+        sqlite3_free(errMsg);
+        sqlite3_close(setup);
+        return false;
+    }
+    sqlite3_exec(setup, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+    ctx.path = sqlite3_db_filename(setup, "main");
+    bool logOpen = openChangeLog(ctx.changeLog, setup, ctx.path);
+    sqlite3_close(setup);
+    if (!logOpen) {
+        closeChangeLog(ctx.changeLog);
+        error = "can't open the change log";
+        return false;
+    }
+
+    if (!startWriteQueue(ctx.writer, ctx.path)) {
+        closeChangeLog(ctx.changeLog);
+        error = "can't open writer connection";
+        return false;
+    }
+    ChangeLog* log = &ctx.changeLog;
+    ctx.writer.capture = submitWrite(ctx.writer, [log](sqlite3* conn, ChangeCapture* &capture) {
+        capture = captureChanges(*log, conn);
+        return capture != nullptr;
+    }, (ChangeCapture*)nullptr).get();
+    if (!ctx.writer.capture) {
+        stopWriteQueue(ctx.writer);
+        closeChangeLog(ctx.changeLog);
+        error = "can't capture changes on the writer connection";
+        return false;
+    }
+    return true;
+}
+
+// The writer closes last: only a read-write connection can checkpoint and
+// remove the WAL on the way out
+void closeDbContext(DbContext &ctx) {
+    {
+        lock_guard<mutex> lock(ctx.readersMutex);
+        for (auto &entry : ctx.readers) closeReadConnection(*entry.second);
+        ctx.readers.clear();
+    }
+    stopWriteQueue(ctx.writer);
+    ctx.writer.capture = nullptr;
+    closeChangeLog(ctx.changeLog);
+
+    // inventory.html loads the bare .db file into sql.js, which never sees a
+    // WAL, so the last process out folds the WAL back in and leaves the file
+    // in rollback-journal mode; the next open switches to WAL again. While
+    // another process still has the database open this fails straight away
+    // (no busy timeout) and the file stays in WAL mode until that one exits.
+    sqlite3* conn = nullptr;
+    if (sqlite3_open_v2(ctx.path.c_str(), &conn, SQLITE_OPEN_READWRITE, nullptr) == SQLITE_OK)
+        sqlite3_exec(conn, "PRAGMA journal_mode=DELETE;", nullptr, nullptr, nullptr);
+    sqlite3_close(conn);
+}
+
+// ------------------------
+// Cancellable Queries
+// ------------------------
+// Interactive searches and reports run under a QueryGuard: a progress handler
+// that shows elapsed time once a query gets slow, stops it at its deadline,
+// and stops it when the user presses Ctrl-C or ESC (or a background job is
+// cancelled). An interrupted query returns SQLITE_INTERRUPT, and whatever rows
+// it produced so far are shown labelled as partial.
+enum QueryOutcome { QUERY_DONE, QUERY_CANCELLED, QUERY_TIMED_OUT, QUERY_FAILED };
+
+const int SEARCH_TIMEOUT_MS = 30000;
+const int REPORT_TIMEOUT_MS = 120000;
+
+struct QueryGuard {
+    string label;
+    int timeoutMs = 0;
+    bool interactive = true;                    // Ctrl-C/ESC and a progress line
+    const atomic<bool>* cancelFlag = nullptr;   // e.g. a background job's
+
+    sqlite3* conn = nullptr;
+    thread::id owner;
+    chrono::steady_clock::time_point start, deadline, lastPolled;
+    atomic<bool> cancelled{false};
+    atomic<bool> timedOut{false};
+    bool shown = false;
+    bool rawTerminal = false;
+#ifndef _WIN32
+    termios savedTerminal;
+#endif
+    void (*previousSignal)(int) = SIG_DFL;
+};
+
+atomic<QueryGuard*> activeQueryGuard{nullptr};
+
+void onQuerySignal(int) {
+    QueryGuard* guard = activeQueryGuard.load();
+    if (!guard) return;
+    guard->cancelled = true;
+    if (guard->conn) sqlite3_interrupt(guard->conn);
+}
+
+bool escapePressed(QueryGuard &g) {
+    if (!g.rawTerminal) return false;
+#ifdef _WIN32
+    while (_kbhit())
+        if (_getch() == 27) return true;
+#else
+    unsigned char c;
+    while (read(STDIN_FILENO, &c, 1) == 1)
+        if (c == 27) return true;
+#endif
+    return false;
+}
+
+// Checks the deadline and cancel sources; on the owning thread it also polls
+// for ESC and redraws the progress line, at most every 50 ms
+bool pollQueryGuard(QueryGuard &g) {
+    auto now = chrono::steady_clock::now();
+    if (g.cancelFlag && g.cancelFlag->load()) g.cancelled = true;
+    if (g.timeoutMs > 0 && now > g.deadline) g.timedOut = true;
+
+    if (g.interactive && this_thread::get_id() == g.owner && now - g.lastPolled > chrono::milliseconds(50)) {
+        g.lastPolled = now;
+        if (escapePressed(g)) g.cancelled = true;
+        double secs = chrono::duration<double>(now - g.start).count();
+        if (secs > 0.5) {
+            cout << "\r" << YELLOW << g.label << "... " << fixed << setprecision(1) << secs
+                 << "s  (Ctrl-C or ESC to stop)" << RESET << defaultfloat << setprecision(6) << flush;
+            g.shown = true;
+        }
+    }
+    return g.cancelled || g.timedOut;
+}
+
+int queryProgress(void* arg) {
+    return pollQueryGuard(*static_cast<QueryGuard*>(arg)) ? 1 : 0;
+}
+
+void attachQueryGuard(QueryGuard &g, sqlite3* conn) {
+    if (conn) sqlite3_progress_handler(conn, 10000, queryProgress, &g);
+}
+
+void detachQueryGuard(sqlite3* conn) {
+    if (conn) sqlite3_progress_handler(conn, 0, nullptr, nullptr);
+}
+
+void startQueryGuard(QueryGuard &g, sqlite3* conn) {
+    g.conn = conn;
+    g.owner = this_thread::get_id();
+    g.start = g.lastPolled = chrono::steady_clock::now();
+    g.deadline = g.start + chrono::milliseconds(g.timeoutMs);
+    attachQueryGuard(g, conn);
+    if (!g.interactive) return;
+
+    activeQueryGuard = &g;
+    g.previousSignal = signal(SIGINT, onQuerySignal);
+    // ESC is only seen if the terminal hands over keys without waiting for Enter
+#ifdef _WIN32
+    g.rawTerminal = _isatty(_fileno(stdin));
+#else
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &g.savedTerminal) == 0) {
+        termios raw = g.savedTerminal;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        g.rawTerminal = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+#endif
+}
+
+// rc is the last result of the guarded work (SQLITE_DONE when it completed)
+QueryOutcome finishQueryGuard(QueryGuard &g, int rc) {
+    detachQueryGuard(g.conn);
+    if (g.interactive) {
+        signal(SIGINT, g.previousSignal);
+        activeQueryGuard = nullptr;
+#ifndef _WIN32
+        if (g.rawTerminal) tcsetattr(STDIN_FILENO, TCSANOW, &g.savedTerminal);
+#endif
+        if (g.shown) cout << "\r" << string(g.label.size() + 40, ' ') << "\r" << flush;
+    }
+    if (g.cancelled) return QUERY_CANCELLED;
+    if (g.timedOut) return QUERY_TIMED_OUT;
+    return rc == SQLITE_DONE || rc == SQLITE_OK ? QUERY_DONE : QUERY_FAILED;
+}
+
+string queryOutcomeNote(const QueryGuard &g, QueryOutcome outcome) {
+    switch (outcome) {
+        case QUERY_CANCELLED: return "PARTIAL RESULTS - cancelled";
+        case QUERY_TIMED_OUT: return "PARTIAL RESULTS - stopped after " + to_string(g.timeoutMs / 1000) + " s";
+        case QUERY_FAILED: return "query failed";
+        default: return "";
+    }
+}
+
+// ------------------------
+// Read Snapshots
+// ------------------------
+// Long reports copy what they show inside one short read transaction and are
+// printed from memory afterwards, so a slow terminal or file never keeps the
+// database pinned. With SQLITE_ENABLE_SNAPSHOT the transaction's snapshot is
+// captured too, so other connections can open exactly the same point in time.
+struct ReadSnapshot {
+    ReadConnection* rc = nullptr;
+    time_t asOf = 0;
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    sqlite3_snapshot* snapshot = nullptr;
+#endif
+};
+
+void endSnapshot(ReadSnapshot &snap) {
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    if (snap.snapshot) sqlite3_snapshot_free(snap.snapshot);
+    snap.snapshot = nullptr;
+#endif
+    if (snap.rc && !sqlite3_get_autocommit(snap.rc->conn))
+        sqlite3_exec(snap.rc->conn, "COMMIT;", nullptr, nullptr, nullptr);
+    snap.rc = nullptr;
+}
+
+// Starts a read transaction on this thread's connection; BEGIN is deferred,
+// so the first read is what fixes the snapshot
+bool beginSnapshot(DbContext &ctx, ReadSnapshot &snap) {
+    snap.rc = readConnection(ctx);
+    if (!snap.rc) return false;
+    if (sqlite3_exec(snap.rc->conn, "BEGIN; SELECT count(*) FROM sqlite_master;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        endSnapshot(snap);
+        return false;
+    }
+    snap.asOf = time(nullptr);
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    if (sqlite3_snapshot_get(snap.rc->conn, "main", &snap.snapshot) != SQLITE_OK)
+        snap.snapshot = nullptr;
+#endif
+    return true;
+}
+
+string snapshotLabel(const ReadSnapshot &snap) {
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&snap.asOf));
+    return string("as of ") + stamp;
+}
+
+// Drops the color codes from text bound for a file
+string stripColors(const string &text) {
+    string plain;
+    plain.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\033' && i + 1 < text.size() && text[i + 1] == '[') {
+            while (i < text.size() && text[i] != 'm') ++i;
+            continue;
+        }
+        plain += text[i];
+    }
+    return plain;
+}
+
+// Renders a report inside one snapshot, lets go of the database, and only
+// then prints it (or writes it to file when one is given). Interrupted
+// reports are still shown, labelled as partial.
+bool writeReport(DbContext &ctx, const function<bool(DbContext &, ostream &)> &render, const string &file = "",
+                 const atomic<bool>* cancelFlag = nullptr) {
+    ReadSnapshot snap;
+    ostringstream out;
+    QueryGuard guard;
+    guard.label = "Building report";
+    guard.timeoutMs = REPORT_TIMEOUT_MS;
+    guard.interactive = !cancelFlag;
+    guard.cancelFlag = cancelFlag;
+
+    QueryOutcome outcome = QUERY_FAILED;
+    bool ok = beginSnapshot(ctx, snap);
+    if (ok) {
+        startQueryGuard(guard, snap.rc->conn);
+        ok = render(ctx, out);
+        outcome = finishQueryGuard(guard, ok ? SQLITE_DONE : SQLITE_ERROR);
+    }
+    endSnapshot(snap);
+    if (!ok) return false;
+
+    out << "(" << snapshotLabel(snap);
+    if (outcome != QUERY_DONE) out << "; " << RED << queryOutcomeNote(guard, outcome) << RESET;
+    out << ")\n";
+    if (file.empty()) {
+        cout << out.str();
+        return outcome == QUERY_DONE;
+    }
+    ofstream f(file, ios::binary);
+    f << stripColors(out.str());
+    return f && outcome == QUERY_DONE;
+}
+
+// ------------------------
+// Parallel Scan
+// ------------------------
+// Splits a table into rowid ranges and aggregates each range on its own thread
+// and read connection, then merges the partial results. While the scanners
+// open their read transactions the writer thread holds the write lock, so no
+// commit can land in between and every range reads the same WAL snapshot.
+// Builds with SQLITE_ENABLE_SNAPSHOT open one pinned snapshot everywhere instead.
+struct ScanBarrier {
+    mutex m;
+    condition_variable cv;
+    int parts = 0;
+    int arrived = 0;
+    bool locked = false;
+    bool failed = false;
+};
+
+const sqlite3_int64 SCAN_MIN_ROWS_PER_PART = 4096;
+
+// sql selects partial aggregates for "rowid BETWEEN ?1 AND ?2"; fold(stmt, partial)
+// is called for each row it returns, merge(total, partial) once per range.
+// Returns false if any range failed or was interrupted through guard; what
+// was scanned is still merged into total.
+template <typename Partial, typename Fold, typename Merge>
+bool parallelScan(DbContext &ctx, const string &table, const string &sql, int threads,
+                  Partial &total, Fold fold, Merge merge, QueryGuard* guard = nullptr) {
+    sqlite3_stmt* bounds = readStatement(ctx, "SELECT min(rowid), max(rowid) FROM " + table + ";");
+    if (!bounds) return false;
+    sqlite3_int64 lo = 0, hi = 0;
+    if (sqlite3_step(bounds) == SQLITE_ROW) {
+        lo = sqlite3_column_int64(bounds, 0);
+        hi = sqlite3_column_int64(bounds, 1);
+    }
+    sqlite3_reset(bounds);
+
+    // Ranges only decide who scans what; the first and last are open-ended so
+    // rows committed after the bounds were read are still counted exactly once
+    sqlite3_int64 span = hi - lo + 1;
+    int parts = (int)max<sqlite3_int64>(1, min<sqlite3_int64>(threads, span / SCAN_MIN_ROWS_PER_PART));
+    sqlite3_int64 step = span / parts;
+
+    ScanBarrier barrier;
+    barrier.parts = parts;
+    vector<Partial> partials(parts);
+    vector<char> ok(parts, 0);
+    atomic<int> finishedParts{0};
+
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    ReadSnapshot pinned;
+    if (!beginSnapshot(ctx, pinned) || !pinned.snapshot) {
+        endSnapshot(pinned);
+        return false;
+    }
+    barrier.locked = true;
+    future<bool> held = async(launch::deferred, [] { return true; });
+#else
+    auto held = submitWrite(ctx.writer, [&barrier](sqlite3*, bool &done) {
+        unique_lock<mutex> lock(barrier.m);
+        barrier.locked = true;
+        barrier.cv.notify_all();
+        barrier.cv.wait(lock, [&] { return barrier.arrived == barrier.parts; });
+        done = true;
+        return true;
+    }, false);
+#endif
+
+    auto scanPart = [&](int i) {
+        sqlite3_int64 first = i == 0 ? numeric_limits<sqlite3_int64>::min() : lo + step * i;
+        sqlite3_int64 last = i == parts - 1 ? numeric_limits<sqlite3_int64>::max() : lo + step * (i + 1) - 1;
+        ReadConnection* rc = readConnection(ctx);
+        {
+            unique_lock<mutex> lock(barrier.m);
+            barrier.cv.wait(lock, [&] { return barrier.locked || barrier.failed; });
+            if (barrier.failed) {
+                lock.unlock();
+                releaseReadConnection(ctx);
+                finishedParts++;
+                return;
+            }
+        }
+
+        bool began = rc && sqlite3_exec(rc->conn, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK
+#ifdef SQLITE_ENABLE_SNAPSHOT
+                     && sqlite3_snapshot_open(rc->conn, "main", pinned.snapshot) == SQLITE_OK
+#endif
+                     && sqlite3_exec(rc->conn, "SELECT count(*) FROM sqlite_master;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        {
+            lock_guard<mutex> lock(barrier.m);
+            barrier.arrived++;
+        }
+        barrier.cv.notify_all();
+
+        sqlite3_stmt* stmt = began ? readStatement(ctx, sql) : nullptr;
+        if (stmt) {
+            if (guard) attachQueryGuard(*guard, rc->conn);
+            sqlite3_bind_int64(stmt, 1, first);
+            sqlite3_bind_int64(stmt, 2, last);
+            int rcStep;
+            while ((rcStep = sqlite3_step(stmt)) == SQLITE_ROW)
+                fold(stmt, partials[i]);
+            ok[i] = rcStep == SQLITE_DONE;
+            sqlite3_reset(stmt);
+            if (guard) detachQueryGuard(rc->conn);
+        }
+        if (rc && !sqlite3_get_autocommit(rc->conn))
+            sqlite3_exec(rc->conn, "COMMIT;", nullptr, nullptr, nullptr);
+        releaseReadConnection(ctx);
+        finishedParts++;
+    };
+
+    vector<thread> scanners;
+    for (int i = 0; i < parts; ++i)
+        scanners.emplace_back(scanPart, i);
+
+    // The write lock could not be taken: let the scanners go without reading
+    if (!held.get()) {
+        lock_guard<mutex> lock(barrier.m);
+        if (!barrier.locked) barrier.failed = true;
+    }
+    barrier.cv.notify_all();
+
+    // Scanners only check the guard; ESC and the progress line are handled here
+    while (guard && finishedParts < parts) {
+        pollQueryGuard(*guard);
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    for (auto &t : scanners) t.join();
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    endSnapshot(pinned);
+#endif
+
+    bool complete = !barrier.failed;
+    for (int i = 0; i < parts; ++i) {
+        complete = complete && ok[i];
+        merge(total, partials[i]);
+    }
+    return complete;
+}
+
+int defaultScanThreads() {
+    return (int)max(1u, min(8u, thread::hardware_concurrency()));
+}
+
+// ------------------------
+// Job Pool
+// ------------------------
+// Background jobs (exports, backups, VACUUM, reports) run on a small
+// work-stealing pool so the menu never waits on them. Each worker pops from
+// the back of its own deque and steals from the front of the others' when it
+// runs dry. Workers run at lowered OS priority and hold themselves to a CPU
+// share (cpuPercent) by sleeping between chunks of work, so sales stay
+// responsive while a job runs.
+enum JobState { JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED, JOB_CANCELLED };
+
+struct Job {
+    long long id = 0;
+    string name;
+    function<bool(Job &, string &)> work;    // fills in the result text
+    atomic<int> state{JOB_QUEUED};
+    atomic<double> progress{0};             // 0..1, or < 0 when unknown
+    atomic<bool> cancelRequested{false};
+    int cpuPercent = 100;
+    chrono::steady_clock::time_point submitted, sliceStart;
+    mutex lock;                             // guards the state changes below and the result
+    chrono::steady_clock::time_point started, finished;
+    string result;
+    promise<void> finishedSignal;
+    shared_future<void> done;
+};
+
+struct JobQueue {
+    mutex m;
+    deque<shared_ptr<Job>> jobs;
+};
+
+struct JobPool {
+    DbContext* ctx = nullptr;
+    int cpuPercent = 50;
+    vector<unique_ptr<JobQueue>> queues;
+    vector<thread> workers;
+    mutex idleMutex;
+    condition_variable idle;
+    atomic<int> pending{0};
+    atomic<bool> running{false};
+    atomic<size_t> nextQueue{0};
+    atomic<long long> nextId{0};
+    mutex historyMutex;
+    vector<shared_ptr<Job>> history;        // every job submitted, for the Jobs screen
+};
+
+const int JOB_CPU_PERCENT = 50;
+
+thread_local int jobWorkerIndex = -1;
+
+const char* jobStateName(int state) {
+    switch (state) {
+        case JOB_QUEUED: return "queued";
+        case JOB_RUNNING: return "running";
+        case JOB_DONE: return "done";
+        case JOB_FAILED: return "failed";
+        default: return "cancelled";
+    }
+}
+
+// Called by jobs between chunks of work: records progress, sleeps off any CPU
+// time beyond the job's share, and returns false once the job is cancelled
+bool jobContinue(Job &job, double progress) {
+    job.progress = progress;
+    if (job.cpuPercent < 100) {
+        auto busy = chrono::steady_clock::now() - job.sliceStart;
+        if (busy > chrono::milliseconds(20)) {
+            this_thread::sleep_for(busy * (100 - job.cpuPercent) / job.cpuPercent);
+            job.sliceStart = chrono::steady_clock::now();
+        }
+    }
+    return !job.cancelRequested;
+}
+
+string jobResult(Job &job) {
+    lock_guard<mutex> lock(job.lock);
+    return job.result;
+}
+
+// The Jobs screen reads state and times together under job.lock, so a job it
+// sees running or finished always has those times set
+void runJob(Job &job) {
+    if (job.cancelRequested) {
+        lock_guard<mutex> lock(job.lock);
+        job.started = job.finished = chrono::steady_clock::now();
+        job.state = JOB_CANCELLED;
+    } else {
+        {
+            lock_guard<mutex> lock(job.lock);
+            job.started = job.sliceStart = chrono::steady_clock::now();
+            job.state = JOB_RUNNING;
+        }
+        string result;
+        bool ok = job.work(job, result);
+        if (ok) job.progress = 1;
+        lock_guard<mutex> lock(job.lock);
+        job.result = result;
+        job.finished = chrono::steady_clock::now();
+        job.state = job.cancelRequested ? JOB_CANCELLED : ok ? JOB_DONE : JOB_FAILED;
+    }
+    job.work = nullptr;
+    job.finishedSignal.set_value();
+}
+
+shared_ptr<Job> takeJob(JobPool &pool, int self) {
+    size_t n = pool.queues.size();
+    for (size_t k = 0; k < n; ++k) {
+        JobQueue &q = *pool.queues[(self + k) % n];
+        lock_guard<mutex> lock(q.m);
+        if (q.jobs.empty()) continue;
+        shared_ptr<Job> job;
+        if (k == 0) {
+            job = q.jobs.back();
+            q.jobs.pop_back();
+        } else {
+            job = q.jobs.front();
+            q.jobs.pop_front();
+        }
+        pool.pending--;
+        return job;
+    }
+    return nullptr;
+}
+
+void lowerThreadPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#endif
+}
+
+void jobWorker(JobPool* pool, int self) {
+    jobWorkerIndex = self;
+    lowerThreadPriority();
+    while (true) {
+        shared_ptr<Job> job = takeJob(*pool, self);
+        if (job) {
+            runJob(*job);
+            continue;
+        }
+        unique_lock<mutex> lock(pool->idleMutex);
+        pool->idle.wait(lock, [&] { return pool->pending > 0 || !pool->running; });
+        if (!pool->running && pool->pending == 0) break;
+    }
+    releaseReadConnection(*pool->ctx);
+}
+
+void startJobPool(JobPool &pool, DbContext &ctx, int workerCount, int cpuPercent) {
+    pool.ctx = &ctx;
+    pool.cpuPercent = max(1, min(100, cpuPercent));
+    pool.running = true;
+    for (int i = 0; i < workerCount; ++i)
+        pool.queues.push_back(make_unique<JobQueue>());
+    for (int i = 0; i < workerCount; ++i)
+        pool.workers.emplace_back(jobWorker, &pool, i);
+}
+
+// Cancels whatever has not finished and waits for the workers to exit
+void stopJobPool(JobPool &pool) {
+    if (!pool.running) return;
+    {
+        lock_guard<mutex> lock(pool.historyMutex);
+        for (auto &job : pool.history) job->cancelRequested = true;
+    }
+    {
+        lock_guard<mutex> lock(pool.idleMutex);
+        pool.running = false;
+    }
+    pool.idle.notify_all();
+    for (auto &w : pool.workers) w.join();
+    pool.workers.clear();
+}
+
+shared_ptr<Job> submitJob(JobPool &pool, const string &name, function<bool(Job &, string &)> work) {
+    auto job = make_shared<Job>();
+    job->id = ++pool.nextId;
+    job->name = name;
+    job->work = move(work);
+    job->cpuPercent = pool.cpuPercent;
+    job->submitted = chrono::steady_clock::now();
+    job->done = job->finishedSignal.get_future().share();
+    {
+        lock_guard<mutex> lock(pool.historyMutex);
+        pool.history.push_back(job);
+    }
+
+    // Jobs spawned by a job stay on that worker's deque for others to steal
+    size_t n = pool.queues.size();
+    size_t target = jobWorkerIndex >= 0 ? (size_t)jobWorkerIndex : pool.nextQueue++ % n;
+    {
+        lock_guard<mutex> lock(pool.queues[target]->m);
+        pool.queues[target]->jobs.push_back(job);
+    }
+    {
+        lock_guard<mutex> lock(pool.idleMutex);
+        pool.pending++;
+    }
+    pool.idle.notify_one();
+    return job;
+}
+
+bool cancelJob(JobPool &pool, long long id) {
+    lock_guard<mutex> lock(pool.historyMutex);
+    for (auto &job : pool.history) {
+        if (job->id != id) continue;
+        job->cancelRequested = true;
+        return true;
+    }
+    return false;
+}
+
+void printJobs(JobPool &pool) {
+    vector<shared_ptr<Job>> jobs;
+    {
+        lock_guard<mutex> lock(pool.historyMutex);
+        jobs = pool.history;
+    }
+    if (jobs.empty()) {
+        cout << YELLOW << "\nNo background jobs yet.\n" << RESET;
+        return;
+    }
+
+    auto now = chrono::steady_clock::now();
+    cout << CYAN << "\n" << left << setw(5) << "ID" << setw(24) << "Job" << setw(11) << "State"
+         << setw(10) << "Progress" << setw(10) << "Time" << "Result\n" << RESET;
+    for (auto &job : jobs) {
+        int state;
+        chrono::steady_clock::time_point from, to;
+        {
+            lock_guard<mutex> lock(job->lock);
+            state = job->state;
+            from = state == JOB_QUEUED ? job->submitted : job->started;
+            to = state == JOB_QUEUED || state == JOB_RUNNING ? now : job->finished;
+        }
+        double progress = job->progress;
+        ostringstream pct, secs;
+        if (progress < 0) pct << "...";
+        else pct << (int)(progress * 100) << "%";
+        secs << fixed << setprecision(1) << chrono::duration<double>(to - from).count() << "s";
+
+        cout << left << setw(5) << job->id << setw(24) << job->name.substr(0, 23)
+             << (state == JOB_FAILED ? RED : state == JOB_DONE ? GREEN : YELLOW) << setw(11) << jobStateName(state) << RESET
+             << setw(10) << pct.str() << setw(10) << secs.str()
+             << (state >= JOB_DONE ? jobResult(*job) : "") << "\n";
+    }
+}
+
+// Shows a progress line until the job finishes (used by the command line)
+int watchJob(Job &job) {
+    while (job.done.wait_for(chrono::milliseconds(200)) != future_status::ready) {
+        double progress = job.progress;
+        cout << "\r" << job.name << ": ";
+        if (progress < 0) cout << "working...";
+        else cout << (int)(progress * 100) << "%   ";
+        cout << flush;
+    }
+    cout << "\r" << job.name << ": " << jobStateName(job.state) << "  " << jobResult(job) << endl;
+    return job.state == JOB_DONE ? 0 : 1;
+}
+
+// ------------------------
+// Fetch products from DB
+// ------------------------
+vector<Product> fetchAllProducts(DbContext &ctx) {
+    vector<Product> products;
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT name, category, quantity, price FROM products;");
+    if (!stmt) return products;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Product p;
+        p.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        p.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        p.quantity = sqlite3_column_int(stmt, 2);
+        p.price = sqlite3_column_double(stmt, 3);
+        products.push_back(p);
+    }
+
+    sqlite3_reset(stmt);
+    return products;
+}
+
+// ------------------------
+// Display Table
+// ------------------------
+bool renderProductTable(DbContext &ctx, ostream &out) {
+    vector<Product> inventory = fetchAllProducts(ctx);
+
+    if (inventory.empty()) {
+        out << RED << "\nNo products found!\n" << RESET;
+        return true;
+    }
+
+    int nameWidth = 20, catWidth = 15, qtyWidth = 8, priceWidth = 10;
+    int tableWidth = nameWidth + catWidth + qtyWidth + priceWidth + 6;
+
+    auto wrapText = [](const string &text, int width) -> vector<string> {
+        vector<string> lines;
+        size_t start = 0;
+        while (start < text.size()) {
+            lines.push_back(text.substr(start, width));
+            start += width;
+        }
+        return lines;
+    };
+
+    out << "+" << string(tableWidth + 1, '-') << "+\n";
+    out << CYAN
+        << "| " << left << setw(nameWidth) << "Product Name"
+        << "| " << setw(catWidth) << "Category"
+        << "| " << setw(qtyWidth) << "Qty"
+        << "| " << setw(priceWidth) << "Price"
+        << "|\n" << RESET;
+    out << "+" << string(tableWidth + 1, '-') << "+\n";
+
+    for (auto &p : inventory) {
+        vector<string> nameLines = wrapText(p.name, nameWidth);
+        vector<string> catLines = wrapText(p.category, catWidth);
+        vector<string> qtyLines = wrapText(to_string(p.quantity), qtyWidth);
+        vector<string> priceLines = wrapText(to_string(p.price), priceWidth);
+
+        size_t maxLines = max({nameLines.size(), catLines.size(), qtyLines.size(), priceLines.size()});
+
+        for (size_t i = 0; i < maxLines; i++) {
+            out << "| "
+                << left << setw(nameWidth) << (i < nameLines.size() ? nameLines[i] : "")
+                << "| " << setw(catWidth) << (i < catLines.size() ? catLines[i] : "")
+                << "| " << setw(qtyWidth) << (i < qtyLines.size() ? qtyLines[i] : "")
+                << "| " << setw(priceWidth) << (i < priceLines.size() ? priceLines[i] : "")
+                << "|\n";
+        }
+
+        out << "+" << string(tableWidth + 1, '-') << "+\n";
+    }
+    return true;
+}
+
+void displayTable(DbContext &ctx) {
+    writeReport(ctx, renderProductTable);
+}
+
+// ------------------------
+// Batch Entry
+// ------------------------
+// The "add another?" loops collect rows here instead of writing each one.
+// Only the pending rows are previewed, and the whole batch is committed as
+// one write operation (one transaction, one fsync) when the user is done.
+// Each row runs under its own savepoint, so a row that breaks a constraint
+// (a duplicate name, say) is reported and skipped without losing the rest.
+const size_t BATCH_PREVIEW_ROWS = 10;
+
+struct BatchRow {
+    vector<string> cells;                   // as shown in the preview
+    function<void(sqlite3_stmt*)> bind;
+};
+
+struct EntryBatch {
+    string noun;                            // "product", "resident", ...
+    string insertSql;
+    vector<string> headers;
+    vector<BatchRow> rows;
+};
+
+// The most recent pending rows, numbered as they will be reported on commit
+void printPendingRows(const EntryBatch &batch) {
+    vector<size_t> widths;
+    for (const string &h : batch.headers) widths.push_back(h.size());
+    size_t first = batch.rows.size() > BATCH_PREVIEW_ROWS ? batch.rows.size() - BATCH_PREVIEW_ROWS : 0;
+    for (size_t r = first; r < batch.rows.size(); ++r)
+        for (size_t c = 0; c < widths.size() && c < batch.rows[r].cells.size(); ++c)
+            widths[c] = min<size_t>(24, max(widths[c], batch.rows[r].cells[c].size()));
+
+    cout << YELLOW << "\nPending " << batch.noun << "s (" << batch.rows.size() << ", not saved yet):\n" << RESET;
+    cout << CYAN << "  " << left << setw(5) << "#";
+    for (size_t c = 0; c < widths.size(); ++c) cout << setw(widths[c] + 2) << batch.headers[c];
+    cout << RESET << "\n";
+    if (first > 0) cout << "  ... " << first << " earlier\n";
+    for (size_t r = first; r < batch.rows.size(); ++r) {
+        cout << "  " << left << setw(5) << r + 1;
+        for (size_t c = 0; c < widths.size() && c < batch.rows[r].cells.size(); ++c)
+            cout << setw(widths[c] + 2) << batch.rows[r].cells[c].substr(0, widths[c]);
+        cout << "\n";
+    }
+    cout << right;
+}
+
+// Inserts every pending row in one transaction and returns how many were
+// saved. errors[i] is empty if row i was, otherwise SQLite's reason why not.
+size_t commitBatch(DbContext &ctx, const EntryBatch &batch, vector<string> &errors) {
+    const EntryBatch* b = &batch;
+    WriteQueue* q = &ctx.writer;
+    errors = submitWrite(ctx.writer, [b, q](sqlite3* conn, vector<string> &result) {
+        result.assign(b->rows.size(), "");
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(conn, b->insertSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            result.assign(b->rows.size(), sqlite3_errmsg(conn));
+            return false;
+        }
+        for (size_t i = 0; i < b->rows.size(); ++i) {
+            ChangeMark mark = markChanges(q->capture);
+            sqlite3_exec(conn, "SAVEPOINT batch_row;", nullptr, nullptr, nullptr);
+            b->rows[i].bind(stmt);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                result[i] = sqlite3_errmsg(conn);
+                sqlite3_reset(stmt);
+                sqlite3_exec(conn, "ROLLBACK TO batch_row;", nullptr, nullptr, nullptr);
+                rewindChanges(q->capture, mark);
+            }
+            sqlite3_exec(conn, "RELEASE batch_row;", nullptr, nullptr, nullptr);
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        sqlite3_finalize(stmt);
+        return true;
+    }, vector<string>(batch.rows.size(), "the transaction could not be committed")).get();
+
+    return count(errors.begin(), errors.end(), "");
+}
+
+// Asks before committing, then reports the outcome row by row
+void finishBatch(DbContext &ctx, EntryBatch &batch) {
+    if (batch.rows.empty()) return;
+    char confirm;
+    cout << "\nSave " << batch.rows.size() << " pending " << batch.noun << (batch.rows.size() == 1 ? "" : "s")
+         << "? (Y/N): ";
+    cin >> confirm;
+    if (toupper(confirm) != 'Y') {
+        cout << YELLOW << "\nDiscarded " << batch.rows.size() << " pending " << batch.noun << "s.\n" << RESET;
+        batch.rows.clear();
+        return;
+    }
+
+    vector<string> errors;
+    size_t saved = commitBatch(ctx, batch, errors);
+    cout << GREEN << "\nSaved " << saved << " of " << batch.rows.size() << " " << batch.noun << "s in one transaction.\n" << RESET;
+    for (size_t i = 0; i < errors.size(); ++i)
+        if (!errors[i].empty())
+            cout << RED << "  #" << i + 1 << " " << batch.rows[i].cells[0] << ": " << errors[i] << "\n" << RESET;
+    batch.rows.clear();
+}
+
+// ------------------------
+// Typo-Tolerant Lookup (BK-tree)
+// ------------------------
+// Product names in a BK-tree, so a mistyped name at the sale prompt still
+// finds its product: the names within TYPO_DISTANCE edits of what was typed
+// (Levenshtein over the characters FOLD compares) are offered instead.
+// Each child hangs off its parent under its distance to the parent's name, and
+// by the triangle inequality a match can only sit under an edge within
+// TYPO_DISTANCE of the query's own distance to that parent, so a search skips
+// every other branch. The tree belongs to the name index below and follows
+// the same writes.
+//
+// Laid out like the radix tree: nodes in one vector, linked by index, names
+// as slices of one string. Spellings that differ only in case or accents get a
+// node each, under an edge of 0. A removed name's node stays behind to route
+// searches; once those outnumber the live ones the tree is rebuilt.
+const unsigned TYPO_DISTANCE = 2;
+const size_t TYPO_SUGGESTIONS = 5;
+
+struct BkTree {
+    struct Node {
+        uint32_t name = 0;          // names[name, name + length)
+        uint32_t firstChild = 0;    // 0 for none (the root is never anyone's child)
+        uint32_t nextSibling = 0;
+        uint16_t length = 0;
+        uint16_t distance = 0;      // edit distance to the parent's name
+        uint32_t rows = 0;          // rows with this name; 0 once removed
+    };
+    vector<Node> nodes;             // nodes[0] is the root
+    string names;
+    size_t live = 0;                // nodes with rows
+};
+
+// The name as FOLD compares it
+u32string foldTypoKey(const char* s, size_t n) {
+    u32string key;
+    key.reserve(n);
+    FoldCursor cursor{reinterpret_cast<const unsigned char*>(s), reinterpret_cast<const unsigned char*>(s) + n};
+    while (char32_t c = nextFolded(cursor)) key.push_back(c);
+    return key;
+}
+
+// Levenshtein distance by the table, one row at a time
+unsigned editDistance(const u32string &a, const u32string &b) {
+    if (a.size() < b.size()) return editDistance(b, a);
+    thread_local vector<unsigned> row;
+    row.resize(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) row[j] = (unsigned)j;
+    for (size_t i = 0; i < a.size(); ++i) {
+        unsigned diagonal = row[0];
+        row[0] = (unsigned)i + 1;
+        for (size_t j = 0; j < b.size(); ++j) {
+            unsigned above = row[j + 1];
+            row[j + 1] = min({above + 1, row[j] + 1, diagonal + (a[i] != b[j])});
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+// A name to compare with many others. Up to 64 code points, a whole column of
+// the table fits in two machine words (Myers' bit-vector algorithm, as Hyyrö
+// states it for edit distance), so each further name costs one step per code
+// point. Longer names fall back to the table.
+struct TypoPattern {
+    u32string key;
+    uint64_t ascii[128] = {};                   // bit i: key[i] is this character
+    vector<pair<char32_t, uint64_t>> other;     // the same for the rest
+};
+
+void makeTypoPattern(TypoPattern &p, const string &name) {
+    p.key = foldTypoKey(name.data(), name.size());
+    if (p.key.size() > 64) return;
+    for (size_t i = 0; i < p.key.size(); ++i) {
+        char32_t c = p.key[i];
+        if (c < 128) {
+            p.ascii[c] |= 1ULL << i;
+            continue;
+        }
+        auto entry = find_if(p.other.begin(), p.other.end(),
+                             [c](const pair<char32_t, uint64_t> &e) { return e.first == c; });
+        if (entry == p.other.end()) p.other.emplace_back(c, 1ULL << i);
+        else entry->second |= 1ULL << i;
+    }
+}
+
+unsigned typoDistance(const TypoPattern &p, const char* text, size_t n) {
+    size_t m = p.key.size();
+    if (m > 64) return editDistance(p.key, foldTypoKey(text, n));
+    unsigned score = (unsigned)m;
+    uint64_t pv = ~0ULL, mv = 0, last = m ? 1ULL << (m - 1) : 0;
+    FoldCursor cursor{reinterpret_cast<const unsigned char*>(text), reinterpret_cast<const unsigned char*>(text) + n};
+    while (char32_t c = nextFolded(cursor)) {
+        if (!m) {
+            ++score;
+            continue;
+        }
+        uint64_t eq = 0;
+        if (c < 128) {
+            eq = p.ascii[c];
+        } else {
+            for (auto &entry : p.other)
+                if (entry.first == c) eq = entry.second;
+        }
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) ++score;
+        else if (mh & last) --score;
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+// The child of node hanging under distance, or 0
+uint32_t findBkChild(const BkTree &t, uint32_t node, unsigned distance) {
+    uint32_t child = t.nodes[node].firstChild;
+    while (child && t.nodes[child].distance != distance) child = t.nodes[child].nextSibling;
+    return child;
+}
+
+bool sameBkName(const BkTree &t, const BkTree::Node &node, const string &name) {
+    return node.length == name.size() && t.names.compare(node.name, node.length, name) == 0;
+}
+
+// Adds the name of `rows` rows; false if it is too long to keep
+bool bkInsert(BkTree &t, const string &name, uint32_t rows = 1) {
+    if (name.size() > UINT16_MAX) return false;
+    uint32_t node = 0;
+    if (!t.nodes.empty()) {
+        TypoPattern pattern;
+        makeTypoPattern(pattern, name);
+        for (;;) {
+            const BkTree::Node &at = t.nodes[node];
+            unsigned distance = typoDistance(pattern, t.names.data() + at.name, at.length);
+            if (distance == 0 && sameBkName(t, at, name)) {
+                if (t.nodes[node].rows == 0) ++t.live;
+                t.nodes[node].rows += rows;
+                return true;
+            }
+            if (uint32_t child = findBkChild(t, node, distance)) {
+                node = child;
+                continue;
+            }
+            BkTree::Node added;
+            added.distance = (uint16_t)distance;
+            added.nextSibling = t.nodes[node].firstChild;
+            t.nodes[node].firstChild = (uint32_t)t.nodes.size();
+            node = (uint32_t)t.nodes.size();
+            t.nodes.push_back(added);
+            break;
+        }
+    } else {
+        t.nodes.emplace_back();
+    }
+    t.nodes[node].name = (uint32_t)t.names.size();
+    t.nodes[node].length = (uint16_t)name.size();
+    t.nodes[node].rows = rows;
+    t.names += name;
+    ++t.live;
+    return true;
+}
+
+// Gives back the spare capacity left from loading
+void shrinkBkTree(BkTree &t) {
+    t.nodes.shrink_to_fit();
+    t.names.shrink_to_fit();
+}
+
+// Reinserts the live names into a fresh tree
+void rebuildBkTree(BkTree &t) {
+    BkTree fresh;
+    for (auto &node : t.nodes)
+        if (node.rows) bkInsert(fresh, t.names.substr(node.name, node.length), node.rows);
+    shrinkBkTree(fresh);
+    t = move(fresh);
+}
+
+// Drops one row's name; the name stays while other rows still have it
+void bkRemove(BkTree &t, const string &name) {
+    if (t.nodes.empty()) return;
+    TypoPattern pattern;
+    makeTypoPattern(pattern, name);
+    uint32_t node = 0;
+    for (;;) {
+        const BkTree::Node &at = t.nodes[node];
+        unsigned distance = typoDistance(pattern, t.names.data() + at.name, at.length);
+        if (distance == 0 && sameBkName(t, at, name)) break;
+        if (!(node = findBkChild(t, node, distance))) return;
+    }
+    if (t.nodes[node].rows == 0 || --t.nodes[node].rows) return;
+    --t.live;
+    if (t.nodes.size() - t.live > max(t.live, (size_t)64)) rebuildBkTree(t);
+}
+
+// Every name within maxDistance of typed as (distance, name), nearest first
+// and then in byte order; visited counts the names compared
+vector<pair<unsigned, string>> bkSearch(const BkTree &t, const string &typed, unsigned maxDistance, size_t &visited) {
+    vector<pair<unsigned, string>> found;
+    visited = 0;
+    if (t.nodes.empty()) return found;
+    TypoPattern pattern;
+    makeTypoPattern(pattern, typed);
+    vector<uint32_t> pending(1, 0);
+    while (!pending.empty()) {
+        const BkTree::Node &node = t.nodes[pending.back()];
+        pending.pop_back();
+        unsigned distance = typoDistance(pattern, t.names.data() + node.name, node.length);
+        ++visited;
+        if (distance <= maxDistance && node.rows) found.emplace_back(distance, t.names.substr(node.name, node.length));
+        for (uint32_t child = node.firstChild; child; child = t.nodes[child].nextSibling)
+            if (t.nodes[child].distance + maxDistance >= distance && t.nodes[child].distance <= distance + maxDistance)
+                pending.push_back(child);
+    }
+    sort(found.begin(), found.end());
+    return found;
+}
+
+size_t bkTreeBytes(const BkTree &t) {
+    return sizeof(t) + t.nodes.capacity() * sizeof(BkTree::Node) + t.names.capacity();
+}
+
+// ------------------------
+// Name Index (type-ahead)
+// ------------------------
+// Product names held in memory as a radix tree, so the name prompt can show
+// the names starting with what has been typed after every key. The tree is
+// loaded once before the menu starts. From then on, temporary triggers on the
+// writer connection report every inserted, renamed and deleted product, and
+// the change-log hooks apply those once the transaction commits, so rolled
+// back writes never reach the tree.
+//
+// Nodes sit in one vector and refer to each other by index; edge labels are
+// slices of one string. A removed name's nodes are reused, but its label bytes
+// stay behind until they are half of the labels, when the tree is rebuilt.
+const size_t NAME_SUGGESTIONS = 6;
+const size_t NAME_HINT_WIDTH = 76;
+
+struct NameTrie {
+    struct Node {
+        uint32_t label = 0;         // edge label: labels[label, label + labelLength)
+        uint32_t firstChild = 0;    // 0 for none; siblings are sorted by their first byte
+        uint32_t nextSibling = 0;
+        uint16_t labelLength = 0;
+        uint16_t rows = 0;          // rows with the name that ends here (names need not be unique)
+    };
+    vector<Node> nodes = vector<Node>(1);   // nodes[0] is the root
+    string labels;
+    vector<uint32_t> freeNodes;
+    size_t names = 0;
+    size_t deadLabelBytes = 0;
+};
+
+struct NameIndex {
+    mutex lock;                     // the writer thread applies changes, the menu reads
+    NameTrie trie;
+    BkTree typos;                   // the same names, for "did you mean" after a miss
+    bool loaded = false;
+};
+
+NameIndex productNames;
+
+uint32_t allocTrieNode(NameTrie &t) {
+    if (t.freeNodes.empty()) {
+        t.nodes.emplace_back();
+        return (uint32_t)t.nodes.size() - 1;
+    }
+    uint32_t id = t.freeNodes.back();
+    t.freeNodes.pop_back();
+    t.nodes[id] = NameTrie::Node();
+    return id;
+}
+
+// The child of node whose label starts with c, or 0; prev is the sibling
+// before it (or before where it would go), 0 if it would be the first
+uint32_t findTrieChild(const NameTrie &t, uint32_t node, unsigned char c, uint32_t &prev) {
+    prev = 0;
+    uint32_t child = t.nodes[node].firstChild;
+    while (child && (unsigned char)t.labels[t.nodes[child].label] < c) {
+        prev = child;
+        child = t.nodes[child].nextSibling;
+    }
+    return child && (unsigned char)t.labels[t.nodes[child].label] == c ? child : 0;
+}
+
+// Adds the name of `rows` rows; false if it was already there (or too long for one label)
+bool trieInsert(NameTrie &t, const string &name, unsigned rows = 1) {
+    if (name.empty() || name.size() > UINT16_MAX) return false;
+    uint32_t node = 0;
+    size_t pos = 0;
+    while (pos < name.size()) {
+        uint32_t prev;
+        uint32_t child = findTrieChild(t, node, name[pos], prev);
+        if (!child) {
+            uint32_t leaf = allocTrieNode(t);
+            NameTrie::Node &n = t.nodes[leaf];
+            n.label = (uint32_t)t.labels.size();
+            n.labelLength = (uint16_t)(name.size() - pos);
+            n.rows = (uint16_t)min<unsigned>(rows, UINT16_MAX);
+            n.nextSibling = prev ? t.nodes[prev].nextSibling : t.nodes[node].firstChild;
+            (prev ? t.nodes[prev].nextSibling : t.nodes[node].firstChild) = leaf;
+            t.labels.append(name, pos, string::npos);
+            ++t.names;
+            return true;
+        }
+
+        size_t length = t.nodes[child].labelLength, common = 1;
+        while (common < length && pos + common < name.size() &&
+               t.labels[t.nodes[child].label + common] == name[pos + common])
+            ++common;
+        if (common < length) {
+            // The name leaves this edge part way: split it at that point
+            uint32_t mid = allocTrieNode(t);
+            NameTrie::Node &m = t.nodes[mid], &old = t.nodes[child];
+            m.label = old.label;
+            m.labelLength = (uint16_t)common;
+            m.firstChild = child;
+            m.nextSibling = old.nextSibling;
+            old.label += (uint32_t)common;
+            old.labelLength -= (uint16_t)common;
+            old.nextSibling = 0;
+            (prev ? t.nodes[prev].nextSibling : t.nodes[node].firstChild) = mid;
+            child = mid;
+        }
+        node = child;
+        pos += common;
+    }
+    NameTrie::Node &end = t.nodes[node];
+    bool added = end.rows == 0;
+    end.rows = (uint16_t)min<unsigned>(end.rows + rows, UINT16_MAX);
+    if (added) ++t.names;
+    return added;
+}
+
+// Appends the names at and below node, in byte order, until out holds limit
+void trieCollect(const NameTrie &t, uint32_t node, string &path, vector<string> &out, size_t limit) {
+    if (out.size() >= limit) return;
+    if (t.nodes[node].rows) out.push_back(path);
+    for (uint32_t child = t.nodes[node].firstChild; child && out.size() < limit; child = t.nodes[child].nextSibling) {
+        const NameTrie::Node &n = t.nodes[child];
+        path.append(t.labels, n.label, n.labelLength);
+        trieCollect(t, child, path, out, limit);
+        path.resize(path.size() - n.labelLength);
+    }
+}
+
+// Rebuilds the tree from its own names, dropping the dead label bytes
+void compactTrie(NameTrie &t) {
+    NameTrie fresh;
+    string path;
+    function<void(uint32_t)> copy = [&](uint32_t node) {
+        if (t.nodes[node].rows) trieInsert(fresh, path, t.nodes[node].rows);
+        for (uint32_t child = t.nodes[node].firstChild; child; child = t.nodes[child].nextSibling) {
+            path.append(t.labels, t.nodes[child].label, t.nodes[child].labelLength);
+            copy(child);
+            path.resize(path.size() - t.nodes[child].labelLength);
+        }
+    };
+    copy(0);
+    t = move(fresh);
+}
+
+// Drops one row's name; the name stays while other rows still have it
+bool trieRemove(NameTrie &t, const string &name) {
+    struct Step {
+        uint32_t parent, prev, node;
+    };
+    vector<Step> path;
+    uint32_t node = 0;
+    size_t pos = 0;
+    while (pos < name.size()) {
+        uint32_t prev;
+        uint32_t child = findTrieChild(t, node, name[pos], prev);
+        if (!child) return false;
+        const NameTrie::Node &n = t.nodes[child];
+        if (n.labelLength > name.size() - pos || t.labels.compare(n.label, n.labelLength, name, pos, n.labelLength))
+            return false;
+        path.push_back({node, prev, child});
+        node = child;
+        pos += n.labelLength;
+    }
+    if (path.empty() || !t.nodes[node].rows) return false;
+    if (--t.nodes[node].rows) return true;
+    --t.names;
+
+    // Nodes that no longer lead to any name go back to the free list
+    while (!path.empty()) {
+        Step step = path.back();
+        NameTrie::Node &n = t.nodes[step.node];
+        if (n.rows || n.firstChild) break;
+        (step.prev ? t.nodes[step.prev].nextSibling : t.nodes[step.parent].firstChild) = n.nextSibling;
+        t.deadLabelBytes += n.labelLength;
+        t.freeNodes.push_back(step.node);
+        path.pop_back();
+    }
+    if (t.deadLabelBytes > t.labels.size() / 2) compactTrie(t);
+    return true;
+}
+
+// Where prefix ends, ignoring ASCII case: each node whose edge it ends on,
+// with the name spelled as stored up to the end of that edge
+void trieFind(const NameTrie &t, uint32_t node, const string &prefix, size_t pos, string &path,
+              vector<pair<uint32_t, string>> &ends) {
+    for (uint32_t child = t.nodes[node].firstChild; child; child = t.nodes[child].nextSibling) {
+        const NameTrie::Node &n = t.nodes[child];
+        size_t compare = min<size_t>(n.labelLength, prefix.size() - pos);
+        size_t i = 0;
+        while (i < compare && tolower((unsigned char)t.labels[n.label + i]) == tolower((unsigned char)prefix[pos + i]))
+            ++i;
+        if (i < compare) continue;
+        path.append(t.labels, n.label, n.labelLength);
+        if (pos + n.labelLength >= prefix.size()) ends.push_back({child, path});
+        else trieFind(t, child, prefix, pos + n.labelLength, path, ends);
+        path.resize(path.size() - n.labelLength);
+    }
+}
+
+// Up to limit names starting with prefix (any case), in byte order
+vector<string> suggestNames(NameIndex &index, const string &prefix, size_t limit) {
+    vector<string> names;
+    if (prefix.empty()) return names;
+    lock_guard<mutex> lock(index.lock);
+    vector<pair<uint32_t, string>> ends;
+    string path;
+    trieFind(index.trie, 0, prefix, 0, path, ends);
+    for (auto &end : ends) trieCollect(index.trie, end.first, end.second, names, limit);
+    return names;
+}
+
+// What Tab fills in: prefix, spelled as stored, extended for as long as
+// every name starting with it agrees
+string completeName(NameIndex &index, const string &prefix) {
+    if (prefix.empty()) return prefix;
+    lock_guard<mutex> lock(index.lock);
+    const NameTrie &t = index.trie;
+    vector<pair<uint32_t, string>> ends;
+    string path;
+    trieFind(t, 0, prefix, 0, path, ends);
+    if (ends.size() != 1) return prefix;
+    uint32_t node = ends[0].first;
+    path = ends[0].second;
+    while (!t.nodes[node].rows && t.nodes[node].firstChild &&
+           !t.nodes[t.nodes[node].firstChild].nextSibling) {
+        node = t.nodes[node].firstChild;
+        path.append(t.labels, t.nodes[node].label, t.nodes[node].labelLength);
+    }
+    return path;
+}
+
+// Gives back the spare capacity left from loading
+void shrinkTrie(NameTrie &t) {
+    t.nodes.shrink_to_fit();
+    t.labels.shrink_to_fit();
+}
+
+size_t trieBytes(const NameTrie &t) {
+    return sizeof(t) + t.nodes.capacity() * sizeof(NameTrie::Node) + t.labels.capacity() +
+           t.freeNodes.capacity() * sizeof(uint32_t);
+}
+
+void printNameIndex(NameIndex &index) {
+    lock_guard<mutex> lock(index.lock);
+    const NameTrie &t = index.trie;
+    cout << "name index      : " << t.names << " names, " << fixed << setprecision(1)
+         << trieBytes(t) / 1048576.0 << " MiB (" << t.nodes.size() - t.freeNodes.size() << " nodes of "
+         << sizeof(NameTrie::Node) << " bytes, " << (t.labels.size() - t.deadLabelBytes) / 1024 << " KiB of labels)\n"
+         << defaultfloat << setprecision(6);
+    const BkTree &b = index.typos;
+    cout << "typo tree       : " << b.live << " names, " << fixed << setprecision(1) << bkTreeBytes(b) / 1048576.0
+         << " MiB (" << b.nodes.size() << " nodes of " << sizeof(BkTree::Node) << " bytes, " << b.names.size() / 1024
+         << " KiB of names)\n"
+         << defaultfloat << setprecision(6);
+}
+
+// Up to limit names within TYPO_DISTANCE edits of typed, nearest first
+vector<string> closeNames(NameIndex &index, const string &typed, size_t limit) {
+    lock_guard<mutex> lock(index.lock);
+    size_t visited;
+    vector<string> names;
+    for (auto &match : bkSearch(index.typos, typed, TYPO_DISTANCE, visited)) {
+        if (names.size() == limit) break;
+        names.push_back(move(match.second));
+    }
+    return names;
+}
+
+void applyNameChanges(NameIndex &index, vector<NameChange> &changes) {
+    lock_guard<mutex> lock(index.lock);
+    for (auto &change : changes) {
+        if (change.hasOld) {
+            trieRemove(index.trie, change.oldName);
+            bkRemove(index.typos, change.oldName);
+        }
+        if (change.hasNew) {
+            trieInsert(index.trie, change.newName);
+            bkInsert(index.typos, change.newName);
+        }
+    }
+}
+
+// name_changed(old, new), called by the triggers below; NULL for no name
+void onNameChanged(sqlite3_context* fn, int, sqlite3_value** args) {
+    NameChange change;
+    const unsigned char* oldName = sqlite3_value_text(args[0]);
+    const unsigned char* newName = sqlite3_value_text(args[1]);
+    if ((change.hasOld = oldName != nullptr)) change.oldName = reinterpret_cast<const char*>(oldName);
+    if ((change.hasNew = newName != nullptr)) change.newName = reinterpret_cast<const char*>(newName);
+    static_cast<ChangeCapture*>(sqlite3_user_data(fn))->pendingNames.push_back(move(change));
+    sqlite3_result_null(fn);
+}
+
+const char* NAME_INDEX_TRIGGERS = R"(
+    CREATE TEMP TRIGGER IF NOT EXISTS products_names_insert AFTER INSERT ON main.products BEGIN
+        SELECT name_changed(NULL, new.name);
+    END;
+    CREATE TEMP TRIGGER IF NOT EXISTS products_names_update AFTER UPDATE OF name ON main.products
+    WHEN old.name IS NOT new.name BEGIN
+        SELECT name_changed(old.name, new.name);
+    END;
+    CREATE TEMP TRIGGER IF NOT EXISTS products_names_delete AFTER DELETE ON main.products BEGIN
+        SELECT name_changed(old.name, NULL);
+    END;
+)";
+
+// Hooks the writer and loads the names in one write operation, so no commit
+// can fall between the two and be counted twice
+bool startNameIndex(DbContext &ctx, NameIndex &index) {
+    ChangeCapture* capture = ctx.writer.capture;
+    NameIndex* target = &index;
+    auto hooked = submitWrite(ctx.writer, [capture, target](sqlite3* conn, bool &ok) {
+        capture->applyNames = [target](vector<NameChange> &changes) { applyNameChanges(*target, changes); };
+        ok = sqlite3_create_function(conn, "name_changed", 2, SQLITE_UTF8, capture, onNameChanged,
+                                     nullptr, nullptr) == SQLITE_OK &&
+             sqlite3_exec(conn, NAME_INDEX_TRIGGERS, nullptr, nullptr, nullptr) == SQLITE_OK;
+        sqlite3_stmt* stmt = nullptr;
+        if (!ok || sqlite3_prepare_v2(conn, "SELECT name FROM products ORDER BY name;", -1, &stmt,
+                                      nullptr) != SQLITE_OK)
+            return ok = false;
+
+        // In name order: each insert lands next to the last. Writes earlier
+        // in this transaction ran before the triggers, so they are read here once.
+        lock_guard<mutex> lock(target->lock);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            if (const unsigned char* name = sqlite3_column_text(stmt, 0)) {
+                trieInsert(target->trie, reinterpret_cast<const char*>(name));
+                bkInsert(target->typos, reinterpret_cast<const char*>(name));
+            }
+        sqlite3_finalize(stmt);
+        shrinkTrie(target->trie);
+        shrinkBkTree(target->typos);
+        target->loaded = true;
+        return ok;
+    }, false);
+    return hooked.get();
+}
+
+int readKey() {
+#ifdef _WIN32
+    return _getch();
+#else
+    return cin.get();
+#endif
+}
+
+// Reads one line like getline. On a terminal it lists the names starting
+// with what has been typed below the prompt after every key, and Tab fills
+// in as much as those names agree on. Piped input is read as a plain line.
+string readName(const string &prompt, NameIndex &index) {
+    cout << prompt << flush;
+    string line;
+#ifdef _WIN32
+    bool terminal = index.loaded && _isatty(_fileno(stdin));
+#else
+    termios saved;
+    bool terminal = index.loaded && isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved) == 0;
+    if (terminal) {
+        termios raw = saved;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        terminal = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+#endif
+    if (!terminal) {
+        getline(cin, line);
+        return line;
+    }
+
+    // The hints go on the line below; the cursor comes back to the end of the input
+    auto redraw = [&] {
+        string hints;
+        for (auto &name : suggestNames(index, line, NAME_SUGGESTIONS))
+            hints += (hints.empty() ? "" : "  |  ") + name;
+        if (hints.size() > NAME_HINT_WIDTH) {
+            size_t cut = NAME_HINT_WIDTH - 3;
+            while (cut > 0 && ((unsigned char)hints[cut] & 0xC0) == 0x80) --cut;
+            hints = hints.substr(0, cut) + "...";
+        }
+        cout << "\r\033[K" << prompt << line << "\n\033[K" << CYAN << hints << RESET
+             << "\033[A\r" << prompt << line << flush;
+    };
+    for (int key = readKey(); key != EOF && key != '\n' && key != '\r'; key = readKey()) {
+        if (key == 127 || key == 8) {
+            while (!line.empty() && ((unsigned char)line.back() & 0xC0) == 0x80) line.pop_back();
+            if (!line.empty()) line.pop_back();
+        } else if (key == '\t') {
+            line = completeName(index, line);
+#ifdef _WIN32
+        } else if (key == 0 || key == 224) {
+            readKey();      // arrow and function keys: a prefix and one code
+#else
+        } else if (key == 27) {
+            // Arrow and function keys: ESC [ (or O), parameters, one final byte
+            int next = readKey();
+            if (next == '[' || next == 'O')
+                for (next = readKey(); next != EOF && !(next >= 0x40 && next <= 0x7E); next = readKey()) {}
+#endif
+        } else if (key >= 32) {
+            line += (char)key;
+        }
+        redraw();
+    }
+    cout << "\n\033[K" << flush;
+#ifndef _WIN32
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+#endif
+    return line;
+}
+
+// ------------------------
+// Add Product
+// ------------------------
+void addProduct(DbContext &ctx) {
+    EntryBatch batch;
+    batch.noun = "product";
+    batch.insertSql = "INSERT INTO products (name, category, quantity, price) VALUES (?, ?, ?, ?);";
+    batch.headers = {"Name", "Category", "Quantity", "Price"};
+
+    char more = 'Y';
+    while (toupper(more) == 'Y') {
+        Product p;
+
+        cout << GREEN << "\n===== Add New Product =====\n" << RESET;
+
+        cin.ignore();
+        cout << "Enter Product Name: ";
+        getline(cin, p.name);
+
+        cout << "Enter Product Category: ";
+        getline(cin, p.category);
+
+        p.quantity = getIntInput("Enter Quantity: ");
+        p.price = getDoubleInput("Enter Price: ");
+
+        ostringstream price;
+        price << fixed << setprecision(2) << p.price;
+        batch.rows.push_back({{p.name, p.category, to_string(p.quantity), price.str()}, [p](sqlite3_stmt* stmt) {
+            sqlite3_bind_text(stmt, 1, p.name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, p.category.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 3, p.quantity);
+            sqlite3_bind_double(stmt, 4, p.price);
+        }});
+        printPendingRows(batch);
+
+        cout << "\nAdd another product? (Y/N): ";
+        cin >> more;
+    }
+    finishBatch(ctx, batch);
+    displayTable(ctx);
+}
+
+// ------------------------
+// View All Products
+// ------------------------
+void viewAllProducts(DbContext &ctx) {
+    cout << GREEN << "\n===== All Products =====\n" << RESET;
+    displayTable(ctx);
+}
+
+// ------------------------
+// Search Records
+// ------------------------
+void searchRecords(DbContext &ctx) {
+    cin.ignore();
+    string keyword;
+
+    cout << GREEN << "\n===== Current Inventory =====\n" << RESET;
+    displayTable(ctx);
+
+    cout << BLUE << "\nEnter product name to search: " << RESET;
+    getline(cin, keyword);
+
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT name, category, quantity, price FROM products WHERE name LIKE ?;");
+    if (!stmt) return;
+    string pattern = "%" + keyword + "%";
+    sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_STATIC);
+
+    QueryGuard guard;
+    guard.label = "Searching";
+    guard.timeoutMs = SEARCH_TIMEOUT_MS;
+    startQueryGuard(guard, sqlite3_db_handle(stmt));
+
+    bool found = false;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        found = true;
+        cout << GREEN << "\nProduct Found:\n" << RESET;
+        cout << "Name: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))
+             << "\nCategory: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))
+             << "\nQuantity: " << sqlite3_column_int(stmt, 2)
+             << "\nPrice: " << sqlite3_column_double(stmt, 3) << "\n";
+    }
+    sqlite3_reset(stmt);
+    QueryOutcome outcome = finishQueryGuard(guard, rc);
+
+    if (outcome != QUERY_DONE)
+        cout << RED << "\n" << queryOutcomeNote(guard, outcome) << "\n" << RESET;
+    else if (!found)
+        cout << RED << "\nNo matching product found.\n" << RESET;
+
+    cout << GREEN << "\n===== Updated Inventory Table =====\n" << RESET;
+    displayTable(ctx);
+}
+
+// ------------------------
+// Update Product
+// ------------------------
+const string SQL_UPDATE_PRODUCT = "UPDATE products SET name=?, category=?, quantity=?, price=? WHERE " +
+                                  foldedNameMatch("products", "name", 5) + ";";
+
+void updateProduct(DbContext &ctx) {
+    cin.ignore();
+    string name;
+
+    cout << GREEN << "\n===== Current Inventory =====\n" << RESET;
+    displayTable(ctx);
+
+    cout << BLUE << "Enter product name to update: " << RESET;
+    getline(cin, name);
+
+    Product p;
+    cout << "New Name: ";
+    getline(cin, p.name);
+    cout << "New Category: ";
+    getline(cin, p.category);
+    p.quantity = getIntInput("New Quantity: ");
+    p.price = getDoubleInput("New Price: ");
+
+    auto updated = submitWrite(ctx.writer, [p, name](sqlite3* conn, bool &ok) {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(conn, SQL_UPDATE_PRODUCT.c_str(), -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, p.name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, p.category.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 3, p.quantity);
+        sqlite3_bind_double(stmt, 4, p.price);
+        sqlite3_bind_text(stmt, 5, name.c_str(), -1, SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        return ok;
+    }, false);
+
+    if (!updated.get())
+        cerr << RED << "Error updating product.\n" << RESET;
+    else
+        cout << GREEN << "Product updated successfully!\n" << RESET;
+
+    displayTable(ctx);
+}
+
+// ------------------------
+// Delete Product
+// ------------------------
+const string SQL_DELETE_PRODUCT = "DELETE FROM products WHERE " + foldedNameMatch("products", "name", 1) + ";";
+
+void deleteProduct(DbContext &ctx) {
+    cin.ignore();
+    string name;
+
+    cout << GREEN << "\n===== Current Inventory =====\n" << RESET;
+    displayTable(ctx);
+
+    cout << BLUE << "Enter product name to delete: " << RESET;
+    getline(cin, name);
+
+    auto deleted = submitWrite(ctx.writer, [name](sqlite3* conn, bool &ok) {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(conn, SQL_DELETE_PRODUCT.c_str(), -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        return ok;
+    }, false);
+
+    if (!deleted.get())
+        cerr << RED << "Error deleting product.\n" << RESET;
+    else
+        cout << GREEN << "Product deleted successfully!\n" << RESET;
+
+    displayTable(ctx);
+}
+
+// ------------------------
+// Process Sales
+// ------------------------
+enum SaleResult { SALE_OK, SALE_NOT_FOUND, SALE_NO_STOCK, SALE_ERROR };
+
+// The name is matched under FOLD, an exact spelling first
+const char* SQL_SELL_PRODUCT = "UPDATE products SET quantity = quantity - ?1 "
+                               "WHERE id = (SELECT id FROM products WHERE name = ?2 COLLATE FOLD "
+                               "ORDER BY name = ?2 DESC, id LIMIT 1) "
+                               "AND quantity >= ?1 RETURNING quantity;";
+const char* SQL_PRODUCT_STOCK = "SELECT quantity FROM products WHERE name = ?1 COLLATE FOLD "
+                                "ORDER BY name = ?1 DESC, id LIMIT 1;";
+
+// Deducts qty from the product's stock in one statement, so concurrent sales
+// cannot both pass the stock check.
+SaleResult sellProduct(sqlite3* conn, const string &name, int qty, int &remaining) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(conn, SQL_SELL_PRODUCT, -1, &stmt, nullptr) != SQLITE_OK)
+        return SALE_ERROR;
+    sqlite3_bind_int(stmt, 1, qty);
+    sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) remaining = sqlite3_column_int(stmt, 0);
+    // RETURNING rows are only final once the statement has run to completion
+    if (rc == SQLITE_ROW) rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) return SALE_ERROR;
+    if (sqlite3_changes(conn) > 0) return SALE_OK;
+
+    sqlite3_prepare_v2(conn, SQL_PRODUCT_STOCK, -1, &stmt, nullptr);
+    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+    if (exists) remaining = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return exists ? SALE_NO_STOCK : SALE_NOT_FOUND;
+}
+
+// Queues the sale on the writer and waits for its group commit
+SaleResult submitSale(DbContext &ctx, const string &name, int qty, int &remaining) {
+    auto sale = submitWrite(ctx.writer, [name, qty](sqlite3* conn, pair<SaleResult, int> &out) {
+        out.first = sellProduct(conn, name, qty, out.second);
+        return out.first == SALE_OK;
+    }, make_pair(SALE_ERROR, 0));
+    auto outcome = sale.get();
+    remaining = outcome.second;
+    return outcome.first;
+}
+
+void processSales(DbContext &ctx) {
+    cin.ignore();
+    string name;
+
+    cout << GREEN << "\n===== Current Inventory =====\n" << RESET;
+    displayTable(ctx);
+
+    name = readName(BLUE "Enter product name to sell: " RESET, productNames);
+
+    int qty;
+    cout << "Enter quantity sold: ";
+    cin >> qty;
+
+    // A miss offers the closest names; picking one retries the sale with it
+    int remaining = 0;
+    SaleResult result;
+    while ((result = submitSale(ctx, name, qty, remaining)) == SALE_NOT_FOUND) {
+        cout << RED << "\nProduct not found.\n" << RESET;
+        vector<string> close = closeNames(productNames, name, TYPO_SUGGESTIONS);
+        if (close.empty()) return;
+        cout << YELLOW << "Did you mean:\n" << RESET;
+        for (size_t i = 0; i < close.size(); ++i)
+            cout << "  " << i + 1 << ". " << close[i] << "\n";
+        int pick = 0;
+        cout << "Sell which one? (0 for none): ";
+        if (!(cin >> pick)) {
+            cin.clear();
+            pick = 0;
+        }
+        if (pick < 1 || pick > (int)close.size()) return;
+        name = close[pick - 1];
+    }
+    switch (result) {
+        case SALE_NOT_FOUND:
+            return;
+        case SALE_NO_STOCK:
+            cout << RED << "\nNot enough stock!\n" << RESET;
+            return;
+        case SALE_ERROR:
+            cerr << RED << "Error updating stock.\n" << RESET;
+            return;
+        case SALE_OK:
+            break;
+    }
+
+    cout << GREEN << "\nSale processed successfully!\n" << RESET;
+    displayTable(ctx);
+}
+
+// ------------------------
+// Low Stock Alerts
+// ------------------------
+void lowStockAlerts(DbContext &ctx) {
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT name, quantity FROM products WHERE quantity < 5;");
+    if (!stmt) return;
+
+    bool any = false;
+    cout << YELLOW << "\n===== LOW STOCK PRODUCTS (Qty < 5) =====\n" << RESET;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        any = true;
+        cout << RED << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))
+             << " Qty: " << sqlite3_column_int(stmt, 1) << RESET << "\n";
+    }
+    sqlite3_reset(stmt);
+
+    if (!any)
+        cout << GREEN << "All stocks are sufficient.\n" << RESET;
+}
+
+// ------------------------
+// Inventory Valuation Report
+// ------------------------
+struct CategoryValue {
+    long long products = 0;
+    double units = 0;
+    double value = 0;
+};
+
+bool inventoryValuation(DbContext &ctx, int threads, map<string, CategoryValue> &byCategory,
+                        QueryGuard* guard = nullptr) {
+    return parallelScan(ctx, "products",
+        "SELECT COALESCE(category, ''), count(*), total(quantity), total(quantity * price) "
+        "FROM products WHERE rowid BETWEEN ?1 AND ?2 GROUP BY 1;",
+        threads, byCategory,
+        [](sqlite3_stmt* stmt, map<string, CategoryValue> &partial) {
+            CategoryValue &c = partial[reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))];
+            c.products += sqlite3_column_int64(stmt, 1);
+            c.units += sqlite3_column_double(stmt, 2);
+            c.value += sqlite3_column_double(stmt, 3);
+        },
+        [](map<string, CategoryValue> &total, const map<string, CategoryValue> &partial) {
+            for (auto &entry : partial) {
+                CategoryValue &c = total[entry.first];
+                c.products += entry.second.products;
+                c.units += entry.second.units;
+                c.value += entry.second.value;
+            }
+        }, guard);
+}
+
+void valuationReport(DbContext &ctx, int threads) {
+    map<string, CategoryValue> byCategory;
+    auto start = chrono::steady_clock::now();
+    QueryGuard guard;
+    guard.label = "Valuing inventory";
+    guard.timeoutMs = REPORT_TIMEOUT_MS;
+    startQueryGuard(guard, nullptr);
+    bool complete = inventoryValuation(ctx, threads, byCategory, &guard);
+    QueryOutcome outcome = finishQueryGuard(guard, complete ? SQLITE_DONE : SQLITE_ERROR);
+    if (outcome == QUERY_FAILED) {
+        cerr << RED << "\nCould not compute the inventory valuation.\n" << RESET;
+        return;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    int catWidth = 20, countWidth = 10, unitWidth = 12, valueWidth = 16;
+    int tableWidth = catWidth + countWidth + unitWidth + valueWidth + 7;
+    cout << GREEN << "\n===== Inventory Valuation =====\n" << RESET;
+    cout << "+" << string(tableWidth, '-') << "+\n";
+    cout << CYAN
+         << "| " << left << setw(catWidth) << "Category"
+         << "| " << setw(countWidth) << "Products"
+         << "| " << setw(unitWidth) << "Units"
+         << "| " << setw(valueWidth) << "Value"
+         << "|\n" << RESET;
+    cout << "+" << string(tableWidth, '-') << "+\n";
+
+    CategoryValue all;
+    cout << fixed << setprecision(2);
+    for (auto &entry : byCategory) {
+        const CategoryValue &c = entry.second;
+        cout << "| " << left << setw(catWidth) << entry.first.substr(0, catWidth - 1)
+             << "| " << setw(countWidth) << c.products
+             << "| " << setw(unitWidth) << setprecision(0) << c.units
+             << "| " << setw(valueWidth) << setprecision(2) << c.value << "|\n";
+        all.products += c.products;
+        all.units += c.units;
+        all.value += c.value;
+    }
+    cout << "+" << string(tableWidth, '-') << "+\n";
+    cout << BOLD
+         << "| " << left << setw(catWidth) << "TOTAL"
+         << "| " << setw(countWidth) << all.products
+         << "| " << setw(unitWidth) << setprecision(0) << all.units
+         << "| " << setw(valueWidth) << setprecision(2) << all.value << "|\n" << RESET;
+    cout << "+" << string(tableWidth, '-') << "+\n";
+    cout << defaultfloat << setprecision(6);
+    cout << "Scanned with up to " << threads << " threads in " << (long long)ms << " ms\n";
+    if (outcome != QUERY_DONE)
+        cout << RED << queryOutcomeNote(guard, outcome) << "\n" << RESET;
+}
+
+// ------------------------
+// HTTP Server (inventory serve)
+// ------------------------
+// A small HTTP/1.1 JSON API on localhost so several tills can share one
+// inventory.db. A fixed pool of workers serves connections, each worker with
+// its own read-only SQLite connection; sales go through the write queue.
+//
+//   GET  /products?limit=50&after=<id>           list, keyset-paginated by id
+//   GET  /products/search?q=<text>&limit=&after=  name search
+//   GET  /products/search?prefix=<text>&limit=&after=
+//                    names starting with text, any case or accents (FOLD index)
+//   GET  /products/low-stock?threshold=5
+//   POST /sell   {"name":"<product>","qty":<n>} as application/json
+//
+// No CORS headers are sent, and a sale must be a JSON body: a page on another
+// site can make the browser post a form here, but not application/json
+// without a preflight that this server never approves. Each request has to
+// arrive in full within HTTP_REQUEST_SECONDS.
+#ifdef _WIN32
+typedef SOCKET socket_t;
+const socket_t INVALID_SOCK = INVALID_SOCKET;
+void closeSocket(socket_t s) { closesocket(s); }
+int poll(pollfd* fds, unsigned long count, int timeout) { return WSAPoll(fds, count, timeout); }
+#else
+typedef int socket_t;
+const socket_t INVALID_SOCK = -1;
+void closeSocket(socket_t s) { close(s); }
+#endif
+
+const int HTTP_MAX_HEADER = 16 * 1024;
+const int HTTP_MAX_PAGE = 500;
+const int HTTP_REQUEST_SECONDS = 5;
+
+bool initSockets() {
+#ifdef _WIN32
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+    signal(SIGPIPE, SIG_IGN);
+    return true;
+#endif
+}
+
+void setSocketTimeout(socket_t s, int seconds) {
+#ifdef _WIN32
+    DWORD ms = seconds * 1000;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#else
+    timeval tv{seconds, 0};
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+}
+
+bool sendAll(socket_t s, const string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(s, data.data() + sent, (int)(data.size() - sent), 0);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+struct HttpRequest {
+    string method;
+    string path;
+    string contentType;             // lowercase, without parameters
+    map<string, string> params;     // query string and form or JSON body
+    bool validBody = true;          // false for a JSON body that did not parse
+    bool keepAlive = true;
+};
+
+struct HttpResponse {
+    int status = 200;
+    string body;
+};
+
+string urlDecode(const string &text) {
+    string out;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            out += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() && isxdigit((unsigned char)text[i + 1])
+                   && isxdigit((unsigned char)text[i + 2])) {
+            out += (char)stoi(text.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+void parseParams(const string &text, map<string, string> &params) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('&', start);
+        if (end == string::npos) end = text.size();
+        string pair = text.substr(start, end - start);
+        size_t eq = pair.find('=');
+        if (eq != string::npos)
+            params[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+        else if (!pair.empty())
+            params[urlDecode(pair)] = "";
+        start = end + 1;
+    }
+}
+
+void appendUtf8(string &out, unsigned code) {
+    if (code < 0x80) {
+        out += (char)code;
+    } else if (code < 0x800) {
+        out += (char)(0xC0 | code >> 6);
+        out += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += (char)(0xE0 | code >> 12);
+        out += (char)(0x80 | (code >> 6 & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    } else {
+        out += (char)(0xF0 | code >> 18);
+        out += (char)(0x80 | (code >> 12 & 0x3F));
+        out += (char)(0x80 | (code >> 6 & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+// A flat JSON object such as {"name":"Soap","qty":2} into params, values kept
+// as text like form fields; false for anything else (arrays, nested objects)
+bool parseJsonObject(const string &text, map<string, string> &params) {
+    size_t i = 0;
+    auto skipSpace = [&] {
+        while (i < text.size() && isspace((unsigned char)text[i])) ++i;
+    };
+    auto hex4 = [&](size_t at, unsigned &code) {
+        if (at + 4 > text.size()) return false;
+        code = 0;
+        for (size_t k = at; k < at + 4; ++k) {
+            if (!isxdigit((unsigned char)text[k])) return false;
+            code = code * 16 + (isdigit((unsigned char)text[k]) ? text[k] - '0' : (tolower(text[k]) - 'a' + 10));
+        }
+        return true;
+    };
+    auto readString = [&](string &out) {
+        if (i >= text.size() || text[i] != '"') return false;
+        for (++i; i < text.size(); ++i) {
+            char c = text[i];
+            if (c == '"') {
+                ++i;
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (++i == text.size()) return false;
+            unsigned code, low;
+            switch (text[i]) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                    if (!hex4(i + 1, code)) return false;
+                    i += 4;
+                    if (code >= 0xD800 && code < 0xDC00 && text.compare(i + 1, 2, "\\u") == 0 &&
+                        hex4(i + 3, low) && low >= 0xDC00 && low < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                    appendUtf8(out, code);
+                    break;
+                default: out += text[i];    // \" \\ \/
+            }
+        }
+        return false;
+    };
+
+    skipSpace();
+    if (i >= text.size() || text[i++] != '{') return false;
+    skipSpace();
+    if (i < text.size() && text[i] == '}') return true;
+    while (true) {
+        string key, value;
+        skipSpace();
+        if (!readString(key)) return false;
+        skipSpace();
+        if (i >= text.size() || text[i++] != ':') return false;
+        skipSpace();
+        if (i < text.size() && text[i] == '"') {
+            if (!readString(value)) return false;
+        } else {
+            size_t start = i;
+            // a number, true, false or null
+            while (i < text.size() && (isalnum((unsigned char)text[i]) || (text[i] && strchr("+-.", text[i])))) ++i;
+            value = text.substr(start, i - start);
+            if (value.empty()) return false;
+            if (value == "null") value.clear();
+        }
+        params[key] = value;
+        skipSpace();
+        if (i < text.size() && text[i] == ',') {
+            ++i;
+            continue;
+        }
+        if (i >= text.size() || text[i++] != '}') return false;
+        skipSpace();
+        return i == text.size();
+    }
+}
+
+string jsonError(const string &message) {
+    return "{\"error\":\"" + jsonEscape(message) + "\"}";
+}
+
+// The fallback also stands in for a value that is not a whole number
+long long paramInt(const HttpRequest &req, const string &key, long long fallback) {
+    auto it = req.params.find(key);
+    if (it == req.params.end() || it->second.empty()) return fallback;
+    char* end;
+    errno = 0;
+    long long value = strtoll(it->second.c_str(), &end, 10);
+    return *end || errno == ERANGE ? fallback : value;
+}
+
+string paramText(const HttpRequest &req, const string &key) {
+    auto it = req.params.find(key);
+    return it == req.params.end() ? "" : it->second;
+}
+
+// recv() that gives up at the deadline. SO_RCVTIMEO only bounds each call, so
+// a client sending a byte every few seconds could otherwise hold a worker.
+int recvBefore(socket_t s, char* chunk, int size, chrono::steady_clock::time_point deadline) {
+    auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+    pollfd readable{};
+    readable.fd = s;
+    readable.events = POLLIN;
+    if (left <= 0 || poll(&readable, 1, (int)left) <= 0) return -1;
+    return recv(s, chunk, size, 0);
+}
+
+// Reads one request from a keep-alive connection; buffer carries over
+// whatever the client pipelined after it.
+bool readHttpRequest(socket_t s, string &buffer, HttpRequest &req) {
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(HTTP_REQUEST_SECONDS);
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+        if (buffer.size() > (size_t)HTTP_MAX_HEADER) return false;
+        char chunk[4096];
+        int n = recvBefore(s, chunk, sizeof(chunk), deadline);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+
+    istringstream head(buffer.substr(0, headerEnd));
+    string line, target, version;
+    getline(head, line);
+    istringstream requestLine(line);
+    requestLine >> req.method >> target >> version;
+    req.keepAlive = version != "HTTP/1.0";
+
+    size_t contentLength = 0;
+    while (getline(head, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == string::npos) continue;
+        string key = line.substr(0, colon), value = line.substr(colon + 1);
+        transform(key.begin(), key.end(), key.begin(), ::tolower);
+        value.erase(0, value.find_first_not_of(' '));
+        transform(value.begin(), value.end(), value.begin(), ::tolower);
+        if (key == "content-length") contentLength = strtoul(value.c_str(), nullptr, 10);
+        else if (key == "content-type") req.contentType = value.substr(0, value.find_first_of("; "));
+        else if (key == "connection") req.keepAlive = value != "close" && (value == "keep-alive" || req.keepAlive);
+    }
+    if (contentLength > 1024 * 1024) return false;
+
+    size_t total = headerEnd + 4 + contentLength;
+    while (buffer.size() < total) {
+        char chunk[4096];
+        int n = recvBefore(s, chunk, sizeof(chunk), deadline);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    string body = buffer.substr(headerEnd + 4, contentLength);
+    buffer.erase(0, total);
+
+    size_t q = target.find('?');
+    req.path = target.substr(0, q);
+    req.params.clear();
+    if (q != string::npos) parseParams(target.substr(q + 1), req.params);
+    if (req.contentType == "application/json") req.validBody = parseJsonObject(body, req.params);
+    else parseParams(body, req.params);
+    return !req.method.empty();
+}
+
+string httpStatusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 415: return "Unsupported Media Type";
+        default:  return "Internal Server Error";
+    }
+}
+
+bool sendHttpResponse(socket_t s, const HttpResponse &res, bool keepAlive) {
+    ostringstream out;
+    out << "HTTP/1.1 " << res.status << " " << httpStatusText(res.status) << "\r\n"
+        << "Content-Type: application/json\r\n"
+        << "Content-Length: " << res.body.size() << "\r\n"
+        << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n\r\n"
+        << res.body;
+    return sendAll(s, out.str());
+}
+
+const char* SQL_LIST_PRODUCTS = "SELECT id, name, category, quantity, price FROM products "
+                                "WHERE id > ? ORDER BY id LIMIT ?;";
+const char* SQL_SEARCH_PRODUCTS = "SELECT id, name, category, quantity, price FROM products "
+                                  "WHERE name LIKE ? AND id > ? ORDER BY id LIMIT ?;";
+// +id keeps the planner on the name range rather than walking every id in order
+const string SQL_PREFIX_PRODUCTS = "SELECT id, name, category, quantity, price FROM products "
+                                  "WHERE " + foldedPrefixMatch("name") + " AND +id > ? ORDER BY id LIMIT ?;";
+const char* SQL_LOW_STOCK = "SELECT id, name, category, quantity, price FROM products "
+                            "WHERE quantity < ? ORDER BY quantity, id;";
+
+// Runs a bound product query and renders {"items":[...],"next":id|null}
+string productsJson(sqlite3_stmt* stmt, int limit) {
+    ostringstream out;
+    out << fixed << setprecision(2) << "{\"items\":[";
+    int count = 0;
+    sqlite3_int64 lastId = 0;
+    while (stmt && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        const char* category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        lastId = sqlite3_column_int64(stmt, 0);
+        out << (count++ ? "," : "")
+            << "{\"id\":" << lastId
+            << ",\"name\":\"" << jsonEscape(name ? name : "")
+            << "\",\"category\":\"" << jsonEscape(category ? category : "")
+            << "\",\"quantity\":" << sqlite3_column_int(stmt, 3)
+            << ",\"price\":" << sqlite3_column_double(stmt, 4) << "}";
+    }
+    sqlite3_reset(stmt);
+    out << "],\"next\":";
+    if (limit > 0 && count == limit) out << lastId;
+    else out << "null";
+    out << "}";
+    return out.str();
+}
+
+HttpResponse handleSell(const HttpRequest &req, DbContext &ctx) {
+    HttpResponse res;
+    if (req.contentType != "application/json") {
+        res.status = 415;
+        res.body = jsonError("send the sale as application/json");
+        return res;
+    }
+    string name = paramText(req, "name");
+    long long qty = paramInt(req, "qty", 0);
+    if (!req.validBody || name.empty() || qty <= 0 || qty > numeric_limits<int>::max()) {
+        res.status = 400;
+        res.body = jsonError("a JSON object with name and a positive qty is required");
+        return res;
+    }
+
+    int remaining = 0;
+    switch (submitSale(ctx, name, (int)qty, remaining)) {
+        case SALE_OK:
+            res.body = "{\"ok\":true,\"name\":\"" + jsonEscape(name) + "\",\"sold\":" + to_string(qty)
+                     + ",\"remaining\":" + to_string(remaining) + "}";
+            break;
+        case SALE_NOT_FOUND:
+            res.status = 404;
+            res.body = jsonError("product not found");
+            break;
+        case SALE_NO_STOCK:
+            res.status = 409;
+            res.body = "{\"error\":\"not enough stock\",\"remaining\":" + to_string(remaining) + "}";
+            break;
+        case SALE_ERROR:
+            res.status = 500;
+            res.body = jsonError("could not update stock");
+            break;
+    }
+    return res;
+}
+
+HttpResponse routeRequest(const HttpRequest &req, DbContext &ctx) {
+    HttpResponse res;
+    int limit = (int)max(1LL, min(paramInt(req, "limit", 50), (long long)HTTP_MAX_PAGE));
+
+    if (req.path == "/sell") {
+        if (req.method != "POST") {
+            res.status = 405;
+            res.body = jsonError("use POST");
+            return res;
+        }
+        return handleSell(req, ctx);
+    }
+    if (req.method != "GET") {
+        res.status = 405;
+        res.body = jsonError("use GET");
+        return res;
+    }
+
+    if (req.path == "/products") {
+        sqlite3_stmt* list = readStatement(ctx, SQL_LIST_PRODUCTS);
+        sqlite3_bind_int64(list, 1, paramInt(req, "after", 0));
+        sqlite3_bind_int(list, 2, limit);
+        res.body = productsJson(list, limit);
+    } else if (req.path == "/products/search" && !paramText(req, "prefix").empty()) {
+        sqlite3_stmt* search = readStatement(ctx, SQL_PREFIX_PRODUCTS);
+        string prefix = paramText(req, "prefix"), end = foldPrefixEnd(prefix);
+        sqlite3_bind_text(search, 1, prefix.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(search, 2, end.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(search, 3, paramInt(req, "after", 0));
+        sqlite3_bind_int(search, 4, limit);
+        res.body = productsJson(search, limit);
+    } else if (req.path == "/products/search") {
+        sqlite3_stmt* search = readStatement(ctx, SQL_SEARCH_PRODUCTS);
+        string pattern = "%" + paramText(req, "q") + "%";
+        sqlite3_bind_text(search, 1, pattern.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(search, 2, paramInt(req, "after", 0));
+        sqlite3_bind_int(search, 3, limit);
+        res.body = productsJson(search, limit);
+    } else if (req.path == "/products/low-stock") {
+        sqlite3_stmt* lowStock = readStatement(ctx, SQL_LOW_STOCK);
+        sqlite3_bind_int64(lowStock, 1, paramInt(req, "threshold", 5));
+        res.body = productsJson(lowStock, 0);
+    } else {
+        res.status = 404;
+        res.body = jsonError("no such endpoint");
+    }
+    return res;
+}
+
+// A connection between requests; buffer keeps any pipelined bytes
+struct HttpConnection {
+    socket_t sock;
+    string buffer;
+    chrono::steady_clock::time_point lastActive;
+};
+
+// One I/O thread polls the listener and idle keep-alive connections and hands
+// readable ones to the workers, so a slow or idle client never ties up a worker.
+struct HttpServer {
+    DbContext* ctx = nullptr;
+    socket_t listener = INVALID_SOCK;
+    socket_t wakeSocket = INVALID_SOCK;     // loopback UDP socket to interrupt poll()
+    sockaddr_in wakeAddr{};
+    int port = 0;
+    atomic<bool> running{false};
+    vector<thread> workers;
+    thread poller;
+
+    mutex queueMutex;
+    condition_variable queueReady;
+    deque<HttpConnection*> ready;           // readable, waiting for a worker
+    vector<HttpConnection*> returned;       // served, back to the poller
+};
+
+const int HTTP_IDLE_SECONDS = 30;
+
+void wakePoller(HttpServer* server) {
+    char byte = 0;
+    sendto(server->wakeSocket, &byte, 1, 0, reinterpret_cast<sockaddr*>(&server->wakeAddr), sizeof(server->wakeAddr));
+}
+
+void httpWorker(HttpServer* server) {
+    if (!readConnection(*server->ctx)) {
+        cerr << RED << "Worker could not open " << server->ctx->path << RESET << endl;
+        return;
+    }
+    while (true) {
+        HttpConnection* conn;
+        {
+            unique_lock<mutex> lock(server->queueMutex);
+            server->queueReady.wait(lock, [&] { return !server->ready.empty() || !server->running; });
+            if (server->ready.empty()) break;
+            conn = server->ready.front();
+            server->ready.pop_front();
+        }
+
+        // Serve whatever the client has sent, then give the connection back
+        bool keep = true;
+        do {
+            HttpRequest req;
+            keep = readHttpRequest(conn->sock, conn->buffer, req);
+            if (keep) keep = sendHttpResponse(conn->sock, routeRequest(req, *server->ctx), req.keepAlive) && req.keepAlive;
+        } while (keep && conn->buffer.find("\r\n\r\n") != string::npos);
+
+        if (!keep) {
+            closeSocket(conn->sock);
+            delete conn;
+            continue;
+        }
+        conn->lastActive = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> lock(server->queueMutex);
+            server->returned.push_back(conn);
+        }
+        wakePoller(server);
+    }
+    releaseReadConnection(*server->ctx);
+}
+
+void pollLoop(HttpServer* server) {
+    vector<HttpConnection*> idle;
+    vector<pollfd> fds;
+    while (server->running) {
+        {
+            lock_guard<mutex> lock(server->queueMutex);
+            idle.insert(idle.end(), server->returned.begin(), server->returned.end());
+            server->returned.clear();
+        }
+
+        fds.assign(2 + idle.size(), pollfd{});
+        fds[0].fd = server->listener;
+        fds[1].fd = server->wakeSocket;
+        for (size_t i = 0; i < idle.size(); ++i) fds[2 + i].fd = idle[i]->sock;
+        for (auto &f : fds) f.events = POLLIN;
+        if (poll(fds.data(), (unsigned long)fds.size(), 1000) < 0) continue;
+
+        if (fds[1].revents) {
+            char drain[64];
+            recv(server->wakeSocket, drain, sizeof(drain), 0);
+        }
+
+        auto now = chrono::steady_clock::now();
+        vector<HttpConnection*> stillIdle;
+        int handedOff = 0;
+        for (size_t i = 0; i < idle.size(); ++i) {
+            if (fds[2 + i].revents) {
+                lock_guard<mutex> lock(server->queueMutex);
+                server->ready.push_back(idle[i]);
+                handedOff++;
+            } else if (now - idle[i]->lastActive > chrono::seconds(HTTP_IDLE_SECONDS)) {
+                closeSocket(idle[i]->sock);
+                delete idle[i];
+            } else {
+                stillIdle.push_back(idle[i]);
+            }
+        }
+        idle.swap(stillIdle);
+
+        if (fds[0].revents && server->running) {
+            socket_t client = accept(server->listener, nullptr, nullptr);
+            if (client != INVALID_SOCK) {
+                setSocketTimeout(client, HTTP_REQUEST_SECONDS);
+                idle.push_back(new HttpConnection{client, "", now});
+            }
+        }
+        for (int i = 0; i < handedOff; ++i) server->queueReady.notify_one();
+    }
+
+    for (auto conn : idle) {
+        closeSocket(conn->sock);
+        delete conn;
+    }
+}
+
+bool openLoopbackSocket(socket_t &s, int type, int port, sockaddr_in &addr) {
+    s = socket(AF_INET, type, 0);
+    if (s == INVALID_SOCK) return false;
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+    addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    socklen_t len = sizeof(addr);
+    if (::bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || getsockname(s, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        closeSocket(s);
+        return false;
+    }
+    return true;
+}
+
+// Binds to 127.0.0.1:port (0 picks a free port) and starts the workers
+bool startHttpServer(HttpServer &server, DbContext &ctx, int port, int workerCount) {
+    if (!initSockets()) return false;
+
+    sockaddr_in addr;
+    if (!openLoopbackSocket(server.listener, SOCK_STREAM, port, addr)) return false;
+    if (listen(server.listener, 128) != 0
+        || !openLoopbackSocket(server.wakeSocket, SOCK_DGRAM, 0, server.wakeAddr)) {
+        closeSocket(server.listener);
+        return false;
+    }
+    server.port = ntohs(addr.sin_port);
+
+    server.ctx = &ctx;
+    server.running = true;
+    for (int i = 0; i < workerCount; ++i)
+        server.workers.emplace_back(httpWorker, &server);
+    server.poller = thread(pollLoop, &server);
+    return true;
+}
+
+void stopHttpServer(HttpServer &server) {
+    server.running = false;
+    wakePoller(&server);
+    server.poller.join();
+
+    server.queueReady.notify_all();
+    for (auto &w : server.workers) w.join();
+    for (auto conn : server.ready) {
+        closeSocket(conn->sock);
+        delete conn;
+    }
+    for (auto conn : server.returned) {
+        closeSocket(conn->sock);
+        delete conn;
+    }
+    closeSocket(server.listener);
+    closeSocket(server.wakeSocket);
+}
+
+volatile sig_atomic_t serveStopRequested = 0;
+
+// Ctrl-C (or SIGTERM) stops the server and returns, so the database is closed
+// properly on the way out
+int serveInventory(DbContext &ctx, int port, int workerCount) {
+    HttpServer server;
+    if (!startHttpServer(server, ctx, port, workerCount)) {
+        cerr << RED << "Could not listen on 127.0.0.1:" << port << RESET << endl;
+        return 1;
+    }
+    cout << GREEN << "Serving inventory on http://127.0.0.1:" << server.port
+         << " with " << workerCount << " workers (Ctrl-C to stop)\n" << RESET;
+    signal(SIGINT, [](int) { serveStopRequested = 1; });
+    signal(SIGTERM, [](int) { serveStopRequested = 1; });
+    while (!serveStopRequested) this_thread::sleep_for(chrono::milliseconds(200));
+    stopHttpServer(server);
+    cout << "Stopped.\n";
+    return 0;
+}
+
+// ------------------------
+// Name Lookup Plans
+// ------------------------
+// An in-memory copy of the schema with no statistics, for the plan check. The
+// planner then weighs products as a large table, so the check tests the index
+// rather than what ANALYZE last made of the rows this database holds.
+sqlite3* openPlanSchema(DbContext &ctx) {
+    sqlite3_stmt* schema = readStatement(ctx, "SELECT sql FROM sqlite_schema "
+                                              "WHERE sql IS NOT NULL AND name NOT LIKE 'sqlite_%' ORDER BY rowid;");
+    sqlite3* conn = nullptr;
+    bool ok = schema && sqlite3_open(":memory:", &conn) == SQLITE_OK;
+    while (ok && sqlite3_step(schema) == SQLITE_ROW)
+        ok = sqlite3_exec(conn, reinterpret_cast<const char*>(sqlite3_column_text(schema, 0)), nullptr, nullptr,
+                          nullptr) == SQLITE_OK;
+    if (schema) sqlite3_reset(schema);
+    if (!ok) {
+        cerr << RED << "Could not copy the schema: " << (conn ? sqlite3_errmsg(conn) : "no database") << RESET << endl;
+        sqlite3_close(conn);
+        return nullptr;
+    }
+    return conn;
+}
+
+// Runs EXPLAIN QUERY PLAN on every statement that finds products by name and
+// fails if any of them would read the whole table instead of the FOLD index
+bool checkNameLookupPlans(sqlite3* conn) {
+    const vector<pair<string, string>> lookups = {
+        {"sale", SQL_SELL_PRODUCT},
+        {"stock check", SQL_PRODUCT_STOCK},
+        {"update", SQL_UPDATE_PRODUCT},
+        {"delete", SQL_DELETE_PRODUCT},
+        {"prefix search", SQL_PREFIX_PRODUCTS},
+    };
+    bool allIndexed = true;
+    for (auto &lookup : lookups) {
+        string sql = "EXPLAIN QUERY PLAN " + lookup.second;
+        sqlite3_stmt* plan;
+        if (sqlite3_prepare_v2(conn, sql.c_str(), -1, &plan, nullptr) != SQLITE_OK) {
+            cerr << RED << lookup.first << ": " << sqlite3_errmsg(conn) << RESET << endl;
+            return false;
+        }
+        string detail;
+        bool scans = false;
+        while (sqlite3_step(plan) == SQLITE_ROW) {
+            string step = reinterpret_cast<const char*>(sqlite3_column_text(plan, 3));
+            scans = scans || step.compare(0, 5, "SCAN ") == 0;
+            detail += (detail.empty() ? "" : "; ") + step;
+        }
+        sqlite3_finalize(plan);
+        allIndexed = allIndexed && !scans;
+        cout << (scans ? RED "FULL SCAN " : GREEN "ok        ") << RESET
+             << left << setw(15) << lookup.first << detail << "\n" << right;
+    }
+    return allIndexed;
+}
+
+// ------------------------
+// HTTP Load Test
+// ------------------------
+// Starts the server on a free loopback port and hammers it from several
+// keep-alive clients, mostly list/search requests with some sales mixed in.
+// It serves a scratch copy of the database, so the test product and its sales
+// never reach inventory.db.
+struct LoadTestClient {
+    long long requests = 0;
+    long long errors = 0;
+    vector<double> latenciesUs;
+};
+
+void runLoadClient(int port, int requestCount, int seed, LoadTestClient &result) {
+    socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    if (connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        result.errors = requestCount;
+        closeSocket(s);
+        return;
+    }
+    setSocketTimeout(s, 5);
+
+    string buffer;
+    for (int i = 0; i < requestCount; ++i) {
+        int kind = (seed + i) % 10;
+        string request;
+        if (kind < 6)
+            request = "GET /products?limit=20&after=" + to_string((seed * 7 + i) % 100) + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        else if (kind < 8)
+            request = "GET /products/search?q=a&limit=20 HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        else if (kind < 9)
+            request = "GET /products/low-stock HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        else
+            request = "POST /sell HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\n"
+                      "Content-Length: 32\r\n\r\n{\"name\":\"loadtest-item\",\"qty\":1}";
+
+        auto start = chrono::steady_clock::now();
+        bool ok = sendAll(s, request);
+
+        // Read the header and Content-Length worth of body
+        size_t headerEnd = string::npos;
+        while (ok && (headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+            char chunk[8192];
+            int n = recv(s, chunk, sizeof(chunk), 0);
+            if (n <= 0) ok = false;
+            else buffer.append(chunk, n);
+        }
+        if (ok) {
+            size_t lenPos = buffer.find("Content-Length: ");
+            size_t bodyLen = lenPos < headerEnd ? strtoul(buffer.c_str() + lenPos + 16, nullptr, 10) : 0;
+            while (ok && buffer.size() < headerEnd + 4 + bodyLen) {
+                char chunk[8192];
+                int n = recv(s, chunk, sizeof(chunk), 0);
+                if (n <= 0) ok = false;
+                else buffer.append(chunk, n);
+            }
+            bool success = buffer.compare(0, 12, "HTTP/1.1 200") == 0 || buffer.compare(0, 12, "HTTP/1.1 409") == 0;
+            if (!success) result.errors++;
+            buffer.erase(0, headerEnd + 4 + bodyLen);
+        }
+        if (!ok) {
+            result.errors += requestCount - i;
+            break;
+        }
+        result.requests++;
+        result.latenciesUs.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+    closeSocket(s);
+}
+
+int loadTestServer(DbContext &ctx, int clients, int requestsPerClient, int workerCount) {
+    const string path = "loadtest.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+        error_code ec;
+        filesystem::remove_all(path + "-changes", ec);
+    };
+    removeScratch();
+
+    ReadConnection* source = readConnection(ctx);
+    DbContext scratch;
+    string error;
+    if (!source ||
+        sqlite3_exec(source->conn, ("VACUUM INTO '" + path + "';").c_str(), nullptr, nullptr, nullptr) != SQLITE_OK ||
+        !openDbContext(scratch, path, "", error)) {
+        cerr << RED << "Could not copy the database for the load test" << RESET << endl;
+        removeScratch();
+        return 1;
+    }
+    // A product for the sell requests to hit
+    submitWrite(scratch.writer, [](sqlite3* conn, bool &ok) {
+        ok = sqlite3_exec(conn, "INSERT INTO products (name, category, quantity, price) "
+                                "SELECT 'loadtest-item', 'test', 1000000000, 1.0 "
+                                "WHERE NOT EXISTS (SELECT 1 FROM products WHERE name = 'loadtest-item');",
+                          nullptr, nullptr, nullptr) == SQLITE_OK;
+        return ok;
+    }, false).wait();
+
+    HttpServer server;
+    if (!startHttpServer(server, scratch, 0, workerCount)) {
+        cerr << RED << "Could not start server" << RESET << endl;
+        closeDbContext(scratch);
+        removeScratch();
+        return 1;
+    }
+
+    vector<LoadTestClient> results(clients);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < clients; ++i)
+        threads.emplace_back(runLoadClient, server.port, requestsPerClient, i, ref(results[i]));
+    for (auto &t : threads) t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stopHttpServer(server);
+    closeDbContext(scratch);
+    removeScratch();
+
+    long long requests = 0, errors = 0;
+    vector<double> latencies;
+    for (auto &r : results) {
+        requests += r.requests;
+        errors += r.errors;
+        latencies.insert(latencies.end(), r.latenciesUs.begin(), r.latenciesUs.end());
+    }
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[min(latencies.size() - 1, (size_t)(p * latencies.size()))];
+    };
+
+    cout << "clients " << clients << ", workers " << workerCount << ", requests " << requests
+         << ", errors " << errors << "\n"
+         << fixed << setprecision(0)
+         << "throughput " << requests / secs << " req/s\n"
+         << "latency p50 " << percentile(0.50) << " us, p99 " << percentile(0.99) << " us\n";
+    printMemory();
+    return errors == 0 ? 0 : 1;
+}
+
+// ------------------------
+// Write Benchmark
+// ------------------------
+// N threads insert rows into a scratch database: first each on its own
+// connection (one transaction and fsync per row, retrying on SQLITE_BUSY),
+// then the same rows through the group-commit write queue.
+int benchmarkWrites(int submitters, int opsEach) {
+    const string path = "bench-writes.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+    };
+    removeScratch();
+
+    sqlite3* setup;
+    sqlite3_open(path.c_str(), &setup);
+    sqlite3_exec(setup, "CREATE TABLE rows (id INTEGER PRIMARY KEY, submitter INTEGER, payload TEXT);",
+                 nullptr, nullptr, nullptr);
+    sqlite3_close(setup);
+
+    const char* sql_insert = "INSERT INTO rows (submitter, payload) VALUES (?, 'benchmark row');";
+    atomic<long long> busyRetries{0}, failures{0};
+    vector<thread> threads;
+
+    IoTotals io = ioTotals();
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < submitters; ++t) {
+        threads.emplace_back([&, t] {
+            sqlite3* conn;
+            sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr);
+            sqlite3_busy_timeout(conn, 5000);
+            sqlite3_stmt* stmt = nullptr;
+            while (sqlite3_prepare_v2(conn, sql_insert, -1, &stmt, nullptr) == SQLITE_BUSY)
+                busyRetries++;
+            for (int i = 0; i < opsEach && stmt; ++i) {
+                sqlite3_bind_int(stmt, 1, t);
+                int rc, attempts = 0;
+                while ((rc = sqlite3_step(stmt)) == SQLITE_BUSY && ++attempts < 1000) {
+                    busyRetries++;
+                    sqlite3_reset(stmt);
+                }
+                if (rc != SQLITE_DONE) failures++;
+                sqlite3_reset(stmt);
+            }
+            sqlite3_finalize(stmt);
+            sqlite3_close(conn);
+        });
+    }
+    for (auto &t : threads) t.join();
+    double directSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long long directBusy = busyRetries, directFailures = failures;
+    long long directSyncs = ioSyncsSince(io);
+
+    WriteQueue queue;
+    startWriteQueue(queue, path);
+    failures = 0;
+    threads.clear();
+    io = ioTotals();
+    start = chrono::steady_clock::now();
+    for (int t = 0; t < submitters; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < opsEach; ++i) {
+                auto done = submitWrite(queue, [&, t](sqlite3* conn, bool &ok) {
+                    sqlite3_stmt* stmt;
+                    sqlite3_prepare_v2(conn, sql_insert, -1, &stmt, nullptr);
+                    sqlite3_bind_int(stmt, 1, t);
+                    ok = sqlite3_step(stmt) == SQLITE_DONE;
+                    sqlite3_finalize(stmt);
+                    return ok;
+                }, false);
+                if (!done.get()) failures++;
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+    double queueSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stopWriteQueue(queue);
+    long long queueSyncs = ioSyncsSince(io);
+    removeScratch();
+
+    long long total = (long long)submitters * opsEach;
+    cout << "submitters " << submitters << ", rows each " << opsEach << "\n" << fixed << setprecision(0)
+         << "own connections : " << total / directSecs << " rows/s, " << total << " transactions, "
+         << directSyncs << " syncs, " << directBusy << " busy retries, " << directFailures << " failed\n"
+         << "write queue     : " << total / queueSecs << " rows/s, " << queue.transactions << " transactions, "
+         << queueSyncs << " syncs, " << failures << " failed\n";
+    printMemory();
+    return directFailures + failures == 0 ? 0 : 1;
+}
+
+// ------------------------
+// Background Jobs
 // ------------------------
-vector<Product> fetchAllProducts() {
-    vector<Product> products;
-    const char* sql_select = "SELECT name, category, quantity, price FROM products;";
+int queryInt(sqlite3* conn, const char* sql) {
     sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_select, -1, &stmt, nullptr);
-
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Product p;
-        p.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        p.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        p.quantity = sqlite3_column_int(stmt, 2);
-        p.price = sqlite3_column_double(stmt, 3);
-        products.push_back(p);
+    int value = 0;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
     }
+    return value;
+}
 
-    sqlite3_finalize(stmt);
-    return products;
+string csvField(const string &text) {
+    if (text.find_first_of(",\"\r\n") == string::npos) return text;
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
 }
 
-// ------------------------
-// Display Table
-// ------------------------
-void displayTable() {
-    vector<Product> inventory = fetchAllProducts();
+// Writes a whole table as CSV from one read snapshot
+bool exportCsv(DbContext &ctx, Job &job, const string &table, const string &file, string &result) {
+    ReadSnapshot snap;
+    if (!beginSnapshot(ctx, snap)) {
+        result = "cannot read the database";
+        return false;
+    }
+    long long total = 0;
+    sqlite3_stmt* count = readStatement(ctx, "SELECT count(*) FROM " + table + ";");
+    if (count && sqlite3_step(count) == SQLITE_ROW) total = sqlite3_column_int64(count, 0);
+    if (count) sqlite3_reset(count);
 
-    if (inventory.empty()) {
-        cout << RED << "\nNo products found!\n" << RESET;
-        return;
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT * FROM " + table + " ORDER BY rowid;");
+    ofstream out(file, ios::binary);
+    if (!stmt || !out) {
+        endSnapshot(snap);
+        result = "cannot write " + file;
+        return false;
     }
 
-    int nameWidth = 20, catWidth = 15, qtyWidth = 8, priceWidth = 10;
-    int tableWidth = nameWidth + catWidth + qtyWidth + priceWidth + 6;
+    int columns = sqlite3_column_count(stmt);
+    for (int c = 0; c < columns; ++c)
+        out << (c ? "," : "") << csvField(sqlite3_column_name(stmt, c));
+    out << "\n";
 
-    auto wrapText = [](const string &text, int width) -> vector<string> {
-        vector<string> lines;
-        size_t start = 0;
-        while (start < text.size()) {
-            lines.push_back(text.substr(start, width));
-            start += width;
+    long long rows = 0;
+    bool cancelled = false;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        for (int c = 0; c < columns; ++c) {
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, c));
+            out << (c ? "," : "") << csvField(text ? text : "");
         }
-        return lines;
-    };
+        out << "\n";
+        if (++rows % 1000 == 0 && !jobContinue(job, total ? (double)rows / total : -1)) {
+            cancelled = true;
+            break;
+        }
+    }
+    sqlite3_reset(stmt);
+    endSnapshot(snap);
+    out.close();
 
-    cout << "+" << string(tableWidth + 1, '-') << "+\n";
-    cout << CYAN
-         << "| " << left << setw(nameWidth) << "Product Name"
-         << "| " << setw(catWidth) << "Category"
-         << "| " << setw(qtyWidth) << "Qty"
-         << "| " << setw(priceWidth) << "Price"
-         << "|\n" << RESET;
-    cout << "+" << string(tableWidth + 1, '-') << "+\n";
+    if (cancelled || rc != SQLITE_DONE || !out) {
+        remove(file.c_str());
+        result = cancelled ? "cancelled" : "export failed";
+        return false;
+    }
+    result = "wrote " + to_string(rows) + " rows to " + file;
+    return true;
+}
 
-    for (auto &p : inventory) {
-        vector<string> nameLines = wrapText(p.name, nameWidth);
-        vector<string> catLines = wrapText(p.category, catWidth);
-        vector<string> qtyLines = wrapText(to_string(p.quantity), qtyWidth);
-        vector<string> priceLines = wrapText(to_string(p.price), priceWidth);
+// Online backup through the backup API, a few pages per step, all read from
+// one snapshot so concurrent sales neither restart nor block it
+bool backupDatabase(DbContext &ctx, Job &job, const string &file, string &result) {
+    ReadSnapshot snap;
+    if (!beginSnapshot(ctx, snap)) {
+        result = "cannot read the database";
+        return false;
+    }
+    sqlite3* dest = nullptr;
+    int rc = sqlite3_open(file.c_str(), &dest);
+    sqlite3_backup* backup = rc == SQLITE_OK ? sqlite3_backup_init(dest, "main", snap.rc->conn, "main") : nullptr;
+    bool cancelled = false;
+    int pages = 0;
+    if (backup) {
+        do {
+            rc = sqlite3_backup_step(backup, 256);
+            pages = sqlite3_backup_pagecount(backup);
+            if (!jobContinue(job, pages ? 1.0 - (double)sqlite3_backup_remaining(backup) / pages : 0)) {
+                cancelled = true;
+                break;
+            }
+            if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) this_thread::sleep_for(chrono::milliseconds(10));
+        } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+        sqlite3_backup_finish(backup);
+    }
+    endSnapshot(snap);
 
-        size_t maxLines = max({nameLines.size(), catLines.size(), qtyLines.size(), priceLines.size()});
+    bool ok = !cancelled && rc == SQLITE_DONE;
+    result = ok ? "copied " + to_string(pages) + " pages to " + file
+                : cancelled ? string("cancelled") : string("backup failed: ") + sqlite3_errmsg(dest);
+    sqlite3_close(dest);
+    if (!ok) remove(file.c_str());
+    return ok;
+}
 
-        for (size_t i = 0; i < maxLines; i++) {
-            cout << "| "
-                 << left << setw(nameWidth) << (i < nameLines.size() ? nameLines[i] : "")
-                 << "| " << setw(catWidth) << (i < catLines.size() ? catLines[i] : "")
-                 << "| " << setw(qtyWidth) << (i < qtyLines.size() ? qtyLines[i] : "")
-                 << "| " << setw(priceWidth) << (i < priceLines.size() ? priceLines[i] : "")
-                 << "|\n";
-        }
+int vacuumProgress(void* arg) {
+    return jobContinue(*static_cast<Job*>(arg), -1) ? 0 : 1;
+}
+
+// VACUUM holds the write lock until it finishes (queued writes wait behind
+// it), so it runs unthrottled; cancelling interrupts it and rolls it back.
+// It also switches older files to incremental auto-vacuum.
+bool vacuumDatabase(DbContext &ctx, Job &job, string &result) {
+    job.cpuPercent = 100;
+    sqlite3* conn = nullptr;
+    if (sqlite3_open_v2(ctx.path.c_str(), &conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        result = "cannot open the database";
+        sqlite3_close(conn);
+        return false;
+    }
+    sqlite3_busy_timeout(conn, 5000);
+    int before = queryInt(conn, "PRAGMA page_count;");
+    sqlite3_progress_handler(conn, 10000, vacuumProgress, &job);
+    sqlite3_exec(conn, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
+    bool ok = sqlite3_exec(conn, "VACUUM;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_progress_handler(conn, 0, nullptr, nullptr);
+    int after = queryInt(conn, "PRAGMA page_count;");
+    result = ok ? to_string(before) + " -> " + to_string(after) + " pages"
+                : job.cancelRequested ? string("cancelled") : string("VACUUM failed: ") + sqlite3_errmsg(conn);
+    sqlite3_close(conn);
+    return ok;
+}
 
-        cout << "+" << string(tableWidth + 1, '-') << "+\n";
+// Queues one of the background jobs by name; nullptr for an unknown one
+shared_ptr<Job> submitNamedJob(DbContext &ctx, JobPool &pool, const string &kind, const string &file) {
+    DbContext* c = &ctx;
+    if (kind == "export" && !file.empty())
+        return submitJob(pool, "Export " + file, [c, file](Job &job, string &result) {
+            return exportCsv(*c, job, "products", file, result);
+        });
+    if (kind == "backup" && !file.empty())
+        return submitJob(pool, "Backup " + file, [c, file](Job &job, string &result) {
+            return backupDatabase(*c, job, file, result);
+        });
+    if (kind == "vacuum")
+        return submitJob(pool, "VACUUM", [c](Job &job, string &result) {
+            return vacuumDatabase(*c, job, result);
+        });
+    if (kind == "report" && !file.empty())
+        return submitJob(pool, "Report " + file, [c, file](Job &job, string &result) {
+            job.progress = -1;
+            bool ok = writeReport(*c, renderProductTable, file, &job.cancelRequested);
+            result = ok ? "wrote " + file : job.cancelRequested ? "partial report in " + file : "cannot write " + file;
+            return ok;
+        });
+    return nullptr;
+}
+
+void jobsMenu(DbContext &ctx, JobPool &pool) {
+    char option = 'R';
+    while (toupper(option) != 'B') {
+        cout << GREEN << "\n===== Background Jobs =====" << RESET;
+        printJobs(pool);
+        cout << "\n[1] Export Products to CSV  [2] Backup Database  [3] VACUUM  [4] Stock Report to File\n"
+             << "[C] Cancel a Job  [R] Refresh  [B] Back\n"
+             << "Choice: ";
+        cin >> option;
+        option = toupper(option);
+
+        const char* kinds[] = {"export", "backup", "vacuum", "report"};
+        if (option >= '1' && option <= '4') {
+            string kind = kinds[option - '1'], file;
+            if (kind != "vacuum") {
+                cin.ignore();
+                cout << "Enter file name: ";
+                getline(cin, file);
+            }
+            if (submitNamedJob(ctx, pool, kind, file))
+                cout << GREEN << "Job queued.\n" << RESET;
+            else
+                cout << RED << "A file name is required.\n" << RESET;
+        } else if (option == 'C') {
+            long long id = getIntInput("Job ID to cancel: ");
+            if (!cancelJob(pool, id))
+                cout << RED << "No such job.\n" << RESET;
+        }
     }
 }
 
 // ------------------------
-// Add Product
+// Maintenance Scheduler
 // ------------------------
-void addProduct() {
-    char more = 'Y';
-    while (toupper(more) == 'Y') {
-        Product p;
+// Keeps the file compact and the planner statistics current without taking
+// the program down. A low-priority thread
+//  - checkpoints the WAL once the writer has appended walCheckpointPages
+//    frames (the writer's own auto-checkpoint is switched off for this), and
+//    truncates it while the menu is idle;
+//  - while the menu sits idle at getUserChoice(), hands free pages back with
+//    incremental_vacuum, one bounded chunk per write transaction so queued
+//    writes never wait long behind it;
+//  - re-runs a sampled ANALYZE once enough rows have changed.
+// Only databases created with auto_vacuum=INCREMENTAL can shrink this way;
+// older files are converted by the next VACUUM job.
+const int WAL_CHECKPOINT_PAGES = 1000;
+const int VACUUM_CHUNK_PAGES = 256;
+const int ANALYZE_MIN_CHANGES = 1000;
+const int ANALYZE_ROW_LIMIT = 1000;
+const int MAINTENANCE_IDLE_MS = 2000;
 
-        cout << GREEN << "\n===== Add New Product =====\n" << RESET;
-
-        cin.ignore();
-        cout << "Enter Product Name: ";
-        getline(cin, p.name);
+struct Maintenance {
+    DbContext* ctx = nullptr;
+    sqlite3* conn = nullptr;            // checkpoints and status; FULLMUTEX, shared with the CLI
+    int walCheckpointPages = WAL_CHECKPOINT_PAGES;
+    atomic<int> walFrames{0};           // as reported by the writer's WAL hook
+    atomic<int> backfilled{0};
+    long long analyzedAtChanges = 0;
+    long long seenTransactions = -1;
+    mutex stateMutex;
+    condition_variable wake;
+    bool running = false;
+    bool idle = false;
+    chrono::steady_clock::time_point idleSince;
+    thread worker;
+    atomic<long long> checkpoints{0};
+    atomic<long long> vacuumedPages{0};
+    atomic<long long> analyzeRuns{0};
+};
 
-        cout << "Enter Product Category: ";
-        getline(cin, p.category);
+// Runs on the writer thread after every commit; only wakes the scheduler
+int onWalCommit(void* arg, sqlite3*, const char*, int frames) {
+    Maintenance* m = static_cast<Maintenance*>(arg);
+    m->walFrames = frames;
+    if (frames - m->backfilled >= m->walCheckpointPages) m->wake.notify_one();
+    return SQLITE_OK;
+}
 
-        p.quantity = getIntInput("Enter Quantity: ");
-        p.price = getDoubleInput("Enter Price: ");
+// The main menu calls this around getUserChoice()
+void setMenuIdle(Maintenance &m, bool idle) {
+    lock_guard<mutex> lock(m.stateMutex);
+    m.idle = idle;
+    m.idleSince = chrono::steady_clock::now();
+    if (idle) m.wake.notify_one();
+}
 
-        const char* sql_insert = "INSERT INTO products (name, category, quantity, price) VALUES (?, ?, ?, ?);";
-        sqlite3_stmt* stmt;
-        sqlite3_prepare_v2(db, sql_insert, -1, &stmt, nullptr);
-        sqlite3_bind_text(stmt, 1, p.name.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, p.category.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 3, p.quantity);
-        sqlite3_bind_double(stmt, 4, p.price);
-        if (sqlite3_step(stmt) != SQLITE_DONE)
-            cerr << RED << "Error inserting product.\n" << RESET;
-        sqlite3_finalize(stmt);
+bool menuIdle(Maintenance &m) {
+    lock_guard<mutex> lock(m.stateMutex);
+    return m.running && m.idle &&
+           chrono::steady_clock::now() - m.idleSince >= chrono::milliseconds(MAINTENANCE_IDLE_MS);
+}
 
-        cout << GREEN << "\nProduct added successfully!\n" << RESET;
-        displayTable();
+// PASSIVE never waits for readers; TRUNCATE does (briefly) and also resets the WAL file
+bool checkpointWal(Maintenance &m, int mode) {
+    int logFrames = 0, done = 0;
+    int rc = sqlite3_wal_checkpoint_v2(m.conn, "main", mode, &logFrames, &done);
+    if (rc != SQLITE_OK && rc != SQLITE_BUSY) return false;
+    m.backfilled = mode == SQLITE_CHECKPOINT_TRUNCATE && rc == SQLITE_OK ? 0 : done;
+    if (mode == SQLITE_CHECKPOINT_TRUNCATE && rc == SQLITE_OK) m.walFrames = 0;
+    m.checkpoints++;
+    return rc == SQLITE_OK;
+}
 
-        cout << "\nAdd another product? (Y/N): ";
-        cin >> more;
-    }
+// Frees up to VACUUM_CHUNK_PAGES pages in one write transaction and returns
+// how many free pages are left (0 if the file cannot shrink incrementally)
+int vacuumChunk(Maintenance &m) {
+    Maintenance* mp = &m;
+    return submitWrite(m.ctx->writer, [mp](sqlite3* conn, int &left) {
+        if (queryInt(conn, "PRAGMA auto_vacuum;") != 2) return true;
+        int before = queryInt(conn, "PRAGMA freelist_count;");
+        string sql = "PRAGMA incremental_vacuum(" + to_string(VACUUM_CHUNK_PAGES) + ");";
+        if (sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) return false;
+        left = queryInt(conn, "PRAGMA freelist_count;");
+        mp->vacuumedPages += before - left;
+        return true;
+    }, 0).get();
 }
 
-// ------------------------
-// View All Products
-// ------------------------
-void viewAllProducts() {
-    cout << GREEN << "\n===== All Products =====\n" << RESET;
-    displayTable();
+// Re-samples statistics when there are none yet or enough rows have changed
+bool analyzeIfStale(Maintenance &m) {
+    Maintenance* mp = &m;
+    return submitWrite(m.ctx->writer, [mp](sqlite3* conn, bool &ran) {
+        long long changes = sqlite3_total_changes(conn);
+        bool haveStats = queryInt(conn, "SELECT count(*) FROM sqlite_master WHERE name = 'sqlite_stat1';") > 0;
+        if (haveStats && changes - mp->analyzedAtChanges < ANALYZE_MIN_CHANGES) return true;
+        if (sqlite3_exec(conn, "ANALYZE;", nullptr, nullptr, nullptr) != SQLITE_OK) return false;
+        mp->analyzedAtChanges = changes;
+        mp->analyzeRuns++;
+        ran = true;
+        return true;
+    }, false).get();
 }
 
-// ------------------------
-// Search Records
-// ------------------------
-void searchRecords() {
-    cin.ignore();
-    string keyword;
+// One round of idle work; untilDone keeps going even if the menu wakes up
+void runMaintenancePass(Maintenance &m, bool untilDone) {
+    analyzeIfStale(m);
+    while ((untilDone || menuIdle(m)) && vacuumChunk(m) > 0) {}
+    if (untilDone || menuIdle(m)) checkpointWal(m, SQLITE_CHECKPOINT_TRUNCATE);
+}
 
-    cout << GREEN << "\n===== Current Inventory =====\n" << RESET;
-    displayTable();
+void maintenanceLoop(Maintenance* m) {
+    lowerThreadPriority();
+    unique_lock<mutex> lock(m->stateMutex);
+    while (m->running) {
+        m->wake.wait_for(lock, chrono::milliseconds(500));
+        if (!m->running) break;
+        lock.unlock();
 
-    cout << BLUE << "\nEnter product name to search: " << RESET;
-    getline(cin, keyword);
+        if (m->walFrames < m->backfilled) m->backfilled = 0;    // the writer restarted the WAL
+        if (m->walFrames - m->backfilled >= m->walCheckpointPages)
+            checkpointWal(*m, SQLITE_CHECKPOINT_PASSIVE);
 
-    const char* sql_search = "SELECT name, category, quantity, price FROM products WHERE name LIKE ?;";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_search, -1, &stmt, nullptr);
-    string pattern = "%" + keyword + "%";
-    sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_STATIC);
+        // Idle passes only repeat after something has been written
+        long long transactions = m->ctx->writer.transactions;
+        if (menuIdle(*m) && transactions != m->seenTransactions) {
+            runMaintenancePass(*m, false);
+            m->seenTransactions = m->ctx->writer.transactions;
+        }
+        lock.lock();
+    }
+}
 
-    bool found = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        found = true;
-        cout << GREEN << "\nProduct Found:\n" << RESET;
-        cout << "Name: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))
-             << "\nCategory: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))
-             << "\nQuantity: " << sqlite3_column_int(stmt, 2)
-             << "\nPrice: " << sqlite3_column_double(stmt, 3) << "\n";
+bool startMaintenance(Maintenance &m, DbContext &ctx, int walCheckpointPages) {
+    m.ctx = &ctx;
+    m.walCheckpointPages = walCheckpointPages;
+    if (sqlite3_open_v2(ctx.path.c_str(), &m.conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_FULLMUTEX, nullptr) != SQLITE_OK) {
+        sqlite3_close(m.conn);
+        m.conn = nullptr;
+        return false;
     }
-    sqlite3_finalize(stmt);
+    configureLookaside(m.conn, LOOKASIDE_READER_SLOT, LOOKASIDE_READER_SLOTS);
+    sqlite3_busy_timeout(m.conn, 200);
 
-    if (!found)
-        cout << RED << "\nNo matching product found.\n" << RESET;
+    // Hooks are installed from the writer thread, which owns its connection
+    Maintenance* mp = &m;
+    submitWrite(ctx.writer, [mp](sqlite3* conn, bool &done) {
+        sqlite3_wal_hook(conn, onWalCommit, mp);
+        string sql = "PRAGMA analysis_limit=" + to_string(ANALYZE_ROW_LIMIT) + ";";
+        sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr);
+        done = true;
+        return true;
+    }, false).get();
 
-    cout << GREEN << "\n===== Updated Inventory Table =====\n" << RESET;
-    displayTable();
+    m.running = true;
+    m.worker = thread(maintenanceLoop, &m);
+    return true;
+}
+
+// Hands checkpointing back to the writer and refreshes statistics on the way
+// out, as SQLite recommends doing before a long-lived connection closes
+void stopMaintenance(Maintenance &m) {
+    if (!m.running) return;
+    {
+        lock_guard<mutex> lock(m.stateMutex);
+        m.running = false;
+    }
+    m.wake.notify_one();
+    m.worker.join();
+    submitWrite(m.ctx->writer, [](sqlite3* conn, bool &done) {
+        sqlite3_wal_autocheckpoint(conn, 1000);
+        sqlite3_exec(conn, "PRAGMA optimize;", nullptr, nullptr, nullptr);
+        done = true;
+        return true;
+    }, false).get();
+    sqlite3_close(m.conn);
+    m.conn = nullptr;
+}
+
+void printMaintenance(Maintenance &m) {
+    static const char* modes[] = {"none", "full", "incremental"};
+    int mode = queryInt(m.conn, "PRAGMA auto_vacuum;");
+    cout << "Pages          : " << queryInt(m.conn, "PRAGMA page_count;")
+         << " (" << queryInt(m.conn, "PRAGMA freelist_count;") << " free)\n"
+         << "auto_vacuum    : " << modes[mode >= 0 && mode <= 2 ? mode : 0] << "\n"
+         << "WAL frames     : " << m.walFrames << " (checkpoint every " << m.walCheckpointPages << ")\n"
+         << "Checkpoints    : " << m.checkpoints << "\n"
+         << "Vacuumed pages : " << m.vacuumedPages << "\n"
+         << "ANALYZE runs   : " << m.analyzeRuns << "\n";
 }
 
 // ------------------------
-// Update Product
+// Crash Recovery Benchmark
 // ------------------------
-void updateProduct() {
-    cin.ignore();
-    string name;
+// A child process fills a scratch WAL database and dies without closing it,
+// optionally after a simulated power cut (see IO_FAULTS cut=N) has silently
+// dropped its later writes. The parent then times how long the first
+// connection takes to recover the WAL and checks what survived.
+const int RECOVERY_ROWS_PER_TXN = 100;
 
-    cout << GREEN << "\n===== Current Inventory =====\n" << RESET;
-    displayTable();
+// Runs in the child process and never returns
+int recoveryChild(const string &path, int rows, long long cutAfterWrites) {
+    ioFaults.powerCutAfter = cutAfterWrites;
+    sqlite3* conn;
+    sqlite3_open(path.c_str(), &conn);
+    sqlite3_exec(conn, "PRAGMA journal_mode=WAL; PRAGMA wal_autocheckpoint=0;"
+                       "CREATE TABLE IF NOT EXISTS rows (id INTEGER PRIMARY KEY, payload TEXT);",
+                 nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(conn, "INSERT INTO rows (payload) VALUES (printf('recovery row %d', ?));", -1, &stmt, nullptr);
+    for (int i = 0; i < rows; ++i) {
+        if (i % RECOVERY_ROWS_PER_TXN == 0) sqlite3_exec(conn, "BEGIN;", nullptr, nullptr, nullptr);
+        sqlite3_bind_int(stmt, 1, i);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (i % RECOVERY_ROWS_PER_TXN == RECOVERY_ROWS_PER_TXN - 1 || i == rows - 1)
+            sqlite3_exec(conn, "COMMIT;", nullptr, nullptr, nullptr);
+    }
+    cout << flush;
+    _Exit(0);   // no sqlite3_close(): the WAL and its index stay behind
+}
 
-    cout << BLUE << "Enter product name to update: " << RESET;
-    getline(cin, name);
+int benchmarkRecovery(const string &self, int rows, long long cutAfterWrites) {
+    const string path = "bench-recovery.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+    };
+    removeScratch();
 
-    Product p;
-    cout << "New Name: ";
-    getline(cin, p.name);
-    cout << "New Category: ";
-    getline(cin, p.category);
-    p.quantity = getIntInput("New Quantity: ");
-    p.price = getDoubleInput("New Price: ");
+    string command = "\"" + self + "\" recovery-child " + path + " " + to_string(rows) + " " + to_string(cutAfterWrites);
+    auto start = chrono::steady_clock::now();
+    if (system(command.c_str()) != 0) {
+        cerr << RED << "The writer process failed.\n" << RESET;
+        removeScratch();
+        return 1;
+    }
+    double fillMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    error_code ec;
+    auto walBytes = filesystem::file_size(path + "-wal", ec);
+    if (ec) walBytes = 0;
 
-    const char* sql_update = "UPDATE products SET name=?, category=?, quantity=?, price=? WHERE name=?;";
+    // The first read on the first connection rebuilds the WAL index
+    IoTotals io = ioTotals();
+    start = chrono::steady_clock::now();
+    sqlite3* conn;
+    sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READWRITE, nullptr);
+    int survived = queryInt(conn, "SELECT count(*) FROM rows;");
+    double recoveryMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
     sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_update, -1, &stmt, nullptr);
-    sqlite3_bind_text(stmt, 1, p.name.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, p.category.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 3, p.quantity);
-    sqlite3_bind_double(stmt, 4, p.price);
-    sqlite3_bind_text(stmt, 5, name.c_str(), -1, SQLITE_STATIC);
-
-    if (sqlite3_step(stmt) != SQLITE_DONE)
-        cerr << RED << "Error updating product.\n" << RESET;
-    else
-        cout << GREEN << "Product updated successfully!\n" << RESET;
+    string integrity = "unknown";
+    if (sqlite3_prepare_v2(conn, "PRAGMA integrity_check;", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) integrity = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(conn);
+    removeScratch();
 
-    sqlite3_finalize(stmt);
-    displayTable();
+    cout << fixed << setprecision(1)
+         << "writer          : " << rows << " rows in " << fillMs << " ms"
+         << (cutAfterWrites >= 0 ? ", power cut after " + to_string(cutAfterWrites) + " writes" : string()) << "\n"
+         << "WAL left behind : " << walBytes / 1024 << " KiB\n"
+         << "recovery        : " << recoveryMs << " ms (open + first read)\n"
+         << "rows survived   : " << survived << " of " << rows << "\n"
+         << "integrity_check : " << integrity << "\n" << defaultfloat << setprecision(6);
+    printIoSince(io);
+    printMemory();
+    return integrity == "ok" ? 0 : 1;
 }
 
 // ------------------------
-// Delete Product
+// Memory Benchmark
 // ------------------------
-void deleteProduct() {
-    cin.ignore();
-    string name;
+// Builds a scratch products table of `rows` rows and runs the read paths the
+// program uses over it (aggregate scan, text search, point lookups), printing
+// memory after each phase. The goal is under 20 MiB resident at 1M rows.
+const long long MEMORY_TARGET_KB = 20 * 1024;
 
-    cout << GREEN << "\n===== Current Inventory =====\n" << RESET;
-    displayTable();
+int benchmarkMemory(int rows) {
+    const string path = "bench-memory.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+    };
+    removeScratch();
 
-    cout << BLUE << "Enter product name to delete: " << RESET;
-    getline(cin, name);
+    sqlite3* conn;
+    if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK) {
+        cerr << RED << "Cannot create " << path << RESET << endl;
+        sqlite3_close(conn);
+        return 1;
+    }
+    configureLookaside(conn, LOOKASIDE_WRITER_SLOT, LOOKASIDE_WRITER_SLOTS);
+
+    auto start = chrono::steady_clock::now();
+    auto phase = [&](const string &name) {
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << left << setw(16) << name << ": " << (long long)ms << " ms\n" << right;
+        printMemory();
+        start = chrono::steady_clock::now();
+    };
 
-    const char* sql_delete = "DELETE FROM products WHERE name=?;";
     sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_delete, -1, &stmt, nullptr);
-    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+    bool ok = sqlite3_exec(conn, "CREATE TABLE products (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL, "
+                                    "category TEXT, quantity INTEGER, price REAL);", nullptr, nullptr, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(conn, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < ?1) "
+                                    "INSERT INTO products (name, category, quantity, price) "
+                                    "SELECT printf('product %07d', i), printf('category %d', i % 20), "
+                                    "i % 500, (i % 1000) / 10.0 FROM n;", -1, &stmt, nullptr) == SQLITE_OK;
+    if (ok) {
+        sqlite3_bind_int(stmt, 1, rows);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+    }
+    if (!ok) {
+        cerr << RED << "Fill failed: " << sqlite3_errmsg(conn) << RESET << endl;
+        sqlite3_close(conn);
+        removeScratch();
+        return 1;
+    }
+    phase("fill " + to_string(rows));
 
-    if (sqlite3_step(stmt) != SQLITE_DONE)
-        cerr << RED << "Error deleting product.\n" << RESET;
-    else
-        cout << GREEN << "Product deleted successfully!\n" << RESET;
+    sqlite3_exec(conn, "SELECT category, count(*), total(quantity * price) FROM products GROUP BY category;", nullptr, nullptr, nullptr);
+    phase("aggregate");
+    sqlite3_exec(conn, "SELECT count(*) FROM products WHERE name LIKE '%12345%';", nullptr, nullptr, nullptr);
+    phase("search");
+    if (sqlite3_prepare_v2(conn, "SELECT name, quantity, price FROM products WHERE id = ?;", -1, &stmt, nullptr) == SQLITE_OK) {
+        for (int i = 0; i < 10000; ++i) {
+            sqlite3_bind_int(stmt, 1, 1 + (int)((i * 7919LL) % max(rows, 1)));
+            while (sqlite3_step(stmt) == SQLITE_ROW) {}
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    phase("10k lookups");
 
-    sqlite3_finalize(stmt);
-    displayTable();
+    sqlite3_close(conn);
+    removeScratch();
+    long long rssKb, peakKb;
+    processMemory(rssKb, peakKb);
+    if (peakKb)
+        cout << "peak RSS " << peakKb / 1024 << " MiB: " << (peakKb < MEMORY_TARGET_KB ? GREEN "within" : RED "over")
+             << " the 20 MiB target" << RESET << "\n";
+    return 0;
 }
 
 // ------------------------
-// Process Sales
+// Typo Lookup Benchmark
 // ------------------------
-void processSales() {
-    cin.ignore();
-    string name;
-
-    cout << GREEN << "\n===== Current Inventory =====\n" << RESET;
-    displayTable();
+// Loads `rows` generated product names into a name index as startup does,
+// then looks up mistyped copies of some of them (one or two edits each)
+// twice: through the BK-tree, and by computing the edit distance to every
+// name (the same bit-parallel distance, so the gap is what the tree skips).
+// Both must find the same names. A lookup runs while the cashier waits:
+// under 10 ms each.
+const double TYPO_TARGET_MS = 10;
+const int TYPO_QUERIES = 40;
 
-    cout << BLUE << "Enter product name to sell: " << RESET;
-    getline(cin, name);
+// Product i of a generated catalogue: brand, item and size
+string benchProductName(long long i) {
+    static const vector<string> syllables = {"ka", "lo", "mi", "ra", "su", "te", "bo", "na", "vi", "zen",
+                                             "pa", "do", "ri", "cu", "me", "sa", "to", "li", "go", "fe"};
+    static const vector<string> items = {
+        "Corned Beef", "Sardines", "Instant Noodles", "Evaporated Milk", "Condensed Milk", "Coffee 3-in-1",
+        "Soy Sauce", "Vinegar", "Fish Sauce", "Cooking Oil", "Rice", "White Sugar", "Brown Sugar", "Iodized Salt",
+        "Crackers", "Bread Loaf", "Peanut Butter", "Cheese Spread", "Luncheon Meat", "Tuna Flakes",
+        "Spaghetti", "Tomato Sauce", "Ketchup", "Mayonnaise", "Powdered Milk", "Chocolate Drink", "Cola",
+        "Orange Juice", "Bottled Water", "Laundry Soap", "Bath Soap", "Shampoo", "Toothpaste", "Dishwashing Liquid",
+        "Fabric Conditioner", "Candles", "Matches", "Batteries", "Tissue", "Canned Corn"};
+    static const vector<string> sizes = {"100g", "155g", "250g", "500g", "1kg", "250ml", "330ml", "500ml", "1L",
+                                         "1.5L", "2L", "6-pack", "12-pack"};
+    long long size = i % (long long)sizes.size();
+    i /= (long long)sizes.size();
+    long long item = i % (long long)items.size();
+    i /= (long long)items.size();
+    string brand = syllables[i % syllables.size()] + syllables[(i / syllables.size()) % syllables.size()];
+    if (i >= (long long)(syllables.size() * syllables.size()))
+        brand += syllables[(i / (syllables.size() * syllables.size())) % syllables.size()];
+    brand[0] = (char)toupper(brand[0]);
+    return brand + " " + items[item] + " " + sizes[size];
+}
 
-    int qty;
-    cout << "Enter quantity sold: ";
-    cin >> qty;
+int benchmarkTypos(int rows) {
+    rows = max(rows, 1);
+    vector<string> names;
+    names.reserve(rows);
+    for (int i = 0; i < rows; ++i) names.push_back(benchProductName(i));
+    sort(names.begin(), names.end());       // the order startNameIndex reads them in
 
-    const char* sql_check = "SELECT quantity FROM products WHERE name=?;";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_check, -1, &stmt, nullptr);
-    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+    auto start = chrono::steady_clock::now();
+    auto elapsedMs = [&start] {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
 
-    if (sqlite3_step(stmt) != SQLITE_ROW) {
-        cout << RED << "\nProduct not found.\n" << RESET;
-        sqlite3_finalize(stmt);
-        return;
+    NameIndex index;
+    {
+        lock_guard<mutex> lock(index.lock);
+        for (auto &name : names) {
+            trieInsert(index.trie, name);
+            bkInsert(index.typos, name);
+        }
+        shrinkTrie(index.trie);
+        shrinkBkTree(index.typos);
+        index.loaded = true;
     }
+    cout << "load " << rows << " names: " << (long long)elapsedMs() << " ms\n";
+    printNameIndex(index);
 
-    int stock = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-
-    if (qty > stock) {
-        cout << RED << "\nNot enough stock!\n" << RESET;
-        return;
+    // One or two edits (replace, drop, insert, swap) to a name picked at random
+    unsigned long long seed = 20240611;
+    auto random = [&seed](size_t below) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (size_t)((seed >> 33) % below);
+    };
+    vector<string> typed;
+    for (int q = 0; q < TYPO_QUERIES; ++q) {
+        string text = names[random(names.size())];
+        for (size_t edits = 1 + random(2); edits > 0 && text.size() > 2; --edits) {
+            size_t at = random(text.size() - 1);
+            switch (random(4)) {
+                case 0: text[at] = (char)('a' + random(26)); break;
+                case 1: text.erase(at, 1); break;
+                case 2: text.insert(at, 1, (char)('a' + random(26))); break;
+                case 3: swap(text[at], text[at + 1]); break;
+            }
+        }
+        if (q % 4 == 0) transform(text.begin(), text.end(), text.begin(), ::tolower);
+        typed.push_back(text);
     }
 
-    const char* sql_update = "UPDATE products SET quantity=? WHERE name=?;";
-    sqlite3_prepare_v2(db, sql_update, -1, &stmt, nullptr);
-    sqlite3_bind_int(stmt, 1, stock - qty);
-    sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);
-    if (sqlite3_step(stmt) != SQLITE_DONE)
-        cerr << RED << "Error updating stock.\n" << RESET;
-
-    sqlite3_finalize(stmt);
-    cout << GREEN << "\nSale processed successfully!\n" << RESET;
-    displayTable();
-}
+    double treeMs = 0, treeWorstMs = 0, scanMs = 0, scanWorstMs = 0;
+    size_t visitedTotal = 0, found = 0;
+    bool same = true;
+    cout << "\n" << left << setw(40) << "Typed" << setw(10) << "tree ms" << setw(10) << "compared"
+         << setw(10) << "scan ms" << "closest\n";
+    for (auto &text : typed) {
+        size_t visited;
+        start = chrono::steady_clock::now();
+        vector<pair<unsigned, string>> viaTree = bkSearch(index.typos, text, TYPO_DISTANCE, visited);
+        double treeOne = elapsedMs();
 
-// ------------------------
-// Low Stock Alerts
-// ------------------------
-void lowStockAlerts() {
-    const char* sql_low = "SELECT name, quantity FROM products WHERE quantity < 5;";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_low, -1, &stmt, nullptr);
+        start = chrono::steady_clock::now();
+        TypoPattern pattern;
+        makeTypoPattern(pattern, text);
+        vector<pair<unsigned, string>> viaScan;
+        for (auto &name : names) {
+            unsigned distance = typoDistance(pattern, name.data(), name.size());
+            if (distance <= TYPO_DISTANCE) viaScan.emplace_back(distance, name);
+        }
+        sort(viaScan.begin(), viaScan.end());
+        double scanOne = elapsedMs();
 
-    bool any = false;
-    cout << YELLOW << "\n===== LOW STOCK PRODUCTS (Qty < 5) =====\n" << RESET;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        any = true;
-        cout << RED << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))
-             << " Qty: " << sqlite3_column_int(stmt, 1) << RESET << "\n";
+        same = same && viaTree == viaScan;
+        treeMs += treeOne;
+        scanMs += scanOne;
+        treeWorstMs = max(treeWorstMs, treeOne);
+        scanWorstMs = max(scanWorstMs, scanOne);
+        visitedTotal += visited;
+        found += !viaTree.empty();
+        cout << left << setw(40) << text.substr(0, 38) << fixed << setprecision(3) << setw(10) << treeOne
+             << setw(10) << visited << setw(10) << scanOne
+             << (viaTree.empty() ? "none" : viaTree[0].second + " (" + to_string(viaTree[0].first) + ")")
+             << (viaTree.size() > 1 ? " +" + to_string(viaTree.size() - 1) : "") << "\n" << defaultfloat << right;
     }
-    sqlite3_finalize(stmt);
 
-    if (!any)
-        cout << GREEN << "All stocks are sufficient.\n" << RESET;
+    cout << "\n" << left << setw(12) << "" << setw(12) << "mean ms" << setw(12) << "worst ms" << "names compared\n"
+         << fixed << setprecision(3)
+         << setw(12) << "BK-tree" << setw(12) << treeMs / typed.size() << setw(12) << treeWorstMs
+         << visitedTotal / typed.size() << " of " << rows << "\n"
+         << setw(12) << "scan" << setw(12) << scanMs / typed.size() << setw(12) << scanWorstMs << rows << "\n"
+         << defaultfloat << right;
+    cout << found << " of " << typed.size() << " typos matched within " << TYPO_DISTANCE << " edits; "
+         << (same ? "tree and scan agree" : RED "tree and scan disagree" RESET) << "; "
+         << fixed << setprecision(1) << scanMs / max(treeMs, 1e-9) << "x faster than the scan\n" << defaultfloat;
+
+    cout << "slowest lookup " << fixed << setprecision(3) << treeWorstMs << " ms: " << defaultfloat
+         << (treeWorstMs < TYPO_TARGET_MS ? GREEN "within" : RED "over") << " the 10 ms target" << RESET << "\n";
+    return same ? 0 : 1;
 }
 
 // ------------------------
@@ -393,6 +4993,8 @@ void displayMenu() {
     printLine("[E] Delete Product Details", YELLOW);
     printLine("[F] Process Sales", YELLOW);
     printLine("[G] Display Low Stock Alerts", YELLOW);
+    printLine("[H] Inventory Valuation Report", YELLOW);
+    printLine("[I] Background Jobs", YELLOW);
     printLine("[X] Exit Program", YELLOW);
 
     cout << CYAN << "+" << string(boxWidth, '-') << "+\n" << RESET;
@@ -405,29 +5007,134 @@ char getUserChoice() {
         cin >> choice;
         choice = toupper(choice);
 
-        if ((choice >= 'A' && choice <= 'G') || choice == 'X') {
+        if ((choice >= 'A' && choice <= 'I') || choice == 'X') {
             cout << "You entered: " << GREEN << choice << RESET;
             cout << "\nConfirm? (Y/N): ";
             cin >> confirm;
             if (toupper(confirm) == 'Y') return choice;
             cout << RED << "\nChoice canceled. Enter again.\n\n" << RESET;
         } else {
-            cout << RED << "\nInvalid option! Please enter A-G or X.\n\n" << RESET;
+            cout << RED << "\nInvalid option! Please enter A-I or X.\n\n" << RESET;
         }
     }
 }
 
 // ------------------------
-// Main
+// Command Line
 // ------------------------
-int main() {
-    // Open DB
-    if (sqlite3_open("inventory.db", &db)) {
-        cerr << RED << "Can't open database: " << sqlite3_errmsg(db) << RESET << endl;
-        return 1;
+int runCommand(DbContext &ctx, JobPool &pool, Maintenance &maint, int argc, char* argv[]) {
+    string command = argv[1];
+
+    if (command == "changes") {
+        printChangesSince(ctx.changeLog, argc >= 3 ? atoll(argv[2]) : 0);
+        return 0;
+    }
+
+    if (command == "report") {
+        bool ok = writeReport(ctx, renderProductTable, argc >= 3 ? argv[2] : "");
+        if (ok && argc >= 3) cout << "wrote " << argv[2] << endl;
+        return ok ? 0 : 1;
+    }
+
+    if (command == "job" && argc >= 3) {
+        auto job = submitNamedJob(ctx, pool, argv[2], argc >= 4 ? argv[3] : "");
+        if (job) return watchJob(*job);
     }
 
-    // Create table if not exists
+    if (command == "check-plans") {
+        sqlite3* schema = openPlanSchema(ctx);
+        bool indexed = schema && checkNameLookupPlans(schema);
+        sqlite3_close(schema);
+        return indexed ? 0 : 1;
+    }
+
+    if (command == "valuation") {
+        valuationReport(ctx, argc >= 3 ? max(1, atoi(argv[2])) : defaultScanThreads());
+        return 0;
+    }
+
+    if (command == "maintenance") {
+        printMaintenance(maint);
+        runMaintenancePass(maint, true);
+        cout << "-- after ANALYZE, incremental vacuum and checkpoint --\n";
+        printMaintenance(maint);
+        return 0;
+    }
+
+    if (command == "serve") {
+        int port = argc >= 3 ? atoi(argv[2]) : 8080;
+        int workers = argc >= 4 ? atoi(argv[3]) : max(2u, thread::hardware_concurrency());
+        return serveInventory(ctx, port, workers);
+    }
+
+    if (command == "bench-recovery") {
+        int rows = argc >= 3 ? atoi(argv[2]) : 100000;
+        long long cut = argc >= 4 ? atoll(argv[3]) : -1;
+        return benchmarkRecovery(argv[0], rows, cut);
+    }
+
+    if (command == "bench-memory")
+        return benchmarkMemory(argc >= 3 ? atoi(argv[2]) : 1000000);
+
+    if (command == "bench-writes") {
+        int submitters = argc >= 3 ? atoi(argv[2]) : 8;
+        int rows = argc >= 4 ? atoi(argv[3]) : 200;
+        return benchmarkWrites(submitters, rows);
+    }
+
+    if (command == "bench-typos")
+        return benchmarkTypos(argc >= 3 ? atoi(argv[2]) : 200000);
+
+    if (command == "suggest" && argc >= 3) {
+        auto start = chrono::steady_clock::now();
+        if (!startNameIndex(ctx, productNames)) {
+            cerr << RED << "Cannot load the product names." << RESET << endl;
+            return 1;
+        }
+        cout << "loaded in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms\n";
+        printNameIndex(productNames);
+        start = chrono::steady_clock::now();
+        vector<string> names = suggestNames(productNames, argv[2], NAME_SUGGESTIONS);
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        for (auto &name : names) cout << "  " << name << "\n";
+        cout << names.size() << " suggestions in " << us << " us; Tab completes to \""
+             << completeName(productNames, argv[2]) << "\"\n";
+        return 0;
+    }
+
+    if (command == "loadtest") {
+        int clients = argc >= 3 ? atoi(argv[2]) : 8;
+        int requests = argc >= 4 ? atoi(argv[3]) : 5000;
+        int workers = argc >= 5 ? atoi(argv[4]) : max(2u, thread::hardware_concurrency());
+        return loadTestServer(ctx, clients, requests, workers);
+    }
+
+    cerr << "Usage: " << argv[0] << " [command]\n"
+         << "  (no command)                             interactive menu\n"
+         << "  changes [after-seq]                      print change-log batches after a sequence number\n"
+         << "  report [file]                            stock table from one read snapshot\n"
+         << "  valuation [threads]                      inventory value by category (parallel scan)\n"
+         << "  suggest <prefix>                         product names the sale prompt would suggest, and the index size\n"
+         << "  check-plans                              fail if any lookup by product name would scan the whole table\n"
+         << "  job export|backup|report <file>          run a background job and show its progress\n"
+         << "  job vacuum                               compact the database as a background job\n"
+         << "  maintenance                              run ANALYZE, incremental vacuum and a WAL checkpoint now\n"
+         << "  serve [port] [workers]                   HTTP/JSON API on 127.0.0.1 (default port 8080)\n"
+         << "  loadtest [clients] [requests] [workers]  benchmark the API over loopback\n"
+         << "  bench-writes [submitters] [rows]         own connections vs. group-commit queue\n"
+         << "  bench-recovery [rows] [cut-after-writes] WAL recovery time after a crash or power cut\n"
+         << "  bench-memory [rows]                      peak and steady-state memory over a scratch inventory\n"
+         << "  bench-typos [rows]                       misspelled-name lookups: BK-tree vs. a full edit-distance scan\n"
+         << "  profile                                  interactive menu, printing the I/O each action caused\n"
+         << "IO_FAULTS=write=N,sync=N,delay=US,cut=N injects I/O errors and delays.\n";
+    return 1;
+}
+
+// ------------------------
+// Main
+// ------------------------
+int main(int argc, char* argv[]) {
+    // Open DB, creating the table if it does not exist
     const char* sql_create = R"(
         CREATE TABLE IF NOT EXISTS products (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -436,31 +5143,68 @@ int main() {
             quantity INTEGER,
             price REAL
         );
+        CREATE INDEX IF NOT EXISTS idx_products_name_fold ON products(name COLLATE FOLD);
     )";
-    char* errMsg = nullptr;
-    if (sqlite3_exec(db, sql_create, nullptr, nullptr, &errMsg) != SQLITE_OK) {
-        cerr << RED << "SQL error: " << errMsg << RESET << endl;
-        sqlite3_free(errMsg);
+    // Allocator first: SQLite only accepts it before it initializes. Every
+    // connection below then goes through the I/O accounting VFS and knows FOLD
+    configureSqliteMemory();
+    registerIoShim();
+    registerFoldCollation();
+    if (argc == 5 && string(argv[1]) == "recovery-child")
+        return recoveryChild(argv[2], atoi(argv[3]), atoll(argv[4]));
+
+    DbContext ctx;
+    string error;
+    if (!openDbContext(ctx, "inventory.db", sql_create, error)) {
+        cerr << RED << "Can't open database: " << error << RESET << endl;
+        return 1;
     }
+    JobPool pool;
+    startJobPool(pool, ctx, (int)max(1u, thread::hardware_concurrency() / 2), JOB_CPU_PERCENT);
+    Maintenance maint;
+    const char* walPages = getenv("WAL_CHECKPOINT_PAGES");
+    if (!startMaintenance(maint, ctx, walPages ? max(1, atoi(walPages)) : WAL_CHECKPOINT_PAGES))
+        cerr << YELLOW << "Maintenance scheduler unavailable; relying on auto-checkpoint.\n" << RESET;
+
+    bool profiling = argc > 1 && string(argv[1]) == "profile";
+    if (argc > 1 && !profiling) {
+        int status = runCommand(ctx, pool, maint, argc, argv);
+        stopMaintenance(maint);
+        stopJobPool(pool);
+        closeDbContext(ctx);
+        return status;
+    }
+    if (!startNameIndex(ctx, productNames))
+        cerr << YELLOW << "Name suggestions unavailable.\n" << RESET;
 
     char choice;
     do {
         displayMenu();
+        setMenuIdle(maint, true);
         choice = getUserChoice();
+        setMenuIdle(maint, false);
+        IoTotals io = ioTotals();
 
         switch (choice) {
-            case 'A': addProduct(); break;
-            case 'B': viewAllProducts(); break;
-            case 'C': searchRecords(); break;
-            case 'D': updateProduct(); break;
-            case 'E': deleteProduct(); break;
-            case 'F': processSales(); break;
-            case 'G': lowStockAlerts(); break;
+            case 'A': addProduct(ctx); break;
+            case 'B': viewAllProducts(ctx); break;
+            case 'C': searchRecords(ctx); break;
+            case 'D': updateProduct(ctx); break;
+            case 'E': deleteProduct(ctx); break;
+            case 'F': processSales(ctx); break;
+            case 'G': lowStockAlerts(ctx); break;
+            case 'H': valuationReport(ctx, defaultScanThreads()); break;
+            case 'I': jobsMenu(ctx, pool); break;
             case 'X':
                 cout << MAGENTA << "\nExiting program... Goodbye!\n" << RESET;
                 break;
         }
 
+        if (profiling && choice != 'X') {
+            cout << "\n";
+            printIoSince(io);
+        }
+
         if (choice != 'X') {
             cout << "\nPress Enter to continue...";
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -469,6 +5213,8 @@ int main() {
         }
     } while (choice != 'X');
 
-    sqlite3_close(db);
+    stopMaintenance(maint);
+    stopJobPool(pool);
+    closeDbContext(ctx);
     return 0;
 }
\ No newline at end of file
@@ -5,6 +5,48 @@
 #include <iomanip>
 #include <sqlite3.h>
 #include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <functional>
+#include <future>
+#include <map>
+#include <unordered_map>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <csignal>
+#include <cmath>
+#include <cerrno>
+#include <fcntl.h>
+#include "../fold/fold.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <conio.h>
+#include <io.h>
+#else
+#include <sys/socket.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <termios.h>
+#endif
 
 using namespace std;
 
@@ -18,9 +60,6 @@ using namespace std;
 #define RED     "\033[31m"
 #define BOLD    "\033[1m"
 
-// SQLite DB pointer
-sqlite3* db = nullptr;
-
 // ------------------------
 // Helper: Clear input buffer
 // ------------------------
@@ -29,389 +68,7313 @@ void clearInput() {
 }
 
 // ------------------------
-// RESIDENTS
+// CHANGE LOG (change-data capture)
 // ------------------------
-void displayResidentsTable() {
-    const char* sql_select = "SELECT name, address, contact FROM residents;";
+// Every committed insert/update/delete on the tracked tables is appended to a
+// segmented log in "<db>-changes/", one batch per transaction:
+//   T <seq> <unix time> <count>
+//   I <table> <rowid> {"column":value,...}         the inserted row
+//   U <table> <rowid> {"column":[old,new],...}     only the columns that changed
+//   D <table> <rowid> {"column":value,...}         the deleted row
+// Segments are named after the first transaction sequence they hold, so a
+// consumer that has read up to N can skip straight to the right segment.
+//
+// The sequence is kept in the database (change_log_seq) and taken inside the
+// writing transaction, and the batch is appended under a lock file held across
+// COMMIT, so several processes sharing one database get distinct sequence
+// numbers and append their batches in commit order. Segments are not fsynced:
+// a power cut can lose the last batches of transactions that did commit, and
+// change_log_seq then runs ahead of the log.
+const vector<string> CHANGE_TRACKED_TABLES = {"residents", "incidents", "announcements"};
+const long long CHANGE_SEGMENT_BYTES = 4 * 1024 * 1024;
+
+struct ChangeRecord {
+    char op;
+    string table;
+    sqlite3_int64 rowid;
+    string values;                  // JSON object, as above
+};
+
+// A name written by a transaction, for the in-memory name index: the old
+// name goes away, the new one is added (an insert has no old name)
+struct NameChange {
+    bool hasOld = false;
+    bool hasNew = false;
+    string oldName;
+    string newName;
+};
+
+// An incident written by a transaction, for the in-memory bitmap index: its
+// type, location and month ("YYYY-MM") before and after (an insert has no old
+// row, a delete no new one)
+const int INCIDENT_DIMENSIONS = 3;
+
+struct IncidentChange {
+    bool hasOld = false;
+    bool hasNew = false;
+    sqlite3_int64 oldRowid = 0;
+    sqlite3_int64 newRowid = 0;
+    string oldValues[INCIDENT_DIMENSIONS];
+    string newValues[INCIDENT_DIMENSIONS];
+};
+
+struct ChangeLog;
+
+// Rows touched by one connection's open transaction
+struct ChangeCapture {
+    sqlite3* conn;
+    ChangeLog* log;                 // the log of the database conn writes to
+    vector<ChangeRecord> pending;   // rows touched by the open transaction
+    vector<ChangeRecord> staged;    // handed over by the commit hook
+    long long pendingSeq = 0;       // taken by reserveChangeSeq before COMMIT
+    long long stagedSeq = 0;
+    vector<NameChange> pendingNames;
+    vector<NameChange> stagedNames;
+    function<void(vector<NameChange> &)> applyNames;   // set once the name index is loaded
+    vector<IncidentChange> pendingIncidents;
+    vector<IncidentChange> stagedIncidents;
+    function<void(vector<IncidentChange> &)> applyIncidents;   // set once the bitmap index is loaded
+};
+
+// One per open database (in its DbContext); it owns the captures of the
+// connections that write to that database
+struct ChangeLog {
+    string dir;
+    long long lastSeq = 0;          // the last batch this process appended or found
+    string segmentPath;
+    long long segmentSize = 0;
+    mutex appendMutex;              // connections on other threads append too
+    int lockFd = -1;                // "<dir>/lock", locked by every process that appends
+    vector<unique_ptr<ChangeCapture>> captures;
+};
+
+string changeSegmentName(long long firstSeq) {
+    ostringstream name;
+    name << setw(20) << setfill('0') << firstSeq << ".log";
+    return name.str();
+}
+
+// Segments of a change-log directory, sorted by their first sequence number
+vector<pair<long long, string>> listChangeSegments(const string &dir) {
+    vector<pair<long long, string>> segments;
+    error_code ec;
+    for (auto &entry : filesystem::directory_iterator(dir, ec)) {
+        string file = entry.path().filename().string();
+        if (file.size() != 24 || file.compare(20, 4, ".log") != 0) continue;
+        segments.push_back({stoll(file.substr(0, 20)), entry.path().string()});
+    }
+    sort(segments.begin(), segments.end());
+    return segments;
+}
+
+// Taken before COMMIT and released once the batch is appended, so batches
+// from every thread and process reach the log in commit order
+void lockChangeLog(ChangeLog &log) {
+    log.appendMutex.lock();
+    if (log.lockFd < 0) return;
+#ifdef _WIN32
+    OVERLAPPED whole{};
+    LockFileEx(reinterpret_cast<HANDLE>(_get_osfhandle(log.lockFd)), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &whole);
+#else
+    while (flock(log.lockFd, LOCK_EX) != 0 && errno == EINTR) {}
+#endif
+}
+
+void unlockChangeLog(ChangeLog &log) {
+    if (log.lockFd >= 0) {
+#ifdef _WIN32
+        OVERLAPPED whole{};
+        UnlockFileEx(reinterpret_cast<HANDLE>(_get_osfhandle(log.lockFd)), 0, 1, 0, &whole);
+#else
+        flock(log.lockFd, LOCK_UN);
+#endif
+    }
+    log.appendMutex.unlock();
+}
+
+// Takes the next batch sequence inside the writing transaction, where the
+// database write lock orders it against every other process
+bool reserveChangeSeq(ChangeCapture &capture) {
     sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << RED << "Failed to fetch residents.\n" << RESET;
-        return;
+    if (sqlite3_prepare_v2(capture.conn, "UPDATE change_log_seq SET seq = seq + 1 RETURNING seq;", -1, &stmt,
+                           nullptr) != SQLITE_OK)
+        return false;
+    bool ok = sqlite3_step(stmt) == SQLITE_ROW;
+    if (ok) capture.pendingSeq = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+// Called with the change log locked. A sequence that does not follow our last
+// one means another process appended in between (and may have started a new
+// segment), so only then is the directory read again.
+void appendChangeBatch(ChangeLog &log, long long seq, vector<ChangeRecord> &staged) {
+    if (seq != log.lastSeq + 1) {
+        auto segments = listChangeSegments(log.dir);
+        log.segmentPath = segments.empty() ? "" : segments.back().second;
+        error_code ec;
+        auto size = filesystem::file_size(log.segmentPath, ec);
+        log.segmentSize = ec ? 0 : (long long)size;
+    }
+    log.lastSeq = seq;
+    if (log.segmentPath.empty() || log.segmentSize >= CHANGE_SEGMENT_BYTES) {
+        log.segmentPath = log.dir + "/" + changeSegmentName(seq);
+        log.segmentSize = 0;
     }
 
-    int nameWidth = 25, addrWidth = 30, contactWidth = 15;
-    int totalWidth = nameWidth + addrWidth + contactWidth + 7;
+    ostringstream batch;
+    batch << "T " << seq << " " << time(nullptr) << " " << staged.size() << "\n";
+    for (auto &c : staged)
+        batch << c.op << " " << c.table << " " << c.rowid << " " << c.values << "\n";
+    staged.clear();
 
-    // Table header
-    cout << "+" << string(totalWidth - 2, '-') << "+\n";
-    cout << CYAN
-         << "| " << left << setw(nameWidth) << "Name"
-         << "| " << setw(addrWidth) << "Address"
-         << "| " << setw(contactWidth) << "Contact"
-         << "|\n" << RESET;
-    cout << "+" << string(totalWidth - 2, '-') << "+\n";
+    // Flushed but not fsynced: the log is a feed, the database stays the source of truth
+    string text = batch.str();
+    ofstream out(log.segmentPath, ios::binary | ios::app);
+    out << text;
+    log.segmentSize += text.size();
+}
 
-    // Helper to wrap text into multiple lines
-    auto wrapText = [](const string &text, int width) -> vector<string> {
-        vector<string> lines;
-        size_t start = 0;
-        while (start < text.length()) {
-            lines.push_back(text.substr(start, width));
-            start += width;
+string jsonEscape(const string &text) {
+    string out;
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += (char)c;
+                }
         }
-        return lines;
-    };
+    }
+    return out;
+}
 
-    // Table rows
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        string addr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        string contact = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+// A column value as JSON; blobs are written as hex strings
+string jsonValue(sqlite3_value* value) {
+    switch (sqlite3_value_type(value)) {
+        case SQLITE_INTEGER:
+            return to_string(sqlite3_value_int64(value));
+        case SQLITE_FLOAT: {
+            double number = sqlite3_value_double(value);
+            if (!isfinite(number)) return "null";
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.17g", number);
+            return buf;
+        }
+        case SQLITE_TEXT: {
+            const char* text = reinterpret_cast<const char*>(sqlite3_value_text(value));
+            return "\"" + jsonEscape(string(text, sqlite3_value_bytes(value))) + "\"";
+        }
+        case SQLITE_BLOB: {
+            const unsigned char* bytes = static_cast<const unsigned char*>(sqlite3_value_blob(value));
+            string hex = "\"";
+            char digits[3];
+            for (int i = 0, n = sqlite3_value_bytes(value); i < n; ++i) {
+                snprintf(digits, sizeof(digits), "%02x", bytes[i]);
+                hex += digits;
+            }
+            return hex + "\"";
+        }
+        default:
+            return "null";
+    }
+}
 
-        vector<string> nameLines = wrapText(name, nameWidth);
-        vector<string> addrLines = wrapText(addr, addrWidth);
-        vector<string> contactLines = wrapText(contact, contactWidth);
+bool sameValue(sqlite3_value* a, sqlite3_value* b) {
+    int type = sqlite3_value_type(a);
+    if (type != sqlite3_value_type(b)) return false;
+    if (type == SQLITE_NULL) return true;
+    if (type == SQLITE_INTEGER) return sqlite3_value_int64(a) == sqlite3_value_int64(b);
+    if (type == SQLITE_FLOAT) return sqlite3_value_double(a) == sqlite3_value_double(b);
+    const void* aBytes = sqlite3_value_blob(a);
+    const void* bBytes = sqlite3_value_blob(b);
+    int size = sqlite3_value_bytes(a);
+    return size == sqlite3_value_bytes(b) && (size == 0 || memcmp(aBytes, bBytes, size) == 0);
+}
 
-        size_t maxLines = max({nameLines.size(), addrLines.size(), contactLines.size()});
+// row_changed(op, table, rowid, ...), called by the triggers below with
+// name/value pairs for an insert or delete and name/old/new triples for an
+// update; an update that changed nothing is left out
+void onRowChanged(sqlite3_context* fn, int argc, sqlite3_value** args) {
+    sqlite3_result_null(fn);
+    ChangeRecord record;
+    record.op = reinterpret_cast<const char*>(sqlite3_value_text(args[0]))[0];
+    record.table = reinterpret_cast<const char*>(sqlite3_value_text(args[1]));
+    record.rowid = sqlite3_value_int64(args[2]);
+    int step = record.op == 'U' ? 3 : 2;
+    for (int i = 3; i + step <= argc; i += step) {
+        if (step == 3 && sameValue(args[i + 1], args[i + 2])) continue;
+        record.values += record.values.empty() ? "{\"" : ",\"";
+        record.values += jsonEscape(reinterpret_cast<const char*>(sqlite3_value_text(args[i]))) + "\":";
+        record.values += step == 2 ? jsonValue(args[i + 1])
+                                   : "[" + jsonValue(args[i + 1]) + "," + jsonValue(args[i + 2]) + "]";
+    }
+    if (record.values.empty() && step == 3) return;
+    record.values += record.values.empty() ? "{}" : "}";
+    static_cast<ChangeCapture*>(sqlite3_user_data(fn))->pending.push_back(move(record));
+}
 
-        for (size_t i = 0; i < maxLines; ++i) {
-            cout << "| "
-                 << left << setw(nameWidth) << (i < nameLines.size() ? nameLines[i] : "")
-                 << "| " << setw(addrWidth) << (i < addrLines.size() ? addrLines[i] : "")
-                 << "| " << setw(contactWidth) << (i < contactLines.size() ? contactLines[i] : "")
-                 << "|\n";
-        }
+// Temp triggers passing every column of a tracked table to row_changed
+string changeTriggers(sqlite3* conn, const string &table) {
+    sqlite3_stmt* info;
+    if (sqlite3_prepare_v2(conn, ("PRAGMA main.table_info(\"" + table + "\");").c_str(), -1, &info, nullptr) != SQLITE_OK)
+        return "";
+    string inserted, updated, deleted;
+    while (sqlite3_step(info) == SQLITE_ROW) {
+        string column = reinterpret_cast<const char*>(sqlite3_column_text(info, 1));
+        string name = ", '" + column + "', ", quoted = "\"" + column + "\"";
+        inserted += name + "new." + quoted;
+        updated += name + "old." + quoted + ", new." + quoted;
+        deleted += name + "old." + quoted;
+    }
+    sqlite3_finalize(info);
+    if (inserted.empty()) return "";
+
+    string trigger = "CREATE TEMP TRIGGER IF NOT EXISTS \"changes_" + table + "_";
+    string target = " ON main.\"" + table + "\" BEGIN SELECT row_changed(";
+    return trigger + "insert\" AFTER INSERT" + target + "'I', '" + table + "', new.rowid" + inserted + "); END;\n"
+         + trigger + "update\" AFTER UPDATE" + target + "'U', '" + table + "', new.rowid" + updated + "); END;\n"
+         + trigger + "delete\" AFTER DELETE" + target + "'D', '" + table + "', old.rowid" + deleted + "); END;\n";
+}
+
+bool createChangeTriggers(sqlite3* conn) {
+    for (auto &table : CHANGE_TRACKED_TABLES) {
+        string triggers = changeTriggers(conn, table);
+        if (triggers.empty() || sqlite3_exec(conn, triggers.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+            return false;
+    }
+    return true;
+}
+
+// The triggers name every column, so a migration that adds or drops one drops
+// them first and creates them again afterwards
+bool dropChangeTriggers(sqlite3* conn) {
+    string sql;
+    for (auto &table : CHANGE_TRACKED_TABLES)
+        for (const char* op : {"insert", "update", "delete"})
+            sql += "DROP TRIGGER IF EXISTS temp.\"changes_" + table + "_" + op + "\";";
+    return sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+int onCommit(void* arg) {
+    ChangeCapture* capture = static_cast<ChangeCapture*>(arg);
+    capture->staged.insert(capture->staged.end(), capture->pending.begin(), capture->pending.end());
+    capture->pending.clear();
+    capture->stagedSeq = capture->pendingSeq;
+    capture->pendingSeq = 0;
+    capture->stagedNames.insert(capture->stagedNames.end(), capture->pendingNames.begin(), capture->pendingNames.end());
+    capture->pendingNames.clear();
+    capture->stagedIncidents.insert(capture->stagedIncidents.end(), capture->pendingIncidents.begin(),
+                                    capture->pendingIncidents.end());
+    capture->pendingIncidents.clear();
+    return 0;
+}
+
+void onRollback(void* arg) {
+    ChangeCapture* capture = static_cast<ChangeCapture*>(arg);
+    capture->pending.clear();
+    capture->staged.clear();
+    capture->pendingSeq = capture->stagedSeq = 0;
+    capture->pendingNames.clear();
+    capture->stagedNames.clear();
+    capture->pendingIncidents.clear();
+    capture->stagedIncidents.clear();
+}
+
+// How much an open transaction had captured when a savepoint was taken, so a
+// ROLLBACK TO can drop what was captured after it
+struct ChangeMark {
+    size_t rows = 0;
+    size_t names = 0;
+    size_t incidents = 0;
+};
+
+ChangeMark markChanges(const ChangeCapture* capture) {
+    ChangeMark mark;
+    if (!capture) return mark;
+    mark.rows = capture->pending.size();
+    mark.names = capture->pendingNames.size();
+    mark.incidents = capture->pendingIncidents.size();
+    return mark;
+}
 
-        cout << "+" << string(totalWidth - 2, '-') << "+\n";
+void rewindChanges(ChangeCapture* capture, const ChangeMark &mark) {
+    if (!capture) return;
+    capture->pending.resize(min(mark.rows, capture->pending.size()));
+    capture->pendingNames.resize(min(mark.names, capture->pendingNames.size()));
+    capture->pendingIncidents.resize(min(mark.incidents, capture->pendingIncidents.size()));
+}
+
+// The commit hook runs before the commit is durable and must not touch the
+// connection, so the batch is written once the statement has finished and the
+// connection is back in autocommit mode (i.e. the commit went through).
+int onStatementDone(unsigned, void* arg, void*, void*) {
+    ChangeCapture* capture = static_cast<ChangeCapture*>(arg);
+    if (!sqlite3_get_autocommit(capture->conn)) return 0;
+    if (!capture->staged.empty()) appendChangeBatch(*capture->log, capture->stagedSeq, capture->staged);
+    if (!capture->stagedNames.empty() && capture->applyNames) capture->applyNames(capture->stagedNames);
+    capture->stagedNames.clear();
+    if (!capture->stagedIncidents.empty() && capture->applyIncidents) capture->applyIncidents(capture->stagedIncidents);
+    capture->stagedIncidents.clear();
+    return 0;
+}
+
+// Hooks a connection into the change log; every writing connection needs
+// this, on the thread that owns the connection (it creates temp triggers)
+ChangeCapture* captureChanges(ChangeLog &log, sqlite3* conn) {
+    log.captures.push_back(make_unique<ChangeCapture>());
+    ChangeCapture* capture = log.captures.back().get();
+    capture->conn = conn;
+    capture->log = &log;
+    if (sqlite3_create_function(conn, "row_changed", -1, SQLITE_UTF8, capture, onRowChanged, nullptr, nullptr) != SQLITE_OK)
+        return nullptr;
+    if (!createChangeTriggers(conn)) return nullptr;
+    sqlite3_commit_hook(conn, onCommit, capture);
+    sqlite3_rollback_hook(conn, onRollback, capture);
+    sqlite3_trace_v2(conn, SQLITE_TRACE_PROFILE, onStatementDone, capture);
+    return capture;
+}
+
+// Opens the log directory and its lock file, and makes sure the database's
+// sequence is at least the last batch on disk (logs written before the
+// sequence moved into the database carry on from there)
+bool openChangeLog(ChangeLog &log, sqlite3* conn, const string &dbPath) {
+    log.dir = dbPath + "-changes";
+    error_code ec;
+    filesystem::create_directories(log.dir, ec);
+    if (log.lockFd >= 0) close(log.lockFd);
+    log.lockFd = open((log.dir + "/lock").c_str(), O_RDWR | O_CREAT, 0644);
+
+    // Resume from the last batch of the newest segment
+    auto segments = listChangeSegments(log.dir);
+    log.segmentPath.clear();
+    log.segmentSize = log.lastSeq = 0;
+    if (!segments.empty()) {
+        log.segmentPath = segments.back().second;
+        log.lastSeq = segments.back().first - 1;
+        ifstream in(log.segmentPath, ios::binary);
+        string line;
+        while (getline(in, line)) {
+            log.segmentSize += line.size() + 1;
+            if (line.size() > 2 && line[0] == 'T')
+                log.lastSeq = stoll(line.substr(2));
+        }
     }
 
+    sqlite3_stmt* stmt;
+    if (sqlite3_exec(conn, "CREATE TABLE IF NOT EXISTS change_log_seq (id INTEGER PRIMARY KEY CHECK (id = 1), "
+                           "seq INTEGER NOT NULL);", nullptr, nullptr, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, "INSERT INTO change_log_seq VALUES (1, ?) "
+                                 "ON CONFLICT (id) DO UPDATE SET seq = max(seq, excluded.seq);",
+                           -1, &stmt, nullptr) != SQLITE_OK)
+        return false;
+    sqlite3_bind_int64(stmt, 1, log.lastSeq);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
     sqlite3_finalize(stmt);
+    return ok && log.lockFd >= 0;
 }
 
-void addResident() {
-    char more = 'Y';
-    while (toupper(more) == 'Y') {
-        string name, address, contact;
-        clearInput();
-        cout << "Enter Full Name: ";
-        getline(cin, name);
+// Drops the captures (their connections are closed by now) and the lock file
+void closeChangeLog(ChangeLog &log) {
+    log.captures.clear();
+    if (log.lockFd >= 0) close(log.lockFd);
+    log.lockFd = -1;
+}
 
-        cout << "Enter Address: ";
-        getline(cin, address);
+// Prints every batch with a sequence number greater than afterSeq
+void printChangesSince(const ChangeLog &log, long long afterSeq) {
+    auto segments = listChangeSegments(log.dir);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (i + 1 < segments.size() && segments[i + 1].first <= afterSeq + 1) continue;
 
-        cout << "Enter Contact Number: ";
-        getline(cin, contact);
+        ifstream in(segments[i].second, ios::binary);
+        string line;
+        bool printing = false;
+        while (getline(in, line)) {
+            if (line.size() > 2 && line[0] == 'T')
+                printing = stoll(line.substr(2)) > afterSeq;
+            if (printing) cout << line << "\n";
+        }
+    }
+}
 
-        const char* sql_insert = "INSERT INTO residents (name, address, contact) VALUES (?, ?, ?);";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql_insert, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 2, address.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 3, contact.c_str(), -1, SQLITE_STATIC);
+// ------------------------
+// MEMORY (allocator and page cache)
+// ------------------------
+// Installed before SQLite initializes, to keep the footprint small and flat
+// on low-RAM PCs:
+//  - small allocations come from size-class pools carved out of 64 KiB slabs
+//    (freed blocks are reused, never returned to the C heap); bigger ones go
+//    straight to malloc;
+//  - database pages live in one contiguous arena shared by every connection,
+//    backed by huge pages when HUGE_PAGES=1 and the system has them. Slots
+//    are carved at each cache's own size (page size plus SQLite's extra
+//    bytes) and freed slots are kept per size, so databases with different
+//    page sizes share it. Once the arena is used up, or the soft heap limit
+//    is reached, caches recycle their own least recently used pages instead
+//    of growing;
+//  - each connection gets a lookaside sized for its role.
+const int MEM_CLASSES = 6;
+const size_t MEM_CLASS_SIZES[MEM_CLASSES] = {32, 64, 128, 256, 512, 1024};
+const size_t MEM_SLAB_BYTES = 64 * 1024;
+const size_t PAGE_ARENA_BYTES = 8 << 20;
+const sqlite3_int64 SOFT_HEAP_LIMIT = 12 << 20;
+// Lookaside: 64 slots of 128 B (8 KiB) for readers and the maintenance
+// connection, 128 slots of 256 B (32 KiB) for the writer
+const int LOOKASIDE_READER_SLOT = 128, LOOKASIDE_READER_SLOTS = 64;
+const int LOOKASIDE_WRITER_SLOT = 256, LOOKASIDE_WRITER_SLOTS = 128;
 
-            if (sqlite3_step(stmt) == SQLITE_DONE)
-                cout << GREEN << "\nResident added successfully!\n" << RESET;
-            else
-                cout << RED << "\nError: Resident might already exist.\n" << RESET;
+// Every block starts with its usable size, which xSize needs
+struct MemPool {
+    mutex lock;
+    void* freeList = nullptr;
+    char* slab = nullptr;
+    size_t slabLeft = 0;
+};
 
-            sqlite3_finalize(stmt);
+MemPool memPools[MEM_CLASSES];
+atomic<long long> memInUse{0};
+atomic<long long> memPeak{0};
+atomic<long long> memReserved{0};   // slabs plus large blocks
+
+void noteMemory(long long delta) {
+    long long now = memInUse += delta;
+    long long peak = memPeak;
+    while (now > peak && !memPeak.compare_exchange_weak(peak, now)) {}
+}
+
+int memClass(size_t size) {
+    for (int c = 0; c < MEM_CLASSES; ++c)
+        if (size <= MEM_CLASS_SIZES[c]) return c;
+    return -1;
+}
+
+void* memMalloc(int bytes) {
+    size_t size = (size_t)bytes;
+    int c = memClass(size);
+    uint64_t* block;
+    if (c < 0) {
+        size = (size + 7) & ~(size_t)7;
+        block = static_cast<uint64_t*>(malloc(size + 8));
+        if (!block) return nullptr;
+        memReserved += size + 8;
+    } else {
+        MemPool &pool = memPools[c];
+        size = MEM_CLASS_SIZES[c];
+        lock_guard<mutex> lock(pool.lock);
+        if (pool.freeList) {
+            block = static_cast<uint64_t*>(pool.freeList);
+            pool.freeList = *reinterpret_cast<void**>(block + 1);
+        } else {
+            if (pool.slabLeft < size + 8) {
+                pool.slab = static_cast<char*>(malloc(MEM_SLAB_BYTES));
+                if (!pool.slab) return nullptr;
+                pool.slabLeft = MEM_SLAB_BYTES;
+                memReserved += MEM_SLAB_BYTES;
+            }
+            block = reinterpret_cast<uint64_t*>(pool.slab);
+            pool.slab += size + 8;
+            pool.slabLeft -= size + 8;
         }
+    }
+    *block = size;
+    noteMemory((long long)size);
+    return block + 1;
+}
+
+void memFree(void* p) {
+    if (!p) return;
+    uint64_t* block = static_cast<uint64_t*>(p) - 1;
+    size_t size = *block;
+    noteMemory(-(long long)size);
+    int c = memClass(size);
+    if (c < 0) {
+        memReserved -= size + 8;
+        free(block);
+        return;
+    }
+    MemPool &pool = memPools[c];
+    lock_guard<mutex> lock(pool.lock);
+    *static_cast<void**>(p) = pool.freeList;
+    pool.freeList = block;
+}
 
-        cout << GREEN << "\n===== Updated Resident Records =====\n" << RESET;
-        displayResidentsTable();
+int memSize(void* p) {
+    return p ? (int)*(static_cast<uint64_t*>(p) - 1) : 0;
+}
 
-        cout << "\nAdd another resident? (Y/N): ";
-        cin >> more;
+void* memRealloc(void* p, int bytes) {
+    if ((size_t)bytes <= (size_t)memSize(p) && memClass(bytes) == memClass(memSize(p))) return p;
+    void* moved = memMalloc(bytes);
+    if (moved && p) {
+        memcpy(moved, p, min(bytes, memSize(p)));
+        memFree(p);
     }
+    return moved;
 }
 
-void updateResident() {
-    cout << GREEN << "\n===== Current Residents =====\n" << RESET;
-    displayResidentsTable();
+int memRoundup(int bytes) {
+    int c = memClass((size_t)bytes);
+    return c >= 0 ? (int)MEM_CLASS_SIZES[c] : (bytes + 7) & ~7;
+}
 
-    clearInput();
-    string oldName;
-    cout << "Enter resident name to update: ";
-    getline(cin, oldName);
+int memInit(void*) { return SQLITE_OK; }
+void memShutdown(void*) {}
 
-    string newName, newAddress, newContact;
-    cout << "New Full Name (leave blank to keep current): ";
-    getline(cin, newName);
-    cout << "New Address (leave blank to keep current): ";
-    getline(cin, newAddress);
-    cout << "New Contact (leave blank to keep current): ";
-    getline(cin, newContact);
+// One page as handed to SQLite: this header, then the page, then its extra bytes
+struct ArenaPage {
+    sqlite3_pcache_page page;
+    unsigned key = 0;
+    unsigned slotSize = 0;      // arena bytes it takes, header included
+    bool pinned = false;
+    bool fromArena = false;
+    ArenaPage* lruPrev = nullptr;
+    ArenaPage* lruNext = nullptr;
+};
 
-    const char* sql_update = "UPDATE residents SET name=COALESCE(NULLIF(?,''),name), "
-                             "address=COALESCE(NULLIF(?,''),address), "
-                             "contact=COALESCE(NULLIF(?,''),contact) WHERE name=?;";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_update, -1, &stmt, nullptr);
-    sqlite3_bind_text(stmt, 1, newName.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, newAddress.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, newContact.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 4, oldName.c_str(), -1, SQLITE_STATIC);
+struct PageArena {
+    mutex lock;
+    char* base = nullptr;
+    size_t bytes = 0;
+    size_t carved = 0;          // bytes handed out as slots so far; the rest is fresh
+    map<size_t, void*> freeSlots;   // by slot size
+    bool hugePages = false;
+    bool mapped = false;
+    atomic<long long> inUse{0};
+    atomic<long long> peak{0};
+    atomic<long long> fallbackPages{0};
+    atomic<long long> pageBytes{0};     // arena and fallback pages alike
+};
 
-    if (sqlite3_step(stmt) == SQLITE_DONE)
-        cout << GREEN << "\nResident updated successfully!\n" << RESET;
-    else
-        cout << RED << "\nResident not found or update failed.\n" << RESET;
+struct PageCache {
+    int szPage = 0;
+    int szExtra = 0;
+    bool purgeable = false;
+    unsigned maxPages = 0;
+    unordered_map<unsigned, ArenaPage*> pages;
+    ArenaPage lru;              // sentinel: lru.lruNext is the oldest unpinned page
+    unsigned unpinned = 0;
+};
 
-    sqlite3_finalize(stmt);
+PageArena pageArena;
 
-    cout << GREEN << "\n===== Updated Resident Records =====\n" << RESET;
-    displayResidentsTable();
+size_t pageSlotSize(int szPage, int szExtra) {
+    return (sizeof(ArenaPage) + szPage + szExtra + 15) & ~(size_t)15;
 }
 
-void searchResident() {
-    cout << GREEN << "\n===== Current Residents =====\n" << RESET;
-    displayResidentsTable();
+// Lazily maps the arena; untouched slots cost no resident memory
+bool mapPageArena() {
+    PageArena &a = pageArena;
+#ifndef _WIN32
+    const size_t hugePage = 2 << 20;
+    const char* huge = getenv("HUGE_PAGES");
+    if (huge && atoi(huge) == 1) {
+        a.bytes = (PAGE_ARENA_BYTES + hugePage - 1) & ~(hugePage - 1);
+        void* p = mmap(nullptr, a.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            a.base = static_cast<char*>(p);
+            a.hugePages = a.mapped = true;
+            return true;
+        }
+    }
+    a.bytes = PAGE_ARENA_BYTES;
+    void* p = mmap(nullptr, a.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) {
+        a.base = static_cast<char*>(p);
+        a.mapped = true;
+        return true;
+    }
+#endif
+    a.bytes = PAGE_ARENA_BYTES;
+    a.base = static_cast<char*>(malloc(a.bytes));
+    return a.base != nullptr;
+}
 
-    clearInput();
-    string keyword;
-    cout << "Enter name keyword to search: ";
-    getline(cin, keyword);
+long long pageCacheBytes() {
+    return pageArena.pageBytes;
+}
+
+// The soft heap limit covers both SQLite's heap and the page cache
+bool underMemoryPressure() {
+    sqlite3_int64 limit = sqlite3_soft_heap_limit64(-1);
+    return limit > 0 && memInUse + pageCacheBytes() >= limit;
+}
+
+ArenaPage* allocPage(PageCache* cache) {
+    size_t need = pageSlotSize(cache->szPage, cache->szExtra);
+    char* slot = nullptr;
+    {
+        PageArena &a = pageArena;
+        lock_guard<mutex> lock(a.lock);
+        if (a.base || mapPageArena()) {
+            void* &freeList = a.freeSlots[need];
+            if (freeList) {
+                slot = static_cast<char*>(freeList);
+                freeList = *reinterpret_cast<void**>(slot);
+            } else if (a.carved + need <= a.bytes) {
+                slot = a.base + a.carved;
+                a.carved += need;
+            }
+        }
+    }
+    if (!slot) return nullptr;
+
+    ArenaPage* p = new (slot) ArenaPage;
+    p->fromArena = true;
+    p->slotSize = (unsigned)need;
+    pageArena.pageBytes += need;
+    long long now = ++pageArena.inUse;
+    long long peak = pageArena.peak;
+    while (now > peak && !pageArena.peak.compare_exchange_weak(peak, now)) {}
+    p->page.pBuf = reinterpret_cast<char*>(p + 1);
+    p->page.pExtra = static_cast<char*>(p->page.pBuf) + cache->szPage;
+    return p;
+}
+
+// For pages SQLite cannot do without (createFlag 2) once the arena is full
+ArenaPage* allocFallbackPage(PageCache* cache) {
+    size_t need = sizeof(ArenaPage) + cache->szPage + cache->szExtra;
+    void* mem = malloc(need);
+    if (!mem) return nullptr;
+    ArenaPage* p = new (mem) ArenaPage;
+    p->slotSize = (unsigned)need;
+    pageArena.pageBytes += need;
+    p->page.pBuf = reinterpret_cast<char*>(p + 1);
+    p->page.pExtra = static_cast<char*>(p->page.pBuf) + cache->szPage;
+    pageArena.fallbackPages++;
+    return p;
+}
+
+void freePage(ArenaPage* p) {
+    pageArena.pageBytes -= p->slotSize;
+    if (!p->fromArena) {
+        pageArena.fallbackPages--;
+        free(p);
+        return;
+    }
+    pageArena.inUse--;
+    lock_guard<mutex> lock(pageArena.lock);
+    void* &freeList = pageArena.freeSlots[p->slotSize];
+    *reinterpret_cast<void**>(p) = freeList;
+    freeList = p;
+}
+
+void lruRemove(PageCache* cache, ArenaPage* p) {
+    p->lruPrev->lruNext = p->lruNext;
+    p->lruNext->lruPrev = p->lruPrev;
+    p->lruPrev = p->lruNext = nullptr;
+    cache->unpinned--;
+}
+
+void lruAppend(PageCache* cache, ArenaPage* p) {
+    p->lruPrev = cache->lru.lruPrev;
+    p->lruNext = &cache->lru;
+    cache->lru.lruPrev->lruNext = p;
+    cache->lru.lruPrev = p;
+    cache->unpinned++;
+}
+
+void discardPage(PageCache* cache, ArenaPage* p) {
+    if (p->lruNext) lruRemove(cache, p);
+    cache->pages.erase(p->key);
+    freePage(p);
+}
+
+// Takes the oldest unpinned page out of the cache for reuse
+ArenaPage* recyclePage(PageCache* cache) {
+    if (!cache->purgeable || cache->unpinned == 0) return nullptr;
+    ArenaPage* p = cache->lru.lruNext;
+    lruRemove(cache, p);
+    cache->pages.erase(p->key);
+    return p;
+}
+
+void trimCache(PageCache* cache, size_t keep) {
+    while (cache->purgeable && cache->unpinned > 0 && cache->pages.size() > keep)
+        discardPage(cache, cache->lru.lruNext);
+}
+
+int pcacheInit(void*) { return SQLITE_OK; }
+void pcacheShutdown(void*) {}
+
+sqlite3_pcache* pcacheCreate(int szPage, int szExtra, int purgeable) {
+    PageCache* cache = new PageCache;
+    cache->szPage = szPage;
+    cache->szExtra = szExtra;
+    cache->purgeable = purgeable != 0;
+    cache->lru.lruPrev = cache->lru.lruNext = &cache->lru;
+    return reinterpret_cast<sqlite3_pcache*>(cache);
+}
+
+void pcacheCachesize(sqlite3_pcache* pc, int pages) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    cache->maxPages = pages > 0 ? (unsigned)pages : 0;
+    if (cache->maxPages) trimCache(cache, cache->maxPages);
+}
+
+int pcachePagecount(sqlite3_pcache* pc) {
+    return (int)reinterpret_cast<PageCache*>(pc)->pages.size();
+}
+
+sqlite3_pcache_page* pcacheFetch(sqlite3_pcache* pc, unsigned key, int createFlag) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    auto it = cache->pages.find(key);
+    if (it != cache->pages.end()) {
+        ArenaPage* p = it->second;
+        if (p->lruNext) lruRemove(cache, p);
+        p->pinned = true;
+        return &p->page;
+    }
+    if (createFlag == 0) return nullptr;
+
+    // Full (or short on memory): reuse our own oldest page, or leave it to
+    // SQLite to spill dirty pages and ask again with createFlag 2
+    bool full = (cache->purgeable && cache->maxPages && cache->pages.size() >= cache->maxPages) ||
+                underMemoryPressure();
+    ArenaPage* p = full ? recyclePage(cache) : nullptr;
+    if (!p && full && createFlag == 1) return nullptr;
+    if (!p) p = allocPage(cache);
+    if (!p) p = recyclePage(cache);
+    if (!p && createFlag == 2) p = allocFallbackPage(cache);
+    if (!p) return nullptr;
+
+    p->key = key;
+    p->pinned = true;
+    memset(p->page.pExtra, 0, cache->szExtra);
+    cache->pages[key] = p;
+    return &p->page;
+}
+
+void pcacheUnpin(sqlite3_pcache* pc, sqlite3_pcache_page* page, int discard) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    ArenaPage* p = reinterpret_cast<ArenaPage*>(page);
+    p->pinned = false;
+    if (discard) {
+        discardPage(cache, p);
+        return;
+    }
+    // Pages of temporary and in-memory databases are the data; never recycle them
+    if (!cache->purgeable) return;
+    lruAppend(cache, p);
+    if (cache->maxPages) trimCache(cache, cache->maxPages);
+}
+
+void pcacheRekey(sqlite3_pcache* pc, sqlite3_pcache_page* page, unsigned oldKey, unsigned newKey) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    ArenaPage* p = reinterpret_cast<ArenaPage*>(page);
+    auto existing = cache->pages.find(newKey);
+    if (existing != cache->pages.end() && existing->second != p) discardPage(cache, existing->second);
+    cache->pages.erase(oldKey);
+    p->key = newKey;
+    cache->pages[newKey] = p;
+}
+
+// Drops every page numbered limit or above, pinned or not
+void pcacheTruncate(sqlite3_pcache* pc, unsigned limit) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    vector<ArenaPage*> doomed;
+    for (auto &entry : cache->pages)
+        if (entry.first >= limit) doomed.push_back(entry.second);
+    for (ArenaPage* p : doomed) discardPage(cache, p);
+}
+
+void pcacheDestroy(sqlite3_pcache* pc) {
+    PageCache* cache = reinterpret_cast<PageCache*>(pc);
+    for (auto &entry : cache->pages) freePage(entry.second);
+    delete cache;
+}
+
+void pcacheShrink(sqlite3_pcache* pc) {
+    trimCache(reinterpret_cast<PageCache*>(pc), 0);
+}
+
+// Must run before anything else touches SQLite (sqlite3_config refuses afterwards)
+bool configureSqliteMemory() {
+    static const sqlite3_mem_methods mem = {
+        memMalloc, memFree, memRealloc, memSize, memRoundup, memInit, memShutdown, nullptr};
+    static const sqlite3_pcache_methods2 pcache = {
+        1, nullptr, pcacheInit, pcacheShutdown, pcacheCreate, pcacheCachesize, pcachePagecount,
+        pcacheFetch, pcacheUnpin, pcacheRekey, pcacheTruncate, pcacheDestroy, pcacheShrink};
+    bool ok = sqlite3_config(SQLITE_CONFIG_MALLOC, &mem) == SQLITE_OK &&
+              sqlite3_config(SQLITE_CONFIG_PCACHE2, &pcache) == SQLITE_OK;
+    sqlite3_soft_heap_limit64(SOFT_HEAP_LIMIT);
+    return ok;
+}
+
+// Right after open, before the connection has allocated anything from it
+void configureLookaside(sqlite3* conn, int slotSize, int slots) {
+    sqlite3_db_config(conn, SQLITE_DBCONFIG_LOOKASIDE, nullptr, slotSize, slots);
+}
+
+// Resident set size now and at its peak, in KiB (0 where unsupported)
+void processMemory(long long &rssKb, long long &peakKb) {
+    rssKb = peakKb = 0;
+#ifndef _WIN32
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) rssKb = atoll(line.c_str() + 6);
+        if (line.compare(0, 6, "VmHWM:") == 0) peakKb = atoll(line.c_str() + 6);
+    }
+#endif
+}
+
+void printMemory() {
+    long long rssKb, peakKb;
+    processMemory(rssKb, peakKb);
+    cout << "memory          : SQLite heap " << memInUse / 1024 << " KiB (peak " << memPeak / 1024
+         << "), page cache " << pageArena.inUse + pageArena.fallbackPages << " pages, " << pageCacheBytes() / 1024
+         << " KiB (peak " << pageArena.peak << " pages" << (pageArena.hugePages ? ", huge pages" : "") << ")";
+    if (rssKb) cout << ", RSS " << rssKb / 1024 << " MiB (peak " << peakKb / 1024 << ")";
+    cout << "\n";
+}
+
+// ------------------------
+// I/O ACCOUNTING (shim VFS)
+// ------------------------
+// A VFS registered as the default at startup that wraps the platform one
+// (unix or win32). It counts reads, writes and syncs per kind of file, keeps
+// a latency histogram for each, and can inject faults for testing, set
+// through IO_FAULTS, e.g. IO_FAULTS=write=500,sync=20,delay=2000:
+//   write=N / sync=N  every Nth write / sync fails with an I/O error
+//   delay=US          sleeps that many microseconds before each write and sync
+//   cut=N             after N writes, writes and syncs "succeed" without
+//                     touching the disk, like a power cut (used by bench-recovery)
+// Only database, WAL and journal files are affected by faults.
+enum IoFileKind { IO_MAIN_DB, IO_WAL, IO_JOURNAL, IO_OTHER, IO_KINDS };
+enum IoOp { IO_READ, IO_WRITE, IO_SYNC, IO_OPS };
+const char* IO_KIND_NAMES[IO_KINDS] = {"main db", "WAL", "journal", "other"};
+const char* IO_OP_NAMES[IO_OPS] = {"read", "write", "sync"};
+const int IO_BUCKETS = 6;   // <10us, <100us, <1ms, <10ms, <100ms, slower
+const char* IO_BUCKET_NAMES[IO_BUCKETS] = {"<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms"};
+
+struct IoCounter {
+    atomic<long long> count{0};
+    atomic<long long> bytes{0};
+    atomic<long long> micros{0};
+    atomic<long long> buckets[IO_BUCKETS] = {};
+};
+
+// A plain copy of the counters, so callers can diff before/after an action
+struct IoTotals {
+    long long count[IO_KINDS][IO_OPS] = {};
+    long long bytes[IO_KINDS][IO_OPS] = {};
+    long long micros[IO_KINDS][IO_OPS] = {};
+    long long buckets[IO_KINDS][IO_OPS][IO_BUCKETS] = {};
+};
+
+struct IoFaults {
+    atomic<long long> failWriteEvery{0};
+    atomic<long long> failSyncEvery{0};
+    atomic<int> delayMicros{0};
+    atomic<long long> powerCutAfter{-1};
+    atomic<long long> writes{0};
+    atomic<long long> syncs{0};
+};
+
+IoCounter ioCounters[IO_KINDS][IO_OPS];
+IoFaults ioFaults;
+sqlite3_vfs* ioRealVfs = nullptr;
+sqlite3_vfs ioShimVfs;
+
+struct IoShimFile {
+    sqlite3_file base;
+    int kind;
+    sqlite3_file* real;     // allocated right behind this struct
+};
+
+sqlite3_file* realFile(sqlite3_file* f) { return reinterpret_cast<IoShimFile*>(f)->real; }
+
+void recordIo(sqlite3_file* f, IoOp op, long long bytes, chrono::steady_clock::time_point start) {
+    long long us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    IoCounter &c = ioCounters[reinterpret_cast<IoShimFile*>(f)->kind][op];
+    c.count++;
+    c.bytes += bytes;
+    c.micros += us;
+    int bucket = 0;
+    for (long long limit = 10; us >= limit && bucket < IO_BUCKETS - 1; limit *= 10) bucket++;
+    c.buckets[bucket]++;
+}
+
+// SQLITE_OK to go ahead, an error code to fail the call, or -1 to pretend it succeeded
+int ioFault(sqlite3_file* f, IoOp op) {
+    if (reinterpret_cast<IoShimFile*>(f)->kind == IO_OTHER) return SQLITE_OK;
+    long long n = op == IO_WRITE ? ++ioFaults.writes : ++ioFaults.syncs;
+    if (int delay = ioFaults.delayMicros) this_thread::sleep_for(chrono::microseconds(delay));
+    long long cut = ioFaults.powerCutAfter;
+    if (cut >= 0 && ioFaults.writes > cut) return -1;
+    long long every = op == IO_WRITE ? ioFaults.failWriteEvery : ioFaults.failSyncEvery;
+    if (every > 0 && n % every == 0) return op == IO_WRITE ? SQLITE_IOERR_WRITE : SQLITE_IOERR_FSYNC;
+    return SQLITE_OK;
+}
+
+int ioClose(sqlite3_file* f) {
+    int rc = realFile(f)->pMethods->xClose(realFile(f));
+    f->pMethods = nullptr;
+    return rc;
+}
+int ioRead(sqlite3_file* f, void* buf, int amount, sqlite3_int64 offset) {
+    auto start = chrono::steady_clock::now();
+    int rc = realFile(f)->pMethods->xRead(realFile(f), buf, amount, offset);
+    recordIo(f, IO_READ, amount, start);
+    return rc;
+}
+int ioWrite(sqlite3_file* f, const void* buf, int amount, sqlite3_int64 offset) {
+    auto start = chrono::steady_clock::now();
+    int rc = ioFault(f, IO_WRITE);
+    if (rc == SQLITE_OK) rc = realFile(f)->pMethods->xWrite(realFile(f), buf, amount, offset);
+    recordIo(f, IO_WRITE, amount, start);
+    return rc < 0 ? SQLITE_OK : rc;
+}
+int ioSync(sqlite3_file* f, int flags) {
+    auto start = chrono::steady_clock::now();
+    int rc = ioFault(f, IO_SYNC);
+    if (rc == SQLITE_OK) rc = realFile(f)->pMethods->xSync(realFile(f), flags);
+    recordIo(f, IO_SYNC, 0, start);
+    return rc < 0 ? SQLITE_OK : rc;
+}
+int ioTruncate(sqlite3_file* f, sqlite3_int64 size) {
+    if (ioFaults.powerCutAfter >= 0 && ioFaults.writes > ioFaults.powerCutAfter) return SQLITE_OK;
+    return realFile(f)->pMethods->xTruncate(realFile(f), size);
+}
+int ioFileSize(sqlite3_file* f, sqlite3_int64* size) { return realFile(f)->pMethods->xFileSize(realFile(f), size); }
+int ioLock(sqlite3_file* f, int level) { return realFile(f)->pMethods->xLock(realFile(f), level); }
+int ioUnlock(sqlite3_file* f, int level) { return realFile(f)->pMethods->xUnlock(realFile(f), level); }
+int ioCheckReservedLock(sqlite3_file* f, int* out) { return realFile(f)->pMethods->xCheckReservedLock(realFile(f), out); }
+int ioFileControl(sqlite3_file* f, int op, void* arg) { return realFile(f)->pMethods->xFileControl(realFile(f), op, arg); }
+int ioSectorSize(sqlite3_file* f) { return realFile(f)->pMethods->xSectorSize(realFile(f)); }
+int ioDeviceCharacteristics(sqlite3_file* f) { return realFile(f)->pMethods->xDeviceCharacteristics(realFile(f)); }
+int ioShmMap(sqlite3_file* f, int region, int size, int extend, void volatile** out) {
+    return realFile(f)->pMethods->xShmMap(realFile(f), region, size, extend, out);
+}
+int ioShmLock(sqlite3_file* f, int offset, int n, int flags) { return realFile(f)->pMethods->xShmLock(realFile(f), offset, n, flags); }
+void ioShmBarrier(sqlite3_file* f) { realFile(f)->pMethods->xShmBarrier(realFile(f)); }
+int ioShmUnmap(sqlite3_file* f, int deleteFlag) { return realFile(f)->pMethods->xShmUnmap(realFile(f), deleteFlag); }
+int ioFetch(sqlite3_file* f, sqlite3_int64 offset, int amount, void** out) {
+    return realFile(f)->pMethods->xFetch(realFile(f), offset, amount, out);
+}
+int ioUnfetch(sqlite3_file* f, sqlite3_int64 offset, void* p) { return realFile(f)->pMethods->xUnfetch(realFile(f), offset, p); }
+
+// One table per method version, so SQLite only calls what the real file has
+const sqlite3_io_methods ioShimMethods[3] = {
+    {1, ioClose, ioRead, ioWrite, ioTruncate, ioSync, ioFileSize, ioLock, ioUnlock, ioCheckReservedLock,
+     ioFileControl, ioSectorSize, ioDeviceCharacteristics, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+    {2, ioClose, ioRead, ioWrite, ioTruncate, ioSync, ioFileSize, ioLock, ioUnlock, ioCheckReservedLock,
+     ioFileControl, ioSectorSize, ioDeviceCharacteristics, ioShmMap, ioShmLock, ioShmBarrier, ioShmUnmap, nullptr, nullptr},
+    {3, ioClose, ioRead, ioWrite, ioTruncate, ioSync, ioFileSize, ioLock, ioUnlock, ioCheckReservedLock,
+     ioFileControl, ioSectorSize, ioDeviceCharacteristics, ioShmMap, ioShmLock, ioShmBarrier, ioShmUnmap, ioFetch, ioUnfetch},
+};
+
+int ioOpen(sqlite3_vfs*, const char* name, sqlite3_file* f, int flags, int* outFlags) {
+    IoShimFile* shim = reinterpret_cast<IoShimFile*>(f);
+    shim->real = reinterpret_cast<sqlite3_file*>(shim + 1);
+    shim->kind = flags & SQLITE_OPEN_MAIN_DB ? IO_MAIN_DB
+               : flags & SQLITE_OPEN_WAL ? IO_WAL
+               : flags & SQLITE_OPEN_MAIN_JOURNAL ? IO_JOURNAL : IO_OTHER;
+    int rc = ioRealVfs->xOpen(ioRealVfs, name, shim->real, flags, outFlags);
+    const sqlite3_io_methods* real = shim->real->pMethods;
+    f->pMethods = real ? &ioShimMethods[min(max(real->iVersion, 1), 3) - 1] : nullptr;
+    return rc;
+}
+int ioDelete(sqlite3_vfs*, const char* name, int syncDir) { return ioRealVfs->xDelete(ioRealVfs, name, syncDir); }
+int ioAccess(sqlite3_vfs*, const char* name, int flags, int* out) { return ioRealVfs->xAccess(ioRealVfs, name, flags, out); }
+int ioFullPathname(sqlite3_vfs*, const char* name, int size, char* out) {
+    return ioRealVfs->xFullPathname(ioRealVfs, name, size, out);
+}
+void* ioDlOpen(sqlite3_vfs*, const char* name) { return ioRealVfs->xDlOpen(ioRealVfs, name); }
+void ioDlError(sqlite3_vfs*, int size, char* out) { ioRealVfs->xDlError(ioRealVfs, size, out); }
+void (*ioDlSym(sqlite3_vfs*, void* handle, const char* symbol))(void) { return ioRealVfs->xDlSym(ioRealVfs, handle, symbol); }
+void ioDlClose(sqlite3_vfs*, void* handle) { ioRealVfs->xDlClose(ioRealVfs, handle); }
+int ioRandomness(sqlite3_vfs*, int size, char* out) { return ioRealVfs->xRandomness(ioRealVfs, size, out); }
+int ioSleep(sqlite3_vfs*, int micros) { return ioRealVfs->xSleep(ioRealVfs, micros); }
+int ioCurrentTime(sqlite3_vfs*, double* out) { return ioRealVfs->xCurrentTime(ioRealVfs, out); }
+int ioGetLastError(sqlite3_vfs*, int size, char* out) {
+    return ioRealVfs->xGetLastError ? ioRealVfs->xGetLastError(ioRealVfs, size, out) : 0;
+}
+int ioCurrentTimeInt64(sqlite3_vfs*, sqlite3_int64* out) { return ioRealVfs->xCurrentTimeInt64(ioRealVfs, out); }
+
+// Reads IO_FAULTS, e.g. "write=500,delay=2000"
+void parseIoFaults(const string &spec) {
+    stringstream in(spec);
+    string item;
+    while (getline(in, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == string::npos) continue;
+        string key = item.substr(0, eq);
+        long long value = atoll(item.c_str() + eq + 1);
+        if (key == "write") ioFaults.failWriteEvery = value;
+        else if (key == "sync") ioFaults.failSyncEvery = value;
+        else if (key == "delay") ioFaults.delayMicros = (int)value;
+        else if (key == "cut") ioFaults.powerCutAfter = value;
+    }
+}
+
+// Must run before the first connection is opened
+bool registerIoShim() {
+    ioRealVfs = sqlite3_vfs_find(nullptr);
+    if (!ioRealVfs) return false;
+    ioShimVfs = sqlite3_vfs{};
+    ioShimVfs.iVersion = 2;
+    ioShimVfs.szOsFile = (int)sizeof(IoShimFile) + ioRealVfs->szOsFile;
+    ioShimVfs.mxPathname = ioRealVfs->mxPathname;
+    ioShimVfs.zName = "iostat";
+    ioShimVfs.xOpen = ioOpen;
+    ioShimVfs.xDelete = ioDelete;
+    ioShimVfs.xAccess = ioAccess;
+    ioShimVfs.xFullPathname = ioFullPathname;
+    ioShimVfs.xDlOpen = ioDlOpen;
+    ioShimVfs.xDlError = ioDlError;
+    ioShimVfs.xDlSym = ioDlSym;
+    ioShimVfs.xDlClose = ioDlClose;
+    ioShimVfs.xRandomness = ioRandomness;
+    ioShimVfs.xSleep = ioSleep;
+    ioShimVfs.xCurrentTime = ioCurrentTime;
+    ioShimVfs.xGetLastError = ioGetLastError;
+    ioShimVfs.xCurrentTimeInt64 = ioCurrentTimeInt64;
+    if (const char* faults = getenv("IO_FAULTS")) parseIoFaults(faults);
+    return sqlite3_vfs_register(&ioShimVfs, 1) == SQLITE_OK;
+}
+
+IoTotals ioTotals() {
+    IoTotals t;
+    for (int k = 0; k < IO_KINDS; ++k)
+        for (int op = 0; op < IO_OPS; ++op) {
+            const IoCounter &c = ioCounters[k][op];
+            t.count[k][op] = c.count;
+            t.bytes[k][op] = c.bytes;
+            t.micros[k][op] = c.micros;
+            for (int b = 0; b < IO_BUCKETS; ++b) t.buckets[k][op][b] = c.buckets[b];
+        }
+    return t;
+}
+
+long long ioSyncsSince(const IoTotals &before) {
+    IoTotals now = ioTotals();
+    long long syncs = 0;
+    for (int k = 0; k < IO_KINDS; ++k) syncs += now.count[k][IO_SYNC] - before.count[k][IO_SYNC];
+    return syncs;
+}
+
+// Prints what happened since `before`: counts, volume and latency per file kind
+void printIoSince(const IoTotals &before) {
+    IoTotals now = ioTotals();
+    bool any = false;
+    for (int k = 0; k < IO_KINDS; ++k)
+        for (int op = 0; op < IO_OPS; ++op) {
+            long long n = now.count[k][op] - before.count[k][op];
+            if (n == 0) continue;
+            if (!any) cout << CYAN << "I/O: " << left << setw(9) << "file" << setw(7) << "op" << right
+                           << setw(8) << "count" << setw(11) << "KiB" << setw(10) << "avg us" << "  latency\n" << RESET;
+            any = true;
+            cout << "     " << left << setw(9) << IO_KIND_NAMES[k] << setw(7) << IO_OP_NAMES[op] << right
+                 << setw(8) << n << setw(11) << (now.bytes[k][op] - before.bytes[k][op]) / 1024
+                 << setw(10) << (now.micros[k][op] - before.micros[k][op]) / n << " ";
+            for (int b = 0; b < IO_BUCKETS; ++b) {
+                long long inBucket = now.buckets[k][op][b] - before.buckets[k][op][b];
+                if (inBucket) cout << " " << IO_BUCKET_NAMES[b] << ":" << inBucket;
+            }
+            cout << "\n";
+        }
+    if (!any) cout << CYAN << "I/O: none\n" << RESET;
+}
+
+// ------------------------
+// NAME COLLATION (FOLD)
+// ------------------------
+// SQLite's NOCASE only folds ASCII, so "Ñ" never equals "ñ" and "Jose" never
+// finds "José". FOLD (fold/fold.h) compares text after folding case and
+// accents away.
+//
+// It is registered on every connection the program opens (as an auto
+// extension), and residents.name and announcements.title are indexed under it, so
+// lookups that ignore case and accents are index searches. Other programs
+// must register FOLD too before they can write to those tables or check the
+// database: the sqlite3 shell loads it from fold_extension.cpp (see the README).
+
+int registerFold(sqlite3* conn, const char**, const sqlite3_api_routines*) {
+    return sqlite3_create_collation_v2(conn, "FOLD", SQLITE_UTF8, nullptr, foldCompare, nullptr);
+}
+
+// Must run before the first connection is opened
+void registerFoldCollation() {
+    sqlite3_auto_extension(reinterpret_cast<void (*)(void)>(registerFold));
+}
+
+// Where a prefix search under FOLD stops: every name that starts with prefix
+// (folded) sorts below prefix followed by the last code point
+string foldPrefixEnd(const string &prefix) {
+    return prefix + "\xF4\x8F\xBF\xBF";
+}
+
+// A WHERE condition for the rows whose column starts with the text bound to
+// its first parameter, under FOLD; the second takes foldPrefixEnd(text)
+string foldedPrefixMatch(const string &column) {
+    return column + " >= ? COLLATE FOLD AND " + column + " < ? COLLATE FOLD";
+}
+
+// A WHERE condition for the rows whose column holds the name bound to ?param,
+// under FOLD. Of several spellings the exact one wins, else the first row's,
+// so "maria" finds "Maria" but never changes "Maria" and "MARÍA" together.
+string foldedNameMatch(const string &table, const string &column, int param) {
+    string p = "?" + to_string(param);
+    return column + " = " + p + " COLLATE FOLD AND " + column + " = (SELECT " + column + " FROM " + table +
+           " WHERE " + column + " = " + p + " COLLATE FOLD ORDER BY " + column + " = " + p + " DESC, id LIMIT 1)";
+}
+
+// ------------------------
+// WRITE QUEUE (group commit)
+// ------------------------
+// All mutations go through one writer thread with its own connection. Callers
+// push an operation onto a lock-free stack and get a future back; the writer
+// takes everything queued every few milliseconds and commits it as a single
+// transaction, so concurrent writers share one fsync instead of fighting over
+// the write lock. Each operation runs under its own savepoint, so one failing
+// (e.g. on a UNIQUE conflict) does not undo the others.
+struct WriteOp {
+    function<bool(sqlite3*)> apply;         // returning false undoes just this operation
+    function<void(bool committed)> finish;
+    WriteOp* next = nullptr;
+};
+
+struct WriteQueue {
+    sqlite3* conn = nullptr;
+    ChangeCapture* capture = nullptr;
+    atomic<WriteOp*> head{nullptr};
+    atomic<size_t> queued{0};
+    atomic<bool> sleeping{false};
+    atomic<bool> running{false};
+    mutex wakeMutex;
+    condition_variable wake;
+    thread worker;
+    int windowMs = 2;
+    size_t lastBatch = 0;
+    atomic<long long> transactions{0};
+    atomic<long long> operations{0};
+};
+
+void pushWrite(WriteQueue &q, WriteOp* op) {
+    WriteOp* top = q.head.load();
+    do {
+        op->next = top;
+    } while (!q.head.compare_exchange_weak(top, op));
+    q.queued++;
+
+    // Only a writer that is actually asleep needs the mutex/condvar handshake
+    if (q.sleeping.load()) {
+        lock_guard<mutex> lock(q.wakeMutex);
+        q.wake.notify_one();
+    }
+}
+
+// fn(conn, result) fills in the result and returns false to undo its changes.
+// The future yields that result once the transaction has committed, or
+// `failed` if the transaction as a whole could not be committed.
+template <typename T, typename F>
+future<T> submitWrite(WriteQueue &q, F fn, T failed) {
+    auto result = make_shared<T>(failed);
+    auto done = make_shared<promise<T>>();
+    WriteOp* op = new WriteOp;
+    op->apply = [fn, result](sqlite3* conn) { return fn(conn, *result); };
+    op->finish = [result, done, failed](bool committed) { done->set_value(committed ? *result : failed); };
+    pushWrite(q, op);
+    return done->get_future();
+}
+
+void runWriteBatch(WriteQueue &q, vector<WriteOp*> &batch) {
+    bool began = sqlite3_exec(q.conn, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    for (size_t i = 0; i < batch.size() && began; ++i) {
+        ChangeMark mark = markChanges(q.capture);
+        sqlite3_exec(q.conn, "SAVEPOINT op;", nullptr, nullptr, nullptr);
+        if (!batch[i]->apply(q.conn)) {
+            sqlite3_exec(q.conn, "ROLLBACK TO op;", nullptr, nullptr, nullptr);
+            rewindChanges(q.capture, mark);
+        }
+        sqlite3_exec(q.conn, "RELEASE op;", nullptr, nullptr, nullptr);
+    }
+
+    // A transaction that changed tracked rows takes its sequence number and the
+    // change-log lock before COMMIT; the trace hook appends it as COMMIT finishes
+    bool logged = began && q.capture && !q.capture->pending.empty();
+    if (logged) lockChangeLog(*q.capture->log);
+    bool committed = began && (!logged || reserveChangeSeq(*q.capture)) &&
+                     sqlite3_exec(q.conn, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (began && !committed)
+        sqlite3_exec(q.conn, "ROLLBACK;", nullptr, nullptr, nullptr);
+    if (logged) unlockChangeLog(*q.capture->log);
+    q.transactions++;
+    q.operations += batch.size();
+
+    for (WriteOp* op : batch) {
+        op->finish(committed);
+        delete op;
+    }
+}
+
+void writerLoop(WriteQueue* q) {
+    while (true) {
+        if (!q->head.load()) {
+            if (!q->running) break;
+            unique_lock<mutex> lock(q->wakeMutex);
+            q->sleeping = true;
+            q->wake.wait(lock, [&] { return q->head.load() != nullptr || !q->running; });
+            q->sleeping = false;
+            continue;
+        }
+
+        // Once writers are seen to overlap, give them up to windowMs to join
+        // this transaction (as many as last time is enough); a lone writer
+        // such as the menu is committed straight away
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds(q->windowMs);
+        while (q->lastBatch > 1 && q->queued.load() < q->lastBatch && chrono::steady_clock::now() < deadline)
+            this_thread::sleep_for(chrono::microseconds(50));
+
+        // The stack is newest-first; reverse it so operations apply in order
+        vector<WriteOp*> batch;
+        for (WriteOp* op = q->head.exchange(nullptr); op; op = op->next)
+            batch.push_back(op);
+        reverse(batch.begin(), batch.end());
+        q->queued -= batch.size();
+        q->lastBatch = batch.size();
+        runWriteBatch(*q, batch);
+    }
+}
+
+bool startWriteQueue(WriteQueue &q, const string &path) {
+    if (sqlite3_open_v2(path.c_str(), &q.conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        sqlite3_close(q.conn);
+        q.conn = nullptr;
+        return false;
+    }
+    configureLookaside(q.conn, LOOKASIDE_WRITER_SLOT, LOOKASIDE_WRITER_SLOTS);
+    sqlite3_busy_timeout(q.conn, 5000);
+    q.running = true;
+    q.worker = thread(writerLoop, &q);
+    return true;
+}
+
+// Drains whatever is still queued, then stops the writer thread
+void stopWriteQueue(WriteQueue &q) {
+    if (!q.running) return;
+    {
+        lock_guard<mutex> lock(q.wakeMutex);
+        q.running = false;
+    }
+    q.wake.notify_one();
+    q.worker.join();
+    sqlite3_close(q.conn);
+    q.conn = nullptr;
+}
+
+// ------------------------
+// DATABASE CONTEXT
+// ------------------------
+// Everything that talks to the database file: the write queue and one
+// read-only connection per reading thread, each with its own statement cache.
+// Functions take the context explicitly rather than sharing one connection, so
+// reports, exports and searches can run off the UI thread. Connections are
+// opened NOMUTEX since no two threads ever use the same one.
+struct ReadConnection {
+    sqlite3* conn = nullptr;
+    map<string, sqlite3_stmt*> statements;
+};
+
+struct DbContext {
+    string path;
+    ChangeLog changeLog;
+    WriteQueue writer;
+    mutex readersMutex;
+    map<thread::id, unique_ptr<ReadConnection>> readers;
+};
+
+void closeReadConnection(ReadConnection &rc) {
+    for (auto &entry : rc.statements) sqlite3_finalize(entry.second);
+    rc.statements.clear();
+    sqlite3_close(rc.conn);
+    rc.conn = nullptr;
+}
+
+// The calling thread's read connection, opened on first use
+ReadConnection* readConnection(DbContext &ctx) {
+    thread::id self = this_thread::get_id();
+    {
+        lock_guard<mutex> lock(ctx.readersMutex);
+        auto it = ctx.readers.find(self);
+        if (it != ctx.readers.end()) return it->second.get();
+    }
+
+    auto rc = make_unique<ReadConnection>();
+    if (sqlite3_open_v2(ctx.path.c_str(), &rc->conn, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        closeReadConnection(*rc);
+        return nullptr;
+    }
+    configureLookaside(rc->conn, LOOKASIDE_READER_SLOT, LOOKASIDE_READER_SLOTS);
+    sqlite3_busy_timeout(rc->conn, 5000);
+    lock_guard<mutex> lock(ctx.readersMutex);
+    return (ctx.readers[self] = move(rc)).get();
+}
+
+// A statement for sql on this thread's connection, prepared once and reset
+// for reuse. Callers must sqlite3_reset() it when done, or the connection
+// keeps reading from the snapshot it started on.
+sqlite3_stmt* readStatement(DbContext &ctx, const string &sql) {
+    ReadConnection* rc = readConnection(ctx);
+    if (!rc) return nullptr;
+
+    sqlite3_stmt* &stmt = rc->statements[sql];
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    } else if (sqlite3_prepare_v3(rc->conn, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        rc->statements.erase(sql);
+        return nullptr;
+    }
+    return stmt;
+}
+
+// Threads that exit before the context is closed give their connection back
+void releaseReadConnection(DbContext &ctx) {
+    unique_ptr<ReadConnection> rc;
+    {
+        lock_guard<mutex> lock(ctx.readersMutex);
+        auto it = ctx.readers.find(this_thread::get_id());
+        if (it == ctx.readers.end()) return;
+        rc = move(it->second);
+        ctx.readers.erase(it);
+    }
+    closeReadConnection(*rc);
+}
+
+// Creates the schema, switches to WAL so readers never block the writer (or
+// each other), and starts the writer with change capture attached.
+bool openDbContext(DbContext &ctx, const string &path, const char* schema, string &error) {
+    sqlite3* setup = nullptr;
+    if (sqlite3_open(path.c_str(), &setup) != SQLITE_OK) {
+        error = sqlite3_errmsg(setup);
+        sqlite3_close(setup);
+        return false;
+    }
+    sqlite3_busy_timeout(setup, 5000);      // another process may be opening it too
+    // Only takes effect before the first table exists; see Maintenance
+    sqlite3_exec(setup, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
+    char* errMsg = nullptr;
+    if (sqlite3_exec(setup, schema, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        error = errMsg;
+        sqlite3_free(errMsg);
+        sqlite3_close(setup);
+        return false;
+    }
+    sqlite3_exec(setup, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+    ctx.path = sqlite3_db_filename(setup, "main");
+    bool logOpen = openChangeLog(ctx.changeLog, setup, ctx.path);
+    sqlite3_close(setup);
+    if (!logOpen) {
+        closeChangeLog(ctx.changeLog);
+        error = "can't open the change log";
+        return false;
+    }
+
+    if (!startWriteQueue(ctx.writer, ctx.path)) {
+        closeChangeLog(ctx.changeLog);
+        error = "can't open writer connection";
+        return false;
+    }
+    ChangeLog* log = &ctx.changeLog;
+    ctx.writer.capture = submitWrite(ctx.writer, [log](sqlite3* conn, ChangeCapture* &capture) {
+        capture = captureChanges(*log, conn);
+        return capture != nullptr;
+    }, (ChangeCapture*)nullptr).get();
+    if (!ctx.writer.capture) {
+        stopWriteQueue(ctx.writer);
+        closeChangeLog(ctx.changeLog);
+        error = "can't capture changes on the writer connection";
+        return false;
+    }
+    return true;
+}
+
+// The writer closes last: only a read-write connection can checkpoint and
+// remove the WAL on the way out
+void closeDbContext(DbContext &ctx) {
+    {
+        lock_guard<mutex> lock(ctx.readersMutex);
+        for (auto &entry : ctx.readers) closeReadConnection(*entry.second);
+        ctx.readers.clear();
+    }
+    stopWriteQueue(ctx.writer);
+    ctx.writer.capture = nullptr;
+    closeChangeLog(ctx.changeLog);
+}
+
+// ------------------------
+// CANCELLABLE QUERIES
+// ------------------------
+// Interactive searches and reports run under a QueryGuard: a progress handler
+// that shows elapsed time once a query gets slow, stops it at its deadline,
+// and stops it when the user presses Ctrl-C or ESC (or a background job is
+// cancelled). An interrupted query returns SQLITE_INTERRUPT, and whatever rows
+// it produced so far are shown labelled as partial.
+enum QueryOutcome { QUERY_DONE, QUERY_CANCELLED, QUERY_TIMED_OUT, QUERY_FAILED };
+
+const int SEARCH_TIMEOUT_MS = 30000;
+const int REPORT_TIMEOUT_MS = 120000;
+
+struct QueryGuard {
+    string label;
+    int timeoutMs = 0;
+    bool interactive = true;                    // Ctrl-C/ESC and a progress line
+    const atomic<bool>* cancelFlag = nullptr;   // e.g. a background job's
+
+    sqlite3* conn = nullptr;
+    thread::id owner;
+    chrono::steady_clock::time_point start, deadline, lastPolled;
+    atomic<bool> cancelled{false};
+    atomic<bool> timedOut{false};
+    bool shown = false;
+    bool rawTerminal = false;
+#ifndef _WIN32
+    termios savedTerminal;
+#endif
+    void (*previousSignal)(int) = SIG_DFL;
+};
+
+atomic<QueryGuard*> activeQueryGuard{nullptr};
+
+void onQuerySignal(int) {
+    QueryGuard* guard = activeQueryGuard.load();
+    if (!guard) return;
+    guard->cancelled = true;
+    if (guard->conn) sqlite3_interrupt(guard->conn);
+}
+
+bool escapePressed(QueryGuard &g) {
+    if (!g.rawTerminal) return false;
+#ifdef _WIN32
+    while (_kbhit())
+        if (_getch() == 27) return true;
+#else
+    unsigned char c;
+    while (read(STDIN_FILENO, &c, 1) == 1)
+        if (c == 27) return true;
+#endif
+    return false;
+}
+
+// Checks the deadline and cancel sources; on the owning thread it also polls
+// for ESC and redraws the progress line, at most every 50 ms
+bool pollQueryGuard(QueryGuard &g) {
+    auto now = chrono::steady_clock::now();
+    if (g.cancelFlag && g.cancelFlag->load()) g.cancelled = true;
+    if (g.timeoutMs > 0 && now > g.deadline) g.timedOut = true;
+
+    if (g.interactive && this_thread::get_id() == g.owner && now - g.lastPolled > chrono::milliseconds(50)) {
+        g.lastPolled = now;
+        if (escapePressed(g)) g.cancelled = true;
+        double secs = chrono::duration<double>(now - g.start).count();
+        if (secs > 0.5) {
+            cout << "\r" << YELLOW << g.label << "... " << fixed << setprecision(1) << secs
+                 << "s  (Ctrl-C or ESC to stop)" << RESET << defaultfloat << setprecision(6) << flush;
+            g.shown = true;
+        }
+    }
+    return g.cancelled || g.timedOut;
+}
+
+int queryProgress(void* arg) {
+    return pollQueryGuard(*static_cast<QueryGuard*>(arg)) ? 1 : 0;
+}
+
+void attachQueryGuard(QueryGuard &g, sqlite3* conn) {
+    if (conn) sqlite3_progress_handler(conn, 10000, queryProgress, &g);
+}
+
+void detachQueryGuard(sqlite3* conn) {
+    if (conn) sqlite3_progress_handler(conn, 0, nullptr, nullptr);
+}
+
+void startQueryGuard(QueryGuard &g, sqlite3* conn) {
+    g.conn = conn;
+    g.owner = this_thread::get_id();
+    g.start = g.lastPolled = chrono::steady_clock::now();
+    g.deadline = g.start + chrono::milliseconds(g.timeoutMs);
+    attachQueryGuard(g, conn);
+    if (!g.interactive) return;
+
+    activeQueryGuard = &g;
+    g.previousSignal = signal(SIGINT, onQuerySignal);
+    // ESC is only seen if the terminal hands over keys without waiting for Enter
+#ifdef _WIN32
+    g.rawTerminal = _isatty(_fileno(stdin));
+#else
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &g.savedTerminal) == 0) {
+        termios raw = g.savedTerminal;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        g.rawTerminal = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+#endif
+}
+
+// rc is the last result of the guarded work (SQLITE_DONE when it completed)
+QueryOutcome finishQueryGuard(QueryGuard &g, int rc) {
+    detachQueryGuard(g.conn);
+    if (g.interactive) {
+        signal(SIGINT, g.previousSignal);
+        activeQueryGuard = nullptr;
+#ifndef _WIN32
+        if (g.rawTerminal) tcsetattr(STDIN_FILENO, TCSANOW, &g.savedTerminal);
+#endif
+        if (g.shown) cout << "\r" << string(g.label.size() + 40, ' ') << "\r" << flush;
+    }
+    if (g.cancelled) return QUERY_CANCELLED;
+    if (g.timedOut) return QUERY_TIMED_OUT;
+    return rc == SQLITE_DONE || rc == SQLITE_OK ? QUERY_DONE : QUERY_FAILED;
+}
+
+string queryOutcomeNote(const QueryGuard &g, QueryOutcome outcome) {
+    switch (outcome) {
+        case QUERY_CANCELLED: return "PARTIAL RESULTS - cancelled";
+        case QUERY_TIMED_OUT: return "PARTIAL RESULTS - stopped after " + to_string(g.timeoutMs / 1000) + " s";
+        case QUERY_FAILED: return "query failed";
+        default: return "";
+    }
+}
+
+// ------------------------
+// READ SNAPSHOTS
+// ------------------------
+// Long reports copy what they show inside one short read transaction and are
+// printed from memory afterwards, so a slow terminal or file never keeps the
+// database pinned. With SQLITE_ENABLE_SNAPSHOT the transaction's snapshot is
+// captured too, so other connections can open exactly the same point in time.
+struct ReadSnapshot {
+    ReadConnection* rc = nullptr;
+    time_t asOf = 0;
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    sqlite3_snapshot* snapshot = nullptr;
+#endif
+};
+
+void endSnapshot(ReadSnapshot &snap) {
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    if (snap.snapshot) sqlite3_snapshot_free(snap.snapshot);
+    snap.snapshot = nullptr;
+#endif
+    if (snap.rc && !sqlite3_get_autocommit(snap.rc->conn))
+        sqlite3_exec(snap.rc->conn, "COMMIT;", nullptr, nullptr, nullptr);
+    snap.rc = nullptr;
+}
+
+// Starts a read transaction on this thread's connection; BEGIN is deferred,
+// so the first read is what fixes the snapshot
+bool beginSnapshot(DbContext &ctx, ReadSnapshot &snap) {
+    snap.rc = readConnection(ctx);
+    if (!snap.rc) return false;
+    if (sqlite3_exec(snap.rc->conn, "BEGIN; SELECT count(*) FROM sqlite_master;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        endSnapshot(snap);
+        return false;
+    }
+    snap.asOf = time(nullptr);
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    if (sqlite3_snapshot_get(snap.rc->conn, "main", &snap.snapshot) != SQLITE_OK)
+        snap.snapshot = nullptr;
+#endif
+    return true;
+}
+
+string snapshotLabel(const ReadSnapshot &snap) {
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&snap.asOf));
+    return string("as of ") + stamp;
+}
+
+// Drops the color codes from text bound for a file
+string stripColors(const string &text) {
+    string plain;
+    plain.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\033' && i + 1 < text.size() && text[i + 1] == '[') {
+            while (i < text.size() && text[i] != 'm') ++i;
+            continue;
+        }
+        plain += text[i];
+    }
+    return plain;
+}
+
+// Renders a report inside one snapshot, lets go of the database, and only
+// then prints it (or writes it to file when one is given). Interrupted
+// reports are still shown, labelled as partial.
+bool writeReport(DbContext &ctx, const function<bool(DbContext &, ostream &)> &render, const string &file = "",
+                 const atomic<bool>* cancelFlag = nullptr) {
+    ReadSnapshot snap;
+    ostringstream out;
+    QueryGuard guard;
+    guard.label = "Building report";
+    guard.timeoutMs = REPORT_TIMEOUT_MS;
+    guard.interactive = !cancelFlag;
+    guard.cancelFlag = cancelFlag;
+
+    QueryOutcome outcome = QUERY_FAILED;
+    bool ok = beginSnapshot(ctx, snap);
+    if (ok) {
+        startQueryGuard(guard, snap.rc->conn);
+        ok = render(ctx, out);
+        outcome = finishQueryGuard(guard, ok ? SQLITE_DONE : SQLITE_ERROR);
+    }
+    endSnapshot(snap);
+    if (!ok) return false;
+
+    out << "(" << snapshotLabel(snap);
+    if (outcome != QUERY_DONE) out << "; " << RED << queryOutcomeNote(guard, outcome) << RESET;
+    out << ")\n";
+    if (file.empty()) {
+        cout << out.str();
+        return outcome == QUERY_DONE;
+    }
+    ofstream f(file, ios::binary);
+    f << stripColors(out.str());
+    return f && outcome == QUERY_DONE;
+}
+
+// ------------------------
+// PARALLEL SCAN
+// ------------------------
+// Splits a table into rowid ranges and aggregates each range on its own thread
+// and read connection, then merges the partial results. While the scanners
+// open their read transactions the writer thread holds the write lock, so no
+// commit can land in between and every range reads the same WAL snapshot.
+// Builds with SQLITE_ENABLE_SNAPSHOT open one pinned snapshot everywhere instead.
+struct ScanBarrier {
+    mutex m;
+    condition_variable cv;
+    int parts = 0;
+    int arrived = 0;
+    bool locked = false;
+    bool failed = false;
+};
+
+const sqlite3_int64 SCAN_MIN_ROWS_PER_PART = 4096;
+
+// sql selects partial aggregates for "rowid BETWEEN ?1 AND ?2"; fold(stmt, partial)
+// is called for each row it returns, merge(total, partial) once per range.
+// Returns false if any range failed or was interrupted through guard; what
+// was scanned is still merged into total.
+template <typename Partial, typename Fold, typename Merge>
+bool parallelScan(DbContext &ctx, const string &table, const string &sql, int threads,
+                  Partial &total, Fold fold, Merge merge, QueryGuard* guard = nullptr) {
+    sqlite3_stmt* bounds = readStatement(ctx, "SELECT min(rowid), max(rowid) FROM " + table + ";");
+    if (!bounds) return false;
+    sqlite3_int64 lo = 0, hi = 0;
+    if (sqlite3_step(bounds) == SQLITE_ROW) {
+        lo = sqlite3_column_int64(bounds, 0);
+        hi = sqlite3_column_int64(bounds, 1);
+    }
+    sqlite3_reset(bounds);
+
+    // Ranges only decide who scans what; the first and last are open-ended so
+    // rows committed after the bounds were read are still counted exactly once
+    sqlite3_int64 span = hi - lo + 1;
+    int parts = (int)max<sqlite3_int64>(1, min<sqlite3_int64>(threads, span / SCAN_MIN_ROWS_PER_PART));
+    sqlite3_int64 step = span / parts;
+
+    ScanBarrier barrier;
+    barrier.parts = parts;
+    vector<Partial> partials(parts);
+    vector<char> ok(parts, 0);
+    atomic<int> finishedParts{0};
+
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    ReadSnapshot pinned;
+    if (!beginSnapshot(ctx, pinned) || !pinned.snapshot) {
+        endSnapshot(pinned);
+        return false;
+    }
+    barrier.locked = true;
+    future<bool> held = async(launch::deferred, [] { return true; });
+#else
+    auto held = submitWrite(ctx.writer, [&barrier](sqlite3*, bool &done) {
+        unique_lock<mutex> lock(barrier.m);
+        barrier.locked = true;
+        barrier.cv.notify_all();
+        barrier.cv.wait(lock, [&] { return barrier.arrived == barrier.parts; });
+        done = true;
+        return true;
+    }, false);
+#endif
+
+    auto scanPart = [&](int i) {
+        sqlite3_int64 first = i == 0 ? numeric_limits<sqlite3_int64>::min() : lo + step * i;
+        sqlite3_int64 last = i == parts - 1 ? numeric_limits<sqlite3_int64>::max() : lo + step * (i + 1) - 1;
+        ReadConnection* rc = readConnection(ctx);
+        {
+            unique_lock<mutex> lock(barrier.m);
+            barrier.cv.wait(lock, [&] { return barrier.locked || barrier.failed; });
+            if (barrier.failed) {
+                lock.unlock();
+                releaseReadConnection(ctx);
+                finishedParts++;
+                return;
+            }
+        }
+
+        bool began = rc && sqlite3_exec(rc->conn, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK
+#ifdef SQLITE_ENABLE_SNAPSHOT
+                     && sqlite3_snapshot_open(rc->conn, "main", pinned.snapshot) == SQLITE_OK
+#endif
+                     && sqlite3_exec(rc->conn, "SELECT count(*) FROM sqlite_master;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        {
+            lock_guard<mutex> lock(barrier.m);
+            barrier.arrived++;
+        }
+        barrier.cv.notify_all();
+
+        sqlite3_stmt* stmt = began ? readStatement(ctx, sql) : nullptr;
+        if (stmt) {
+            if (guard) attachQueryGuard(*guard, rc->conn);
+            sqlite3_bind_int64(stmt, 1, first);
+            sqlite3_bind_int64(stmt, 2, last);
+            int rcStep;
+            while ((rcStep = sqlite3_step(stmt)) == SQLITE_ROW)
+                fold(stmt, partials[i]);
+            ok[i] = rcStep == SQLITE_DONE;
+            sqlite3_reset(stmt);
+            if (guard) detachQueryGuard(rc->conn);
+        }
+        if (rc && !sqlite3_get_autocommit(rc->conn))
+            sqlite3_exec(rc->conn, "COMMIT;", nullptr, nullptr, nullptr);
+        releaseReadConnection(ctx);
+        finishedParts++;
+    };
+
+    vector<thread> scanners;
+    for (int i = 0; i < parts; ++i)
+        scanners.emplace_back(scanPart, i);
+
+    // The write lock could not be taken: let the scanners go without reading
+    if (!held.get()) {
+        lock_guard<mutex> lock(barrier.m);
+        if (!barrier.locked) barrier.failed = true;
+    }
+    barrier.cv.notify_all();
+
+    // Scanners only check the guard; ESC and the progress line are handled here
+    while (guard && finishedParts < parts) {
+        pollQueryGuard(*guard);
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    for (auto &t : scanners) t.join();
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    endSnapshot(pinned);
+#endif
+
+    bool complete = !barrier.failed;
+    for (int i = 0; i < parts; ++i) {
+        complete = complete && ok[i];
+        merge(total, partials[i]);
+    }
+    return complete;
+}
+
+int defaultScanThreads() {
+    return (int)max(1u, min(8u, thread::hardware_concurrency()));
+}
+
+// ------------------------
+// JOB POOL
+// ------------------------
+// Background jobs (exports, backups, VACUUM, reports) run on a small
+// work-stealing pool so the menu never waits on them. Each worker pops from
+// the back of its own deque and steals from the front of the others' when it
+// runs dry. Workers run at lowered OS priority and hold themselves to a CPU
+// share (cpuPercent) by sleeping between chunks of work, so sales stay
+// responsive while a job runs.
+enum JobState { JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED, JOB_CANCELLED };
+
+struct Job {
+    long long id = 0;
+    string name;
+    function<bool(Job &, string &)> work;    // fills in the result text
+    atomic<int> state{JOB_QUEUED};
+    atomic<double> progress{0};             // 0..1, or < 0 when unknown
+    atomic<bool> cancelRequested{false};
+    int cpuPercent = 100;
+    chrono::steady_clock::time_point submitted, sliceStart;
+    mutex lock;                             // guards the state changes below and the result
+    chrono::steady_clock::time_point started, finished;
+    string result;
+    promise<void> finishedSignal;
+    shared_future<void> done;
+};
+
+struct JobQueue {
+    mutex m;
+    deque<shared_ptr<Job>> jobs;
+};
+
+struct JobPool {
+    DbContext* ctx = nullptr;
+    int cpuPercent = 50;
+    vector<unique_ptr<JobQueue>> queues;
+    vector<thread> workers;
+    mutex idleMutex;
+    condition_variable idle;
+    atomic<int> pending{0};
+    atomic<bool> running{false};
+    atomic<size_t> nextQueue{0};
+    atomic<long long> nextId{0};
+    mutex historyMutex;
+    vector<shared_ptr<Job>> history;        // every job submitted, for the Jobs screen
+};
+
+const int JOB_CPU_PERCENT = 50;
+
+thread_local int jobWorkerIndex = -1;
+
+const char* jobStateName(int state) {
+    switch (state) {
+        case JOB_QUEUED: return "queued";
+        case JOB_RUNNING: return "running";
+        case JOB_DONE: return "done";
+        case JOB_FAILED: return "failed";
+        default: return "cancelled";
+    }
+}
+
+// Called by jobs between chunks of work: records progress, sleeps off any CPU
+// time beyond the job's share, and returns false once the job is cancelled
+bool jobContinue(Job &job, double progress) {
+    job.progress = progress;
+    if (job.cpuPercent < 100) {
+        auto busy = chrono::steady_clock::now() - job.sliceStart;
+        if (busy > chrono::milliseconds(20)) {
+            this_thread::sleep_for(busy * (100 - job.cpuPercent) / job.cpuPercent);
+            job.sliceStart = chrono::steady_clock::now();
+        }
+    }
+    return !job.cancelRequested;
+}
+
+string jobResult(Job &job) {
+    lock_guard<mutex> lock(job.lock);
+    return job.result;
+}
+
+// The Jobs screen reads state and times together under job.lock, so a job it
+// sees running or finished always has those times set
+void runJob(Job &job) {
+    if (job.cancelRequested) {
+        lock_guard<mutex> lock(job.lock);
+        job.started = job.finished = chrono::steady_clock::now();
+        job.state = JOB_CANCELLED;
+    } else {
+        {
+            lock_guard<mutex> lock(job.lock);
+            job.started = job.sliceStart = chrono::steady_clock::now();
+            job.state = JOB_RUNNING;
+        }
+        string result;
+        bool ok = job.work(job, result);
+        if (ok) job.progress = 1;
+        lock_guard<mutex> lock(job.lock);
+        job.result = result;
+        job.finished = chrono::steady_clock::now();
+        job.state = job.cancelRequested ? JOB_CANCELLED : ok ? JOB_DONE : JOB_FAILED;
+    }
+    job.work = nullptr;
+    job.finishedSignal.set_value();
+}
+
+shared_ptr<Job> takeJob(JobPool &pool, int self) {
+    size_t n = pool.queues.size();
+    for (size_t k = 0; k < n; ++k) {
+        JobQueue &q = *pool.queues[(self + k) % n];
+        lock_guard<mutex> lock(q.m);
+        if (q.jobs.empty()) continue;
+        shared_ptr<Job> job;
+        if (k == 0) {
+            job = q.jobs.back();
+            q.jobs.pop_back();
+        } else {
+            job = q.jobs.front();
+            q.jobs.pop_front();
+        }
+        pool.pending--;
+        return job;
+    }
+    return nullptr;
+}
+
+void lowerThreadPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#endif
+}
+
+void jobWorker(JobPool* pool, int self) {
+    jobWorkerIndex = self;
+    lowerThreadPriority();
+    while (true) {
+        shared_ptr<Job> job = takeJob(*pool, self);
+        if (job) {
+            runJob(*job);
+            continue;
+        }
+        unique_lock<mutex> lock(pool->idleMutex);
+        pool->idle.wait(lock, [&] { return pool->pending > 0 || !pool->running; });
+        if (!pool->running && pool->pending == 0) break;
+    }
+    releaseReadConnection(*pool->ctx);
+}
+
+void startJobPool(JobPool &pool, DbContext &ctx, int workerCount, int cpuPercent) {
+    pool.ctx = &ctx;
+    pool.cpuPercent = max(1, min(100, cpuPercent));
+    pool.running = true;
+    for (int i = 0; i < workerCount; ++i)
+        pool.queues.push_back(make_unique<JobQueue>());
+    for (int i = 0; i < workerCount; ++i)
+        pool.workers.emplace_back(jobWorker, &pool, i);
+}
+
+// Cancels whatever has not finished and waits for the workers to exit
+void stopJobPool(JobPool &pool) {
+    if (!pool.running) return;
+    {
+        lock_guard<mutex> lock(pool.historyMutex);
+        for (auto &job : pool.history) job->cancelRequested = true;
+    }
+    {
+        lock_guard<mutex> lock(pool.idleMutex);
+        pool.running = false;
+    }
+    pool.idle.notify_all();
+    for (auto &w : pool.workers) w.join();
+    pool.workers.clear();
+}
+
+shared_ptr<Job> submitJob(JobPool &pool, const string &name, function<bool(Job &, string &)> work) {
+    auto job = make_shared<Job>();
+    job->id = ++pool.nextId;
+    job->name = name;
+    job->work = move(work);
+    job->cpuPercent = pool.cpuPercent;
+    job->submitted = chrono::steady_clock::now();
+    job->done = job->finishedSignal.get_future().share();
+    {
+        lock_guard<mutex> lock(pool.historyMutex);
+        pool.history.push_back(job);
+    }
+
+    // Jobs spawned by a job stay on that worker's deque for others to steal
+    size_t n = pool.queues.size();
+    size_t target = jobWorkerIndex >= 0 ? (size_t)jobWorkerIndex : pool.nextQueue++ % n;
+    {
+        lock_guard<mutex> lock(pool.queues[target]->m);
+        pool.queues[target]->jobs.push_back(job);
+    }
+    {
+        lock_guard<mutex> lock(pool.idleMutex);
+        pool.pending++;
+    }
+    pool.idle.notify_one();
+    return job;
+}
+
+bool cancelJob(JobPool &pool, long long id) {
+    lock_guard<mutex> lock(pool.historyMutex);
+    for (auto &job : pool.history) {
+        if (job->id != id) continue;
+        job->cancelRequested = true;
+        return true;
+    }
+    return false;
+}
+
+void printJobs(JobPool &pool) {
+    vector<shared_ptr<Job>> jobs;
+    {
+        lock_guard<mutex> lock(pool.historyMutex);
+        jobs = pool.history;
+    }
+    if (jobs.empty()) {
+        cout << YELLOW << "\nNo background jobs yet.\n" << RESET;
+        return;
+    }
+
+    auto now = chrono::steady_clock::now();
+    cout << CYAN << "\n" << left << setw(5) << "ID" << setw(24) << "Job" << setw(11) << "State"
+         << setw(10) << "Progress" << setw(10) << "Time" << "Result\n" << RESET;
+    for (auto &job : jobs) {
+        int state;
+        chrono::steady_clock::time_point from, to;
+        {
+            lock_guard<mutex> lock(job->lock);
+            state = job->state;
+            from = state == JOB_QUEUED ? job->submitted : job->started;
+            to = state == JOB_QUEUED || state == JOB_RUNNING ? now : job->finished;
+        }
+        double progress = job->progress;
+        ostringstream pct, secs;
+        if (progress < 0) pct << "...";
+        else pct << (int)(progress * 100) << "%";
+        secs << fixed << setprecision(1) << chrono::duration<double>(to - from).count() << "s";
+
+        cout << left << setw(5) << job->id << setw(24) << job->name.substr(0, 23)
+             << (state == JOB_FAILED ? RED : state == JOB_DONE ? GREEN : YELLOW) << setw(11) << jobStateName(state) << RESET
+             << setw(10) << pct.str() << setw(10) << secs.str()
+             << (state >= JOB_DONE ? jobResult(*job) : "") << "\n";
+    }
+}
+
+// Shows a progress line until the job finishes (used by the command line)
+int watchJob(Job &job) {
+    while (job.done.wait_for(chrono::milliseconds(200)) != future_status::ready) {
+        double progress = job.progress;
+        cout << "\r" << job.name << ": ";
+        if (progress < 0) cout << "working...";
+        else cout << (int)(progress * 100) << "%   ";
+        cout << flush;
+    }
+    cout << "\r" << job.name << ": " << jobStateName(job.state) << "  " << jobResult(job) << endl;
+    return job.state == JOB_DONE ? 0 : 1;
+}
+
+// ------------------------
+// BATCH ENTRY
+// ------------------------
+// The "add another?" loops collect rows here instead of writing each one.
+// Only the pending rows are previewed, and the whole batch is committed as
+// one write operation (one transaction, one fsync) when the user is done.
+// Each row runs under its own savepoint, so a row that breaks a constraint
+// (a duplicate name, say) is reported and skipped without losing the rest.
+const size_t BATCH_PREVIEW_ROWS = 10;
+
+struct BatchRow {
+    vector<string> cells;                   // as shown in the preview
+    function<void(sqlite3_stmt*)> bind;
+};
+
+struct EntryBatch {
+    string noun;                            // "product", "resident", ...
+    string insertSql;
+    vector<string> headers;
+    vector<BatchRow> rows;
+};
+
+// The most recent pending rows, numbered as they will be reported on commit
+void printPendingRows(const EntryBatch &batch) {
+    vector<size_t> widths;
+    for (const string &h : batch.headers) widths.push_back(h.size());
+    size_t first = batch.rows.size() > BATCH_PREVIEW_ROWS ? batch.rows.size() - BATCH_PREVIEW_ROWS : 0;
+    for (size_t r = first; r < batch.rows.size(); ++r)
+        for (size_t c = 0; c < widths.size() && c < batch.rows[r].cells.size(); ++c)
+            widths[c] = min<size_t>(24, max(widths[c], batch.rows[r].cells[c].size()));
+
+    cout << YELLOW << "\nPending " << batch.noun << "s (" << batch.rows.size() << ", not saved yet):\n" << RESET;
+    cout << CYAN << "  " << left << setw(5) << "#";
+    for (size_t c = 0; c < widths.size(); ++c) cout << setw(widths[c] + 2) << batch.headers[c];
+    cout << RESET << "\n";
+    if (first > 0) cout << "  ... " << first << " earlier\n";
+    for (size_t r = first; r < batch.rows.size(); ++r) {
+        cout << "  " << left << setw(5) << r + 1;
+        for (size_t c = 0; c < widths.size() && c < batch.rows[r].cells.size(); ++c)
+            cout << setw(widths[c] + 2) << batch.rows[r].cells[c].substr(0, widths[c]);
+        cout << "\n";
+    }
+    cout << right;
+}
+
+// Inserts every pending row in one transaction and returns how many were
+// saved. errors[i] is empty if row i was, otherwise SQLite's reason why not.
+size_t commitBatch(DbContext &ctx, const EntryBatch &batch, vector<string> &errors) {
+    const EntryBatch* b = &batch;
+    WriteQueue* q = &ctx.writer;
+    errors = submitWrite(ctx.writer, [b, q](sqlite3* conn, vector<string> &result) {
+        result.assign(b->rows.size(), "");
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(conn, b->insertSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            result.assign(b->rows.size(), sqlite3_errmsg(conn));
+            return false;
+        }
+        for (size_t i = 0; i < b->rows.size(); ++i) {
+            ChangeMark mark = markChanges(q->capture);
+            sqlite3_exec(conn, "SAVEPOINT batch_row;", nullptr, nullptr, nullptr);
+            b->rows[i].bind(stmt);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                result[i] = sqlite3_errmsg(conn);
+                sqlite3_reset(stmt);
+                sqlite3_exec(conn, "ROLLBACK TO batch_row;", nullptr, nullptr, nullptr);
+                rewindChanges(q->capture, mark);
+            }
+            sqlite3_exec(conn, "RELEASE batch_row;", nullptr, nullptr, nullptr);
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        sqlite3_finalize(stmt);
+        return true;
+    }, vector<string>(batch.rows.size(), "the transaction could not be committed")).get();
+
+    return count(errors.begin(), errors.end(), "");
+}
+
+// Asks before committing, then reports the outcome row by row
+void finishBatch(DbContext &ctx, EntryBatch &batch) {
+    if (batch.rows.empty()) return;
+    char confirm;
+    cout << "\nSave " << batch.rows.size() << " pending " << batch.noun << (batch.rows.size() == 1 ? "" : "s")
+         << "? (Y/N): ";
+    cin >> confirm;
+    if (toupper(confirm) != 'Y') {
+        cout << YELLOW << "\nDiscarded " << batch.rows.size() << " pending " << batch.noun << "s.\n" << RESET;
+        batch.rows.clear();
+        return;
+    }
+
+    vector<string> errors;
+    size_t saved = commitBatch(ctx, batch, errors);
+    cout << GREEN << "\nSaved " << saved << " of " << batch.rows.size() << " " << batch.noun << "s in one transaction.\n" << RESET;
+    for (size_t i = 0; i < errors.size(); ++i)
+        if (!errors[i].empty())
+            cout << RED << "  #" << i + 1 << " " << batch.rows[i].cells[0] << ": " << errors[i] << "\n" << RESET;
+    batch.rows.clear();
+}
+
+// ------------------------
+// NAME INDEX (type-ahead)
+// ------------------------
+// Resident names held in memory as a radix tree, so the name prompts can show
+// the names starting with what has been typed after every key. The tree is
+// loaded once before the menu starts. From then on, temporary triggers on the
+// writer connection report every inserted, renamed and deleted resident, and
+// the change-log hooks apply those once the transaction commits, so rolled
+// back writes never reach the tree.
+//
+// Nodes sit in one vector and refer to each other by index; edge labels are
+// slices of one string. A removed name's nodes are reused, but its label bytes
+// stay behind until they are half of the labels, when the tree is rebuilt.
+const size_t NAME_SUGGESTIONS = 6;
+const size_t NAME_HINT_WIDTH = 76;
+
+struct NameTrie {
+    struct Node {
+        uint32_t label = 0;         // edge label: labels[label, label + labelLength)
+        uint32_t firstChild = 0;    // 0 for none; siblings are sorted by their first byte
+        uint32_t nextSibling = 0;
+        uint16_t labelLength = 0;
+        uint16_t rows = 0;          // rows with the name that ends here (names need not be unique)
+    };
+    vector<Node> nodes = vector<Node>(1);   // nodes[0] is the root
+    string labels;
+    vector<uint32_t> freeNodes;
+    size_t names = 0;
+    size_t deadLabelBytes = 0;
+};
+
+struct NameIndex {
+    mutex lock;                     // the writer thread applies changes, the menu reads
+    NameTrie trie;
+    bool loaded = false;
+};
+
+NameIndex residentNames;
+
+uint32_t allocTrieNode(NameTrie &t) {
+    if (t.freeNodes.empty()) {
+        t.nodes.emplace_back();
+        return (uint32_t)t.nodes.size() - 1;
+    }
+    uint32_t id = t.freeNodes.back();
+    t.freeNodes.pop_back();
+    t.nodes[id] = NameTrie::Node();
+    return id;
+}
+
+// The child of node whose label starts with c, or 0; prev is the sibling
+// before it (or before where it would go), 0 if it would be the first
+uint32_t findTrieChild(const NameTrie &t, uint32_t node, unsigned char c, uint32_t &prev) {
+    prev = 0;
+    uint32_t child = t.nodes[node].firstChild;
+    while (child && (unsigned char)t.labels[t.nodes[child].label] < c) {
+        prev = child;
+        child = t.nodes[child].nextSibling;
+    }
+    return child && (unsigned char)t.labels[t.nodes[child].label] == c ? child : 0;
+}
+
+// Adds the name of `rows` rows; false if it was already there (or too long for one label)
+bool trieInsert(NameTrie &t, const string &name, unsigned rows = 1) {
+    if (name.empty() || name.size() > UINT16_MAX) return false;
+    uint32_t node = 0;
+    size_t pos = 0;
+    while (pos < name.size()) {
+        uint32_t prev;
+        uint32_t child = findTrieChild(t, node, name[pos], prev);
+        if (!child) {
+            uint32_t leaf = allocTrieNode(t);
+            NameTrie::Node &n = t.nodes[leaf];
+            n.label = (uint32_t)t.labels.size();
+            n.labelLength = (uint16_t)(name.size() - pos);
+            n.rows = (uint16_t)min<unsigned>(rows, UINT16_MAX);
+            n.nextSibling = prev ? t.nodes[prev].nextSibling : t.nodes[node].firstChild;
+            (prev ? t.nodes[prev].nextSibling : t.nodes[node].firstChild) = leaf;
+            t.labels.append(name, pos, string::npos);
+            ++t.names;
+            return true;
+        }
+
+        size_t length = t.nodes[child].labelLength, common = 1;
+        while (common < length && pos + common < name.size() &&
+               t.labels[t.nodes[child].label + common] == name[pos + common])
+            ++common;
+        if (common < length) {
+            // The name leaves this edge part way: split it at that point
+            uint32_t mid = allocTrieNode(t);
+            NameTrie::Node &m = t.nodes[mid], &old = t.nodes[child];
+            m.label = old.label;
+            m.labelLength = (uint16_t)common;
+            m.firstChild = child;
+            m.nextSibling = old.nextSibling;
+            old.label += (uint32_t)common;
+            old.labelLength -= (uint16_t)common;
+            old.nextSibling = 0;
+            (prev ? t.nodes[prev].nextSibling : t.nodes[node].firstChild) = mid;
+            child = mid;
+        }
+        node = child;
+        pos += common;
+    }
+    NameTrie::Node &end = t.nodes[node];
+    bool added = end.rows == 0;
+    end.rows = (uint16_t)min<unsigned>(end.rows + rows, UINT16_MAX);
+    if (added) ++t.names;
+    return added;
+}
+
+// Appends the names at and below node, in byte order, until out holds limit
+void trieCollect(const NameTrie &t, uint32_t node, string &path, vector<string> &out, size_t limit) {
+    if (out.size() >= limit) return;
+    if (t.nodes[node].rows) out.push_back(path);
+    for (uint32_t child = t.nodes[node].firstChild; child && out.size() < limit; child = t.nodes[child].nextSibling) {
+        const NameTrie::Node &n = t.nodes[child];
+        path.append(t.labels, n.label, n.labelLength);
+        trieCollect(t, child, path, out, limit);
+        path.resize(path.size() - n.labelLength);
+    }
+}
+
+// Rebuilds the tree from its own names, dropping the dead label bytes
+void compactTrie(NameTrie &t) {
+    NameTrie fresh;
+    string path;
+    function<void(uint32_t)> copy = [&](uint32_t node) {
+        if (t.nodes[node].rows) trieInsert(fresh, path, t.nodes[node].rows);
+        for (uint32_t child = t.nodes[node].firstChild; child; child = t.nodes[child].nextSibling) {
+            path.append(t.labels, t.nodes[child].label, t.nodes[child].labelLength);
+            copy(child);
+            path.resize(path.size() - t.nodes[child].labelLength);
+        }
+    };
+    copy(0);
+    t = move(fresh);
+}
+
+// Drops one row's name; the name stays while other rows still have it
+bool trieRemove(NameTrie &t, const string &name) {
+    struct Step {
+        uint32_t parent, prev, node;
+    };
+    vector<Step> path;
+    uint32_t node = 0;
+    size_t pos = 0;
+    while (pos < name.size()) {
+        uint32_t prev;
+        uint32_t child = findTrieChild(t, node, name[pos], prev);
+        if (!child) return false;
+        const NameTrie::Node &n = t.nodes[child];
+        if (n.labelLength > name.size() - pos || t.labels.compare(n.label, n.labelLength, name, pos, n.labelLength))
+            return false;
+        path.push_back({node, prev, child});
+        node = child;
+        pos += n.labelLength;
+    }
+    if (path.empty() || !t.nodes[node].rows) return false;
+    if (--t.nodes[node].rows) return true;
+    --t.names;
+
+    // Nodes that no longer lead to any name go back to the free list
+    while (!path.empty()) {
+        Step step = path.back();
+        NameTrie::Node &n = t.nodes[step.node];
+        if (n.rows || n.firstChild) break;
+        (step.prev ? t.nodes[step.prev].nextSibling : t.nodes[step.parent].firstChild) = n.nextSibling;
+        t.deadLabelBytes += n.labelLength;
+        t.freeNodes.push_back(step.node);
+        path.pop_back();
+    }
+    if (t.deadLabelBytes > t.labels.size() / 2) compactTrie(t);
+    return true;
+}
+
+// Where prefix ends, ignoring ASCII case: each node whose edge it ends on,
+// with the name spelled as stored up to the end of that edge
+void trieFind(const NameTrie &t, uint32_t node, const string &prefix, size_t pos, string &path,
+              vector<pair<uint32_t, string>> &ends) {
+    for (uint32_t child = t.nodes[node].firstChild; child; child = t.nodes[child].nextSibling) {
+        const NameTrie::Node &n = t.nodes[child];
+        size_t compare = min<size_t>(n.labelLength, prefix.size() - pos);
+        size_t i = 0;
+        while (i < compare && tolower((unsigned char)t.labels[n.label + i]) == tolower((unsigned char)prefix[pos + i]))
+            ++i;
+        if (i < compare) continue;
+        path.append(t.labels, n.label, n.labelLength);
+        if (pos + n.labelLength >= prefix.size()) ends.push_back({child, path});
+        else trieFind(t, child, prefix, pos + n.labelLength, path, ends);
+        path.resize(path.size() - n.labelLength);
+    }
+}
+
+// Up to limit names starting with prefix (any case), in byte order
+vector<string> suggestNames(NameIndex &index, const string &prefix, size_t limit) {
+    vector<string> names;
+    if (prefix.empty()) return names;
+    lock_guard<mutex> lock(index.lock);
+    vector<pair<uint32_t, string>> ends;
+    string path;
+    trieFind(index.trie, 0, prefix, 0, path, ends);
+    for (auto &end : ends) trieCollect(index.trie, end.first, end.second, names, limit);
+    return names;
+}
+
+// What Tab fills in: prefix, spelled as stored, extended for as long as
+// every name starting with it agrees
+string completeName(NameIndex &index, const string &prefix) {
+    if (prefix.empty()) return prefix;
+    lock_guard<mutex> lock(index.lock);
+    const NameTrie &t = index.trie;
+    vector<pair<uint32_t, string>> ends;
+    string path;
+    trieFind(t, 0, prefix, 0, path, ends);
+    if (ends.size() != 1) return prefix;
+    uint32_t node = ends[0].first;
+    path = ends[0].second;
+    while (!t.nodes[node].rows && t.nodes[node].firstChild &&
+           !t.nodes[t.nodes[node].firstChild].nextSibling) {
+        node = t.nodes[node].firstChild;
+        path.append(t.labels, t.nodes[node].label, t.nodes[node].labelLength);
+    }
+    return path;
+}
+
+// Gives back the spare capacity left from loading
+void shrinkTrie(NameTrie &t) {
+    t.nodes.shrink_to_fit();
+    t.labels.shrink_to_fit();
+}
+
+size_t trieBytes(const NameTrie &t) {
+    return sizeof(t) + t.nodes.capacity() * sizeof(NameTrie::Node) + t.labels.capacity() +
+           t.freeNodes.capacity() * sizeof(uint32_t);
+}
+
+void printNameIndex(NameIndex &index) {
+    lock_guard<mutex> lock(index.lock);
+    const NameTrie &t = index.trie;
+    cout << "name index      : " << t.names << " names, " << fixed << setprecision(1)
+         << trieBytes(t) / 1048576.0 << " MiB (" << t.nodes.size() - t.freeNodes.size() << " nodes of "
+         << sizeof(NameTrie::Node) << " bytes, " << (t.labels.size() - t.deadLabelBytes) / 1024 << " KiB of labels)\n"
+         << defaultfloat << setprecision(6);
+}
+
+void applyNameChanges(NameIndex &index, vector<NameChange> &changes) {
+    lock_guard<mutex> lock(index.lock);
+    for (auto &change : changes) {
+        if (change.hasOld) trieRemove(index.trie, change.oldName);
+        if (change.hasNew) trieInsert(index.trie, change.newName);
+    }
+}
+
+// name_changed(old, new), called by the triggers below; NULL for no name
+void onNameChanged(sqlite3_context* fn, int, sqlite3_value** args) {
+    NameChange change;
+    const unsigned char* oldName = sqlite3_value_text(args[0]);
+    const unsigned char* newName = sqlite3_value_text(args[1]);
+    if ((change.hasOld = oldName != nullptr)) change.oldName = reinterpret_cast<const char*>(oldName);
+    if ((change.hasNew = newName != nullptr)) change.newName = reinterpret_cast<const char*>(newName);
+    static_cast<ChangeCapture*>(sqlite3_user_data(fn))->pendingNames.push_back(move(change));
+    sqlite3_result_null(fn);
+}
+
+const char* NAME_INDEX_TRIGGERS = R"(
+    CREATE TEMP TRIGGER IF NOT EXISTS residents_names_insert AFTER INSERT ON main.residents BEGIN
+        SELECT name_changed(NULL, new.name);
+    END;
+    CREATE TEMP TRIGGER IF NOT EXISTS residents_names_update AFTER UPDATE OF name ON main.residents
+    WHEN old.name IS NOT new.name BEGIN
+        SELECT name_changed(old.name, new.name);
+    END;
+    CREATE TEMP TRIGGER IF NOT EXISTS residents_names_delete AFTER DELETE ON main.residents BEGIN
+        SELECT name_changed(old.name, NULL);
+    END;
+)";
+
+// Hooks the writer and loads the names in one write operation, so no commit
+// can fall between the two and be counted twice
+bool startNameIndex(DbContext &ctx, NameIndex &index) {
+    ChangeCapture* capture = ctx.writer.capture;
+    NameIndex* target = &index;
+    auto hooked = submitWrite(ctx.writer, [capture, target](sqlite3* conn, bool &ok) {
+        capture->applyNames = [target](vector<NameChange> &changes) { applyNameChanges(*target, changes); };
+        ok = sqlite3_create_function(conn, "name_changed", 2, SQLITE_UTF8, capture, onNameChanged,
+                                     nullptr, nullptr) == SQLITE_OK &&
+             sqlite3_exec(conn, NAME_INDEX_TRIGGERS, nullptr, nullptr, nullptr) == SQLITE_OK;
+        sqlite3_stmt* stmt = nullptr;
+        if (!ok || sqlite3_prepare_v2(conn, "SELECT name FROM residents ORDER BY name;", -1, &stmt,
+                                      nullptr) != SQLITE_OK)
+            return ok = false;
+
+        // In name order off the UNIQUE index: each insert lands next to the
+        // last. Writes earlier in this transaction ran before the triggers, so
+        // they are read here once.
+        lock_guard<mutex> lock(target->lock);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            if (const unsigned char* name = sqlite3_column_text(stmt, 0))
+                trieInsert(target->trie, reinterpret_cast<const char*>(name));
+        sqlite3_finalize(stmt);
+        shrinkTrie(target->trie);
+        target->loaded = true;
+        return ok;
+    }, false);
+    return hooked.get();
+}
+
+int readKey() {
+#ifdef _WIN32
+    return _getch();
+#else
+    return cin.get();
+#endif
+}
+
+// Reads one line like getline. On a terminal it lists the names starting
+// with what has been typed below the prompt after every key, and Tab fills
+// in as much as those names agree on. Piped input is read as a plain line.
+string readName(const string &prompt, NameIndex &index) {
+    cout << prompt << flush;
+    string line;
+#ifdef _WIN32
+    bool terminal = index.loaded && _isatty(_fileno(stdin));
+#else
+    termios saved;
+    bool terminal = index.loaded && isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved) == 0;
+    if (terminal) {
+        termios raw = saved;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        terminal = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+#endif
+    if (!terminal) {
+        getline(cin, line);
+        return line;
+    }
+
+    // The hints go on the line below; the cursor comes back to the end of the input
+    auto redraw = [&] {
+        string hints;
+        for (auto &name : suggestNames(index, line, NAME_SUGGESTIONS))
+            hints += (hints.empty() ? "" : "  |  ") + name;
+        if (hints.size() > NAME_HINT_WIDTH) {
+            size_t cut = NAME_HINT_WIDTH - 3;
+            while (cut > 0 && ((unsigned char)hints[cut] & 0xC0) == 0x80) --cut;
+            hints = hints.substr(0, cut) + "...";
+        }
+        cout << "\r\033[K" << prompt << line << "\n\033[K" << CYAN << hints << RESET
+             << "\033[A\r" << prompt << line << flush;
+    };
+    for (int key = readKey(); key != EOF && key != '\n' && key != '\r'; key = readKey()) {
+        if (key == 127 || key == 8) {
+            while (!line.empty() && ((unsigned char)line.back() & 0xC0) == 0x80) line.pop_back();
+            if (!line.empty()) line.pop_back();
+        } else if (key == '\t') {
+            line = completeName(index, line);
+#ifdef _WIN32
+        } else if (key == 0 || key == 224) {
+            readKey();      // arrow and function keys: a prefix and one code
+#else
+        } else if (key == 27) {
+            // Arrow and function keys: ESC [ (or O), parameters, one final byte
+            int next = readKey();
+            if (next == '[' || next == 'O')
+                for (next = readKey(); next != EOF && !(next >= 0x40 && next <= 0x7E); next = readKey()) {}
+#endif
+        } else if (key >= 32) {
+            line += (char)key;
+        }
+        redraw();
+    }
+    cout << "\n\033[K" << flush;
+#ifndef _WIN32
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+#endif
+    return line;
+}
+
+// ------------------------
+// FUZZY NAME SEARCH
+// ------------------------
+// Resident names are matched on trigrams, so "Dela Cruz", "De la Cruz" and
+// "Delacruz" find each other and a misspelling still finds the name. Names
+// are compared as keys: lower case, without spaces and . , - '. The trigrams
+// of every key are held in residents_trigrams, an FTS5 trigram index that
+// stores no content, kept up to date by triggers on residents.
+//
+// A name matches when it holds FUZZY_MIN_SHARED of the keyword's trigrams.
+// The search reads each trigram's posting list up to FUZZY_RARE_POSTINGS ids:
+// every name on a list that short (a rare trigram) is a candidate. Any other
+// match must hold enough of the common trigrams alone, so FTS5 is asked for
+// names holding all of those, then all but one, ... (ORs of ANDed groups,
+// which FTS5 answers by skipping through the posting lists) until enough are
+// found. Leaving the rare trigrams out of those queries keeps FTS5 from
+// walking their lists once per group. Reading a candidate's name costs a
+// page read, so at most FUZZY_VERIFY are checked: the names those queries
+// found, then the ones on the most rare lists. Matches are ranked by how much
+// of the keyword they hold, then by trigram similarity of the whole name.
+const double FUZZY_MIN_SHARED = 0.6;
+const size_t FUZZY_CANDIDATES = 200;
+const size_t FUZZY_RARE_POSTINGS = 4000;
+const size_t FUZZY_VERIFY = 600;
+const size_t FUZZY_RESULTS = 20;
+const size_t FUZZY_MAX_GROUPS = 256;
+
+string nameKey(const string &name) {
+    string key;
+    for (char c : name) {
+        if (c == ' ' || c == '.' || c == ',' || c == '-' || c == '\'') continue;
+        key += (char)tolower((unsigned char)c);
+    }
+    return key;
+}
+
+// The same key as an SQL expression, for the triggers
+string nameKeySql(const string &column) {
+    return "lower(replace(replace(replace(replace(replace(" + column +
+           ", ' ', ''), '.', ''), ',', ''), '-', ''), '''', ''))";
+}
+
+// Distinct trigrams of a key, in characters rather than bytes as FTS5 counts them
+vector<string> nameTrigrams(const string &key) {
+    vector<size_t> starts;
+    for (size_t i = 0; i < key.size(); ++i)
+        if (((unsigned char)key[i] & 0xC0) != 0x80) starts.push_back(i);
+    starts.push_back(key.size());
+
+    vector<string> grams;
+    for (size_t i = 0; i + 3 < starts.size(); ++i)
+        grams.push_back(key.substr(starts[i], starts[i + 3] - starts[i]));
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+string residentTrigramSchema() {
+    return "CREATE VIRTUAL TABLE IF NOT EXISTS residents_trigrams USING fts5("
+           "name_key, content='', detail='none', tokenize='trigram');"
+           "CREATE TRIGGER IF NOT EXISTS residents_trigrams_insert AFTER INSERT ON residents BEGIN "
+           "INSERT INTO residents_trigrams(rowid, name_key) VALUES (new.id, " + nameKeySql("new.name") + "); END;"
+           "CREATE TRIGGER IF NOT EXISTS residents_trigrams_delete AFTER DELETE ON residents BEGIN "
+           "INSERT INTO residents_trigrams(residents_trigrams, rowid, name_key) "
+           "VALUES ('delete', old.id, " + nameKeySql("old.name") + "); END;"
+           "CREATE TRIGGER IF NOT EXISTS residents_trigrams_update AFTER UPDATE OF name ON residents BEGIN "
+           "INSERT INTO residents_trigrams(residents_trigrams, rowid, name_key) "
+           "VALUES ('delete', old.id, " + nameKeySql("old.name") + "); "
+           "INSERT INTO residents_trigrams(rowid, name_key) VALUES (new.id, " + nameKeySql("new.name") + "); END;";
+}
+
+// Indexes every name, then merges the index into one segment: each trigram is
+// then a single posting list, which is what makes the ANDs cheap
+string residentTrigramFill() {
+    return "INSERT INTO residents_trigrams(rowid, name_key) SELECT id, " + nameKeySql("name") + " FROM residents;"
+           "INSERT INTO residents_trigrams(residents_trigrams) VALUES ('optimize');";
+}
+
+// An FTS5 query matching names that hold at least `shared` of the trigrams:
+// every choice of that many, ANDed, ORed together. Empty if that is more than
+// FUZZY_MAX_GROUPS groups.
+string trigramGroupsQuery(const vector<string> &grams, size_t shared) {
+    size_t n = grams.size(), groups = 1;
+    for (size_t i = 0; i < min(shared, n - shared); ++i) {
+        groups = groups * (n - i) / (i + 1);
+        if (groups > FUZZY_MAX_GROUPS) return "";
+    }
+
+    vector<size_t> pick(shared);
+    for (size_t i = 0; i < shared; ++i) pick[i] = i;
+    string query;
+    while (true) {
+        query += query.empty() ? "(" : " OR (";
+        for (size_t i = 0; i < shared; ++i) {
+            query += i ? " AND \"" : "\"";
+            for (char c : grams[pick[i]]) query += c == '"' ? string("\"\"") : string(1, c);
+            query += "\"";
+        }
+        query += ")";
+
+        // Next combination in lexicographic order
+        size_t i = shared;
+        while (i > 0 && pick[i - 1] == n - shared + i - 1) --i;
+        if (i == 0) break;
+        ++pick[i - 1];
+        for (size_t j = i; j < shared; ++j) pick[j] = pick[j - 1] + 1;
+    }
+    return query;
+}
+
+struct ResidentMatch {
+    string name;
+    string address;
+    string contact;
+    size_t shared = 0;          // keyword trigrams found in the name
+    double similarity = 0;      // trigram similarity (Jaccard) of the two keys
+    bool soundsAlike = false;   // same phonetic codes as the keyword (see nameSound)
+};
+
+// statement(sql) hands out a prepared statement for sql, cached by the caller.
+// Returns false when the keyword is too short for trigrams or the index is
+// missing; the caller then falls back to LIKE.
+bool fuzzyResidentSearch(const function<sqlite3_stmt*(const string &)> &statement, const string &keyword,
+                         vector<ResidentMatch> &matches) {
+    matches.clear();
+    vector<string> grams = nameTrigrams(nameKey(keyword));
+    sqlite3_stmt* match = grams.empty() ? nullptr
+        : statement("SELECT rowid FROM residents_trigrams WHERE residents_trigrams MATCH ?1 LIMIT ?2;");
+    sqlite3_stmt* names = match ? statement("SELECT name FROM residents WHERE id = ?1;") : nullptr;
+    sqlite3_stmt* details = names ? statement("SELECT address, contact FROM residents WHERE id = ?1;") : nullptr;
+    if (!details) return false;
+
+    auto collect = [match](const string &query, size_t limit, vector<sqlite3_int64> &ids) {
+        if (query.empty()) return;
+        sqlite3_bind_text(match, 1, query.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(match, 2, (sqlite3_int64)limit);
+        while (sqlite3_step(match) == SQLITE_ROW) ids.push_back(sqlite3_column_int64(match, 0));
+        sqlite3_reset(match);
+    };
+    auto distinct = [](vector<sqlite3_int64> &ids) {
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    };
+
+    // Every name on a rare trigram's list is a candidate
+    size_t n = grams.size();
+    size_t minShared = max<size_t>(1, (size_t)ceil(FUZZY_MIN_SHARED * n));
+    vector<sqlite3_int64> candidates;
+    vector<string> common;
+    for (auto &gram : grams) {
+        vector<sqlite3_int64> ids;
+        collect(trigramGroupsQuery({gram}, 1), FUZZY_RARE_POSTINGS + 1, ids);
+        if (ids.size() <= FUZZY_RARE_POSTINGS) candidates.insert(candidates.end(), ids.begin(), ids.end());
+        else common.push_back(gram);
+    }
+
+    // Any other match holds enough of the common ones. Rows come back in
+    // rowid order, so a LIMIT of FUZZY_CANDIDATES always leaves room for
+    // names the previous step did not find.
+    vector<sqlite3_int64> found;
+    for (size_t shared = common.size(); shared >= minShared && found.size() < FUZZY_RESULTS; --shared) {
+        string query = trigramGroupsQuery(common, shared);
+        if (query.empty()) break;
+        collect(query, FUZZY_CANDIDATES, found);
+        distinct(found);
+    }
+    sort(candidates.begin(), candidates.end());
+    vector<pair<size_t, sqlite3_int64>> byHits;     // (rare lists holding the name, id)
+    for (size_t i = 0, j; i < candidates.size(); i = j) {
+        for (j = i; j < candidates.size() && candidates[j] == candidates[i]; ++j) {}
+        if (!binary_search(found.begin(), found.end(), candidates[i])) byHits.push_back({j - i, candidates[i]});
+    }
+    size_t extra = min(byHits.size(), FUZZY_VERIFY - min(found.size(), FUZZY_VERIFY));
+    partial_sort(byHits.begin(), byHits.begin() + extra, byHits.end(),
+                 [](const pair<size_t, sqlite3_int64> &a, const pair<size_t, sqlite3_int64> &b) {
+                     return a.first != b.first ? a.first > b.first : a.second < b.second;
+                 });
+    candidates.assign(found.begin(), found.begin() + min(found.size(), FUZZY_VERIFY));
+    for (size_t i = 0; i < extra; ++i) candidates.push_back(byHits[i].second);
+    sort(candidates.begin(), candidates.end());
+
+    // Scored on the name alone; only the best are read in full. A key's
+    // trigram count is taken as its length - 2 (repeats within one name are rare).
+    struct Scored {
+        sqlite3_int64 id;
+        ResidentMatch match;
+    };
+    vector<Scored> scored;
+    for (sqlite3_int64 id : candidates) {
+        sqlite3_bind_int64(names, 1, id);
+        if (sqlite3_step(names) == SQLITE_ROW && sqlite3_column_text(names, 0)) {
+            Scored s{id, {}};
+            s.match.name = reinterpret_cast<const char*>(sqlite3_column_text(names, 0));
+            string key = nameKey(s.match.name);
+            for (auto &gram : grams) s.match.shared += key.find(gram) != string::npos;
+            size_t chars = 0;
+            for (char c : key) chars += ((unsigned char)c & 0xC0) != 0x80;
+            size_t keyGrams = max(chars, (size_t)2) - 2;
+            s.match.similarity = (double)s.match.shared / (n + max(keyGrams, s.match.shared) - s.match.shared);
+            if (s.match.shared >= minShared) scored.push_back(move(s));
+        }
+        sqlite3_reset(names);
+    }
+
+    size_t keep = min(scored.size(), FUZZY_RESULTS);
+    partial_sort(scored.begin(), scored.begin() + keep, scored.end(), [](const Scored &a, const Scored &b) {
+        if (a.match.shared != b.match.shared) return a.match.shared > b.match.shared;
+        if (a.match.similarity != b.match.similarity) return a.match.similarity > b.match.similarity;
+        return a.match.name < b.match.name;
+    });
+    for (size_t i = 0; i < keep; ++i) {
+        ResidentMatch &m = scored[i].match;
+        sqlite3_bind_int64(details, 1, scored[i].id);
+        if (sqlite3_step(details) == SQLITE_ROW) {
+            const unsigned char* address = sqlite3_column_text(details, 0);
+            const unsigned char* contact = sqlite3_column_text(details, 1);
+            m.address = address ? reinterpret_cast<const char*>(address) : "";
+            m.contact = contact ? reinterpret_cast<const char*>(contact) : "";
+        }
+        sqlite3_reset(details);
+        matches.push_back(m);
+    }
+    return true;
+}
+
+// ------------------------
+// PHONETIC NAME KEYS
+// ------------------------
+// Names are often written down the way they were heard, so every resident
+// also has name_sound: one code per word of the name, spelled the way the
+// word sounds in Filipino and Spanish. Within a word:
+//   ñ = ny, accents dropped          v = b, f = ph = p
+//   c, k, q(u) = K; c before e/i = S  s = z = S, ch = ts
+//   j = h, g before e/i = h, gu before e/i = g, ng = N
+//   vowels, w and y only count at the start of a word (as A)
+// Particles (de, dela, del, san, ...) join the word after them, so "De la
+// Cruz", "Dela Cruz" and "Delacruz" are all DLKRS. name_sound is set by the
+// program on every insert and update, indexed for whole-name lookups, and
+// residents_sounds (FTS5 over the codes) finds names by any of their words.
+const vector<string> NAME_PARTICLES = {"de", "del", "dela", "delas", "delos", "la", "las", "los",
+                                       "san", "santa", "santo", "sta", "sto"};
+
+// Lower-case ASCII letters of one word, with ñ as ny and accents dropped
+string foldNameWord(const string &word) {
+    string folded;
+    for (size_t i = 0; i < word.size(); ++i) {
+        unsigned char c = word[i];
+        if (isalpha(c)) folded += (char)tolower(c);
+        else if (c == 0xC3 && i + 1 < word.size()) {
+            unsigned char n = (unsigned char)word[++i] | 0x20;     // Latin-1 capitals differ from small letters by 0x20
+            if (n == 0xB1) folded += "ny";
+            else if (n == 0xA1 || n == 0xA0) folded += 'a';
+            else if (n == 0xA9 || n == 0xA8) folded += 'e';
+            else if (n == 0xAD || n == 0xAC) folded += 'i';
+            else if (n == 0xB3 || n == 0xB2) folded += 'o';
+            else if (n == 0xBA || n == 0xB9 || n == 0xBC) folded += 'u';
+        }
+    }
+    return folded;
+}
+
+string wordSound(const string &word) {
+    string code;
+    char last = 0;      // code of the letter just before; a vowel resets it
+    auto emit = [&code, &last](char c) {
+        if (c != last) code += c;
+        last = c;
+    };
+    auto at = [&word](size_t i) { return i < word.size() ? word[i] : '\0'; };
+    for (size_t i = 0; i < word.size(); ++i) {
+        char c = word[i], next = at(i + 1);
+        bool soft = next == 'e' || next == 'i' || next == 'y';
+        switch (c) {
+            case 'a': case 'e': case 'i': case 'o': case 'u': case 'w': case 'y':
+                if (i == 0) code += 'A';
+                last = 0;
+                break;
+            case 'b': case 'v': emit('B'); break;
+            case 'f': emit('P'); break;
+            case 'p': emit('P'); if (next == 'h') ++i; break;
+            case 'c':
+                if (next == 'h') { emit('C'); ++i; }
+                else emit(soft ? 'S' : 'K');
+                break;
+            case 'k': emit('K'); break;
+            case 'q': emit('K'); if (next == 'u') ++i; break;
+            case 'g':
+                if (next == 'u' && (at(i + 2) == 'e' || at(i + 2) == 'i')) { emit('G'); ++i; }
+                else emit(soft ? 'H' : 'G');
+                break;
+            case 'h': case 'j': emit('H'); break;
+            case 's': case 'z': emit('S'); if (c == 's' && next == 'h') ++i; break;
+            case 't':
+                if (next == 's') { emit('C'); ++i; }
+                else { emit('T'); if (next == 'h') ++i; }
+                break;
+            case 'd': emit('D'); break;
+            case 'l': emit('L'); break;
+            case 'r': emit('R'); break;
+            case 'm': emit('M'); break;
+            case 'n': emit('N'); if (next == 'g') ++i; break;
+            case 'x': emit('K'); emit('S'); break;
+        }
+    }
+    return code;
+}
+
+// The codes of every word of a name, particles joined to the word after them
+string nameSound(const string &name) {
+    vector<string> words;
+    string word;
+    for (size_t i = 0; i <= name.size(); ++i) {
+        char c = i < name.size() ? name[i] : ' ';
+        if (c == ' ' || c == '-' || c == '.' || c == ',') {
+            if (!word.empty()) words.push_back(foldNameWord(word));
+            word.clear();
+        } else {
+            word += c;
+        }
+    }
+    string sound, pending;
+    for (size_t i = 0; i < words.size(); ++i) {
+        pending += words[i];
+        bool particle = find(NAME_PARTICLES.begin(), NAME_PARTICLES.end(), words[i]) != NAME_PARTICLES.end();
+        if (particle && i + 1 < words.size()) continue;
+        string code = wordSound(pending);
+        if (!code.empty()) sound += (sound.empty() ? "" : " ") + code;
+        pending.clear();
+    }
+    return sound;
+}
+
+const char* RESIDENT_SOUND_SCHEMA = R"(
+    CREATE VIRTUAL TABLE IF NOT EXISTS residents_sounds USING fts5(
+        name_sound, content='residents', content_rowid='id', detail='none', columnsize=0);
+    CREATE TRIGGER IF NOT EXISTS residents_sounds_insert AFTER INSERT ON residents BEGIN
+        INSERT INTO residents_sounds(rowid, name_sound) VALUES (new.id, new.name_sound);
+    END;
+    CREATE TRIGGER IF NOT EXISTS residents_sounds_delete AFTER DELETE ON residents BEGIN
+        INSERT INTO residents_sounds(residents_sounds, rowid, name_sound) VALUES ('delete', old.id, old.name_sound);
+    END;
+    CREATE TRIGGER IF NOT EXISTS residents_sounds_update AFTER UPDATE OF name_sound ON residents BEGIN
+        INSERT INTO residents_sounds(residents_sounds, rowid, name_sound) VALUES ('delete', old.id, old.name_sound);
+        INSERT INTO residents_sounds(rowid, name_sound) VALUES (new.id, new.name_sound);
+    END;
+)";
+
+// Databases from before name_sound get the column, and any resident without
+// a code (added by an older program) gets one; the index makes that check cheap
+bool migrateResidentSounds(DbContext &ctx) {
+    auto migrated = submitWrite(ctx.writer, [](sqlite3* conn, bool &ok) {
+        sqlite3_stmt* columns;
+        if (sqlite3_prepare_v2(conn, "SELECT 1 FROM pragma_table_info('residents') WHERE name = 'name_sound';",
+                               -1, &columns, nullptr) != SQLITE_OK)
+            return false;
+        bool present = sqlite3_step(columns) == SQLITE_ROW;
+        sqlite3_finalize(columns);
+
+        sqlite3_create_function(conn, "name_sound", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+            [](sqlite3_context* fn, int, sqlite3_value** args) {
+                const char* name = reinterpret_cast<const char*>(sqlite3_value_text(args[0]));
+                string sound = nameSound(name ? name : "");
+                sqlite3_result_text(fn, sound.c_str(), -1, SQLITE_TRANSIENT);
+            }, nullptr, nullptr);
+        ok = (present || (dropChangeTriggers(conn) &&
+                          sqlite3_exec(conn, "ALTER TABLE residents ADD COLUMN name_sound TEXT;",
+                                       nullptr, nullptr, nullptr) == SQLITE_OK &&
+                          createChangeTriggers(conn))) &&
+             sqlite3_exec(conn, "CREATE INDEX IF NOT EXISTS idx_residents_name_sound ON residents(name_sound);"
+                                "UPDATE residents SET name_sound = name_sound(name) WHERE name_sound IS NULL;",
+                          nullptr, nullptr, nullptr) == SQLITE_OK;
+        return ok;
+    }, false);
+    return migrated.get();
+}
+
+// Adds the residents whose name sounds like the keyword to matches (or marks
+// the ones already there): first whole names, then names with every word of
+// the keyword among theirs. False when the index is missing.
+bool phoneticResidentSearch(const function<sqlite3_stmt*(const string &)> &statement, const string &keyword,
+                            vector<ResidentMatch> &matches) {
+    string sound = nameSound(keyword);
+    if (sound.empty()) return true;
+    sqlite3_stmt* whole = statement("SELECT name, address, contact FROM residents WHERE name_sound = ?1 LIMIT ?2;");
+    sqlite3_stmt* words = statement(
+        "SELECT r.name, r.address, r.contact FROM residents_sounds s JOIN residents r ON r.id = s.rowid "
+        "WHERE residents_sounds MATCH ?1 LIMIT ?2;");
+    if (!whole || !words) return false;
+
+    // Codes are capital letters only, so quoting each one is always valid FTS5
+    string query;
+    size_t start = 0;
+    while (start < sound.size()) {
+        size_t end = min(sound.find(' ', start), sound.size());
+        query += (query.empty() ? "\"" : " \"") + sound.substr(start, end - start) + "\"";
+        start = end + 1;
+    }
+
+    size_t added = 0;
+    for (auto &pass : vector<pair<sqlite3_stmt*, string>>{{whole, sound}, {words, query}}) {
+        sqlite3_stmt* stmt = pass.first;
+        sqlite3_bind_text(stmt, 1, pass.second.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, (sqlite3_int64)FUZZY_RESULTS);
+        while (added < FUZZY_RESULTS && sqlite3_step(stmt) == SQLITE_ROW) {
+            string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            auto known = find_if(matches.begin(), matches.end(),
+                                 [&name](const ResidentMatch &m) { return m.name == name; });
+            if (known != matches.end()) {
+                known->soundsAlike = true;
+                continue;
+            }
+            ResidentMatch m;
+            m.name = name;
+            const unsigned char* address = sqlite3_column_text(stmt, 1);
+            const unsigned char* contact = sqlite3_column_text(stmt, 2);
+            m.address = address ? reinterpret_cast<const char*>(address) : "";
+            m.contact = contact ? reinterpret_cast<const char*>(contact) : "";
+            m.soundsAlike = true;
+            matches.push_back(m);
+            ++added;
+        }
+        sqlite3_reset(stmt);
+    }
+    return true;
+}
+
+// ------------------------
+// RESIDENTS
+// ------------------------
+bool renderResidentsTable(DbContext &ctx, ostream &out) {
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT name, address, contact FROM residents;");
+    if (!stmt) {
+        cout << RED << "Failed to fetch residents.\n" << RESET;
+        return false;
+    }
+
+    int nameWidth = 25, addrWidth = 30, contactWidth = 15;
+    int totalWidth = nameWidth + addrWidth + contactWidth + 7;
+
+    // Table header
+    out << "+" << string(totalWidth - 2, '-') << "+\n";
+    out << CYAN
+        << "| " << left << setw(nameWidth) << "Name"
+        << "| " << setw(addrWidth) << "Address"
+        << "| " << setw(contactWidth) << "Contact"
+        << "|\n" << RESET;
+    out << "+" << string(totalWidth - 2, '-') << "+\n";
+
+    // Helper to wrap text into multiple lines
+    auto wrapText = [](const string &text, int width) -> vector<string> {
+        vector<string> lines;
+        size_t start = 0;
+        while (start < text.length()) {
+            lines.push_back(text.substr(start, width));
+            start += width;
+        }
+        return lines;
+    };
+
+    // Table rows
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        string addr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        string contact = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+
+        vector<string> nameLines = wrapText(name, nameWidth);
+        vector<string> addrLines = wrapText(addr, addrWidth);
+        vector<string> contactLines = wrapText(contact, contactWidth);
+
+        size_t maxLines = max({nameLines.size(), addrLines.size(), contactLines.size()});
+
+        for (size_t i = 0; i < maxLines; ++i) {
+            out << "| "
+                << left << setw(nameWidth) << (i < nameLines.size() ? nameLines[i] : "")
+                << "| " << setw(addrWidth) << (i < addrLines.size() ? addrLines[i] : "")
+                << "| " << setw(contactWidth) << (i < contactLines.size() ? contactLines[i] : "")
+                << "|\n";
+        }
+
+        out << "+" << string(totalWidth - 2, '-') << "+\n";
+    }
+
+    sqlite3_reset(stmt);
+    return true;
+}
+
+void displayResidentsTable(DbContext &ctx) {
+    writeReport(ctx, renderResidentsTable);
+}
+
+void addResident(DbContext &ctx) {
+    EntryBatch batch;
+    batch.noun = "resident";
+    batch.insertSql = "INSERT INTO residents (name, address, contact, name_sound) VALUES (?, ?, ?, ?);";
+    batch.headers = {"Name", "Address", "Contact"};
+
+    char more = 'Y';
+    while (toupper(more) == 'Y') {
+        string name, address, contact;
+        clearInput();
+        cout << "Enter Full Name: ";
+        getline(cin, name);
+
+        cout << "Enter Address: ";
+        getline(cin, address);
+
+        cout << "Enter Contact Number: ";
+        getline(cin, contact);
+
+        batch.rows.push_back({{name, address, contact}, [name, address, contact](sqlite3_stmt* stmt) {
+            sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, address.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, contact.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 4, nameSound(name).c_str(), -1, SQLITE_TRANSIENT);
+        }});
+        printPendingRows(batch);
+
+        cout << "\nAdd another resident? (Y/N): ";
+        cin >> more;
+    }
+    finishBatch(ctx, batch);
+
+    cout << GREEN << "\n===== Updated Resident Records =====\n" << RESET;
+    displayResidentsTable(ctx);
+}
+
+const string SQL_UPDATE_RESIDENT = "UPDATE residents SET name=COALESCE(NULLIF(?,''),name), "
+                                   "name_sound=COALESCE(NULLIF(?,''),name_sound), "
+                                   "address=COALESCE(NULLIF(?,''),address), "
+                                   "contact=COALESCE(NULLIF(?,''),contact) WHERE " +
+                                   foldedNameMatch("residents", "name", 5) + ";";
+const string SQL_DELETE_RESIDENT = "DELETE FROM residents WHERE " + foldedNameMatch("residents", "name", 1) + ";";
+
+void updateResident(DbContext &ctx) {
+    cout << GREEN << "\n===== Current Residents =====\n" << RESET;
+    displayResidentsTable(ctx);
+
+    clearInput();
+    string oldName = readName("Enter resident name to update: ", residentNames);
+
+    string newName, newAddress, newContact;
+    cout << "New Full Name (leave blank to keep current): ";
+    getline(cin, newName);
+    cout << "New Address (leave blank to keep current): ";
+    getline(cin, newAddress);
+    cout << "New Contact (leave blank to keep current): ";
+    getline(cin, newContact);
+
+    auto updated = submitWrite(ctx.writer, [=](sqlite3* conn, bool &ok) {
+        string newSound = newName.empty() ? "" : nameSound(newName);
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(conn, SQL_UPDATE_RESIDENT.c_str(), -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, newName.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, newSound.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, newAddress.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, newContact.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 5, oldName.c_str(), -1, SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        return ok;
+    }, false);
+
+    if (updated.get())
+        cout << GREEN << "\nResident updated successfully!\n" << RESET;
+    else
+        cout << RED << "\nResident not found or update failed.\n" << RESET;
+
+    cout << GREEN << "\n===== Updated Resident Records =====\n" << RESET;
+    displayResidentsTable(ctx);
+}
+
+void searchResident(DbContext &ctx) {
+    cout << GREEN << "\n===== Current Residents =====\n" << RESET;
+    displayResidentsTable(ctx);
+
+    clearInput();
+    string keyword;
+    cout << "Enter name keyword to search: ";
+    getline(cin, keyword);
+
+    ReadConnection* rc = readConnection(ctx);
+    if (!rc) return;
+    QueryGuard guard;
+    guard.label = "Searching";
+    guard.timeoutMs = SEARCH_TIMEOUT_MS;
+    startQueryGuard(guard, rc->conn);
+
+    // Closest names first, then names that only sound alike; keywords under
+    // three letters are plain substrings
+    vector<ResidentMatch> matches;
+    bool fuzzy = fuzzyResidentSearch([&ctx](const string &sql) { return readStatement(ctx, sql); }, keyword, matches);
+    int status = SQLITE_DONE;
+    if (!fuzzy) {
+        sqlite3_stmt* stmt = readStatement(ctx, "SELECT name, address, contact FROM residents WHERE name LIKE ?;");
+        if (!stmt) {
+            finishQueryGuard(guard, SQLITE_ERROR);
+            return;
+        }
+        string pattern = "%" + keyword + "%";
+        sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_STATIC);
+        while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+            ResidentMatch m;
+            m.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            m.address = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            m.contact = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            matches.push_back(m);
+        }
+        sqlite3_reset(stmt);
+    }
+    if (status == SQLITE_DONE)
+        phoneticResidentSearch([&ctx](const string &sql) { return readStatement(ctx, sql); }, keyword, matches);
+    QueryOutcome outcome = finishQueryGuard(guard, status);
+
+    cout << GREEN << "\n===== Search Results =====\n" << RESET;
+    size_t keywordGrams = nameTrigrams(nameKey(keyword)).size();
+    for (auto &m : matches) {
+        cout << "Name   : " << m.name << "\nAddress: " << m.address << "\nContact: " << m.contact << "\n";
+        string note;
+        if (fuzzy && m.shared)
+            note = to_string((int)(100 * m.similarity + 0.5)) + "% similar" +
+                   (m.shared == keywordGrams ? ", contains the keyword" : "");
+        if (m.soundsAlike) note += note.empty() ? "sounds like the keyword" : ", sounds alike";
+        if (!note.empty()) cout << "Match  : " << note << "\n";
+        cout << "------------------\n";
+    }
+    if (outcome != QUERY_DONE) cout << RED << queryOutcomeNote(guard, outcome) << "\n" << RESET;
+    else if (matches.empty()) cout << RED << "No matching residents found.\n" << RESET;
+}
+
+void deleteResident(DbContext &ctx) {
+    cout << GREEN << "\n===== Current Residents =====\n" << RESET;
+    displayResidentsTable(ctx);
+
+    clearInput();
+    string name = readName("Enter resident name to delete: ", residentNames);
+
+    auto deleted = submitWrite(ctx.writer, [name](sqlite3* conn, bool &ok) {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(conn, SQL_DELETE_RESIDENT.c_str(), -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        return ok;
+    }, false);
+
+    if (deleted.get())
+        cout << GREEN << "\nResident deleted successfully!\n" << RESET;
+    else
+        cout << RED << "\nResident not found or deletion failed.\n" << RESET;
+
+    cout << GREEN << "\n===== Updated Resident Records =====\n" << RESET;
+    displayResidentsTable(ctx);
+}
+
+// ------------------------
+// INCIDENT TIMESTAMPS
+// ------------------------
+// Incidents store when they happened as one INTEGER, occurred_at (Unix
+// seconds, UTC), indexed so date ranges are index range scans. Dates and times
+// are still typed and shown as local "YYYY-MM-DD" and "HH:MM".
+const unsigned char DAYS_IN_MONTH[13] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+// Days since 1970-01-01 of a proleptic Gregorian date (years from 0 on)
+long long daysFromCivil(unsigned y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    unsigned era = y / 400;
+    unsigned yoe = y - era * 400;
+    unsigned doy = (153 * ((m + 9) % 12) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097LL + doe - 719468;
+}
+
+// Parses "YYYY-MM-DD" and "HH:MM" into seconds since 1970-01-01 00:00 of the
+// same wall clock. Every character and field is checked with arithmetic that
+// only accumulates into `bad`, so a valid entry costs no branches beyond the
+// length check; month lengths and leap years included.
+bool parseWallClock(const string &date, const string &time, long long &seconds) {
+    if (date.size() != 10 || time.size() != 5) return false;
+    const unsigned char* d = reinterpret_cast<const unsigned char*>(date.data());
+    const unsigned char* t = reinterpret_cast<const unsigned char*>(time.data());
+    unsigned bad = (d[4] != '-') | (d[7] != '-') | (t[2] != ':');
+    auto digit = [&bad](unsigned char c) {
+        unsigned v = c - '0';
+        bad |= v > 9;
+        return v;
+    };
+
+    unsigned year = digit(d[0]) * 1000 + digit(d[1]) * 100 + digit(d[2]) * 10 + digit(d[3]);
+    unsigned month = digit(d[5]) * 10 + digit(d[6]);
+    unsigned day = digit(d[8]) * 10 + digit(d[9]);
+    unsigned hour = digit(t[0]) * 10 + digit(t[1]);
+    unsigned minute = digit(t[3]) * 10 + digit(t[4]);
+
+    unsigned leap = (year % 4 == 0) & ((year % 100 != 0) | (year % 400 == 0));
+    unsigned monthDays = DAYS_IN_MONTH[month * (month <= 12)] + (leap & (month == 2));
+    bad |= (year < 1900) | (month - 1 > 11) | (day - 1 >= monthDays) | (hour > 23) | (minute > 59);
+
+    seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60;
+    return !bad;
+}
+
+// How far local time is ahead of UTC at instant t
+long long utcOffsetAt(time_t t) {
+    tm local = *localtime(&t);
+    tm utc = *gmtime(&t);
+    auto wall = [](const tm &c) {
+        return daysFromCivil(c.tm_year + 1900, c.tm_mon + 1, c.tm_mday) * 86400 +
+               c.tm_hour * 3600 + c.tm_min * 60 + c.tm_sec;
+    };
+    return wall(local) - wall(utc);
+}
+
+// A local date and time as an occurred_at value
+bool parseIncidentTime(const string &date, const string &time, long long &occurredAt) {
+    long long wall;
+    if (!parseWallClock(date, time, wall)) return false;
+    occurredAt = wall - utcOffsetAt((time_t)wall);
+    return true;
+}
+
+// Whole local days from..to (inclusive) as an occurred_at range
+bool parseIncidentDays(const string &from, const string &to, long long &lo, long long &hi) {
+    long long last;
+    if (!parseIncidentTime(from, "00:00", lo) || !parseIncidentTime(to, "00:00", last)) return false;
+    hi = last + 86400 - 1;
+    return lo <= hi;
+}
+
+// The incident columns as shown, occurred_at turned back into local date and time
+const string INCIDENT_COLUMNS =
+    "type, location, "
+    "COALESCE(strftime('%Y-%m-%d', occurred_at, 'unixepoch', 'localtime'), '') AS date, "
+    "COALESCE(strftime('%H:%M', occurred_at, 'unixepoch', 'localtime'), '') AS time, "
+    "description";
+
+// Date ranges use the occurred_at index. Searches by type or location use the
+// composite ones, which also hold the other filter columns, so rows that do
+// not match are rejected inside the index and never read from the table.
+const char* INCIDENT_INDEXES = R"(
+    CREATE INDEX IF NOT EXISTS idx_incidents_occurred_at ON incidents(occurred_at);
+    CREATE INDEX IF NOT EXISTS idx_incidents_type
+        ON incidents(type COLLATE NOCASE, occurred_at, location COLLATE NOCASE);
+    CREATE INDEX IF NOT EXISTS idx_incidents_location
+        ON incidents(location COLLATE NOCASE, occurred_at, type COLLATE NOCASE);
+)";
+
+// Databases from before occurred_at keep the typed text in date and time.
+// Those are converted in one write transaction and the two columns dropped;
+// text that does not parse is kept at the end of the incident's description.
+bool migrateIncidentTimes(DbContext &ctx) {
+    auto migrated = submitWrite(ctx.writer, [](sqlite3* conn, int &converted) {
+        bool legacy = false;
+        sqlite3_stmt* columns;
+        if (sqlite3_prepare_v2(conn, "SELECT 1 FROM pragma_table_info('incidents') WHERE name = 'date';",
+                               -1, &columns, nullptr) != SQLITE_OK)
+            return false;
+        legacy = sqlite3_step(columns) == SQLITE_ROW;
+        sqlite3_finalize(columns);
+
+        if (legacy) {
+            sqlite3_create_function(conn, "incident_time", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                [](sqlite3_context* fn, int, sqlite3_value** args) {
+                    const char* date = reinterpret_cast<const char*>(sqlite3_value_text(args[0]));
+                    const char* time = reinterpret_cast<const char*>(sqlite3_value_text(args[1]));
+                    long long occurredAt = 0;
+                    if (date && parseIncidentTime(date, time && *time ? time : "00:00", occurredAt))
+                        sqlite3_result_int64(fn, occurredAt);
+                    else
+                        sqlite3_result_null(fn);
+                }, nullptr, nullptr);
+            const char* convert = R"(
+                UPDATE incidents SET occurred_at = incident_time(date, time);
+                UPDATE incidents
+                   SET description = COALESCE(description, '') || ' [recorded as: ' ||
+                                     TRIM(COALESCE(date, '') || ' ' || COALESCE(time, '')) || ']'
+                 WHERE occurred_at IS NULL AND COALESCE(date, '') || COALESCE(time, '') <> '';
+            )";
+            // The change-log triggers are recreated around each column change,
+            // so the conversion itself is logged
+            bool ok = dropChangeTriggers(conn) &&
+                      sqlite3_exec(conn, "ALTER TABLE incidents ADD COLUMN occurred_at INTEGER;",
+                                   nullptr, nullptr, nullptr) == SQLITE_OK &&
+                      createChangeTriggers(conn) &&
+                      sqlite3_exec(conn, convert, nullptr, nullptr, nullptr) == SQLITE_OK &&
+                      dropChangeTriggers(conn) &&
+                      sqlite3_exec(conn, "ALTER TABLE incidents DROP COLUMN date; ALTER TABLE incidents DROP COLUMN time;",
+                                   nullptr, nullptr, nullptr) == SQLITE_OK &&
+                      createChangeTriggers(conn);
+            if (!ok) return false;
+        }
+        converted = legacy;
+        return sqlite3_exec(conn, INCIDENT_INDEXES, nullptr, nullptr, nullptr) == SQLITE_OK;
+    }, -1);
+
+    int converted = migrated.get();
+    if (converted > 0)
+        cerr << YELLOW << "Converted incident dates and times to occurred_at.\n" << RESET;
+    return converted >= 0;
+}
+
+// ------------------------
+// INCIDENTS
+// ------------------------
+bool renderIncidentRows(sqlite3_stmt* stmt, ostream &out, size_t* rows = nullptr) {
+    int typeWidth = 15, locWidth = 20, dateWidth = 12, timeWidth = 8, descWidth = 40;
+    int totalWidth = typeWidth + locWidth + dateWidth + timeWidth + descWidth + 11;
+
+    // Table header
+    out << "+" << string(totalWidth - 2, '-') << "+\n";
+    out << CYAN
+        << "| " << left << setw(typeWidth) << "Type"
+        << "| " << setw(locWidth) << "Location"
+        << "| " << setw(dateWidth) << "Date"
+        << "| " << setw(timeWidth) << "Time"
+        << "| " << setw(descWidth) << "Description"
+        << "|\n" << RESET;
+    out << "+" << string(totalWidth - 2, '-') << "+\n";
+
+    // Helper to wrap text into multiple lines
+    auto wrapText = [](const string &text, int width) -> vector<string> {
+        vector<string> lines;
+        size_t start = 0;
+        while (start < text.length()) {
+            lines.push_back(text.substr(start, width));
+            start += width;
+        }
+        return lines;
+    };
+
+    // Table rows
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (rows) ++*rows;
+        string type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        string loc = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        string time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        string desc = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+
+        vector<string> typeLines = wrapText(type, typeWidth);
+        vector<string> locLines = wrapText(loc, locWidth);
+        vector<string> dateLines = wrapText(date, dateWidth);
+        vector<string> timeLines = wrapText(time, timeWidth);
+        vector<string> descLines = wrapText(desc, descWidth);
+
+        size_t maxLines = max({typeLines.size(), locLines.size(), dateLines.size(), timeLines.size(), descLines.size()});
+
+        for (size_t i = 0; i < maxLines; ++i) {
+            out << "| "
+                << left << setw(typeWidth) << (i < typeLines.size() ? typeLines[i] : "")
+                << "| " << setw(locWidth) << (i < locLines.size() ? locLines[i] : "")
+                << "| " << setw(dateWidth) << (i < dateLines.size() ? dateLines[i] : "")
+                << "| " << setw(timeWidth) << (i < timeLines.size() ? timeLines[i] : "")
+                << "| " << setw(descWidth) << (i < descLines.size() ? descLines[i] : "")
+                << "|\n";
+        }
+
+        out << "+" << string(totalWidth - 2, '-') << "+\n";
+    }
+
+    sqlite3_reset(stmt);
+    return true;
+}
+
+bool renderIncidentsTable(DbContext &ctx, ostream &out) {
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT " + INCIDENT_COLUMNS + " FROM incidents;");
+    if (!stmt) {
+        cout << RED << "Failed to fetch incidents.\n" << RESET;
+        return false;
+    }
+    return renderIncidentRows(stmt, out);
+}
+
+// Incidents with occurred_at in [from, to], oldest first, off the index
+bool renderIncidentsBetween(DbContext &ctx, ostream &out, long long from, long long to) {
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT " + INCIDENT_COLUMNS + " FROM incidents "
+                                            "WHERE occurred_at BETWEEN ?1 AND ?2 ORDER BY occurred_at;");
+    if (!stmt) {
+        cout << RED << "Failed to fetch incidents.\n" << RESET;
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, from);
+    sqlite3_bind_int64(stmt, 2, to);
+    return renderIncidentRows(stmt, out);
+}
+
+void displayIncidentsTable(DbContext &ctx) {
+    writeReport(ctx, renderIncidentsTable);
+}
+
+void displayIncidentsBetween(DbContext &ctx, long long from, long long to) {
+    writeReport(ctx, [from, to](DbContext &c, ostream &out) { return renderIncidentsBetween(c, out, from, to); });
+}
+
+// View Incidents: everything, the last N days, or a range of dates
+void viewIncidents(DbContext &ctx) {
+    char option;
+    cout << "\n[1] All Incidents  [2] Last N Days  [3] Date Range\n"
+         << "Choice: ";
+    cin >> option;
+
+    if (option == '2') {
+        int days;
+        cout << "Number of days: ";
+        cin >> days;
+        if (!cin || days < 1) {
+            cin.clear();
+            cout << RED << "Enter a number of days of at least 1.\n" << RESET;
+            return;
+        }
+        long long now = (long long)time(nullptr);
+        displayIncidentsBetween(ctx, now - days * 86400LL, now);
+    } else if (option == '3') {
+        string from, to;
+        long long lo = 0, hi = 0;
+        clearInput();
+        while (true) {
+            cout << "From (YYYY-MM-DD): ";
+            getline(cin, from);
+            cout << "To (YYYY-MM-DD): ";
+            getline(cin, to);
+            if (parseIncidentDays(from, to, lo, hi)) break;
+            if (!cin) return;
+            cout << RED << "Enter two valid dates, the first not after the second.\n" << RESET;
+        }
+        displayIncidentsBetween(ctx, lo, hi);
+    } else {
+        displayIncidentsTable(ctx);
+    }
+}
+
+void reportIncident(DbContext &ctx) {
+    EntryBatch batch;
+    batch.noun = "incident";
+    batch.insertSql = "INSERT INTO incidents (type, location, occurred_at, description) VALUES (?,?,?,?);";
+    batch.headers = {"Type", "Location", "Date", "Time", "Description"};
+
+    char more = 'Y';
+    while (toupper(more) == 'Y') {
+        string type, location, date, time, description;
+        clearInput();
+        cout << "Enter Incident Type: ";
+        getline(cin, type);
+        cout << "Enter Location: ";
+        getline(cin, location);
+        long long occurredAt = 0;
+        while (true) {
+            cout << "Enter Date (YYYY-MM-DD): ";
+            getline(cin, date);
+            cout << "Enter Time (HH:MM): ";
+            getline(cin, time);
+            if (parseIncidentTime(date, time, occurredAt)) break;
+            if (!cin) return;   // input closed: nothing can be confirmed or saved
+            cout << RED << "Not a valid date and time; use e.g. 2024-03-15 and 14:30.\n" << RESET;
+        }
+        cout << "Enter Description: ";
+        getline(cin, description);
+
+        batch.rows.push_back({{type, location, date, time, description}, [=](sqlite3_stmt* stmt) {
+            sqlite3_bind_text(stmt, 1, type.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, location.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 3, occurredAt);
+            sqlite3_bind_text(stmt, 4, description.c_str(), -1, SQLITE_TRANSIENT);
+        }});
+        printPendingRows(batch);
+
+        cout << "\nReport another incident? (Y/N): ";
+        cin >> more;
+    }
+    finishBatch(ctx, batch);
+
+    cout << GREEN << "\n===== Updated Incident Records =====\n" << RESET;
+    displayIncidentsTable(ctx);
+}
+
+// ------------------------
+// INCIDENT SEARCH
+// ------------------------
+// Any combination of type, location (both exact, ignoring case), a date range
+// and a description keyword, newest first. Each combination is its own cached
+// statement, shaped so it is answered from one of the incident indexes; a
+// keyword alone is limited to the last KEYWORD_WINDOW_DAYS so it still is.
+const int KEYWORD_WINDOW_DAYS = 365;
+const int SEARCH_MAX_ROWS = 500;
+
+struct IncidentFilter {
+    string type;
+    string location;
+    string keyword;
+    bool dated = false;
+    long long from = 0;
+    long long to = 0;
+};
+
+// Parameters keep their numbers in every shape: ?1 type, ?2 location,
+// ?3/?4 occurred_at range, ?5 keyword, ?6 row limit
+string incidentSearchSql(const IncidentFilter &f) {
+    string sql = "SELECT " + INCIDENT_COLUMNS + " FROM incidents WHERE 1";
+    if (!f.type.empty()) sql += " AND type = ?1 COLLATE NOCASE";
+    if (!f.location.empty()) sql += " AND location = ?2 COLLATE NOCASE";
+    if (f.dated) sql += " AND occurred_at BETWEEN ?3 AND ?4";
+    if (!f.keyword.empty()) sql += " AND description LIKE ?5";
+    return sql + " ORDER BY occurred_at DESC LIMIT ?6;";
+}
+
+// A keyword with nothing else to narrow it gets the default window
+IncidentFilter boundedFilter(IncidentFilter f) {
+    if (!f.keyword.empty() && f.type.empty() && f.location.empty() && !f.dated) {
+        f.dated = true;
+        f.to = (long long)time(nullptr);
+        f.from = f.to - KEYWORD_WINDOW_DAYS * 86400LL;
+    }
+    return f;
+}
+
+bool renderIncidentSearch(DbContext &ctx, ostream &out, const IncidentFilter &filter) {
+    IncidentFilter f = boundedFilter(filter);
+    sqlite3_stmt* stmt = readStatement(ctx, incidentSearchSql(f));
+    if (!stmt) {
+        cout << RED << "Failed to search incidents.\n" << RESET;
+        return false;
+    }
+    string pattern = "%" + f.keyword + "%";
+    if (!f.type.empty()) sqlite3_bind_text(stmt, 1, f.type.c_str(), -1, SQLITE_TRANSIENT);
+    if (!f.location.empty()) sqlite3_bind_text(stmt, 2, f.location.c_str(), -1, SQLITE_TRANSIENT);
+    if (f.dated) {
+        sqlite3_bind_int64(stmt, 3, f.from);
+        sqlite3_bind_int64(stmt, 4, f.to);
+    }
+    if (!f.keyword.empty()) sqlite3_bind_text(stmt, 5, pattern.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 6, SEARCH_MAX_ROWS + 1);
+
+    size_t rows = 0;
+    bool ok = renderIncidentRows(stmt, out, &rows);
+    if (f.dated && !filter.dated)
+        out << YELLOW << "Keyword searched in the last " << KEYWORD_WINDOW_DAYS
+            << " days; add a date range to look further back.\n" << RESET;
+    if (rows > (size_t)SEARCH_MAX_ROWS)
+        out << YELLOW << "More than " << SEARCH_MAX_ROWS << " matches; narrow the search to see them all.\n" << RESET;
+    else
+        out << rows << " matching incident" << (rows == 1 ? "" : "s") << "\n";
+    return ok;
+}
+
+void searchIncidents(DbContext &ctx) {
+    IncidentFilter f;
+    string from, to;
+    clearInput();
+    cout << "Leave any field blank to not filter on it.\n";
+    cout << "Incident Type: ";
+    getline(cin, f.type);
+    cout << "Location: ";
+    getline(cin, f.location);
+    while (true) {
+        cout << "From (YYYY-MM-DD): ";
+        getline(cin, from);
+        cout << "To (YYYY-MM-DD): ";
+        getline(cin, to);
+        if (from.empty() && to.empty()) break;
+        if (from.empty()) from = "1900-01-01";
+        if (to.empty()) to = "9999-12-31";
+        if ((f.dated = parseIncidentDays(from, to, f.from, f.to)) || !cin) break;
+        cout << RED << "Enter valid dates, the first not after the second.\n" << RESET;
+    }
+    cout << "Keyword in Description: ";
+    getline(cin, f.keyword);
+
+    if (f.type.empty() && f.location.empty() && !f.dated && f.keyword.empty()) {
+        displayIncidentsTable(ctx);
+        return;
+    }
+    cout << GREEN << "\n===== Matching Incidents =====\n" << RESET;
+    writeReport(ctx, [&f](DbContext &c, ostream &out) { return renderIncidentSearch(c, out, f); });
+}
+
+// An in-memory copy of the schema with no statistics, for the plan checks.
+// The planner then weighs every table as a large one, so the checks test the
+// index shapes rather than what ANALYZE last made of a few dozen rows.
+sqlite3* openPlanSchema(DbContext &ctx) {
+    sqlite3_stmt* schema = readStatement(ctx, "SELECT sql FROM sqlite_schema "
+                                              "WHERE sql IS NOT NULL AND name NOT LIKE 'sqlite_%' ORDER BY rowid;");
+    sqlite3* conn = nullptr;
+    bool ok = schema && sqlite3_open(":memory:", &conn) == SQLITE_OK;
+    while (ok && sqlite3_step(schema) == SQLITE_ROW) {
+        // A virtual table's shadow tables are listed too, but already made by it
+        string sql = reinterpret_cast<const char*>(sqlite3_column_text(schema, 0));
+        if (sql.compare(0, 13, "CREATE TABLE ") == 0) sql.insert(13, "IF NOT EXISTS ");
+        ok = sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+    if (schema) sqlite3_reset(schema);
+    if (!ok) {
+        cerr << RED << "Could not copy the schema: " << (conn ? sqlite3_errmsg(conn) : "no database") << RESET << endl;
+        sqlite3_close(conn);
+        return nullptr;
+    }
+    return conn;
+}
+
+// Prints the plan of sql on one line under label; false if it cannot be
+// prepared. scans is set when the plan reads a whole table or index.
+bool showPlan(sqlite3* conn, const string &label, const string &sql, bool &scans) {
+    sqlite3_stmt* plan;
+    if (sqlite3_prepare_v2(conn, ("EXPLAIN QUERY PLAN " + sql).c_str(), -1, &plan, nullptr) != SQLITE_OK) {
+        cerr << RED << label << ": " << sqlite3_errmsg(conn) << RESET << endl;
+        return false;
+    }
+    string detail;
+    scans = false;
+    while (sqlite3_step(plan) == SQLITE_ROW) {
+        string step = reinterpret_cast<const char*>(sqlite3_column_text(plan, 3));
+        scans = scans || step.compare(0, 5, "SCAN ") == 0;
+        detail += (detail.empty() ? "" : "; ") + step;
+    }
+    sqlite3_finalize(plan);
+    cout << (scans ? RED "FULL SCAN " : GREEN "ok        ") << RESET
+         << left << setw(29) << label << detail << "\n" << right;
+    return true;
+}
+
+// Runs EXPLAIN QUERY PLAN on every search shape and fails if any of them
+// would read the whole incidents table (or a whole index) instead of a range
+bool checkIncidentPlans(sqlite3* conn) {
+    bool allIndexed = true;
+    for (int shape = 1; shape < 16; ++shape) {
+        IncidentFilter f;
+        string name;
+        if (shape & 1) f.type = "x", name += "type ";
+        if (shape & 2) f.location = "x", name += "location ";
+        if (shape & 4) f.dated = true, name += "dates ";
+        if (shape & 8) f.keyword = "x", name += "keyword ";
+        f = boundedFilter(f);
+
+        bool scans;
+        if (!showPlan(conn, name, incidentSearchSql(f), scans)) return false;
+        allIndexed = allIndexed && !scans;
+    }
+    return allIndexed;
+}
+
+// ------------------------
+// INCIDENT REPORT (count by type)
+// ------------------------
+bool incidentCountsByType(DbContext &ctx, int threads, map<string, long long> &counts, QueryGuard* guard = nullptr) {
+    return parallelScan(ctx, "incidents",
+        "SELECT COALESCE(type, ''), count(*) FROM incidents WHERE rowid BETWEEN ?1 AND ?2 GROUP BY 1;",
+        threads, counts,
+        [](sqlite3_stmt* stmt, map<string, long long> &partial) {
+            partial[reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))] += sqlite3_column_int64(stmt, 1);
+        },
+        [](map<string, long long> &total, const map<string, long long> &partial) {
+            for (auto &entry : partial) total[entry.first] += entry.second;
+        }, guard);
+}
+
+void incidentReport(DbContext &ctx, int threads) {
+    map<string, long long> counts;
+    auto start = chrono::steady_clock::now();
+    QueryGuard guard;
+    guard.label = "Counting incidents";
+    guard.timeoutMs = REPORT_TIMEOUT_MS;
+    startQueryGuard(guard, nullptr);
+    bool complete = incidentCountsByType(ctx, threads, counts, &guard);
+    QueryOutcome outcome = finishQueryGuard(guard, complete ? SQLITE_DONE : SQLITE_ERROR);
+    if (outcome == QUERY_FAILED) {
+        cout << RED << "\nCould not compute the incident report.\n" << RESET;
+        return;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    // Most frequent first
+    vector<pair<string, long long>> rows(counts.begin(), counts.end());
+    sort(rows.begin(), rows.end(), [](const pair<string, long long> &a, const pair<string, long long> &b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+
+    int typeWidth = 30, countWidth = 12;
+    int totalWidth = typeWidth + countWidth + 5;
+    long long total = 0;
+    cout << GREEN << "\n===== Incidents by Type =====\n" << RESET;
+    cout << "+" << string(totalWidth, '-') << "+\n";
+    cout << CYAN
+         << "| " << left << setw(typeWidth) << "Type"
+         << "| " << setw(countWidth) << "Count"
+         << "|\n" << RESET;
+    cout << "+" << string(totalWidth, '-') << "+\n";
+    for (auto &row : rows) {
+        cout << "| " << left << setw(typeWidth) << row.first.substr(0, typeWidth - 1)
+             << "| " << setw(countWidth) << row.second << "|\n";
+        total += row.second;
+    }
+    cout << "+" << string(totalWidth, '-') << "+\n";
+    cout << BOLD
+         << "| " << left << setw(typeWidth) << "TOTAL"
+         << "| " << setw(countWidth) << total << "|\n" << RESET;
+    cout << "+" << string(totalWidth, '-') << "+\n";
+    cout << "Scanned with up to " << threads << " threads in " << (long long)ms << " ms\n";
+    if (outcome != QUERY_DONE) cout << RED << queryOutcomeNote(guard, outcome) << "\n" << RESET;
+}
+
+// ------------------------
+// INCIDENT ROLLUPS
+// ------------------------
+// Incident counts per local day by type, by location and by hour of day, kept
+// by triggers in the same transaction as the incidents they count. Trends and
+// monthly reports read only these tables: a year is at most 365 rows per type,
+// location or hour however many incidents there are. Days and hours are local
+// time, as the incident screens show them; rebuild-rollups recounts them after
+// the machine's time zone changes.
+const int TREND_WINDOWS[] = {7, 30, 365};
+const int TREND_WINDOW_COUNT = 3;
+const int TREND_TOP_LOCATIONS = 8;
+
+// One rollup table: its key column and how an incident row gives the key
+struct IncidentRollup {
+    const char* table;
+    const char* column;
+    const char* before;     // key = before + "new." / "old." / "" + after
+    const char* after;
+};
+
+const IncidentRollup INCIDENT_ROLLUPS[] = {
+    {"incident_daily_types", "type", "COALESCE(", "type, '') COLLATE NOCASE"},
+    {"incident_daily_locations", "location", "COALESCE(", "location, '') COLLATE NOCASE"},
+    {"incident_daily_hours", "hour", "CAST(strftime('%H', ", "occurred_at, 'unixepoch', 'localtime') AS INTEGER)"},
+};
+
+const char* INCIDENT_ROLLUP_TABLES = R"(
+    CREATE TABLE IF NOT EXISTS incident_daily_types (
+        day TEXT NOT NULL,
+        type TEXT NOT NULL COLLATE NOCASE,
+        incidents INTEGER NOT NULL,
+        PRIMARY KEY (day, type)
+    ) WITHOUT ROWID;
+
+    CREATE TABLE IF NOT EXISTS incident_daily_locations (
+        day TEXT NOT NULL,
+        location TEXT NOT NULL COLLATE NOCASE,
+        incidents INTEGER NOT NULL,
+        PRIMARY KEY (day, location)
+    ) WITHOUT ROWID;
+
+    CREATE TABLE IF NOT EXISTS incident_daily_hours (
+        day TEXT NOT NULL,
+        hour INTEGER NOT NULL,
+        incidents INTEGER NOT NULL,
+        PRIMARY KEY (day, hour)
+    ) WITHOUT ROWID;
+)";
+
+// row is "new.", "old." or "" (a column of incidents itself)
+string rollupDay(const string &row) {
+    return "date(" + row + "occurred_at, 'unixepoch', 'localtime')";
+}
+
+string rollupKey(const IncidentRollup &rollup, const string &row) {
+    return rollup.before + row + rollup.after;
+}
+
+// The tables and the triggers that keep them. An incident without occurred_at
+// is on no day and counted nowhere; a count that drops to zero is deleted.
+string incidentRollupSchema() {
+    string added, removed;
+    for (auto &rollup : INCIDENT_ROLLUPS) {
+        string table = rollup.table, column = rollup.column;
+        added += "INSERT INTO " + table + " (day, " + column + ", incidents) SELECT " + rollupDay("new.") + ", " +
+                 rollupKey(rollup, "new.") + ", 1 WHERE new.occurred_at IS NOT NULL "
+                 "ON CONFLICT (day, " + column + ") DO UPDATE SET incidents = incidents + 1;\n";
+        string match = " WHERE day = " + rollupDay("old.") + " AND " + column + " = " + rollupKey(rollup, "old.");
+        removed += "UPDATE " + table + " SET incidents = incidents - 1" + match + ";\n" +
+                   "DELETE FROM " + table + match + " AND incidents <= 0;\n";
+    }
+    return string(INCIDENT_ROLLUP_TABLES) +
+           "CREATE TRIGGER IF NOT EXISTS incidents_rollup_insert AFTER INSERT ON incidents BEGIN\n" + added + "END;\n"
+           "CREATE TRIGGER IF NOT EXISTS incidents_rollup_delete AFTER DELETE ON incidents BEGIN\n" + removed + "END;\n"
+           "CREATE TRIGGER IF NOT EXISTS incidents_rollup_update AFTER UPDATE OF type, location, occurred_at "
+           "ON incidents BEGIN\n" + removed + added + "END;\n";
+}
+
+// Counts every incident into empty rollup tables
+string incidentRollupFill() {
+    string fill;
+    for (auto &rollup : INCIDENT_ROLLUPS)
+        fill += string("INSERT INTO ") + rollup.table + " (day, " + rollup.column + ", incidents) SELECT " +
+                rollupDay("") + ", " + rollupKey(rollup, "") + ", count(*) FROM incidents "
+                "WHERE occurred_at IS NOT NULL GROUP BY 1, 2;\n";
+    return fill;
+}
+
+// Creates the rollups on first start and counts the incidents already there
+bool setupIncidentRollups(DbContext &ctx) {
+    auto ready = submitWrite(ctx.writer, [](sqlite3* conn, bool &ok) {
+        sqlite3_stmt* existing;
+        if (sqlite3_prepare_v2(conn, "SELECT 1 FROM sqlite_schema WHERE name = 'incident_daily_types';", -1,
+                               &existing, nullptr) != SQLITE_OK)
+            return false;
+        bool fill = sqlite3_step(existing) != SQLITE_ROW;
+        sqlite3_finalize(existing);
+
+        ok = sqlite3_exec(conn, incidentRollupSchema().c_str(), nullptr, nullptr, nullptr) == SQLITE_OK &&
+             (!fill || sqlite3_exec(conn, incidentRollupFill().c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+        return ok;
+    }, false);
+    return ready.get();
+}
+
+bool rebuildIncidentRollups(DbContext &ctx) {
+    auto rebuilt = submitWrite(ctx.writer, [](sqlite3* conn, bool &ok) {
+        string sql;
+        for (auto &rollup : INCIDENT_ROLLUPS) sql += string("DELETE FROM ") + rollup.table + ";\n";
+        sql += incidentRollupFill();
+        ok = sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+        return ok;
+    }, false);
+    return rebuilt.get();
+}
+
+// Where the trend queries read (day, key, incidents) rows from, one source per
+// INCIDENT_ROLLUPS entry: the rollup tables, or the same rows counted from
+// incidents on the fly, which the benchmark checks the rollups against
+vector<string> trendSources(bool rollups) {
+    vector<string> sources;
+    for (auto &rollup : INCIDENT_ROLLUPS)
+        sources.push_back(rollups ? string(rollup.table)
+            : "(SELECT " + rollupDay("") + " AS day, " + rollupKey(rollup, "") + " AS " + rollup.column +
+              ", 1 AS incidents FROM incidents)");
+    return sources;
+}
+
+struct TrendRow {
+    string name;
+    long long counts[TREND_WINDOW_COUNT] = {};     // incidents in each window
+};
+
+struct IncidentTrends {
+    string asOf;                                    // the last day of every window
+    long long totals[TREND_WINDOW_COUNT] = {};
+    long long previous[TREND_WINDOW_COUNT] = {};    // the same length of time just before
+    vector<TrendRow> types, locations;              // locations: the busiest of the last 30 days
+    long long hours[24] = {};                       // over the longest window
+};
+
+// Type and location names group the way their NOCASE columns do
+struct NocaseLess {
+    bool operator()(const string &a, const string &b) const { return sqlite3_stricmp(a.c_str(), b.c_str()) < 0; }
+};
+
+// statement(sql) hands out a prepared statement for sql, cached by the caller.
+// asOf is a local "YYYY-MM-DD"; every window ends with it. Each source is read
+// once over the days the windows cover and counted here, so the time depends on
+// days times distinct types or locations, never on the number of incidents.
+bool loadIncidentTrends(const function<sqlite3_stmt*(const string &)> &statement, const vector<string> &from,
+                        const string &asOf, IncidentTrends &trends) {
+    trends = IncidentTrends();
+    trends.asOf = asOf;
+    const int longest = TREND_WINDOW_COUNT - 1, busiest = 1;     // 365 days; locations ranked by 30
+
+    // The day before each window, then the day before each previous window
+    string boundsSql = "SELECT ";
+    for (int w = 0; w < 2 * TREND_WINDOW_COUNT; ++w)
+        boundsSql += string(w ? ", " : "") + "date(?1, '-" +
+                     to_string(TREND_WINDOWS[w % TREND_WINDOW_COUNT] * (1 + w / TREND_WINDOW_COUNT)) + " days')";
+    auto rowsSql = [](const IncidentRollup &rollup, const string &source) {
+        return string("SELECT day, ") + rollup.column + ", incidents FROM " + source + " WHERE day > ?2 AND day <= ?1;";
+    };
+    sqlite3_stmt* bounds = statement(boundsSql + ";");
+    sqlite3_stmt* types = bounds ? statement(rowsSql(INCIDENT_ROLLUPS[0], from[0])) : nullptr;
+    sqlite3_stmt* locations = types ? statement(rowsSql(INCIDENT_ROLLUPS[1], from[1])) : nullptr;
+    sqlite3_stmt* hours = locations ? statement(rowsSql(INCIDENT_ROLLUPS[2], from[2])) : nullptr;
+    if (!hours) return false;
+
+    string starts[2 * TREND_WINDOW_COUNT];
+    sqlite3_bind_text(bounds, 1, asOf.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = sqlite3_step(bounds) == SQLITE_ROW;
+    for (int w = 0; w < 2 * TREND_WINDOW_COUNT && ok; ++w) {
+        const unsigned char* day = sqlite3_column_text(bounds, w);
+        ok = day != nullptr;
+        if (ok) starts[w] = reinterpret_cast<const char*>(day);
+    }
+    sqlite3_reset(bounds);
+    if (!ok) return false;
+
+    // Rows of one source from the day after `after` to asOf
+    auto read = [&asOf](sqlite3_stmt* stmt, const string &after, const function<void(const char*, sqlite3_stmt*)> &row) {
+        sqlite3_bind_text(stmt, 1, asOf.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, after.c_str(), -1, SQLITE_TRANSIENT);
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+            row(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), stmt);
+        sqlite3_reset(stmt);
+        return rc == SQLITE_DONE;
+    };
+    auto count = [&](map<string, TrendRow, NocaseLess> &rows, const char* day, sqlite3_stmt* stmt) {
+        const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        TrendRow &row = rows[name ? name : ""];
+        if (row.name.empty() && name) row.name = name;
+        for (int w = 0; w < TREND_WINDOW_COUNT; ++w)
+            if (strcmp(day, starts[w].c_str()) > 0) row.counts[w] += sqlite3_column_int64(stmt, 2);
+    };
+    auto ranked = [](map<string, TrendRow, NocaseLess> &rows, int window) {
+        vector<TrendRow> list;
+        for (auto &entry : rows) list.push_back(entry.second);
+        stable_sort(list.begin(), list.end(), [window](const TrendRow &a, const TrendRow &b) {
+            return a.counts[window] != b.counts[window] ? a.counts[window] > b.counts[window]
+                                                        : a.counts[longest] > b.counts[longest];
+        });
+        return list;
+    };
+
+    map<string, TrendRow, NocaseLess> byType, byLocation;
+    ok = read(types, starts[TREND_WINDOW_COUNT + longest], [&](const char* day, sqlite3_stmt* stmt) {
+             long long incidents = sqlite3_column_int64(stmt, 2);
+             for (int w = 0; w < TREND_WINDOW_COUNT; ++w) {
+                 if (strcmp(day, starts[w].c_str()) > 0) trends.totals[w] += incidents;
+                 else if (strcmp(day, starts[TREND_WINDOW_COUNT + w].c_str()) > 0) trends.previous[w] += incidents;
+             }
+             if (strcmp(day, starts[longest].c_str()) > 0) count(byType, day, stmt);
+         }) &&
+         read(locations, starts[longest], [&](const char* day, sqlite3_stmt* stmt) { count(byLocation, day, stmt); }) &&
+         read(hours, starts[longest], [&trends](const char*, sqlite3_stmt* stmt) {
+             int hour = sqlite3_column_int(stmt, 1);
+             if (hour >= 0 && hour < 24) trends.hours[hour] += sqlite3_column_int64(stmt, 2);
+         });
+    trends.types = ranked(byType, longest);
+    trends.locations = ranked(byLocation, busiest);
+    if (trends.locations.size() > (size_t)TREND_TOP_LOCATIONS) trends.locations.resize(TREND_TOP_LOCATIONS);
+    return ok;
+}
+
+struct IncidentMonth {
+    string month;                                   // "YYYY-MM"
+    long long total = 0, previousTotal = 0;         // this month and the one before
+    vector<pair<string, long long>> types, locations;
+    string busiestDay;
+    long long busiestDayIncidents = 0;
+};
+
+bool loadIncidentMonth(const function<sqlite3_stmt*(const string &)> &statement, const vector<string> &from,
+                       const string &month, IncidentMonth &report) {
+    report = IncidentMonth();
+    report.month = month;
+    const string inMonth = "day BETWEEN ?1 || '-01' AND ?1 || '-31'";
+    const string previousMonth = "day BETWEEN strftime('%Y-%m-01', ?1 || '-01', '-1 month') AND "
+                                 "strftime('%Y-%m-31', ?1 || '-01', '-1 month')";
+    auto byKey = [&](const IncidentRollup &rollup, const string &source) {
+        return string("SELECT ") + rollup.column + ", sum(incidents) FROM " + source + " WHERE " + inMonth +
+               " GROUP BY 1 ORDER BY 2 DESC, 1;";
+    };
+    sqlite3_stmt* totals = statement("SELECT total(incidents) FILTER (WHERE " + inMonth + "), "
+                                     "total(incidents) FILTER (WHERE " + previousMonth + ") FROM " + from[0] +
+                                     " WHERE day BETWEEN strftime('%Y-%m-01', ?1 || '-01', '-1 month') AND ?1 || '-31';");
+    sqlite3_stmt* busiest = totals ? statement("SELECT day, sum(incidents) FROM " + from[0] + " WHERE " + inMonth +
+                                               " GROUP BY 1 ORDER BY 2 DESC, 1 LIMIT 1;") : nullptr;
+    sqlite3_stmt* types = busiest ? statement(byKey(INCIDENT_ROLLUPS[0], from[0])) : nullptr;
+    sqlite3_stmt* locations = types ? statement(byKey(INCIDENT_ROLLUPS[1], from[1])) : nullptr;
+    if (!locations) return false;
+
+    auto run = [&month](sqlite3_stmt* stmt, const function<void(sqlite3_stmt*)> &row) {
+        sqlite3_bind_text(stmt, 1, month.c_str(), -1, SQLITE_TRANSIENT);
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) row(stmt);
+        sqlite3_reset(stmt);
+        return rc == SQLITE_DONE;
+    };
+    auto collect = [](vector<pair<string, long long>> &rows) {
+        return [&rows](sqlite3_stmt* stmt) {
+            rows.push_back({reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_int64(stmt, 1)});
+        };
+    };
+    return run(totals, [&report](sqlite3_stmt* stmt) {
+               report.total = sqlite3_column_int64(stmt, 0);
+               report.previousTotal = sqlite3_column_int64(stmt, 1);
+           }) &&
+           run(busiest, [&report](sqlite3_stmt* stmt) {
+               report.busiestDay = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+               report.busiestDayIncidents = sqlite3_column_int64(stmt, 1);
+           }) &&
+           run(types, collect(report.types)) &&
+           run(locations, collect(report.locations));
+}
+
+// "+12%", "-5%", or "new" when there was nothing to compare with
+string trendChange(long long now, long long before) {
+    if (before == 0) return now ? "new" : "-";
+    long long percent = llround((now - before) * 100.0 / before);
+    return (percent > 0 ? "+" : "") + to_string(percent) + "%";
+}
+
+string localToday() {
+    time_t now = time(nullptr);
+    char day[11];
+    strftime(day, sizeof(day), "%Y-%m-%d", localtime(&now));
+    return day;
+}
+
+bool renderIncidentTrends(DbContext &ctx, ostream &out, const string &asOf) {
+    IncidentTrends trends;
+    if (!loadIncidentTrends([&ctx](const string &sql) { return readStatement(ctx, sql); }, trendSources(true),
+                            asOf, trends)) {
+        cout << RED << "Failed to read the incident rollups.\n" << RESET;
+        return false;
+    }
+
+    int nameWidth = 24, countWidth = 10;
+    int totalWidth = nameWidth + 2 + (countWidth + 2) * TREND_WINDOW_COUNT;
+    auto rule = [&] { out << "+" << string(totalWidth, '-') << "+\n"; };
+    auto header = [&](const string &first) {
+        rule();
+        out << CYAN << "| " << left << setw(nameWidth) << first;
+        for (int w = 0; w < TREND_WINDOW_COUNT; ++w) out << "| " << setw(countWidth) << to_string(TREND_WINDOWS[w]) + " days";
+        out << "|\n" << RESET;
+        rule();
+    };
+    auto rows = [&](const vector<TrendRow> &list) {
+        for (auto &row : list) {
+            out << "| " << left << setw(nameWidth) << (row.name.empty() ? "(none)" : row.name.substr(0, nameWidth - 1));
+            for (int w = 0; w < TREND_WINDOW_COUNT; ++w) out << "| " << setw(countWidth) << row.counts[w];
+            out << "|\n";
+        }
+        rule();
+    };
+
+    out << GREEN << "\n===== Incident Trends to " << asOf << " =====\n" << RESET;
+    header("Incidents");
+    out << "| " << left << setw(nameWidth) << "Total";
+    for (int w = 0; w < TREND_WINDOW_COUNT; ++w) out << "| " << setw(countWidth) << trends.totals[w];
+    out << "|\n| " << setw(nameWidth) << "Period before";
+    for (int w = 0; w < TREND_WINDOW_COUNT; ++w) out << "| " << setw(countWidth) << trends.previous[w];
+    out << "|\n" << BOLD << "| " << setw(nameWidth) << "Change";
+    for (int w = 0; w < TREND_WINDOW_COUNT; ++w)
+        out << "| " << setw(countWidth) << trendChange(trends.totals[w], trends.previous[w]);
+    out << "|\n" << RESET;
+    rule();
+
+    out << GREEN << "\nBy type\n" << RESET;
+    header("Type");
+    rows(trends.types);
+    out << GREEN << "\nBusiest locations (last 30 days)\n" << RESET;
+    header("Location");
+    rows(trends.locations);
+
+    const int longest = TREND_WINDOWS[TREND_WINDOW_COUNT - 1], barWidth = 40;
+    long long peak = *max_element(trends.hours, trends.hours + 24);
+    out << GREEN << "\nHour of day (last " << longest << " days)\n" << RESET;
+    for (int hour = 0; hour < 24; ++hour) {
+        int bar = peak ? (int)((trends.hours[hour] * barWidth + peak - 1) / peak) : 0;
+        out << setfill('0') << right << setw(2) << hour << ":00 " << setfill(' ') << YELLOW << left
+            << setw(barWidth) << string(bar, '#') << RESET << " " << trends.hours[hour] << "\n";
+    }
+    return true;
+}
+
+bool renderIncidentMonth(DbContext &ctx, ostream &out, const string &month) {
+    IncidentMonth report;
+    if (!loadIncidentMonth([&ctx](const string &sql) { return readStatement(ctx, sql); }, trendSources(true),
+                           month, report)) {
+        cout << RED << "Failed to read the incident rollups.\n" << RESET;
+        return false;
+    }
+
+    int nameWidth = 30, countWidth = 12;
+    int totalWidth = nameWidth + countWidth + 5;
+    auto table = [&](const string &heading, const vector<pair<string, long long>> &rows) {
+        out << "+" << string(totalWidth, '-') << "+\n";
+        out << CYAN << "| " << left << setw(nameWidth) << heading << "| " << setw(countWidth) << "Incidents" << "|\n"
+            << RESET;
+        out << "+" << string(totalWidth, '-') << "+\n";
+        for (auto &row : rows)
+            out << "| " << left << setw(nameWidth) << (row.first.empty() ? "(none)" : row.first.substr(0, nameWidth - 1))
+                << "| " << setw(countWidth) << row.second << "|\n";
+        out << "+" << string(totalWidth, '-') << "+\n";
+    };
+
+    out << GREEN << "\n===== Incident Report for " << month << " =====\n" << RESET;
+    out << "Incidents      : " << report.total << " (" << trendChange(report.total, report.previousTotal)
+        << " on the month before, " << report.previousTotal << ")\n";
+    if (!report.busiestDay.empty())
+        out << "Busiest day    : " << report.busiestDay << " (" << report.busiestDayIncidents << ")\n";
+    out << "\n";
+    table("Type", report.types);
+    out << "\n";
+    table("Location", report.locations);
+    return true;
+}
+
+// "YYYY-MM-DD", or "" for today
+void incidentTrends(DbContext &ctx, string asOf = "") {
+    long long unused;
+    if (asOf.empty()) asOf = localToday();
+    else if (!parseWallClock(asOf, "00:00", unused)) {
+        cout << RED << "Not a valid date; use e.g. 2024-03-15.\n" << RESET;
+        return;
+    }
+    if (!writeReport(ctx, [&asOf](DbContext &c, ostream &out) { return renderIncidentTrends(c, out, asOf); }))
+        cout << RED << "\nCould not show the incident trends.\n" << RESET;
+}
+
+void incidentMonthReport(DbContext &ctx, const string &month, const string &file = "") {
+    long long unused;
+    if (!parseWallClock(month + "-01", "00:00", unused)) {
+        cout << RED << "Not a valid month; use e.g. 2024-03.\n" << RESET;
+        return;
+    }
+    if (!writeReport(ctx, [&month](DbContext &c, ostream &out) { return renderIncidentMonth(c, out, month); }, file))
+        cout << RED << "\nCould not build the monthly incident report.\n" << RESET;
+    else if (!file.empty())
+        cout << GREEN << "Monthly report written to " << file << "\n" << RESET;
+}
+
+void incidentTrendsMenu(DbContext &ctx) {
+    char option;
+    cout << "\n[1] Trends  [2] Monthly Report\n"
+         << "Choice: ";
+    cin >> option;
+    clearInput();
+    if (option == '2') {
+        string month;
+        cout << "Month (YYYY-MM): ";
+        getline(cin, month);
+        incidentMonthReport(ctx, month);
+    } else {
+        incidentTrends(ctx);
+    }
+}
+
+// ------------------------
+// INCIDENT BITMAP INDEX
+// ------------------------
+// For drilling down into incidents by type, location and month: each distinct
+// value of the three holds the rowids of its incidents as a compressed
+// (roaring) bitmap in memory. A filter is an OR of the values chosen in each
+// dimension and an AND across them, so counting "theft in Purok 3 during June"
+// costs a few thousand word operations however large the table is, and
+// showing those incidents is a fetch by rowid. Loaded at startup; from then on
+// temporary triggers on the writer connection report every incident written,
+// applied once the transaction commits, as for the name index. The incidents
+// table has no status column, so there is no status dimension.
+//
+// A bitmap splits each rowid into its high and low 16 bits. Every high half
+// in use has a container of low halves: a sorted array while it holds up to
+// ROARING_ARRAY_MAX of them (2 bytes each), a 65536-bit bitmap beyond that
+// (8 KiB). Rowids must fit in 32 bits; an index that meets a larger one turns
+// itself off.
+const uint32_t ROARING_ARRAY_MAX = 4096;
+const uint32_t ROARING_WORDS = 1024;
+const size_t INCIDENT_DRILL_ROWS = 20;
+const size_t INCIDENT_DRILL_VALUES = 40;
+const char* INCIDENT_DIMENSION_NAMES[INCIDENT_DIMENSIONS] = {"type", "location", "month"};
+
+struct Roaring {
+    struct Container {
+        uint16_t key = 0;           // the high 16 bits
+        uint32_t count = 0;
+        vector<uint16_t> array;     // sorted low halves, while count <= ROARING_ARRAY_MAX
+        vector<uint64_t> bits;      // ROARING_WORDS words otherwise
+    };
+    vector<Container> containers;   // sorted by key
+};
+
+// Bits set in a word, summed in pairs, nibbles, then bytes; compilers turn this
+// into one popcnt instruction where the target has it
+inline uint32_t popcount64(uint64_t word) {
+    word -= (word >> 1) & 0x5555555555555555ULL;
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (uint32_t)((word * 0x0101010101010101ULL) >> 56);
+}
+
+// Index of the lowest set bit of a non-zero word
+inline uint32_t lowestBit(uint64_t word) {
+    return popcount64((word & (~word + 1)) - 1);
+}
+
+void containerToBitmap(Roaring::Container &c) {
+    c.bits.assign(ROARING_WORDS, 0);
+    for (uint16_t low : c.array) c.bits[low >> 6] |= 1ULL << (low & 63);
+    vector<uint16_t>().swap(c.array);
+}
+
+void containerToArray(Roaring::Container &c) {
+    c.array.clear();
+    c.array.reserve(c.count);
+    for (uint32_t w = 0; w < ROARING_WORDS; ++w)
+        for (uint64_t word = c.bits[w]; word; word &= word - 1)
+            c.array.push_back((uint16_t)(w * 64 + lowestBit(word)));
+    vector<uint64_t>().swap(c.bits);
+}
+
+// Settles a freshly computed container into the cheaper of the two forms
+void settleContainer(Roaring::Container &c) {
+    if (!c.bits.empty() && c.count <= ROARING_ARRAY_MAX) containerToArray(c);
+    else if (c.bits.empty() && c.count > ROARING_ARRAY_MAX) containerToBitmap(c);
+}
+
+vector<Roaring::Container>::iterator findContainer(Roaring &r, uint16_t key) {
+    return lower_bound(r.containers.begin(), r.containers.end(), key,
+                       [](const Roaring::Container &c, uint16_t k) { return c.key < k; });
+}
+
+// Rowids usually arrive in increasing order, so the last container is tried first
+void roaringAdd(Roaring &r, uint32_t value) {
+    uint16_t key = (uint16_t)(value >> 16), low = (uint16_t)value;
+    auto at = !r.containers.empty() && r.containers.back().key == key ? r.containers.end() - 1 : findContainer(r, key);
+    if (at == r.containers.end() || at->key != key) {
+        at = r.containers.insert(at, Roaring::Container());
+        at->key = key;
+    }
+    Roaring::Container &c = *at;
+    if (!c.bits.empty()) {
+        uint64_t &word = c.bits[low >> 6], bit = 1ULL << (low & 63);
+        c.count += !(word & bit);
+        word |= bit;
+        return;
+    }
+    if (c.array.empty() || c.array.back() < low) {
+        c.array.push_back(low);
+    } else {
+        auto slot = lower_bound(c.array.begin(), c.array.end(), low);
+        if (*slot == low) return;
+        c.array.insert(slot, low);
+    }
+    if (++c.count > ROARING_ARRAY_MAX) containerToBitmap(c);
+}
+
+void roaringRemove(Roaring &r, uint32_t value) {
+    uint16_t key = (uint16_t)(value >> 16), low = (uint16_t)value;
+    auto at = findContainer(r, key);
+    if (at == r.containers.end() || at->key != key) return;
+    Roaring::Container &c = *at;
+    if (!c.bits.empty()) {
+        uint64_t &word = c.bits[low >> 6], bit = 1ULL << (low & 63);
+        if (!(word & bit)) return;
+        word &= ~bit;
+        if (--c.count <= ROARING_ARRAY_MAX) containerToArray(c);
+    } else {
+        auto slot = lower_bound(c.array.begin(), c.array.end(), low);
+        if (slot == c.array.end() || *slot != low) return;
+        c.array.erase(slot);
+        --c.count;
+    }
+    if (c.count == 0) r.containers.erase(at);
+}
+
+uint64_t roaringCount(const Roaring &r) {
+    uint64_t count = 0;
+    for (auto &c : r.containers) count += c.count;
+    return count;
+}
+
+// a AND b for one pair of containers with the same key. With `out` null only
+// the count is computed.
+uint32_t andContainers(const Roaring::Container &a, const Roaring::Container &b, Roaring::Container* out) {
+    uint32_t count = 0;
+    if (!a.bits.empty() && !b.bits.empty()) {
+        if (out) {
+            out->bits.resize(ROARING_WORDS);
+            for (uint32_t w = 0; w < ROARING_WORDS; ++w) count += popcount64(out->bits[w] = a.bits[w] & b.bits[w]);
+        } else {
+            for (uint32_t w = 0; w < ROARING_WORDS; ++w) count += popcount64(a.bits[w] & b.bits[w]);
+        }
+    } else if (!a.bits.empty() || !b.bits.empty()) {
+        const Roaring::Container &array = a.bits.empty() ? a : b, &bitmap = a.bits.empty() ? b : a;
+        for (uint16_t low : array.array)
+            if (bitmap.bits[low >> 6] >> (low & 63) & 1) {
+                ++count;
+                if (out) out->array.push_back(low);
+            }
+    } else {
+        // Merge; when one side is much shorter, skip through the other by binary search
+        const vector<uint16_t> &small = a.count <= b.count ? a.array : b.array;
+        const vector<uint16_t> &large = a.count <= b.count ? b.array : a.array;
+        auto from = large.begin();
+        bool gallop = small.size() * 32 < large.size();
+        for (uint16_t low : small) {
+            from = gallop ? lower_bound(from, large.end(), low) : find_if(from, large.end(), [low](uint16_t x) { return x >= low; });
+            if (from == large.end()) break;
+            if (*from == low) {
+                ++count;
+                if (out) out->array.push_back(low);
+            }
+        }
+    }
+    if (out) {
+        out->key = a.key;
+        out->count = count;
+        settleContainer(*out);
+    }
+    return count;
+}
+
+void orContainers(const Roaring::Container &a, const Roaring::Container &b, Roaring::Container &out) {
+    out.key = a.key;
+    if (a.bits.empty() && b.bits.empty()) {
+        out.array.reserve(a.array.size() + b.array.size());
+        set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), back_inserter(out.array));
+        out.count = (uint32_t)out.array.size();
+    } else {
+        const Roaring::Container &bitmap = !a.bits.empty() ? a : b, &other = !a.bits.empty() ? b : a;
+        out.count = 0;
+        if (!other.bits.empty()) {
+            out.bits.resize(ROARING_WORDS);
+            for (uint32_t w = 0; w < ROARING_WORDS; ++w) out.count += popcount64(out.bits[w] = bitmap.bits[w] | other.bits[w]);
+        } else {
+            out.bits = bitmap.bits;
+            out.count = bitmap.count;
+            for (uint16_t low : other.array) {
+                uint64_t &word = out.bits[low >> 6], bit = 1ULL << (low & 63);
+                out.count += !(word & bit);
+                word |= bit;
+            }
+        }
+    }
+    settleContainer(out);
+}
+
+// Walks the containers of a and b with matching keys
+template <typename Both>
+void matchContainers(const Roaring &a, const Roaring &b, Both both) {
+    auto x = a.containers.begin(), y = b.containers.begin();
+    while (x != a.containers.end() && y != b.containers.end()) {
+        if (x->key < y->key) ++x;
+        else if (y->key < x->key) ++y;
+        else both(*x++, *y++);
+    }
+}
+
+Roaring roaringAnd(const Roaring &a, const Roaring &b) {
+    Roaring result;
+    matchContainers(a, b, [&result](const Roaring::Container &x, const Roaring::Container &y) {
+        Roaring::Container c;
+        if (andContainers(x, y, &c)) result.containers.push_back(move(c));
+    });
+    return result;
+}
+
+uint64_t roaringAndCount(const Roaring &a, const Roaring &b) {
+    uint64_t count = 0;
+    matchContainers(a, b, [&count](const Roaring::Container &x, const Roaring::Container &y) {
+        count += andContainers(x, y, nullptr);
+    });
+    return count;
+}
+
+// a OR b; with `keys` (sorted) only the containers with those keys
+Roaring roaringOr(const Roaring &a, const Roaring &b, const vector<uint16_t>* keys = nullptr) {
+    Roaring result;
+    auto wanted = [keys](uint16_t key) { return !keys || binary_search(keys->begin(), keys->end(), key); };
+    auto x = a.containers.begin(), y = b.containers.begin();
+    while (x != a.containers.end() || y != b.containers.end()) {
+        if (y == b.containers.end() || (x != a.containers.end() && x->key < y->key)) {
+            if (wanted(x->key)) result.containers.push_back(*x);
+            ++x;
+        } else if (x == a.containers.end() || y->key < x->key) {
+            if (wanted(y->key)) result.containers.push_back(*y);
+            ++y;
+        } else {
+            if (wanted(x->key)) {
+                result.containers.emplace_back();
+                orContainers(*x, *y, result.containers.back());
+            }
+            ++x, ++y;
+        }
+    }
+    return result;
+}
+
+// Up to `limit` values, largest first
+vector<uint32_t> roaringLast(const Roaring &r, size_t limit) {
+    vector<uint32_t> values;
+    for (auto c = r.containers.rbegin(); c != r.containers.rend() && values.size() < limit; ++c) {
+        uint32_t high = (uint32_t)c->key << 16;
+        if (c->bits.empty()) {
+            for (auto low = c->array.rbegin(); low != c->array.rend() && values.size() < limit; ++low)
+                values.push_back(high | *low);
+            continue;
+        }
+        for (int w = ROARING_WORDS - 1; w >= 0 && values.size() < limit; --w)
+            for (uint64_t word = c->bits[w]; word && values.size() < limit;) {
+                int top = 63;
+                while (!(word >> top & 1)) --top;
+                values.push_back(high | (uint32_t)(w * 64 + top));
+                word &= ~(1ULL << top);
+            }
+    }
+    return values;
+}
+
+size_t roaringBytes(const Roaring &r) {
+    size_t bytes = sizeof(Roaring) + r.containers.capacity() * sizeof(Roaring::Container);
+    for (auto &c : r.containers) bytes += c.array.capacity() * sizeof(uint16_t) + c.bits.capacity() * sizeof(uint64_t);
+    return bytes;
+}
+
+void shrinkRoaring(Roaring &r) {
+    r.containers.shrink_to_fit();
+    for (auto &c : r.containers) c.array.shrink_to_fit();
+}
+
+struct IncidentBitmaps {
+    mutex lock;
+    bool loaded = false;
+    Roaring all;
+    map<string, Roaring, NocaseLess> values[INCIDENT_DIMENSIONS];   // type, location, month ("" for none)
+};
+
+IncidentBitmaps incidentBitmaps;
+
+// Values chosen per dimension; none chosen matches every incident
+struct DrillFilter {
+    vector<string> values[INCIDENT_DIMENSIONS];
+};
+
+bool addIndexedIncident(IncidentBitmaps &index, sqlite3_int64 rowid, const string (&values)[INCIDENT_DIMENSIONS]) {
+    if (rowid < 0 || rowid > (sqlite3_int64)UINT32_MAX) return false;
+    roaringAdd(index.all, (uint32_t)rowid);
+    for (int d = 0; d < INCIDENT_DIMENSIONS; ++d) roaringAdd(index.values[d][values[d]], (uint32_t)rowid);
+    return true;
+}
+
+void removeIndexedIncident(IncidentBitmaps &index, sqlite3_int64 rowid, const string (&values)[INCIDENT_DIMENSIONS]) {
+    if (rowid < 0 || rowid > (sqlite3_int64)UINT32_MAX) return;
+    roaringRemove(index.all, (uint32_t)rowid);
+    for (int d = 0; d < INCIDENT_DIMENSIONS; ++d) {
+        auto value = index.values[d].find(values[d]);
+        if (value == index.values[d].end()) continue;
+        roaringRemove(value->second, (uint32_t)rowid);
+        if (value->second.containers.empty()) index.values[d].erase(value);
+    }
+}
+
+void applyIncidentChanges(IncidentBitmaps &index, vector<IncidentChange> &changes) {
+    lock_guard<mutex> lock(index.lock);
+    for (auto &change : changes) {
+        if (change.hasOld) removeIndexedIncident(index, change.oldRowid, change.oldValues);
+        if (change.hasNew && !addIndexedIncident(index, change.newRowid, change.newValues)) index.loaded = false;
+    }
+}
+
+// incident_changed(old id, type, location, month, new id, type, location,
+// month), called by the triggers below; NULL ids for no row
+void onIncidentChanged(sqlite3_context* fn, int, sqlite3_value** args) {
+    IncidentChange change;
+    auto text = [args](int i) {
+        const unsigned char* value = sqlite3_value_text(args[i]);
+        return value ? string(reinterpret_cast<const char*>(value)) : string();
+    };
+    if ((change.hasOld = sqlite3_value_type(args[0]) != SQLITE_NULL)) {
+        change.oldRowid = sqlite3_value_int64(args[0]);
+        for (int d = 0; d < INCIDENT_DIMENSIONS; ++d) change.oldValues[d] = text(1 + d);
+    }
+    if ((change.hasNew = sqlite3_value_type(args[4]) != SQLITE_NULL)) {
+        change.newRowid = sqlite3_value_int64(args[4]);
+        for (int d = 0; d < INCIDENT_DIMENSIONS; ++d) change.newValues[d] = text(5 + d);
+    }
+    static_cast<ChangeCapture*>(sqlite3_user_data(fn))->pendingIncidents.push_back(move(change));
+    sqlite3_result_null(fn);
+}
+
+const char* INCIDENT_BITMAP_TRIGGERS = R"(
+    CREATE TEMP TRIGGER IF NOT EXISTS incidents_bitmaps_insert AFTER INSERT ON main.incidents BEGIN
+        SELECT incident_changed(NULL, NULL, NULL, NULL, new.id, new.type, new.location,
+                                strftime('%Y-%m', new.occurred_at, 'unixepoch', 'localtime'));
+    END;
+    CREATE TEMP TRIGGER IF NOT EXISTS incidents_bitmaps_update
+    AFTER UPDATE OF id, type, location, occurred_at ON main.incidents BEGIN
+        SELECT incident_changed(old.id, old.type, old.location,
+                                strftime('%Y-%m', old.occurred_at, 'unixepoch', 'localtime'),
+                                new.id, new.type, new.location,
+                                strftime('%Y-%m', new.occurred_at, 'unixepoch', 'localtime'));
+    END;
+    CREATE TEMP TRIGGER IF NOT EXISTS incidents_bitmaps_delete AFTER DELETE ON main.incidents BEGIN
+        SELECT incident_changed(old.id, old.type, old.location,
+                                strftime('%Y-%m', old.occurred_at, 'unixepoch', 'localtime'),
+                                NULL, NULL, NULL, NULL);
+    END;
+)";
+
+const char* SQL_INCIDENT_DIMENSIONS =
+    "SELECT id, type, location, strftime('%Y-%m', occurred_at, 'unixepoch', 'localtime') FROM incidents;";
+
+// Fills an empty index from one statement over SQL_INCIDENT_DIMENSIONS
+bool loadIncidentBitmaps(IncidentBitmaps &index, sqlite3_stmt* stmt) {
+    string values[INCIDENT_DIMENSIONS];
+    bool ok = true;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && ok) {
+        for (int d = 0; d < INCIDENT_DIMENSIONS; ++d) {
+            const unsigned char* value = sqlite3_column_text(stmt, 1 + d);
+            values[d] = value ? reinterpret_cast<const char*>(value) : "";
+        }
+        ok = addIndexedIncident(index, sqlite3_column_int64(stmt, 0), values);
+    }
+    sqlite3_reset(stmt);
+    shrinkRoaring(index.all);
+    for (auto &dimension : index.values)
+        for (auto &value : dimension) shrinkRoaring(value.second);
+    index.loaded = ok && rc == SQLITE_DONE;
+    return index.loaded;
+}
+
+// Hooks the writer first, so no write can fall between the load and the hooks
+bool startIncidentBitmaps(DbContext &ctx, IncidentBitmaps &index) {
+    ChangeCapture* capture = ctx.writer.capture;
+    IncidentBitmaps* target = &index;
+    auto hooked = submitWrite(ctx.writer, [capture, target](sqlite3* conn, bool &ok) {
+        capture->applyIncidents = [target](vector<IncidentChange> &changes) { applyIncidentChanges(*target, changes); };
+        ok = sqlite3_create_function(conn, "incident_changed", 8, SQLITE_UTF8, capture, onIncidentChanged,
+                                     nullptr, nullptr) == SQLITE_OK &&
+             sqlite3_exec(conn, INCIDENT_BITMAP_TRIGGERS, nullptr, nullptr, nullptr) == SQLITE_OK;
+        return ok;
+    }, false);
+    if (!hooked.get()) return false;
+
+    sqlite3_stmt* stmt = readStatement(ctx, SQL_INCIDENT_DIMENSIONS);
+    if (!stmt) return false;
+    lock_guard<mutex> lock(index.lock);
+    return loadIncidentBitmaps(index, stmt);
+}
+
+size_t incidentBitmapBytes(const IncidentBitmaps &index) {
+    size_t bytes = roaringBytes(index.all);
+    for (auto &dimension : index.values)
+        for (auto &value : dimension) bytes += value.first.capacity() + 64 + roaringBytes(value.second);
+    return bytes;
+}
+
+// The OR of the chosen values of each constrained dimension except `skip`.
+// Unknown values match nothing. An OR only keeps the high halves every
+// constrained dimension has, as no other can survive the AND. Call with
+// index.lock held.
+vector<const Roaring*> filterSets(IncidentBitmaps &index, const DrillFilter &filter, vector<Roaring> &owned,
+                                  int skip = -1) {
+    static const Roaring none;
+    vector<vector<const Roaring*>> chosen;
+    for (int d = 0; d < INCIDENT_DIMENSIONS; ++d) {
+        if (d == skip || filter.values[d].empty()) continue;
+        chosen.emplace_back();
+        for (auto &name : filter.values[d]) {
+            auto value = index.values[d].find(name);
+            if (value != index.values[d].end()) chosen.back().push_back(&value->second);
+        }
+    }
+
+    vector<uint16_t> keys;
+    for (size_t i = 0; i < chosen.size(); ++i) {
+        vector<uint16_t> any;
+        for (const Roaring* set : chosen[i])
+            for (auto &c : set->containers) any.push_back(c.key);
+        sort(any.begin(), any.end());
+        any.erase(unique(any.begin(), any.end()), any.end());
+        if (i == 0) keys = move(any);
+        else {
+            vector<uint16_t> both;
+            set_intersection(keys.begin(), keys.end(), any.begin(), any.end(), back_inserter(both));
+            keys = move(both);
+        }
+    }
+
+    owned.reserve(owned.size() + chosen.size());    // the pointers below stay valid
+    vector<const Roaring*> sets;
+    for (auto &values : chosen) {
+        if (values.size() <= 1) {
+            sets.push_back(values.empty() ? &none : values[0]);
+            continue;
+        }
+        Roaring merged = roaringOr(*values[0], *values[1], &keys);
+        for (size_t i = 2; i < values.size(); ++i) merged = roaringOr(merged, *values[i], &keys);
+        owned.push_back(move(merged));
+        sets.push_back(&owned.back());
+    }
+    // Smallest first: every AND is then at most that size
+    sort(sets.begin(), sets.end(), [](const Roaring* a, const Roaring* b) { return roaringCount(*a) < roaringCount(*b); });
+    return sets;
+}
+
+// The incidents matching a filter; with `matches` null only their count
+uint64_t matchIncidents(IncidentBitmaps &index, const DrillFilter &filter, Roaring* matches = nullptr,
+                        int skip = -1) {
+    vector<Roaring> owned;
+    vector<const Roaring*> sets = filterSets(index, filter, owned, skip);
+    if (sets.empty()) sets.push_back(&index.all);
+    if (sets.size() == 1) {
+        if (matches) *matches = *sets[0];
+        return roaringCount(*sets[0]);
+    }
+    const Roaring* joined = sets[0];
+    Roaring partial;
+    for (size_t i = 1; i + 1 < sets.size(); ++i) {
+        partial = roaringAnd(*joined, *sets[i]);
+        joined = &partial;
+    }
+    if (!matches) return roaringAndCount(*joined, *sets.back());
+    *matches = roaringAnd(*joined, *sets.back());
+    return roaringCount(*matches);
+}
+
+// Each value of one dimension with its count among the incidents matching the
+// other dimensions' choices (a facet count): what choosing it would leave
+vector<pair<string, uint64_t>> incidentFacets(IncidentBitmaps &index, const DrillFilter &filter, int dimension) {
+    Roaring others;
+    bool constrained = false;
+    for (int d = 0; d < INCIDENT_DIMENSIONS; ++d) constrained = constrained || (d != dimension && !filter.values[d].empty());
+    if (constrained) matchIncidents(index, filter, &others, dimension);
+
+    vector<pair<string, uint64_t>> facets;
+    for (auto &value : index.values[dimension]) {
+        uint64_t count = constrained ? roaringAndCount(others, value.second) : roaringCount(value.second);
+        if (count) facets.push_back({value.first, count});
+    }
+    // Months in order, newest first; the rest by count
+    if (dimension == 2)
+        sort(facets.begin(), facets.end(), [](const pair<string, uint64_t> &a, const pair<string, uint64_t> &b) {
+            return a.first > b.first;
+        });
+    else
+        stable_sort(facets.begin(), facets.end(), [](const pair<string, uint64_t> &a, const pair<string, uint64_t> &b) {
+            return a.second > b.second;
+        });
+    return facets;
+}
+
+string describeFilter(const DrillFilter &filter, int dimension) {
+    if (filter.values[dimension].empty()) return "any";
+    string text;
+    for (auto &value : filter.values[dimension]) text += (text.empty() ? "" : ", ") + (value.empty() ? "(none)" : value);
+    return text;
+}
+
+// The newest INCIDENT_DRILL_ROWS incidents of a set, fetched by rowid
+bool renderIncidentsById(DbContext &ctx, ostream &out, const vector<uint32_t> &rowids) {
+    string ids = "[";
+    for (size_t i = 0; i < rowids.size(); ++i) ids += (i ? "," : "") + to_string(rowids[i]);
+    ids += "]";
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT " + INCIDENT_COLUMNS + " FROM incidents "
+                                            "WHERE id IN (SELECT value FROM json_each(?1)) ORDER BY id DESC;");
+    if (!stmt) {
+        cout << RED << "Failed to fetch incidents.\n" << RESET;
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, ids.c_str(), -1, SQLITE_TRANSIENT);
+    return renderIncidentRows(stmt, out);
+}
+
+void showDrillMatches(DbContext &ctx, IncidentBitmaps &index, const DrillFilter &filter) {
+    Roaring matches;
+    uint64_t count;
+    vector<uint32_t> newest;
+    {
+        lock_guard<mutex> lock(index.lock);
+        count = matchIncidents(index, filter, &matches);
+        newest = roaringLast(matches, INCIDENT_DRILL_ROWS);
+    }
+    cout << GREEN << "\n===== Incidents Matching (" << count << ") =====\n" << RESET;
+    if (count > newest.size()) cout << "The newest " << newest.size() << ":\n";
+    if (!writeReport(ctx, [&newest](DbContext &c, ostream &out) { return renderIncidentsById(c, out, newest); }))
+        cout << RED << "\nCould not show the incidents.\n" << RESET;
+}
+
+// Counts the matches of a filter and how long that took
+uint64_t countDrillMatches(IncidentBitmaps &index, const DrillFilter &filter, double &us) {
+    auto start = chrono::steady_clock::now();
+    lock_guard<mutex> lock(index.lock);
+    uint64_t count = matchIncidents(index, filter);
+    us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    return count;
+}
+
+void incidentDrillDown(DbContext &ctx, IncidentBitmaps &index) {
+    if (!index.loaded) {
+        cout << RED << "\nThe incident bitmap index is unavailable.\n" << RESET;
+        return;
+    }
+    DrillFilter filter;
+    while (true) {
+        double us;
+        uint64_t count = countDrillMatches(index, filter, us), total;
+        {
+            lock_guard<mutex> lock(index.lock);
+            total = roaringCount(index.all);
+        }
+        cout << GREEN << "\n===== Incident Drill-Down =====\n" << RESET
+             << "Matching " << BOLD << count << RESET << " of " << total << " incidents (counted in "
+             << fixed << setprecision(1) << us << " us)\n" << defaultfloat;
+        for (int d = 0; d < INCIDENT_DIMENSIONS; ++d)
+            cout << "  " << left << setw(9) << INCIDENT_DIMENSION_NAMES[d] << ": " << describeFilter(filter, d) << "\n";
+        cout << right << "\n[1] Type  [2] Location  [3] Month  [4] Show Incidents  [5] Clear  [0] Back\n"
+             << "Choice: ";
+        char option;
+        cin >> option;
+        if (!cin || option == '0') return;
+        if (option == '4') {
+            showDrillMatches(ctx, index, filter);
+            continue;
+        }
+        if (option == '5') {
+            filter = DrillFilter();
+            continue;
+        }
+        int dimension = option - '1';
+        if (dimension < 0 || dimension >= INCIDENT_DIMENSIONS) continue;
+
+        vector<pair<string, uint64_t>> facets;
+        {
+            lock_guard<mutex> lock(index.lock);
+            facets = incidentFacets(index, filter, dimension);
+        }
+        size_t shown = min(facets.size(), INCIDENT_DRILL_VALUES);
+        cout << CYAN << "\n" << INCIDENT_DIMENSION_NAMES[dimension] << " (incidents with the other choices)\n" << RESET;
+        for (size_t i = 0; i < shown; ++i)
+            cout << "  " << right << setw(3) << i + 1 << "  " << left << setw(30)
+                 << (facets[i].first.empty() ? "(none)" : facets[i].first.substr(0, 29)) << facets[i].second << "\n";
+        if (facets.size() > shown) cout << "  ... " << facets.size() - shown << " more\n";
+        cout << right << "Numbers to keep, separated by spaces (blank for any): ";
+        clearInput();
+        string line;
+        getline(cin, line);
+        istringstream picks(line);
+        vector<string> chosen;
+        for (size_t pick; picks >> pick;)
+            if (pick >= 1 && pick <= shown) chosen.push_back(facets[pick - 1].first);
+        filter.values[dimension] = chosen;
+    }
+}
+
+// ------------------------
+// ANNOUNCEMENTS
+// ------------------------
+bool renderAnnouncementsTable(DbContext &ctx, ostream &out) {
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT title, date, content FROM announcements;");
+    if (!stmt) {
+        cout << RED << "Failed to fetch announcements.\n" << RESET;
+        return false;
+    }
+
+    int titleWidth = 25, dateWidth = 12, contentWidth = 40;
+    int totalWidth = titleWidth + dateWidth + contentWidth + 7;
+
+    // Table header
+    out << "+" << string(totalWidth - 2, '-') << "+\n";
+    out << CYAN
+        << "| " << left << setw(titleWidth) << "Title"
+        << "| " << setw(dateWidth) << "Date"
+        << "| " << setw(contentWidth) << "Content"
+        << "|\n" << RESET;
+    out << "+" << string(totalWidth - 2, '-') << "+\n";
+
+    auto wrapText = [](const string &text, int width) -> vector<string> {
+        vector<string> lines;
+        size_t start = 0;
+        while (start < text.length()) {
+            lines.push_back(text.substr(start, width));
+            start += width;
+        }
+        return lines;
+    };
+
+    // Table rows
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        string title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        string content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+
+        vector<string> titleLines = wrapText(title, titleWidth);
+        vector<string> dateLines = wrapText(date, dateWidth);
+        vector<string> contentLines = wrapText(content, contentWidth);
+
+        size_t maxLines = max({titleLines.size(), dateLines.size(), contentLines.size()});
+
+        for (size_t i = 0; i < maxLines; ++i) {
+            out << "| "
+                << left << setw(titleWidth) << (i < titleLines.size() ? titleLines[i] : "")
+                << "| " << setw(dateWidth) << (i < dateLines.size() ? dateLines[i] : "")
+                << "| " << setw(contentWidth) << (i < contentLines.size() ? contentLines[i] : "")
+                << "|\n";
+        }
+
+        out << "+" << string(totalWidth - 2, '-') << "+\n";
+    }
+
+    sqlite3_reset(stmt);
+    return true;
+}
+
+void displayAnnouncementsTable(DbContext &ctx) {
+    writeReport(ctx, renderAnnouncementsTable);
+}
+
+void addAnnouncement(DbContext &ctx) {
+    EntryBatch batch;
+    batch.noun = "announcement";
+    batch.insertSql = "INSERT INTO announcements (title, date, content) VALUES (?,?,?);";
+    batch.headers = {"Title", "Date", "Content"};
+
+    char more = 'Y';
+    while (toupper(more) == 'Y') {
+        string title, date, content;
+        clearInput();
+        cout << "Enter Title: ";
+        getline(cin, title);
+        cout << "Enter Date (YYYY-MM-DD): ";
+        getline(cin, date);
+        cout << "Enter Content: ";
+        getline(cin, content);
+
+        batch.rows.push_back({{title, date, content}, [title, date, content](sqlite3_stmt* stmt) {
+            sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, date.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, content.c_str(), -1, SQLITE_TRANSIENT);
+        }});
+        printPendingRows(batch);
+
+        cout << "\nAdd another announcement? (Y/N): ";
+        cin >> more;
+    }
+    finishBatch(ctx, batch);
+
+    cout << GREEN << "\n===== Updated Announcements =====\n" << RESET;
+    displayAnnouncementsTable(ctx);
+}
+
+// ------------------------
+// FULL-TEXT SEARCH
+// ------------------------
+// FTS5 indexes over incident descriptions and announcement titles and content.
+// They are external-content tables: the text lives only in incidents and
+// announcements, and the triggers below keep the indexes in step with every
+// insert, update and delete made through any connection.
+const char* FULL_TEXT_SCHEMA = R"(
+    CREATE VIRTUAL TABLE IF NOT EXISTS incidents_fts USING fts5(
+        description, content='incidents', content_rowid='id',
+        tokenize='unicode61 remove_diacritics 2', prefix='2 3');
+    CREATE TRIGGER IF NOT EXISTS incidents_fts_insert AFTER INSERT ON incidents BEGIN
+        INSERT INTO incidents_fts(rowid, description) VALUES (new.id, new.description);
+    END;
+    CREATE TRIGGER IF NOT EXISTS incidents_fts_delete AFTER DELETE ON incidents BEGIN
+        INSERT INTO incidents_fts(incidents_fts, rowid, description) VALUES ('delete', old.id, old.description);
+    END;
+    CREATE TRIGGER IF NOT EXISTS incidents_fts_update AFTER UPDATE OF description ON incidents BEGIN
+        INSERT INTO incidents_fts(incidents_fts, rowid, description) VALUES ('delete', old.id, old.description);
+        INSERT INTO incidents_fts(rowid, description) VALUES (new.id, new.description);
+    END;
+
+    CREATE VIRTUAL TABLE IF NOT EXISTS announcements_fts USING fts5(
+        title, content, content='announcements', content_rowid='id',
+        tokenize='unicode61 remove_diacritics 2', prefix='2 3');
+    CREATE TRIGGER IF NOT EXISTS announcements_fts_insert AFTER INSERT ON announcements BEGIN
+        INSERT INTO announcements_fts(rowid, title, content) VALUES (new.id, new.title, new.content);
+    END;
+    CREATE TRIGGER IF NOT EXISTS announcements_fts_delete AFTER DELETE ON announcements BEGIN
+        INSERT INTO announcements_fts(announcements_fts, rowid, title, content)
+        VALUES ('delete', old.id, old.title, old.content);
+    END;
+    CREATE TRIGGER IF NOT EXISTS announcements_fts_update AFTER UPDATE OF title, content ON announcements BEGIN
+        INSERT INTO announcements_fts(announcements_fts, rowid, title, content)
+        VALUES ('delete', old.id, old.title, old.content);
+        INSERT INTO announcements_fts(rowid, title, content) VALUES (new.id, new.title, new.content);
+    END;
+)";
+
+const int FTS_MAX_RESULTS = 20;
+const int FTS_SNIPPET_TOKENS = 16;
+
+// Creates the indexes and triggers (with the resident name trigrams and
+// sounds); indexes
+// that did not exist yet are built from the rows already in the tables
+bool setupFullText(DbContext &ctx) {
+    auto ready = submitWrite(ctx.writer, [](sqlite3* conn, bool &ok) {
+        const vector<pair<string, string>> indexes = {
+            {"incidents_fts", "INSERT INTO incidents_fts(incidents_fts) VALUES ('rebuild');"},
+            {"announcements_fts", "INSERT INTO announcements_fts(announcements_fts) VALUES ('rebuild');"},
+            {"residents_trigrams", residentTrigramFill()},
+            {"residents_sounds", "INSERT INTO residents_sounds(residents_sounds) VALUES ('rebuild');"},
+        };
+        sqlite3_stmt* existing;
+        if (sqlite3_prepare_v2(conn, "SELECT 1 FROM sqlite_schema WHERE name = ?;", -1, &existing, nullptr) != SQLITE_OK)
+            return false;
+        vector<string> fills;
+        for (auto &index : indexes) {
+            sqlite3_bind_text(existing, 1, index.first.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(existing) != SQLITE_ROW) fills.push_back(index.second);
+            sqlite3_reset(existing);
+        }
+        sqlite3_finalize(existing);
+
+        ok = sqlite3_exec(conn, FULL_TEXT_SCHEMA, nullptr, nullptr, nullptr) == SQLITE_OK &&
+             sqlite3_exec(conn, residentTrigramSchema().c_str(), nullptr, nullptr, nullptr) == SQLITE_OK &&
+             sqlite3_exec(conn, RESIDENT_SOUND_SCHEMA, nullptr, nullptr, nullptr) == SQLITE_OK;
+        for (size_t i = 0; i < fills.size() && ok; ++i)
+            ok = sqlite3_exec(conn, fills[i].c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+        return ok;
+    }, false);
+    return ready.get();
+}
+
+// Turns what was typed into an FTS5 query: words must all appear, "quoted
+// words" as a phrase, and a trailing * makes a word a prefix (motor*). Every
+// term is quoted, so punctuation in the input can never be a syntax error.
+string fullTextQuery(const string &input) {
+    string query;
+    size_t i = 0;
+    while (i < input.size()) {
+        if (isspace((unsigned char)input[i])) {
+            ++i;
+            continue;
+        }
+        string term;
+        bool prefix = false;
+        if (input[i] == '"') {
+            size_t end = input.find('"', i + 1);
+            if (end == string::npos) end = input.size();
+            term = input.substr(i + 1, end - i - 1);
+            i = end + 1;
+        } else {
+            size_t end = i;
+            while (end < input.size() && !isspace((unsigned char)input[end])) ++end;
+            term = input.substr(i, end - i);
+            i = end;
+            prefix = term.size() > 1 && term.back() == '*';
+            if (prefix) term.pop_back();
+        }
+        if (term.empty()) continue;
+
+        string quoted = "\"";
+        for (char c : term) quoted += c == '"' ? string("\"\"") : string(1, c);
+        query += (query.empty() ? "" : " ") + quoted + "\"" + (prefix ? "*" : "");
+    }
+    return query;
+}
+
+// Best matches first (BM25), each with the matching words highlighted in a
+// snippet of the text. Announcement titles weigh ten times their content.
+bool renderFullTextSearch(DbContext &ctx, ostream &out, const string &input) {
+    string query = fullTextQuery(input);
+    if (query.empty()) {
+        out << RED << "Enter at least one word to search for.\n" << RESET;
+        return true;
+    }
+
+    struct Source {
+        string heading;
+        string sql;
+    };
+    const Source sources[] = {
+        {"Incidents",
+         "SELECT i.id, COALESCE(i.type, '') || ' | ' || COALESCE(i.location, '') || ' | ' || "
+         "COALESCE(strftime('%Y-%m-%d %H:%M', i.occurred_at, 'unixepoch', 'localtime'), ''), "
+         "snippet(incidents_fts, 0, ?2, ?3, '...', ?4), bm25(incidents_fts) "
+         "FROM incidents_fts JOIN incidents i ON i.id = incidents_fts.rowid "
+         "WHERE incidents_fts MATCH ?1 ORDER BY bm25(incidents_fts) LIMIT ?5;"},
+        {"Announcements",
+         "SELECT a.id, COALESCE(a.title, '') || ' | ' || COALESCE(a.date, ''), "
+         "snippet(announcements_fts, -1, ?2, ?3, '...', ?4), bm25(announcements_fts, 10.0, 1.0) "
+         "FROM announcements_fts JOIN announcements a ON a.id = announcements_fts.rowid "
+         "WHERE announcements_fts MATCH ?1 ORDER BY bm25(announcements_fts, 10.0, 1.0) LIMIT ?5;"},
+    };
+
+    auto start = chrono::steady_clock::now();
+    for (auto &source : sources) {
+        sqlite3_stmt* stmt = readStatement(ctx, source.sql);
+        if (!stmt) {
+            cout << RED << "Failed to search " << source.heading << ".\n" << RESET;
+            return false;
+        }
+        sqlite3_bind_text(stmt, 1, query.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, BOLD YELLOW, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, RESET, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 4, FTS_SNIPPET_TOKENS);
+        sqlite3_bind_int(stmt, 5, FTS_MAX_RESULTS);
+
+        out << GREEN << "\n===== " << source.heading << " =====\n" << RESET;
+        int found = 0;
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            ++found;
+            out << CYAN << "#" << sqlite3_column_int64(stmt, 0) << RESET << "  "
+                << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))
+                << "  (score " << fixed << setprecision(2) << -sqlite3_column_double(stmt, 3) << ")\n"
+                << defaultfloat << "    " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)) << "\n";
+        }
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) return false;
+        if (!found) out << "No matches.\n";
+        else if (found == FTS_MAX_RESULTS) out << "(best " << FTS_MAX_RESULTS << " shown)\n";
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    out << "\nSearched for " << query << " in " << fixed << setprecision(1) << ms << " ms\n" << defaultfloat;
+    return true;
+}
+
+void fullTextSearch(DbContext &ctx) {
+    string input;
+    clearInput();
+    cout << "Words to find (\"a phrase\", prefix*): ";
+    getline(cin, input);
+    writeReport(ctx, [&input](DbContext &c, ostream &out) { return renderFullTextSearch(c, out, input); });
+}
+
+// ------------------------
+// MIRROR (page-delta standby copy)
+// ------------------------
+// Only pages whose hash differs from the standby are copied. Before the standby
+// is touched, its old pages are saved in a regular SQLite rollback journal
+// ("<standby>-journal"), so an interrupted mirror is rolled back by SQLite the
+// next time the standby is opened. The standby is kept in rollback-journal mode
+// so it is always a single self-contained file.
+const char MIRROR_MANIFEST_MAGIC[8] = {'B', 'G', 'Y', 'M', 'I', 'R', 'R', '1'};
+const unsigned char SQLITE_JOURNAL_MAGIC[8] = {0xd9, 0xd5, 0x05, 0xf9, 0x20, 0xa1, 0x63, 0xd7};
+const int MIRROR_JOURNAL_SECTOR = 512;
+
+struct MirrorStats {
+    uint32_t pageSize = 0;
+    uint32_t pageCount = 0;
+    uint32_t pagesCopied = 0;
+    uint32_t pagesJournaled = 0;
+    bool usedManifest = false;
+};
+
+// Page hashes of the standby as of its last mirror, so the standby does not
+// have to be read back in full on every run.
+struct MirrorManifest {
+    uint32_t pageSize = 0;
+    uint32_t changeCounter = 0;
+    vector<uint64_t> hashes;
+};
+
+uint32_t readBigEndian32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void writeBigEndian32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+uint64_t hashPage(const unsigned char* data, uint32_t size) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ size;
+    for (uint32_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+bool loadMirrorManifest(const string &path, MirrorManifest &manifest) {
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+
+    char magic[8];
+    uint32_t count = 0;
+    in.read(magic, 8);
+    in.read(reinterpret_cast<char*>(&manifest.pageSize), 4);
+    in.read(reinterpret_cast<char*>(&manifest.changeCounter), 4);
+    in.read(reinterpret_cast<char*>(&count), 4);
+    if (!in || memcmp(magic, MIRROR_MANIFEST_MAGIC, 8) != 0) return false;
+
+    manifest.hashes.resize(count);
+    in.read(reinterpret_cast<char*>(manifest.hashes.data()), (streamsize)count * 8);
+    return (bool)in;
+}
+
+bool saveMirrorManifest(const string &path, const MirrorManifest &manifest) {
+    string tmpPath = path + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        uint32_t count = (uint32_t)manifest.hashes.size();
+        out.write(MIRROR_MANIFEST_MAGIC, 8);
+        out.write(reinterpret_cast<const char*>(&manifest.pageSize), 4);
+        out.write(reinterpret_cast<const char*>(&manifest.changeCounter), 4);
+        out.write(reinterpret_cast<const char*>(&count), 4);
+        out.write(reinterpret_cast<const char*>(manifest.hashes.data()), (streamsize)count * 8);
+        if (!out) return false;
+    }
+    remove(path.c_str());
+    return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+int queryInt(sqlite3* conn, const char* sql) {
+    sqlite3_stmt* stmt;
+    int value = 0;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+bool readFilePage(sqlite3_file* file, unsigned char* buf, uint32_t pageSize, uint32_t pgno) {
+    int rc = file->pMethods->xRead(file, buf, pageSize, (sqlite3_int64)(pgno - 1) * pageSize);
+    return rc == SQLITE_OK || rc == SQLITE_IOERR_SHORT_READ;
+}
+
+// Saves the standby pages that are about to be overwritten in the journal
+// format SQLite's pager replays when it finds a hot journal.
+bool writeStandbyJournal(sqlite3_vfs* vfs, const string &journalPath, sqlite3_file* standby,
+                         uint32_t pageSize, uint32_t origPages, const vector<uint32_t> &pages) {
+    sqlite3_file* journal = static_cast<sqlite3_file*>(sqlite3_malloc(vfs->szOsFile));
+    if (!journal) return false;
+    memset(journal, 0, vfs->szOsFile);
+
+    int flags = SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE;
+    if (vfs->xOpen(vfs, journalPath.c_str(), journal, flags, nullptr) != SQLITE_OK) {
+        if (journal->pMethods) journal->pMethods->xClose(journal);
+        sqlite3_free(journal);
+        return false;
+    }
+
+    uint32_t nonce;
+    sqlite3_randomness(sizeof(nonce), &nonce);
+
+    vector<unsigned char> header(MIRROR_JOURNAL_SECTOR, 0);
+    memcpy(header.data(), SQLITE_JOURNAL_MAGIC, 8);
+    writeBigEndian32(&header[8], (uint32_t)pages.size());
+    writeBigEndian32(&header[12], nonce);
+    writeBigEndian32(&header[16], origPages);
+    writeBigEndian32(&header[20], MIRROR_JOURNAL_SECTOR);
+    writeBigEndian32(&header[24], pageSize);
+    int rc = journal->pMethods->xWrite(journal, header.data(), MIRROR_JOURNAL_SECTOR, 0);
+
+    // Each record is: page number, original page, checksum
+    vector<unsigned char> record(pageSize + 8);
+    sqlite3_int64 offset = MIRROR_JOURNAL_SECTOR;
+    for (size_t i = 0; i < pages.size() && rc == SQLITE_OK; ++i) {
+        writeBigEndian32(record.data(), pages[i]);
+        if (!readFilePage(standby, record.data() + 4, pageSize, pages[i])) {
+            rc = SQLITE_IOERR;
+            break;
+        }
+        uint32_t checksum = nonce;
+        for (int k = (int)pageSize - 200; k > 0; k -= 200)
+            checksum += record[4 + k];
+        writeBigEndian32(record.data() + 4 + pageSize, checksum);
+
+        rc = journal->pMethods->xWrite(journal, record.data(), (int)record.size(), offset);
+        offset += record.size();
+    }
+
+    if (rc == SQLITE_OK)
+        rc = journal->pMethods->xSync(journal, SQLITE_SYNC_NORMAL);
+    journal->pMethods->xClose(journal);
+    sqlite3_free(journal);
+    return rc == SQLITE_OK;
+}
+
+// A new or empty standby is seeded whole through the backup API. Patching pages
+// needs an existing database underneath: a write transaction on an empty file
+// has SQLite build a fresh page 1 that its COMMIT writes over the copied one.
+bool seedStandby(sqlite3* conn, const string &standbyPath, MirrorStats &stats, string &error) {
+    // The backup API will not read from a connection in a write transaction, so
+    // the pages come through a second one; conn's lock still holds writers off.
+    sqlite3 *source = nullptr, *standbyDb = nullptr;
+    bool ok = sqlite3_open_v2(sqlite3_db_filename(conn, "main"), &source, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK
+              && sqlite3_open_v2(standbyPath.c_str(), &standbyDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                                 nullptr) == SQLITE_OK;
+    sqlite3_busy_timeout(source, 5000);
+    sqlite3_backup* backup = ok ? sqlite3_backup_init(standbyDb, "main", source, "main") : nullptr;
+    ok = backup && sqlite3_backup_step(backup, -1) == SQLITE_DONE;
+    if (backup) sqlite3_backup_finish(backup);
+    sqlite3_close(source);
+
+    // The copy keeps the source's WAL flag; a standby is a rollback-journal file.
+    // Reopening it is the check that it is whole before success is reported.
+    string check;
+    if (ok && sqlite3_exec(standbyDb, "PRAGMA journal_mode=DELETE;", nullptr, nullptr, nullptr) == SQLITE_OK) {
+        sqlite3_close(standbyDb);
+        standbyDb = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_open_v2(standbyPath.c_str(), &standbyDb, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK &&
+            sqlite3_prepare_v2(standbyDb, "PRAGMA quick_check;", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW)
+            check = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        sqlite3_finalize(stmt);
+    }
+    if (check != "ok") {
+        error = "cannot seed standby: " + (check.empty() ? string(sqlite3_errmsg(standbyDb)) : check);
+        ok = false;
+    }
+    sqlite3_close(standbyDb);
+
+    remove((standbyPath + "-pagehash").c_str());    // the next run hashes the standby itself
+    stats.pagesCopied = ok ? stats.pageCount : 0;
+    return ok;
+}
+
+// Copies the changed pages of the (already locked) source into the standby.
+bool mirrorPages(sqlite3* conn, const string &standbyPath, MirrorStats &stats, string &error) {
+    sqlite3_file* source = nullptr;
+    sqlite3_file_control(conn, "main", SQLITE_FCNTL_FILE_POINTER, &source);
+    uint32_t pageSize = (uint32_t)queryInt(conn, "PRAGMA page_size;");
+    uint32_t pageCount = (uint32_t)queryInt(conn, "PRAGMA page_count;");
+    stats.pageSize = pageSize;
+    stats.pageCount = pageCount;
+    if (!source || pageSize == 0) {
+        error = "cannot access the source database file";
+        return false;
+    }
+    error_code ec;
+    if (!filesystem::exists(standbyPath, ec) || filesystem::file_size(standbyPath, ec) == 0)
+        return seedStandby(conn, standbyPath, stats, error);
+
+    sqlite3* standbyDb = nullptr;
+    if (sqlite3_open_v2(standbyPath.c_str(), &standbyDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        error = string("cannot open standby: ") + sqlite3_errmsg(standbyDb);
+        sqlite3_close(standbyDb);
+        return false;
+    }
+    sqlite3_busy_timeout(standbyDb, 5000);
+
+    // The exclusive lock keeps readers of the standby out while pages are replaced.
+    // Taking it also rolls back the journal of an earlier interrupted mirror.
+    if (sqlite3_exec(standbyDb, "BEGIN EXCLUSIVE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        error = string("cannot lock standby: ") + sqlite3_errmsg(standbyDb);
+        sqlite3_close(standbyDb);
+        return false;
+    }
+
+    sqlite3_file* standby = nullptr;
+    sqlite3_file_control(standbyDb, "main", SQLITE_FCNTL_FILE_POINTER, &standby);
+    sqlite3_int64 standbySize = 0;
+    standby->pMethods->xFileSize(standby, &standbySize);
+
+    unsigned char oldHeader[100] = {0};
+    uint32_t oldPageSize = pageSize, oldCounter = 0;
+    if (standbySize >= 100) {
+        standby->pMethods->xRead(standby, oldHeader, 100, 0);
+        oldPageSize = ((uint32_t)oldHeader[16] << 8) | oldHeader[17];
+        if (oldPageSize == 1) oldPageSize = 65536;
+        oldCounter = readBigEndian32(&oldHeader[24]);
+        if (oldHeader[18] == 2 || oldPageSize < 512) {
+            error = "standby is not a rollback-journal SQLite database";
+            sqlite3_exec(standbyDb, "ROLLBACK;", nullptr, nullptr, nullptr);
+            sqlite3_close(standbyDb);
+            return false;
+        }
+    }
+    uint32_t oldPages = (uint32_t)(standbySize / oldPageSize);
+
+    // SQLite never stores data on the page holding the lock byte range.
+    uint32_t lockPage = 0x40000000 / pageSize + 1;
+    uint32_t oldLockPage = 0x40000000 / oldPageSize + 1;
+
+    string manifestPath = standbyPath + "-pagehash";
+    MirrorManifest manifest;
+    stats.usedManifest = loadMirrorManifest(manifestPath, manifest)
+                         && manifest.pageSize == pageSize && oldPageSize == pageSize
+                         && manifest.changeCounter == oldCounter && manifest.hashes.size() == oldPages;
+
+    MirrorManifest next;
+    next.pageSize = pageSize;
+    next.changeCounter = oldCounter + 1;
+    next.hashes.assign(pageCount, 0);
+
+    // Pass 1: find the pages that differ
+    vector<uint32_t> changed;
+    vector<unsigned char> page(pageSize), oldPage(pageSize);
+    bool ok = true;
+    for (uint32_t pgno = 1; pgno <= pageCount && ok; ++pgno) {
+        if (pgno == lockPage) continue;
+        if (!readFilePage(source, page.data(), pageSize, pgno)) {
+            error = "read error on source page " + to_string(pgno);
+            ok = false;
+            break;
+        }
+        uint64_t h = hashPage(page.data(), pageSize);
+        next.hashes[pgno - 1] = h;
+
+        // Page 1 always changes on the standby (header patch below)
+        bool same = false;
+        if (pgno > 1 && oldPageSize == pageSize && pgno <= oldPages) {
+            if (stats.usedManifest)
+                same = manifest.hashes[pgno - 1] == h;
+            else
+                same = readFilePage(standby, oldPage.data(), pageSize, pgno)
+                       && hashPage(oldPage.data(), pageSize) == h;
+        }
+        if (!same) changed.push_back(pgno);
+    }
+
+    // Pass 2: journal the standby pages that will be overwritten or cut off
+    vector<uint32_t> journalPages;
+    if (oldPageSize == pageSize) {
+        for (uint32_t pgno : changed)
+            if (pgno <= oldPages) journalPages.push_back(pgno);
+        for (uint32_t pgno = pageCount + 1; pgno <= oldPages; ++pgno)
+            if (pgno != lockPage) journalPages.push_back(pgno);
+    } else {
+        for (uint32_t pgno = 1; pgno <= oldPages; ++pgno)
+            if (pgno != oldLockPage) journalPages.push_back(pgno);
+    }
+
+    sqlite3_vfs* vfs = sqlite3_vfs_find(nullptr);
+    string journalPath = string(sqlite3_db_filename(standbyDb, "main")) + "-journal";
+    if (ok && !writeStandbyJournal(vfs, journalPath, standby, oldPageSize, oldPages, journalPages)) {
+        error = "cannot write standby journal";
+        ok = false;
+    }
+    stats.pagesJournaled = (uint32_t)journalPages.size();
+
+    // Pass 3: copy the changed pages, then drop the journal to commit
+    for (size_t i = 0; i < changed.size() && ok; ++i) {
+        uint32_t pgno = changed[i];
+        if (!readFilePage(source, page.data(), pageSize, pgno)) {
+            error = "read error on source page " + to_string(pgno);
+            ok = false;
+            break;
+        }
+        if (pgno == 1) {
+            page[18] = page[19] = 1;    // rollback-journal mode
+            writeBigEndian32(&page[24], next.changeCounter);
+            writeBigEndian32(&page[28], pageCount);
+            writeBigEndian32(&page[92], next.changeCounter);
+        }
+        if (standby->pMethods->xWrite(standby, page.data(), (int)pageSize,
+                                      (sqlite3_int64)(pgno - 1) * pageSize) != SQLITE_OK) {
+            error = "write error on standby page " + to_string(pgno);
+            ok = false;
+        }
+    }
+    sqlite3_int64 newSize = (sqlite3_int64)pageCount * pageSize;
+    if (ok && standbySize > newSize && standby->pMethods->xTruncate(standby, newSize) != SQLITE_OK) {
+        error = "cannot truncate standby";
+        ok = false;
+    }
+    if (ok && standby->pMethods->xSync(standby, SQLITE_SYNC_NORMAL) != SQLITE_OK) {
+        error = "cannot sync standby";
+        ok = false;
+    }
+    // Left in place on failure, the journal restores the previous standby on next open
+    if (ok && vfs->xDelete(vfs, journalPath.c_str(), 1) != SQLITE_OK) {
+        error = "cannot remove standby journal";
+        ok = false;
+    }
+    stats.pagesCopied = ok ? (uint32_t)changed.size() : 0;
+
+    sqlite3_exec(standbyDb, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(standbyDb);
+
+    if (ok && !saveMirrorManifest(manifestPath, next))
+        remove(manifestPath.c_str());   // next run re-reads the standby instead
+    return ok;
+}
+
+bool mirrorDatabase(DbContext &ctx, const string &standbyPath, MirrorStats &stats, string &error) {
+    sqlite3* conn = nullptr;
+    if (sqlite3_open_v2(ctx.path.c_str(), &conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        error = string("cannot open database: ") + sqlite3_errmsg(conn);
+        sqlite3_close(conn);
+        return false;
+    }
+    sqlite3_busy_timeout(conn, 5000);
+
+    // Writers are held off for the duration of the copy; readers are not.
+    if (sqlite3_exec(conn, "BEGIN IMMEDIATE; SELECT count(*) FROM sqlite_master;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        error = string("cannot lock database: ") + sqlite3_errmsg(conn);
+        sqlite3_close(conn);
+        return false;
+    }
+
+    // In WAL mode the main file is only complete once every frame is checkpointed.
+    // No new frames can appear while we hold the write lock.
+    bool ready = true;
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(conn, "PRAGMA journal_mode;", -1, &stmt, nullptr);
+    bool wal = sqlite3_step(stmt) == SQLITE_ROW
+               && string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))) == "wal";
+    sqlite3_finalize(stmt);
+    if (wal) {
+        sqlite3* ckpt = nullptr;
+        sqlite3_open_v2(ctx.path.c_str(), &ckpt, SQLITE_OPEN_READWRITE, nullptr);
+        sqlite3_exec(ckpt, "SELECT count(*) FROM sqlite_master;", nullptr, nullptr, nullptr);
+        ready = false;
+        for (int attempt = 0; attempt < 50 && !ready; ++attempt) {
+            int logFrames = -1, done = -1;
+            sqlite3_wal_checkpoint_v2(ckpt, "main", SQLITE_CHECKPOINT_PASSIVE, &logFrames, &done);
+            ready = logFrames >= 0 && logFrames == done;
+            if (!ready) this_thread::sleep_for(chrono::milliseconds(100));
+        }
+        sqlite3_close(ckpt);
+        if (!ready) error = "WAL could not be checkpointed (long-running readers?)";
+    }
+
+    bool ok = ready && mirrorPages(conn, standbyPath, stats, error);
+    sqlite3_exec(conn, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(conn);
+    return ok;
+}
+
+void mirrorToStandby(DbContext &ctx, const string &standbyPath) {
+    MirrorStats stats;
+    string error;
+    auto start = chrono::steady_clock::now();
+    bool ok = mirrorDatabase(ctx, standbyPath, stats, error);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (!ok) {
+        cout << RED << "\nMirror failed: " << error << "\n" << RESET;
+        return;
+    }
+    cout << GREEN << "\nStandby updated: " << standbyPath << "\n" << RESET;
+    cout << "Pages copied  : " << stats.pagesCopied << " of " << stats.pageCount
+         << " (" << (uint64_t)stats.pagesCopied * stats.pageSize / 1024 << " KB)\n";
+    cout << "Page hashes   : " << (stats.usedManifest ? "from manifest" : "read from standby") << "\n";
+    cout << "Time          : " << fixed << setprecision(2) << secs << " s\n";
+}
+
+void mirrorMenu(DbContext &ctx) {
+    clearInput();
+    string path;
+    cout << "Enter standby file path: ";
+    getline(cin, path);
+    if (path.empty()) {
+        cout << RED << "\nNo path given.\n" << RESET;
+        return;
+    }
+    mirrorToStandby(ctx, path);
+}
+
+// ------------------------
+// HTTP SERVER (barangay serve)
+// ------------------------
+// Serves the residents, incidents and announcements tables as paginated JSON
+// on localhost, so barangay.html only fetches the page it shows instead of the
+// whole database file. Pages are keyset-paginated on id (?after=<id>&limit=N)
+// and filterable; every page carries an ETag and repeat requests get a 304.
+//
+//   GET /residents?name=&address=&name_prefix=
+//   GET /incidents?type=&location=&from=YYYY-MM-DD&to=YYYY-MM-DD&q=<description>
+//                    (from/to are local days, matched on the occurred_at index)
+//   GET /announcements?title=&from=&to=&title_prefix=
+//                    (*_prefix: starts with, any case or accents, on the FOLD index)
+//   GET /            the viewer (barangay.html)
+//
+// No CORS headers are sent: these are residents' names and contacts, so only
+// the viewer this server hands out at / may read them, not whatever other
+// site is open in the same browser. Each request has to arrive in full within
+// HTTP_REQUEST_SECONDS.
+#ifdef _WIN32
+typedef SOCKET socket_t;
+const socket_t INVALID_SOCK = INVALID_SOCKET;
+void closeSocket(socket_t s) { closesocket(s); }
+int poll(pollfd* fds, unsigned long count, int timeout) { return WSAPoll(fds, count, timeout); }
+#else
+typedef int socket_t;
+const socket_t INVALID_SOCK = -1;
+void closeSocket(socket_t s) { close(s); }
+#endif
+
+const int HTTP_MAX_HEADER = 16 * 1024;
+const int HTTP_MAX_PAGE = 500;
+const int HTTP_REQUEST_SECONDS = 5;
+
+bool initSockets() {
+#ifdef _WIN32
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+    signal(SIGPIPE, SIG_IGN);
+    return true;
+#endif
+}
+
+void setSocketTimeout(socket_t s, int seconds) {
+#ifdef _WIN32
+    DWORD ms = seconds * 1000;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#else
+    timeval tv{seconds, 0};
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+}
+
+bool sendAll(socket_t s, const string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(s, data.data() + sent, (int)(data.size() - sent), 0);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+struct HttpRequest {
+    string method;
+    string path;
+    map<string, string> params;     // query string and form body
+    string ifNoneMatch;
+    bool keepAlive = true;
+};
+
+struct HttpResponse {
+    int status = 200;
+    string contentType = "application/json";
+    string etag;
+    string body;
+};
+
+uint64_t hashText(const string &text) {
+    uint64_t h = 1469598103934665603ULL;   // FNV-1a
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+string urlDecode(const string &text) {
+    string out;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            out += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() && isxdigit((unsigned char)text[i + 1])
+                   && isxdigit((unsigned char)text[i + 2])) {
+            out += (char)stoi(text.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+void parseParams(const string &text, map<string, string> &params) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('&', start);
+        if (end == string::npos) end = text.size();
+        string pair = text.substr(start, end - start);
+        size_t eq = pair.find('=');
+        if (eq != string::npos)
+            params[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+        else if (!pair.empty())
+            params[urlDecode(pair)] = "";
+        start = end + 1;
+    }
+}
+
+string jsonError(const string &message) {
+    return "{\"error\":\"" + jsonEscape(message) + "\"}";
+}
+
+// The fallback also stands in for a value that is not a whole number
+long long paramInt(const HttpRequest &req, const string &key, long long fallback) {
+    auto it = req.params.find(key);
+    if (it == req.params.end() || it->second.empty()) return fallback;
+    char* end;
+    errno = 0;
+    long long value = strtoll(it->second.c_str(), &end, 10);
+    return *end || errno == ERANGE ? fallback : value;
+}
+
+string paramText(const HttpRequest &req, const string &key) {
+    auto it = req.params.find(key);
+    return it == req.params.end() ? "" : it->second;
+}
+
+// recv() that gives up at the deadline. SO_RCVTIMEO only bounds each call, so
+// a client sending a byte every few seconds could otherwise hold a worker.
+int recvBefore(socket_t s, char* chunk, int size, chrono::steady_clock::time_point deadline) {
+    auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+    pollfd readable{};
+    readable.fd = s;
+    readable.events = POLLIN;
+    if (left <= 0 || poll(&readable, 1, (int)left) <= 0) return -1;
+    return recv(s, chunk, size, 0);
+}
+
+// Reads one request from a keep-alive connection; buffer carries over
+// whatever the client pipelined after it.
+bool readHttpRequest(socket_t s, string &buffer, HttpRequest &req) {
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(HTTP_REQUEST_SECONDS);
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+        if (buffer.size() > (size_t)HTTP_MAX_HEADER) return false;
+        char chunk[4096];
+        int n = recvBefore(s, chunk, sizeof(chunk), deadline);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+
+    istringstream head(buffer.substr(0, headerEnd));
+    string line, target, version;
+    getline(head, line);
+    istringstream requestLine(line);
+    requestLine >> req.method >> target >> version;
+    req.keepAlive = version != "HTTP/1.0";
+
+    size_t contentLength = 0;
+    while (getline(head, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == string::npos) continue;
+        string key = line.substr(0, colon), value = line.substr(colon + 1);
+        transform(key.begin(), key.end(), key.begin(), ::tolower);
+        value.erase(0, value.find_first_not_of(' '));
+        if (key == "content-length") {
+            contentLength = strtoul(value.c_str(), nullptr, 10);
+        } else if (key == "if-none-match") {
+            req.ifNoneMatch = value;
+        } else if (key == "connection") {
+            transform(value.begin(), value.end(), value.begin(), ::tolower);
+            req.keepAlive = value != "close" && (value == "keep-alive" || req.keepAlive);
+        }
+    }
+    if (contentLength > 1024 * 1024) return false;
+
+    size_t total = headerEnd + 4 + contentLength;
+    while (buffer.size() < total) {
+        char chunk[4096];
+        int n = recvBefore(s, chunk, sizeof(chunk), deadline);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    string body = buffer.substr(headerEnd + 4, contentLength);
+    buffer.erase(0, total);
+
+    size_t q = target.find('?');
+    req.path = target.substr(0, q);
+    req.params.clear();
+    if (q != string::npos) parseParams(target.substr(q + 1), req.params);
+    parseParams(body, req.params);
+    return !req.method.empty();
+}
+
+string httpStatusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        default:  return "Internal Server Error";
+    }
+}
+
+bool sendHttpResponse(socket_t s, const HttpResponse &res, const HttpRequest &req) {
+    bool notModified = !res.etag.empty() && req.ifNoneMatch == res.etag;
+    int status = notModified ? 304 : res.status;
+
+    ostringstream out;
+    out << "HTTP/1.1 " << status << " " << httpStatusText(status) << "\r\n"
+        << "Content-Type: " << res.contentType << "\r\n"
+        << "Content-Length: " << (notModified ? 0 : res.body.size()) << "\r\n";
+    if (!res.etag.empty())
+        out << "ETag: " << res.etag << "\r\nCache-Control: no-cache\r\n";
+    out << "Connection: " << (req.keepAlive ? "keep-alive" : "close") << "\r\n\r\n";
+    if (!notModified) out << res.body;
+    return sendAll(s, out.str());
+}
+
+// Which query parameters a table accepts and how each one filters
+struct TableFilter {
+    string param;
+    string column;
+    string op;      // "=", "nocase" (= in any case), "like" (contains), "prefix" (under FOLD),
+                    // ">=", "<=", "since"/"until" (YYYY-MM-DD on an epoch column)
+};
+
+struct TableEndpoint {
+    string path;
+    string table;
+    string columns;
+    vector<TableFilter> filters;
+};
+
+const vector<TableEndpoint> TABLE_ENDPOINTS = {
+    {"/residents", "residents", "id, name, address, contact",
+     {{"name", "name", "like"}, {"address", "address", "like"}, {"name_prefix", "name", "prefix"}}},
+    {"/incidents", "incidents", "id, " + INCIDENT_COLUMNS,
+     {{"type", "type", "nocase"}, {"location", "location", "like"},
+      {"from", "occurred_at", "since"}, {"to", "occurred_at", "until"}, {"q", "description", "like"}}},
+    {"/announcements", "announcements", "id, title, content, date",
+     {{"title", "title", "like"}, {"from", "date", ">="}, {"to", "date", "<="},
+      {"title_prefix", "title", "prefix"}}},
+};
+
+// Renders one keyset page: {"items":[...],"next":id|null}
+string tablePageJson(sqlite3_stmt* stmt, int limit) {
+    ostringstream out;
+    out << "{\"items\":[";
+    int count = 0;
+    sqlite3_int64 lastId = 0;
+    int columns = sqlite3_column_count(stmt);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        lastId = sqlite3_column_int64(stmt, 0);
+        out << (count++ ? ",{" : "{");
+        for (int i = 0; i < columns; ++i) {
+            out << (i ? ",\"" : "\"") << sqlite3_column_name(stmt, i) << "\":";
+            switch (sqlite3_column_type(stmt, i)) {
+                case SQLITE_NULL:
+                    out << "null";
+                    break;
+                case SQLITE_INTEGER:
+                    out << sqlite3_column_int64(stmt, i);
+                    break;
+                default:
+                    out << "\"" << jsonEscape(reinterpret_cast<const char*>(sqlite3_column_text(stmt, i))) << "\"";
+            }
+        }
+        out << "}";
+    }
+    sqlite3_reset(stmt);
+    out << "],\"next\":";
+    if (count == limit) out << lastId;
+    else out << "null";
+    out << "}";
+    return out.str();
+}
+
+// The statement for a page with the given filters, each taking the parameters
+// its op needs after the id. A prefix ranges over its FOLD index, so the ids
+// are then only filtered (+id) rather than walked in order.
+string tablePageSql(const TableEndpoint &endpoint, const vector<const TableFilter*> &given) {
+    string conditions;
+    bool prefixed = false;
+    for (auto f : given) {
+        if (f->op == "like") {
+            conditions += " AND " + f->column + " LIKE ?";
+        } else if (f->op == "prefix") {
+            conditions += " AND " + foldedPrefixMatch(f->column);
+            prefixed = true;
+        } else if (f->op == "nocase") {
+            conditions += " AND " + f->column + " = ? COLLATE NOCASE";     // as idx_incidents_type is declared
+        } else if (f->op == "since" || f->op == "until") {
+            conditions += " AND " + f->column + (f->op == "since" ? " >= ?" : " <= ?");
+        } else {
+            conditions += " AND " + f->column + " " + f->op + " ?";
+        }
+    }
+    return "SELECT " + endpoint.columns + " FROM " + endpoint.table + " WHERE " + (prefixed ? "+id" : "id") +
+           " > ?" + conditions + " ORDER BY id LIMIT ?;";
+}
+
+HttpResponse handleTablePage(const HttpRequest &req, const TableEndpoint &endpoint, DbContext &ctx) {
+    HttpResponse res;
+    int limit = (int)max(1LL, min(paramInt(req, "limit", 50), (long long)HTTP_MAX_PAGE));
+
+    // Only the filters actually given become part of the statement
+    vector<const TableFilter*> given;
+    vector<string> values;
+    for (auto &f : endpoint.filters) {
+        string value = paramText(req, f.param);
+        if (value.empty()) continue;
+        if (f.op == "like") {
+            value = "%" + value + "%";
+        } else if (f.op == "prefix") {
+            values.push_back(value);
+            value = foldPrefixEnd(value);
+        } else if (f.op == "since" || f.op == "until") {
+            long long lo = 0, hi = 0;
+            if (!parseIncidentDays(value, value, lo, hi)) {
+                res.status = 400;
+                res.body = jsonError(f.param + " must be a date, YYYY-MM-DD");
+                return res;
+            }
+            value = to_string(f.op == "since" ? lo : hi);
+        }
+        given.push_back(&f);
+        values.push_back(value);
+    }
+    string sql = tablePageSql(endpoint, given);
+
+    // Statements stay cached per filter shape on the worker's connection
+    sqlite3_stmt* stmt = readStatement(ctx, sql);
+    if (!stmt) {
+        ReadConnection* rc = readConnection(ctx);
+        res.status = 500;
+        res.body = jsonError(rc ? sqlite3_errmsg(rc->conn) : "database unavailable");
+        return res;
+    }
+    int param = 1;
+    sqlite3_bind_int64(stmt, param++, paramInt(req, "after", 0));
+    for (auto &v : values)
+        sqlite3_bind_text(stmt, param++, v.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, param, limit);
+
+    res.body = tablePageJson(stmt, limit);
+    res.etag = "\"" + to_string(hashText(res.body)) + "\"";
+    return res;
+}
+
+// The same check for every lookup by resident name or announcement title,
+// each of which should search a FOLD index, and the API's incident type filter
+bool checkNameLookupPlans(sqlite3* conn) {
+    vector<pair<string, string>> lookups = {{"resident update", SQL_UPDATE_RESIDENT},
+                                            {"resident delete", SQL_DELETE_RESIDENT}};
+    for (auto &endpoint : TABLE_ENDPOINTS)
+        for (auto &f : endpoint.filters)
+            if (f.op == "prefix" || f.op == "nocase") lookups.emplace_back(endpoint.path + "?" + f.param, tablePageSql(endpoint, {&f}));
+
+    bool allIndexed = true;
+    for (auto &lookup : lookups) {
+        bool scans;
+        if (!showPlan(conn, lookup.first, lookup.second, scans)) return false;
+        allIndexed = allIndexed && !scans;
+    }
+    return allIndexed;
+}
+
+HttpResponse routeRequest(const HttpRequest &req, DbContext &ctx) {
+    HttpResponse res;
+    if (req.method != "GET") {
+        res.status = 405;
+        res.body = jsonError("use GET");
+        return res;
+    }
+
+    for (auto &endpoint : TABLE_ENDPOINTS)
+        if (req.path == endpoint.path) return handleTablePage(req, endpoint, ctx);
+
+    // The viewer itself, so it can be opened straight from the server
+    if (req.path == "/" || req.path == "/barangay.html") {
+        ifstream in("barangay.html", ios::binary);
+        if (in) {
+            res.contentType = "text/html; charset=utf-8";
+            res.body.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+            return res;
+        }
+    }
+
+    res.status = 404;
+    res.body = jsonError("no such endpoint");
+    return res;
+}
+
+// A connection between requests; buffer keeps any pipelined bytes
+struct HttpConnection {
+    socket_t sock;
+    string buffer;
+    chrono::steady_clock::time_point lastActive;
+};
+
+// One I/O thread polls the listener and idle keep-alive connections and hands
+// readable ones to the workers, so a slow or idle client never ties up a worker.
+struct HttpServer {
+    DbContext* ctx = nullptr;
+    socket_t listener = INVALID_SOCK;
+    socket_t wakeSocket = INVALID_SOCK;     // loopback UDP socket to interrupt poll()
+    sockaddr_in wakeAddr{};
+    int port = 0;
+    atomic<bool> running{false};
+    vector<thread> workers;
+    thread poller;
+
+    mutex queueMutex;
+    condition_variable queueReady;
+    deque<HttpConnection*> ready;           // readable, waiting for a worker
+    vector<HttpConnection*> returned;       // served, back to the poller
+};
+
+const int HTTP_IDLE_SECONDS = 30;
+
+void wakePoller(HttpServer* server) {
+    char byte = 0;
+    sendto(server->wakeSocket, &byte, 1, 0, reinterpret_cast<sockaddr*>(&server->wakeAddr), sizeof(server->wakeAddr));
+}
+
+void httpWorker(HttpServer* server) {
+    if (!readConnection(*server->ctx)) {
+        cerr << RED << "Worker could not open " << server->ctx->path << RESET << endl;
+        return;
+    }
+    while (true) {
+        HttpConnection* conn;
+        {
+            unique_lock<mutex> lock(server->queueMutex);
+            server->queueReady.wait(lock, [&] { return !server->ready.empty() || !server->running; });
+            if (server->ready.empty()) break;
+            conn = server->ready.front();
+            server->ready.pop_front();
+        }
+
+        // Serve whatever the client has sent, then give the connection back
+        bool keep = true;
+        do {
+            HttpRequest req;
+            keep = readHttpRequest(conn->sock, conn->buffer, req);
+            if (keep) keep = sendHttpResponse(conn->sock, routeRequest(req, *server->ctx), req) && req.keepAlive;
+        } while (keep && conn->buffer.find("\r\n\r\n") != string::npos);
+
+        if (!keep) {
+            closeSocket(conn->sock);
+            delete conn;
+            continue;
+        }
+        conn->lastActive = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> lock(server->queueMutex);
+            server->returned.push_back(conn);
+        }
+        wakePoller(server);
+    }
+    releaseReadConnection(*server->ctx);
+}
+
+void pollLoop(HttpServer* server) {
+    vector<HttpConnection*> idle;
+    vector<pollfd> fds;
+    while (server->running) {
+        {
+            lock_guard<mutex> lock(server->queueMutex);
+            idle.insert(idle.end(), server->returned.begin(), server->returned.end());
+            server->returned.clear();
+        }
+
+        fds.assign(2 + idle.size(), pollfd{});
+        fds[0].fd = server->listener;
+        fds[1].fd = server->wakeSocket;
+        for (size_t i = 0; i < idle.size(); ++i) fds[2 + i].fd = idle[i]->sock;
+        for (auto &f : fds) f.events = POLLIN;
+        if (poll(fds.data(), (unsigned long)fds.size(), 1000) < 0) continue;
+
+        if (fds[1].revents) {
+            char drain[64];
+            recv(server->wakeSocket, drain, sizeof(drain), 0);
+        }
+
+        auto now = chrono::steady_clock::now();
+        vector<HttpConnection*> stillIdle;
+        int handedOff = 0;
+        for (size_t i = 0; i < idle.size(); ++i) {
+            if (fds[2 + i].revents) {
+                lock_guard<mutex> lock(server->queueMutex);
+                server->ready.push_back(idle[i]);
+                handedOff++;
+            } else if (now - idle[i]->lastActive > chrono::seconds(HTTP_IDLE_SECONDS)) {
+                closeSocket(idle[i]->sock);
+                delete idle[i];
+            } else {
+                stillIdle.push_back(idle[i]);
+            }
+        }
+        idle.swap(stillIdle);
+
+        if (fds[0].revents && server->running) {
+            socket_t client = accept(server->listener, nullptr, nullptr);
+            if (client != INVALID_SOCK) {
+                setSocketTimeout(client, HTTP_REQUEST_SECONDS);
+                idle.push_back(new HttpConnection{client, "", now});
+            }
+        }
+        for (int i = 0; i < handedOff; ++i) server->queueReady.notify_one();
+    }
+
+    for (auto conn : idle) {
+        closeSocket(conn->sock);
+        delete conn;
+    }
+}
+
+bool openLoopbackSocket(socket_t &s, int type, int port, sockaddr_in &addr) {
+    s = socket(AF_INET, type, 0);
+    if (s == INVALID_SOCK) return false;
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+    addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    socklen_t len = sizeof(addr);
+    if (::bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || getsockname(s, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        closeSocket(s);
+        return false;
+    }
+    return true;
+}
+
+// Binds to 127.0.0.1:port (0 picks a free port) and starts the workers
+bool startHttpServer(HttpServer &server, DbContext &ctx, int port, int workerCount) {
+    if (!initSockets()) return false;
+
+    sockaddr_in addr;
+    if (!openLoopbackSocket(server.listener, SOCK_STREAM, port, addr)) return false;
+    if (listen(server.listener, 128) != 0
+        || !openLoopbackSocket(server.wakeSocket, SOCK_DGRAM, 0, server.wakeAddr)) {
+        closeSocket(server.listener);
+        return false;
+    }
+    server.port = ntohs(addr.sin_port);
+
+    server.ctx = &ctx;
+    server.running = true;
+    for (int i = 0; i < workerCount; ++i)
+        server.workers.emplace_back(httpWorker, &server);
+    server.poller = thread(pollLoop, &server);
+    return true;
+}
+
+void stopHttpServer(HttpServer &server) {
+    server.running = false;
+    wakePoller(&server);
+    server.poller.join();
+
+    server.queueReady.notify_all();
+    for (auto &w : server.workers) w.join();
+    for (auto conn : server.ready) {
+        closeSocket(conn->sock);
+        delete conn;
+    }
+    for (auto conn : server.returned) {
+        closeSocket(conn->sock);
+        delete conn;
+    }
+    closeSocket(server.listener);
+    closeSocket(server.wakeSocket);
+}
+
+int serveBarangay(DbContext &ctx, int port, int workerCount) {
+    HttpServer server;
+    if (!startHttpServer(server, ctx, port, workerCount)) {
+        cerr << RED << "Could not listen on 127.0.0.1:" << port << RESET << endl;
+        return 1;
+    }
+    cout << GREEN << "Serving barangay data on http://127.0.0.1:" << server.port
+         << " with " << workerCount << " workers (Ctrl-C to stop)\n" << RESET;
+    server.poller.join();
+    return 0;
+}
+
+// ------------------------
+// ------------------------
+// WRITE BENCHMARK
+// ------------------------
+// N threads insert rows into a scratch database: first each on its own
+// connection (one transaction and fsync per row, retrying on SQLITE_BUSY),
+// then the same rows through the group-commit write queue.
+int benchmarkWrites(int submitters, int opsEach) {
+    const string path = "bench-writes.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+    };
+    removeScratch();
+
+    sqlite3* setup;
+    sqlite3_open(path.c_str(), &setup);
+    sqlite3_exec(setup, "CREATE TABLE rows (id INTEGER PRIMARY KEY, submitter INTEGER, payload TEXT);",
+                 nullptr, nullptr, nullptr);
+    sqlite3_close(setup);
+
+    const char* sql_insert = "INSERT INTO rows (submitter, payload) VALUES (?, 'benchmark row');";
+    atomic<long long> busyRetries{0}, failures{0};
+    vector<thread> threads;
+
+    IoTotals io = ioTotals();
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < submitters; ++t) {
+        threads.emplace_back([&, t] {
+            sqlite3* conn;
+            sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr);
+            sqlite3_busy_timeout(conn, 5000);
+            sqlite3_stmt* stmt = nullptr;
+            while (sqlite3_prepare_v2(conn, sql_insert, -1, &stmt, nullptr) == SQLITE_BUSY)
+                busyRetries++;
+            for (int i = 0; i < opsEach && stmt; ++i) {
+                sqlite3_bind_int(stmt, 1, t);
+                int rc, attempts = 0;
+                while ((rc = sqlite3_step(stmt)) == SQLITE_BUSY && ++attempts < 1000) {
+                    busyRetries++;
+                    sqlite3_reset(stmt);
+                }
+                if (rc != SQLITE_DONE) failures++;
+                sqlite3_reset(stmt);
+            }
+            sqlite3_finalize(stmt);
+            sqlite3_close(conn);
+        });
+    }
+    for (auto &t : threads) t.join();
+    double directSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long long directBusy = busyRetries, directFailures = failures;
+    long long directSyncs = ioSyncsSince(io);
+
+    WriteQueue queue;
+    startWriteQueue(queue, path);
+    failures = 0;
+    threads.clear();
+    io = ioTotals();
+    start = chrono::steady_clock::now();
+    for (int t = 0; t < submitters; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < opsEach; ++i) {
+                auto done = submitWrite(queue, [&, t](sqlite3* conn, bool &ok) {
+                    sqlite3_stmt* stmt;
+                    sqlite3_prepare_v2(conn, sql_insert, -1, &stmt, nullptr);
+                    sqlite3_bind_int(stmt, 1, t);
+                    ok = sqlite3_step(stmt) == SQLITE_DONE;
+                    sqlite3_finalize(stmt);
+                    return ok;
+                }, false);
+                if (!done.get()) failures++;
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+    double queueSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stopWriteQueue(queue);
+    long long queueSyncs = ioSyncsSince(io);
+    removeScratch();
+
+    long long total = (long long)submitters * opsEach;
+    cout << "submitters " << submitters << ", rows each " << opsEach << "\n" << fixed << setprecision(0)
+         << "own connections : " << total / directSecs << " rows/s, " << total << " transactions, "
+         << directSyncs << " syncs, " << directBusy << " busy retries, " << directFailures << " failed\n"
+         << "write queue     : " << total / queueSecs << " rows/s, " << queue.transactions << " transactions, "
+         << queueSyncs << " syncs, " << failures << " failed\n";
+    printMemory();
+    return directFailures + failures == 0 ? 0 : 1;
+}
+
+// ------------------------
+// BACKGROUND JOBS
+// ------------------------
+string csvField(const string &text) {
+    if (text.find_first_of(",\"\r\n") == string::npos) return text;
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Writes a whole table as CSV from one read snapshot
+bool exportCsv(DbContext &ctx, Job &job, const string &table, const string &file, string &result) {
+    ReadSnapshot snap;
+    if (!beginSnapshot(ctx, snap)) {
+        result = "cannot read the database";
+        return false;
+    }
+    long long total = 0;
+    sqlite3_stmt* count = readStatement(ctx, "SELECT count(*) FROM " + table + ";");
+    if (count && sqlite3_step(count) == SQLITE_ROW) total = sqlite3_column_int64(count, 0);
+    if (count) sqlite3_reset(count);
+
+    sqlite3_stmt* stmt = readStatement(ctx, "SELECT * FROM " + table + " ORDER BY rowid;");
+    ofstream out(file, ios::binary);
+    if (!stmt || !out) {
+        endSnapshot(snap);
+        result = "cannot write " + file;
+        return false;
+    }
+
+    int columns = sqlite3_column_count(stmt);
+    for (int c = 0; c < columns; ++c)
+        out << (c ? "," : "") << csvField(sqlite3_column_name(stmt, c));
+    out << "\n";
+
+    long long rows = 0;
+    bool cancelled = false;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        for (int c = 0; c < columns; ++c) {
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, c));
+            out << (c ? "," : "") << csvField(text ? text : "");
+        }
+        out << "\n";
+        if (++rows % 1000 == 0 && !jobContinue(job, total ? (double)rows / total : -1)) {
+            cancelled = true;
+            break;
+        }
+    }
+    sqlite3_reset(stmt);
+    endSnapshot(snap);
+    out.close();
+
+    if (cancelled || rc != SQLITE_DONE || !out) {
+        remove(file.c_str());
+        result = cancelled ? "cancelled" : "export failed";
+        return false;
+    }
+    result = "wrote " + to_string(rows) + " rows to " + file;
+    return true;
+}
+
+// Online backup through the backup API, a few pages per step, all read from
+// one snapshot so concurrent sales neither restart nor block it
+bool backupDatabase(DbContext &ctx, Job &job, const string &file, string &result) {
+    ReadSnapshot snap;
+    if (!beginSnapshot(ctx, snap)) {
+        result = "cannot read the database";
+        return false;
+    }
+    sqlite3* dest = nullptr;
+    int rc = sqlite3_open(file.c_str(), &dest);
+    sqlite3_backup* backup = rc == SQLITE_OK ? sqlite3_backup_init(dest, "main", snap.rc->conn, "main") : nullptr;
+    bool cancelled = false;
+    int pages = 0;
+    if (backup) {
+        do {
+            rc = sqlite3_backup_step(backup, 256);
+            pages = sqlite3_backup_pagecount(backup);
+            if (!jobContinue(job, pages ? 1.0 - (double)sqlite3_backup_remaining(backup) / pages : 0)) {
+                cancelled = true;
+                break;
+            }
+            if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) this_thread::sleep_for(chrono::milliseconds(10));
+        } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+        sqlite3_backup_finish(backup);
+    }
+    endSnapshot(snap);
+
+    bool ok = !cancelled && rc == SQLITE_DONE;
+    result = ok ? "copied " + to_string(pages) + " pages to " + file
+                : cancelled ? string("cancelled") : string("backup failed: ") + sqlite3_errmsg(dest);
+    sqlite3_close(dest);
+    if (!ok) remove(file.c_str());
+    return ok;
+}
+
+int vacuumProgress(void* arg) {
+    return jobContinue(*static_cast<Job*>(arg), -1) ? 0 : 1;
+}
+
+// VACUUM holds the write lock until it finishes (queued writes wait behind
+// it), so it runs unthrottled; cancelling interrupts it and rolls it back.
+// It also switches older files to incremental auto-vacuum.
+bool vacuumDatabase(DbContext &ctx, Job &job, string &result) {
+    job.cpuPercent = 100;
+    sqlite3* conn = nullptr;
+    if (sqlite3_open_v2(ctx.path.c_str(), &conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        result = "cannot open the database";
+        sqlite3_close(conn);
+        return false;
+    }
+    sqlite3_busy_timeout(conn, 5000);
+    int before = queryInt(conn, "PRAGMA page_count;");
+    sqlite3_progress_handler(conn, 10000, vacuumProgress, &job);
+    sqlite3_exec(conn, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
+    bool ok = sqlite3_exec(conn, "VACUUM;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_progress_handler(conn, 0, nullptr, nullptr);
+    int after = queryInt(conn, "PRAGMA page_count;");
+    result = ok ? to_string(before) + " -> " + to_string(after) + " pages"
+                : job.cancelRequested ? string("cancelled") : string("VACUUM failed: ") + sqlite3_errmsg(conn);
+    sqlite3_close(conn);
+    return ok;
+}
+
+bool isReportTable(const string &table) {
+    return table == "residents" || table == "incidents" || table == "announcements";
+}
+
+bool (*tableRenderer(const string &table))(DbContext &, ostream &) {
+    if (table == "residents") return renderResidentsTable;
+    if (table == "incidents") return renderIncidentsTable;
+    if (table == "announcements") return renderAnnouncementsTable;
+    return nullptr;
+}
+
+// Queues one of the background jobs by name; nullptr for an unknown one
+shared_ptr<Job> submitNamedJob(DbContext &ctx, JobPool &pool, const string &kind, const string &table, const string &file) {
+    DbContext* c = &ctx;
+    if (kind == "export" && isReportTable(table) && !file.empty())
+        return submitJob(pool, "Export " + file, [c, table, file](Job &job, string &result) {
+            return exportCsv(*c, job, table, file, result);
+        });
+    if (kind == "report" && isReportTable(table) && !file.empty())
+        return submitJob(pool, "Report " + file, [c, table, file](Job &job, string &result) {
+            job.progress = -1;
+            bool ok = writeReport(*c, tableRenderer(table), file, &job.cancelRequested);
+            result = ok ? "wrote " + file : job.cancelRequested ? "partial report in " + file : "cannot write " + file;
+            return ok;
+        });
+    if (kind == "backup" && !file.empty())
+        return submitJob(pool, "Backup " + file, [c, file](Job &job, string &result) {
+            return backupDatabase(*c, job, file, result);
+        });
+    if (kind == "vacuum")
+        return submitJob(pool, "VACUUM", [c](Job &job, string &result) {
+            return vacuumDatabase(*c, job, result);
+        });
+    return nullptr;
+}
+
+void jobsMenu(DbContext &ctx, JobPool &pool) {
+    char option = 'R';
+    while (toupper(option) != 'B') {
+        cout << GREEN << "\n===== Background Jobs =====" << RESET;
+        printJobs(pool);
+        cout << "\n[1] Export Table to CSV  [2] Table Report to File  [3] Backup Database  [4] VACUUM\n"
+             << "[C] Cancel a Job  [R] Refresh  [B] Back\n"
+             << "Choice: ";
+        cin >> option;
+        option = toupper(option);
+
+        const char* kinds[] = {"export", "report", "backup", "vacuum"};
+        if (option >= '1' && option <= '4') {
+            string kind = kinds[option - '1'], table, file;
+            clearInput();
+            if (kind == "export" || kind == "report") {
+                cout << "Table (residents, incidents, announcements): ";
+                getline(cin, table);
+            }
+            if (kind != "vacuum") {
+                cout << "Enter file name: ";
+                getline(cin, file);
+            }
+            if (submitNamedJob(ctx, pool, kind, table, file))
+                cout << GREEN << "Job queued.\n" << RESET;
+            else
+                cout << RED << "Unknown table or missing file name.\n" << RESET;
+        } else if (option == 'C') {
+            long long id;
+            cout << "Job ID to cancel: ";
+            cin >> id;
+            if (!cin || !cancelJob(pool, id)) {
+                cin.clear();
+                cout << RED << "No such job.\n" << RESET;
+            }
+        }
+    }
+}
+
+// ------------------------
+// MAINTENANCE SCHEDULER
+// ------------------------
+// Keeps the file compact and the planner statistics current without taking
+// the program down. A low-priority thread
+//  - checkpoints the WAL once the writer has appended walCheckpointPages
+//    frames (the writer's own auto-checkpoint is switched off for this), and
+//    truncates it while the menu is idle;
+//  - while the menu sits idle at getUserChoice(), hands free pages back with
+//    incremental_vacuum, one bounded chunk per write transaction so queued
+//    writes never wait long behind it;
+//  - re-runs a sampled ANALYZE once enough rows have changed.
+// Only databases created with auto_vacuum=INCREMENTAL can shrink this way;
+// older files are converted by the next VACUUM job.
+const int WAL_CHECKPOINT_PAGES = 1000;
+const int VACUUM_CHUNK_PAGES = 256;
+const int ANALYZE_MIN_CHANGES = 1000;
+const int ANALYZE_ROW_LIMIT = 1000;
+const int MAINTENANCE_IDLE_MS = 2000;
+
+struct Maintenance {
+    DbContext* ctx = nullptr;
+    sqlite3* conn = nullptr;            // checkpoints and status; FULLMUTEX, shared with the CLI
+    int walCheckpointPages = WAL_CHECKPOINT_PAGES;
+    atomic<int> walFrames{0};           // as reported by the writer's WAL hook
+    atomic<int> backfilled{0};
+    long long analyzedAtChanges = 0;
+    long long seenTransactions = -1;
+    mutex stateMutex;
+    condition_variable wake;
+    bool running = false;
+    bool idle = false;
+    chrono::steady_clock::time_point idleSince;
+    thread worker;
+    atomic<long long> checkpoints{0};
+    atomic<long long> vacuumedPages{0};
+    atomic<long long> analyzeRuns{0};
+};
+
+// Runs on the writer thread after every commit; only wakes the scheduler
+int onWalCommit(void* arg, sqlite3*, const char*, int frames) {
+    Maintenance* m = static_cast<Maintenance*>(arg);
+    m->walFrames = frames;
+    if (frames - m->backfilled >= m->walCheckpointPages) m->wake.notify_one();
+    return SQLITE_OK;
+}
+
+// The main menu calls this around getUserChoice()
+void setMenuIdle(Maintenance &m, bool idle) {
+    lock_guard<mutex> lock(m.stateMutex);
+    m.idle = idle;
+    m.idleSince = chrono::steady_clock::now();
+    if (idle) m.wake.notify_one();
+}
+
+bool menuIdle(Maintenance &m) {
+    lock_guard<mutex> lock(m.stateMutex);
+    return m.running && m.idle &&
+           chrono::steady_clock::now() - m.idleSince >= chrono::milliseconds(MAINTENANCE_IDLE_MS);
+}
+
+// PASSIVE never waits for readers; TRUNCATE does (briefly) and also resets the WAL file
+bool checkpointWal(Maintenance &m, int mode) {
+    int logFrames = 0, done = 0;
+    int rc = sqlite3_wal_checkpoint_v2(m.conn, "main", mode, &logFrames, &done);
+    if (rc != SQLITE_OK && rc != SQLITE_BUSY) return false;
+    m.backfilled = mode == SQLITE_CHECKPOINT_TRUNCATE && rc == SQLITE_OK ? 0 : done;
+    if (mode == SQLITE_CHECKPOINT_TRUNCATE && rc == SQLITE_OK) m.walFrames = 0;
+    m.checkpoints++;
+    return rc == SQLITE_OK;
+}
+
+// Frees up to VACUUM_CHUNK_PAGES pages in one write transaction and returns
+// how many free pages are left (0 if the file cannot shrink incrementally)
+int vacuumChunk(Maintenance &m) {
+    Maintenance* mp = &m;
+    return submitWrite(m.ctx->writer, [mp](sqlite3* conn, int &left) {
+        if (queryInt(conn, "PRAGMA auto_vacuum;") != 2) return true;
+        int before = queryInt(conn, "PRAGMA freelist_count;");
+        string sql = "PRAGMA incremental_vacuum(" + to_string(VACUUM_CHUNK_PAGES) + ");";
+        if (sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) return false;
+        left = queryInt(conn, "PRAGMA freelist_count;");
+        mp->vacuumedPages += before - left;
+        return true;
+    }, 0).get();
+}
+
+// Re-samples statistics when there are none yet or enough rows have changed
+bool analyzeIfStale(Maintenance &m) {
+    Maintenance* mp = &m;
+    return submitWrite(m.ctx->writer, [mp](sqlite3* conn, bool &ran) {
+        long long changes = sqlite3_total_changes(conn);
+        bool haveStats = queryInt(conn, "SELECT count(*) FROM sqlite_master WHERE name = 'sqlite_stat1';") > 0;
+        if (haveStats && changes - mp->analyzedAtChanges < ANALYZE_MIN_CHANGES) return true;
+        if (sqlite3_exec(conn, "ANALYZE;", nullptr, nullptr, nullptr) != SQLITE_OK) return false;
+        mp->analyzedAtChanges = changes;
+        mp->analyzeRuns++;
+        ran = true;
+        return true;
+    }, false).get();
+}
+
+// One round of idle work; untilDone keeps going even if the menu wakes up
+void runMaintenancePass(Maintenance &m, bool untilDone) {
+    analyzeIfStale(m);
+    while ((untilDone || menuIdle(m)) && vacuumChunk(m) > 0) {}
+    if (untilDone || menuIdle(m)) checkpointWal(m, SQLITE_CHECKPOINT_TRUNCATE);
+}
+
+void maintenanceLoop(Maintenance* m) {
+    lowerThreadPriority();
+    unique_lock<mutex> lock(m->stateMutex);
+    while (m->running) {
+        m->wake.wait_for(lock, chrono::milliseconds(500));
+        if (!m->running) break;
+        lock.unlock();
+
+        if (m->walFrames < m->backfilled) m->backfilled = 0;    // the writer restarted the WAL
+        if (m->walFrames - m->backfilled >= m->walCheckpointPages)
+            checkpointWal(*m, SQLITE_CHECKPOINT_PASSIVE);
+
+        // Idle passes only repeat after something has been written
+        long long transactions = m->ctx->writer.transactions;
+        if (menuIdle(*m) && transactions != m->seenTransactions) {
+            runMaintenancePass(*m, false);
+            m->seenTransactions = m->ctx->writer.transactions;
+        }
+        lock.lock();
+    }
+}
+
+bool startMaintenance(Maintenance &m, DbContext &ctx, int walCheckpointPages) {
+    m.ctx = &ctx;
+    m.walCheckpointPages = walCheckpointPages;
+    if (sqlite3_open_v2(ctx.path.c_str(), &m.conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_FULLMUTEX, nullptr) != SQLITE_OK) {
+        sqlite3_close(m.conn);
+        m.conn = nullptr;
+        return false;
+    }
+    configureLookaside(m.conn, LOOKASIDE_READER_SLOT, LOOKASIDE_READER_SLOTS);
+    sqlite3_busy_timeout(m.conn, 200);
+
+    // Hooks are installed from the writer thread, which owns its connection
+    Maintenance* mp = &m;
+    submitWrite(ctx.writer, [mp](sqlite3* conn, bool &done) {
+        sqlite3_wal_hook(conn, onWalCommit, mp);
+        string sql = "PRAGMA analysis_limit=" + to_string(ANALYZE_ROW_LIMIT) + ";";
+        sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr);
+        done = true;
+        return true;
+    }, false).get();
+
+    m.running = true;
+    m.worker = thread(maintenanceLoop, &m);
+    return true;
+}
+
+// Hands checkpointing back to the writer and refreshes statistics on the way
+// out, as SQLite recommends doing before a long-lived connection closes
+void stopMaintenance(Maintenance &m) {
+    if (!m.running) return;
+    {
+        lock_guard<mutex> lock(m.stateMutex);
+        m.running = false;
+    }
+    m.wake.notify_one();
+    m.worker.join();
+    submitWrite(m.ctx->writer, [](sqlite3* conn, bool &done) {
+        sqlite3_wal_autocheckpoint(conn, 1000);
+        sqlite3_exec(conn, "PRAGMA optimize;", nullptr, nullptr, nullptr);
+        done = true;
+        return true;
+    }, false).get();
+    sqlite3_close(m.conn);
+    m.conn = nullptr;
+}
+
+void printMaintenance(Maintenance &m) {
+    static const char* modes[] = {"none", "full", "incremental"};
+    int mode = queryInt(m.conn, "PRAGMA auto_vacuum;");
+    cout << "Pages          : " << queryInt(m.conn, "PRAGMA page_count;")
+         << " (" << queryInt(m.conn, "PRAGMA freelist_count;") << " free)\n"
+         << "auto_vacuum    : " << modes[mode >= 0 && mode <= 2 ? mode : 0] << "\n"
+         << "WAL frames     : " << m.walFrames << " (checkpoint every " << m.walCheckpointPages << ")\n"
+         << "Checkpoints    : " << m.checkpoints << "\n"
+         << "Vacuumed pages : " << m.vacuumedPages << "\n"
+         << "ANALYZE runs   : " << m.analyzeRuns << "\n";
+}
+
+// ------------------------
+// CRASH RECOVERY BENCHMARK
+// ------------------------
+// A child process fills a scratch WAL database and dies without closing it,
+// optionally after a simulated power cut (see IO_FAULTS cut=N) has silently
+// dropped its later writes. The parent then times how long the first
+// connection takes to recover the WAL and checks what survived.
+const int RECOVERY_ROWS_PER_TXN = 100;
+
+// Runs in the child process and never returns
+int recoveryChild(const string &path, int rows, long long cutAfterWrites) {
+    ioFaults.powerCutAfter = cutAfterWrites;
+    sqlite3* conn;
+    sqlite3_open(path.c_str(), &conn);
+    sqlite3_exec(conn, "PRAGMA journal_mode=WAL; PRAGMA wal_autocheckpoint=0;"
+                       "CREATE TABLE IF NOT EXISTS rows (id INTEGER PRIMARY KEY, payload TEXT);",
+                 nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(conn, "INSERT INTO rows (payload) VALUES (printf('recovery row %d', ?));", -1, &stmt, nullptr);
+    for (int i = 0; i < rows; ++i) {
+        if (i % RECOVERY_ROWS_PER_TXN == 0) sqlite3_exec(conn, "BEGIN;", nullptr, nullptr, nullptr);
+        sqlite3_bind_int(stmt, 1, i);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (i % RECOVERY_ROWS_PER_TXN == RECOVERY_ROWS_PER_TXN - 1 || i == rows - 1)
+            sqlite3_exec(conn, "COMMIT;", nullptr, nullptr, nullptr);
+    }
+    cout << flush;
+    _Exit(0);   // no sqlite3_close(): the WAL and its index stay behind
+}
+
+int benchmarkRecovery(const string &self, int rows, long long cutAfterWrites) {
+    const string path = "bench-recovery.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+    };
+    removeScratch();
+
+    string command = "\"" + self + "\" recovery-child " + path + " " + to_string(rows) + " " + to_string(cutAfterWrites);
+    auto start = chrono::steady_clock::now();
+    if (system(command.c_str()) != 0) {
+        cerr << RED << "The writer process failed.\n" << RESET;
+        removeScratch();
+        return 1;
+    }
+    double fillMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    error_code ec;
+    auto walBytes = filesystem::file_size(path + "-wal", ec);
+    if (ec) walBytes = 0;
 
-    const char* sql_search = "SELECT name, address, contact FROM residents WHERE name LIKE ?;";
+    // The first read on the first connection rebuilds the WAL index
+    IoTotals io = ioTotals();
+    start = chrono::steady_clock::now();
+    sqlite3* conn;
+    sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READWRITE, nullptr);
+    int survived = queryInt(conn, "SELECT count(*) FROM rows;");
+    double recoveryMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
     sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_search, -1, &stmt, nullptr);
-    string pattern = "%" + keyword + "%";
-    sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_STATIC);
-
-    cout << GREEN << "\n===== Search Results =====\n" << RESET;
-    bool found = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        found = true;
-        string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        string addr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        string contact = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        cout << "Name   : " << name << "\nAddress: " << addr << "\nContact: " << contact << "\n------------------\n";
+    string integrity = "unknown";
+    if (sqlite3_prepare_v2(conn, "PRAGMA integrity_check;", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) integrity = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        sqlite3_finalize(stmt);
     }
-    if (!found) cout << RED << "No matching residents found.\n" << RESET;
-    sqlite3_finalize(stmt);
+    sqlite3_close(conn);
+    removeScratch();
+
+    cout << fixed << setprecision(1)
+         << "writer          : " << rows << " rows in " << fillMs << " ms"
+         << (cutAfterWrites >= 0 ? ", power cut after " + to_string(cutAfterWrites) + " writes" : string()) << "\n"
+         << "WAL left behind : " << walBytes / 1024 << " KiB\n"
+         << "recovery        : " << recoveryMs << " ms (open + first read)\n"
+         << "rows survived   : " << survived << " of " << rows << "\n"
+         << "integrity_check : " << integrity << "\n" << defaultfloat << setprecision(6);
+    printIoSince(io);
+    printMemory();
+    return integrity == "ok" ? 0 : 1;
 }
 
-void deleteResident() {
-    cout << GREEN << "\n===== Current Residents =====\n" << RESET;
-    displayResidentsTable();
+// ------------------------
+// MEMORY BENCHMARK
+// ------------------------
+// Builds a scratch incidents table of `rows` rows and runs the read paths the
+// program uses over it (aggregate scan, text search, point lookups), printing
+// memory after each phase. The goal is under 20 MiB resident at 1M rows.
+const long long MEMORY_TARGET_KB = 20 * 1024;
 
-    clearInput();
-    string name;
-    cout << "Enter resident name to delete: ";
-    getline(cin, name);
+int benchmarkMemory(int rows) {
+    const string path = "bench-memory.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+    };
+    removeScratch();
+
+    sqlite3* conn;
+    if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK) {
+        cerr << RED << "Cannot create " << path << RESET << endl;
+        sqlite3_close(conn);
+        return 1;
+    }
+    configureLookaside(conn, LOOKASIDE_WRITER_SLOT, LOOKASIDE_WRITER_SLOTS);
+
+    auto start = chrono::steady_clock::now();
+    auto phase = [&](const string &name) {
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << left << setw(16) << name << ": " << (long long)ms << " ms\n" << right;
+        printMemory();
+        start = chrono::steady_clock::now();
+    };
 
-    const char* sql_delete = "DELETE FROM residents WHERE name=?;";
     sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, sql_delete, -1, &stmt, nullptr);
-    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+    bool ok = sqlite3_exec(conn, "CREATE TABLE incidents (id INTEGER PRIMARY KEY AUTOINCREMENT, type TEXT, location TEXT, "
+                                    "occurred_at INTEGER, description TEXT);", nullptr, nullptr, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(conn, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < ?1) "
+                                    "INSERT INTO incidents (type, location, occurred_at, description) "
+                                    "SELECT printf('type %d', i % 12), printf('Purok %d', i % 7), "
+                                    "1704067200 + (i % 336) * 86400 + 28800, "
+                                    "printf('incident report number %d', i) FROM n;", -1, &stmt, nullptr) == SQLITE_OK;
+    if (ok) {
+        sqlite3_bind_int(stmt, 1, rows);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+    }
+    if (!ok) {
+        cerr << RED << "Fill failed: " << sqlite3_errmsg(conn) << RESET << endl;
+        sqlite3_close(conn);
+        removeScratch();
+        return 1;
+    }
+    phase("fill " + to_string(rows));
 
-    if (sqlite3_step(stmt) == SQLITE_DONE)
-        cout << GREEN << "\nResident deleted successfully!\n" << RESET;
-    else
-        cout << RED << "\nResident not found or deletion failed.\n" << RESET;
+    sqlite3_exec(conn, "SELECT type, count(*) FROM incidents GROUP BY type;", nullptr, nullptr, nullptr);
+    phase("aggregate");
+    sqlite3_exec(conn, "SELECT count(*) FROM incidents WHERE description LIKE '%12345%';", nullptr, nullptr, nullptr);
+    phase("search");
+    if (sqlite3_prepare_v2(conn, "SELECT type, location, description FROM incidents WHERE id = ?;", -1, &stmt, nullptr) == SQLITE_OK) {
+        for (int i = 0; i < 10000; ++i) {
+            sqlite3_bind_int(stmt, 1, 1 + (int)((i * 7919LL) % max(rows, 1)));
+            while (sqlite3_step(stmt) == SQLITE_ROW) {}
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    phase("10k lookups");
 
-    sqlite3_finalize(stmt);
-    cout << GREEN << "\n===== Updated Resident Records =====\n" << RESET;
-    displayResidentsTable();
+    sqlite3_close(conn);
+    removeScratch();
+    long long rssKb, peakKb;
+    processMemory(rssKb, peakKb);
+    if (peakKb)
+        cout << "peak RSS " << peakKb / 1024 << " MiB: " << (peakKb < MEMORY_TARGET_KB ? GREEN "within" : RED "over")
+             << " the 20 MiB target" << RESET << "\n";
+    return 0;
 }
 
 // ------------------------
-// INCIDENTS
+// NAME SEARCH BENCHMARK
 // ------------------------
-void displayIncidentsTable() {
-    const char* sql_select = "SELECT type, location, date, time, description FROM incidents;";
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << RED << "Failed to fetch incidents.\n" << RESET;
-        return;
-    }
+// Fills a scratch residents table with `rows` generated Filipino names
+// (surnames in their usual spellings, "Dela Cruz" / "De la Cruz" /
+// "Delacruz" among them), builds the trigram index and times the old
+// LIKE '%keyword%' query against the trigram search for a set of keywords,
+// misspellings included. The goal is under 20 ms a search at 1M names.
+const double NAME_SEARCH_TARGET_MS = 20;
 
-    int typeWidth = 15, locWidth = 20, dateWidth = 12, timeWidth = 8, descWidth = 40;
-    int totalWidth = typeWidth + locWidth + dateWidth + timeWidth + descWidth + 11;
+const vector<string> BENCH_FIRST_NAMES = {
+    "Juan", "Maria", "Jose", "Ana", "Pedro", "Rosa", "Antonio", "Carmen", "Manuel", "Teresita",
+    "Ramon", "Luz", "Eduardo", "Josefina", "Ricardo", "Corazon", "Roberto", "Lourdes", "Fernando", "Imelda",
+    "Rodrigo", "Marites", "Danilo", "Remedios", "Ernesto", "Leonora", "Rolando", "Erlinda", "Arnel", "Maricel",
+    "Jerome", "Kristine", "Mark", "Angelica", "John Paul", "Mary Grace", "Christian", "Princess", "Rhea", "Jun"};
+const vector<string> BENCH_SURNAMES = {
+    "Dela Cruz", "De la Cruz", "Delacruz", "Santos", "Reyes", "Bautista", "Ocampo", "Garcia", "Mendoza", "Torres",
+    "Villanueva", "Ramos", "Aquino", "Castillo", "Flores", "Gonzales", "Rivera", "Fernandez", "Lopez", "Mercado",
+    "Pascual", "Navarro", "Soriano", "Salazar", "De Guzman", "Del Rosario", "Dimaculangan", "Macapagal",
+    "Panganiban", "Magsaysay", "Quizon", "Buenaventura", "Evangelista", "Manalastas", "Sison", "Tolentino",
+    "Valdez", "Yap", "Tan", "Lim", "Go", "Sy", "Co", "Ong", "Zamora", "Cabrera", "Dizon", "Gatchalian",
+    "Ilagan", "Jimenez", "Katigbak", "Lacson", "Marcos", "Nepomuceno", "Ortega", "Padilla", "Quiambao",
+    "Roxas", "Samonte", "Umali"};
 
-    // Table header
-    cout << "+" << string(totalWidth - 2, '-') << "+\n";
-    cout << CYAN
-         << "| " << left << setw(typeWidth) << "Type"
-         << "| " << setw(locWidth) << "Location"
-         << "| " << setw(dateWidth) << "Date"
-         << "| " << setw(timeWidth) << "Time"
-         << "| " << setw(descWidth) << "Description"
-         << "|\n" << RESET;
-    cout << "+" << string(totalWidth - 2, '-') << "+\n";
+long long benchNameCount() {
+    return (long long)BENCH_FIRST_NAMES.size() * BENCH_FIRST_NAMES.size() * 26 * BENCH_SURNAMES.size();
+}
 
-    // Helper to wrap text into multiple lines
-    auto wrapText = [](const string &text, int width) -> vector<string> {
-        vector<string> lines;
-        size_t start = 0;
-        while (start < text.length()) {
-            lines.push_back(text.substr(start, width));
-            start += width;
-        }
-        return lines;
+// Every i a different name: i is spread over all combinations by a
+// multiplier coprime to their count
+string benchResidentName(long long i) {
+    long long c = i * 1000003 % benchNameCount();
+    string name = BENCH_FIRST_NAMES[c % BENCH_FIRST_NAMES.size()] + " ";
+    c /= BENCH_FIRST_NAMES.size();
+    name += BENCH_FIRST_NAMES[c % BENCH_FIRST_NAMES.size()] + " ";
+    c /= BENCH_FIRST_NAMES.size();
+    name += string(1, (char)('A' + c % 26)) + ". ";
+    return name + BENCH_SURNAMES[c / 26];
+}
+
+int benchmarkNameSearch(int rows) {
+    const string path = "bench-names.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
     };
+    removeScratch();
 
-    // Table rows
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        string type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        string loc = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        string time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        string desc = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+    sqlite3* conn;
+    if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK) {
+        cerr << RED << "Cannot create " << path << RESET << endl;
+        sqlite3_close(conn);
+        return 1;
+    }
+    configureLookaside(conn, LOOKASIDE_WRITER_SLOT, LOOKASIDE_WRITER_SLOTS);
 
-        vector<string> typeLines = wrapText(type, typeWidth);
-        vector<string> locLines = wrapText(loc, locWidth);
-        vector<string> dateLines = wrapText(date, dateWidth);
-        vector<string> timeLines = wrapText(time, timeWidth);
-        vector<string> descLines = wrapText(desc, descWidth);
+    rows = (int)min<long long>(rows, benchNameCount());
 
-        size_t maxLines = max({typeLines.size(), locLines.size(), dateLines.size(), timeLines.size(), descLines.size()});
+    auto start = chrono::steady_clock::now();
+    auto elapsedMs = [&start] {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
 
-        for (size_t i = 0; i < maxLines; ++i) {
-            cout << "| "
-                 << left << setw(typeWidth) << (i < typeLines.size() ? typeLines[i] : "")
-                 << "| " << setw(locWidth) << (i < locLines.size() ? locLines[i] : "")
-                 << "| " << setw(dateWidth) << (i < dateLines.size() ? dateLines[i] : "")
-                 << "| " << setw(timeWidth) << (i < timeLines.size() ? timeLines[i] : "")
-                 << "| " << setw(descWidth) << (i < descLines.size() ? descLines[i] : "")
-                 << "|\n";
+    sqlite3_stmt* insert;
+    bool ok = sqlite3_exec(conn, "CREATE TABLE residents (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT UNIQUE, "
+                                    "address TEXT, contact TEXT); BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(conn, "INSERT INTO residents (name, address, contact) VALUES (?,?,?);",
+                                 -1, &insert, nullptr) == SQLITE_OK;
+    for (int i = 0; i < rows && ok; ++i) {
+        string name = benchResidentName(i);
+        string address = "Purok " + to_string(i % 7);
+        string contact = "09" + to_string(100000000 + i);
+        sqlite3_bind_text(insert, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(insert, 2, address.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(insert, 3, contact.c_str(), -1, SQLITE_TRANSIENT);
+        ok = sqlite3_step(insert) == SQLITE_DONE;
+        sqlite3_reset(insert);
+    }
+    if (ok) sqlite3_finalize(insert);
+    ok = ok && sqlite3_exec(conn, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    cout << "fill " << rows << " names: " << (long long)elapsedMs() << " ms\n";
+
+    start = chrono::steady_clock::now();
+    ok = ok && sqlite3_exec(conn, ("BEGIN;" + residentTrigramSchema() + residentTrigramFill() + "COMMIT;").c_str(),
+                            nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (!ok) {
+        cerr << RED << "Setup failed: " << sqlite3_errmsg(conn) << RESET << endl;
+        sqlite3_close(conn);
+        removeScratch();
+        return 1;
+    }
+    cout << "trigram index: " << (long long)elapsedMs() << " ms\n\n";
+
+    map<string, sqlite3_stmt*> statements;
+    auto statement = [&](const string &sql) {
+        sqlite3_stmt* &stmt = statements[sql];
+        if (!stmt) sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr);
+        return stmt;
+    };
+
+    const vector<string> keywords = {"Dela Cruz", "De la Cruz", "delacruz", "Dela Crus", "Villanueba",
+                                     "Dimaculangn", "Maricel Santos", "Gatchalian", "Katigbac", "Jo"};
+    const int runs = 5;
+    double worstMs = 0;
+    cout << left << setw(16) << "Keyword" << setw(12) << "LIKE ms" << setw(12) << "LIKE rows"
+         << setw(14) << "trigram ms" << "best match" << "\n";
+    for (auto &keyword : keywords) {
+        sqlite3_stmt* like = statement("SELECT name FROM residents WHERE name LIKE ?;");
+        string pattern = "%" + keyword + "%";
+        long long likeRows = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < runs; ++r) {
+            sqlite3_bind_text(like, 1, pattern.c_str(), -1, SQLITE_TRANSIENT);
+            likeRows = 0;
+            while (sqlite3_step(like) == SQLITE_ROW) ++likeRows;
+            sqlite3_reset(like);
         }
+        double likeMs = elapsedMs() / runs;
+
+        vector<ResidentMatch> matches;
+        start = chrono::steady_clock::now();
+        bool fuzzy = true;
+        for (int r = 0; r < runs; ++r) fuzzy = fuzzyResidentSearch(statement, keyword, matches);
+        double fuzzyMs = elapsedMs() / runs;
+        if (fuzzy) worstMs = max(worstMs, fuzzyMs);
 
-        cout << "+" << string(totalWidth - 2, '-') << "+\n";
+        cout << left << setw(16) << keyword << fixed << setprecision(1) << setw(12) << likeMs << setw(12) << likeRows
+             << setw(14);
+        if (!fuzzy) cout << "-" << "(too short for trigrams: LIKE)";
+        else cout << fuzzyMs << (matches.empty() ? "none" : matches[0].name) << " +" << matches.size() - min<size_t>(1, matches.size());
+        cout << "\n" << defaultfloat << right;
     }
 
-    sqlite3_finalize(stmt);
+    for (auto &entry : statements) sqlite3_finalize(entry.second);
+    sqlite3_close(conn);
+    removeScratch();
+    cout << "\nslowest trigram search " << fixed << setprecision(1) << worstMs << " ms: " << defaultfloat
+         << (worstMs < NAME_SEARCH_TARGET_MS ? GREEN "within" : RED "over") << " the 20 ms target" << RESET << "\n";
+    return 0;
 }
 
-void reportIncident() {
-    char more = 'Y';
-    while (toupper(more) == 'Y') {
-        string type, location, date, time, description;
-        clearInput();
-        cout << "Enter Incident Type: ";
-        getline(cin, type);
-        cout << "Enter Location: ";
-        getline(cin, location);
-        cout << "Enter Date (YYYY-MM-DD): ";
-        getline(cin, date);
-        cout << "Enter Time (HH:MM): ";
-        getline(cin, time);
-        cout << "Enter Description: ";
-        getline(cin, description);
+// ------------------------
+// SUGGESTION BENCHMARK
+// ------------------------
+// Loads `rows` generated names into a name index and reports its size, then
+// types a few names one key at a time (as typed, in any case) and times the
+// suggestions after every key: a keystroke allows under 1 ms. Last, a tenth
+// of the names are renamed and then deleted through the same path commits take.
+const double SUGGESTION_TARGET_MS = 1;
 
-        const char* sql_insert = "INSERT INTO incidents (type, location, date, time, description) VALUES (?,?,?,?,?);";
-        sqlite3_stmt* stmt;
-        sqlite3_prepare_v2(db, sql_insert, -1, &stmt, nullptr);
-        sqlite3_bind_text(stmt, 1, type.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, location.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, date.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, time.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 5, description.c_str(), -1, SQLITE_STATIC);
-
-        if (sqlite3_step(stmt) == SQLITE_DONE)
-            cout << GREEN << "\nIncident reported successfully!\n" << RESET;
-        else
-            cout << RED << "\nError reporting incident.\n" << RESET;
-        sqlite3_finalize(stmt);
+int benchmarkSuggestions(int rows) {
+    rows = (int)min<long long>(rows, benchNameCount());
+    vector<string> names;
+    names.reserve(rows);
+    size_t nameBytes = 0;
+    for (int i = 0; i < rows; ++i) {
+        names.push_back(benchResidentName(i));
+        nameBytes += names.back().size();
+    }
+    sort(names.begin(), names.end());       // the order startNameIndex reads them in
 
-        cout << GREEN << "\n===== Updated Incident Records =====\n" << RESET;
-        displayIncidentsTable();
+    auto start = chrono::steady_clock::now();
+    auto elapsedMs = [&start] {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
 
-        cout << "\nReport another incident? (Y/N): ";
-        cin >> more;
+    NameIndex index;
+    {
+        lock_guard<mutex> lock(index.lock);
+        for (auto &name : names) trieInsert(index.trie, name);
+        shrinkTrie(index.trie);
+        index.loaded = true;
     }
+    cout << "load " << rows << " names: " << (long long)elapsedMs() << " ms\n";
+    printNameIndex(index);
+    cout << "names as text   : " << fixed << setprecision(1) << nameBytes / 1048576.0 << " MiB\n\n" << defaultfloat;
+
+    const vector<string> typed = {"Maricel Mary Grace L. Santos", "jose jun n. dimaculangan", "Ana Mark A. De la Cruz",
+                                  "JOHN PAUL", "Princess Rhea", "Zaldy"};
+    double worstMs = 0;
+    cout << left << setw(30) << "Typed" << setw(7) << "keys" << setw(10) << "mean us" << setw(10) << "worst us"
+         << "shown after the last key\n";
+    for (auto &text : typed) {
+        double totalMs = 0, slowestMs = 0;
+        vector<string> shown;
+        for (size_t keys = 1; keys <= text.size(); ++keys) {
+            start = chrono::steady_clock::now();
+            shown = suggestNames(index, text.substr(0, keys), NAME_SUGGESTIONS);
+            double ms = elapsedMs();
+            totalMs += ms;
+            slowestMs = max(slowestMs, ms);
+        }
+        worstMs = max(worstMs, slowestMs);
+        cout << left << setw(30) << text << setw(7) << text.size() << fixed << setprecision(1)
+             << setw(10) << totalMs * 1000 / text.size() << setw(10) << slowestMs * 1000
+             << (shown.empty() ? "none" : shown[0]) << (shown.size() > 1 ? " +" + to_string(shown.size() - 1) : "")
+             << "\n" << defaultfloat << right;
+    }
+
+    vector<NameChange> renames, deletes;
+    for (size_t i = 0; i < names.size(); i += 10) {
+        NameChange rename;
+        rename.hasOld = rename.hasNew = true;
+        rename.oldName = names[i];
+        rename.newName = names[i] + " Jr.";
+        renames.push_back(rename);
+        NameChange gone;
+        gone.hasOld = true;
+        gone.oldName = rename.newName;
+        deletes.push_back(gone);
+    }
+    start = chrono::steady_clock::now();
+    applyNameChanges(index, renames);
+    double renameMs = elapsedMs();
+    start = chrono::steady_clock::now();
+    applyNameChanges(index, deletes);
+    double deleteMs = elapsedMs();
+    cout << "\n" << renames.size() << " renames: " << fixed << setprecision(2) << renameMs * 1000 / renames.size()
+         << " us each, " << deletes.size() << " deletes: " << deleteMs * 1000 / deletes.size() << " us each\n"
+         << defaultfloat;
+    printNameIndex(index);
+
+    cout << "\nslowest keystroke " << fixed << setprecision(3) << worstMs << " ms: " << defaultfloat
+         << (worstMs < SUGGESTION_TARGET_MS ? GREEN "within" : RED "over") << " the 1 ms target" << RESET << "\n";
+    return 0;
 }
 
 // ------------------------
-// ANNOUNCEMENTS
+// ROLLUP BENCHMARK
 // ------------------------
-void displayAnnouncementsTable() {
-    const char* sql_select = "SELECT title, date, content FROM announcements;";
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << RED << "Failed to fetch announcements.\n" << RESET;
-        return;
+// Fills a scratch incidents table with `rows` incidents over the last three
+// years, then times an insert without and with the rollup triggers, and the
+// trends and monthly report read from the rollups against the same queries
+// counting the incidents themselves. Both must give the same numbers.
+const double ROLLUP_TARGET_MS = 20;
+
+int benchmarkRollups(int rows) {
+    const string path = "bench-rollups.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+    };
+    removeScratch();
+
+    sqlite3* conn;
+    if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK) {
+        cerr << RED << "Cannot create " << path << RESET << endl;
+        sqlite3_close(conn);
+        return 1;
     }
+    auto start = chrono::steady_clock::now();
+    auto elapsedMs = [&start] {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+    auto fail = [&](const string &what) {
+        cerr << RED << what << " failed: " << sqlite3_errmsg(conn) << RESET << endl;
+        sqlite3_close(conn);
+        removeScratch();
+        return 1;
+    };
 
-    int titleWidth = 25, dateWidth = 12, contentWidth = 40;
-    int totalWidth = titleWidth + dateWidth + contentWidth + 7;
+    // Incident i happens at a spread-out moment of the last 1095 days
+    const long long now = (long long)time(nullptr), span = 1095 * 86400LL;
+    const string fillSql =
+        "WITH RECURSIVE n(i) AS (SELECT ?1 UNION ALL SELECT i + 1 FROM n WHERE i < ?2) "
+        "INSERT INTO incidents (type, location, occurred_at, description) "
+        "SELECT printf('type %d', i * 7 % 12), printf('Purok %d', i * 13 % 9 + 1), ?3 - i * 2654435761 % ?4, "
+        "printf('incident report number %d', i) FROM n;";
+    sqlite3_stmt* fill;
+    if (sqlite3_exec(conn, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL; "
+                           "CREATE TABLE incidents (id INTEGER PRIMARY KEY AUTOINCREMENT, type TEXT, location TEXT, "
+                           "occurred_at INTEGER, description TEXT);", nullptr, nullptr, nullptr) != SQLITE_OK ||
+        sqlite3_exec(conn, INCIDENT_INDEXES, nullptr, nullptr, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, fillSql.c_str(), -1, &fill, nullptr) != SQLITE_OK)
+        return fail("Setup");
+    auto insert = [&](long long first, long long last) {
+        sqlite3_bind_int64(fill, 1, first);
+        sqlite3_bind_int64(fill, 2, last);
+        sqlite3_bind_int64(fill, 3, now);
+        sqlite3_bind_int64(fill, 4, span);
+        bool ok = sqlite3_step(fill) == SQLITE_DONE;
+        sqlite3_reset(fill);
+        return ok;
+    };
+    // One incident per statement, all in one transaction: the CPU cost of an
+    // insert, not of a commit
+    const int singles = 20000;
+    auto insertSingles = [&](long long first) {
+        bool ok = sqlite3_exec(conn, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        for (long long i = first; i < first + singles && ok; ++i) ok = insert(i, i);
+        return sqlite3_exec(conn, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr) == SQLITE_OK && ok;
+    };
 
-    // Table header
-    cout << "+" << string(totalWidth - 2, '-') << "+\n";
-    cout << CYAN
-         << "| " << left << setw(titleWidth) << "Title"
-         << "| " << setw(dateWidth) << "Date"
-         << "| " << setw(contentWidth) << "Content"
-         << "|\n" << RESET;
-    cout << "+" << string(totalWidth - 2, '-') << "+\n";
+    if (!insert(1, rows)) return fail("Fill");
+    cout << "fill " << rows << " incidents: " << (long long)elapsedMs() << " ms\n";
+    start = chrono::steady_clock::now();
+    if (!insertSingles(rows + 1)) return fail("Insert");
+    double plainUs = elapsedMs() * 1000 / singles;
+    start = chrono::steady_clock::now();
+    if (sqlite3_exec(conn, (incidentRollupSchema() + incidentRollupFill()).c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+        return fail("Rollups");
+    cout << "count into rollups: " << (long long)elapsedMs() << " ms\n";
+    start = chrono::steady_clock::now();
+    if (!insertSingles(rows + singles + 1)) return fail("Insert");
+    double rollupUs = elapsedMs() * 1000 / singles;
+    sqlite3_finalize(fill);
+    cout << "insert, no rollups: " << fixed << setprecision(1) << plainUs << " us per incident\n"
+         << "insert, rollups   : " << rollupUs << " us per incident\n\n" << defaultfloat;
 
-    auto wrapText = [](const string &text, int width) -> vector<string> {
-        vector<string> lines;
-        size_t start = 0;
-        while (start < text.length()) {
-            lines.push_back(text.substr(start, width));
-            start += width;
-        }
-        return lines;
+    map<string, sqlite3_stmt*> statements;
+    auto statement = [&](const string &sql) {
+        sqlite3_stmt* &stmt = statements[sql];
+        if (!stmt) sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr);
+        return stmt;
     };
+    const string asOf = localToday(), month = asOf.substr(0, 7);
+    const int runs = 20;
+    IncidentTrends trends[2];
+    IncidentMonth months[2];
+    double trendMs[2], monthMs[2];
+    bool ok = true;
+    for (int rollups = 1; rollups >= 0; --rollups) {
+        int times = rollups ? runs : 1;
+        vector<string> from = trendSources(rollups);
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < times; ++r) ok = loadIncidentTrends(statement, from, asOf, trends[rollups]) && ok;
+        trendMs[rollups] = elapsedMs() / times;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < times; ++r) ok = loadIncidentMonth(statement, from, month, months[rollups]) && ok;
+        monthMs[rollups] = elapsedMs() / times;
+    }
+    for (auto &entry : statements) sqlite3_finalize(entry.second);
+    if (!ok) return fail("Trends");
+    sqlite3_close(conn);
+    removeScratch();
 
-    // Table rows
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        string title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        string content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    auto sameRows = [](const vector<TrendRow> &a, const vector<TrendRow> &b) {
+        return equal(a.begin(), a.end(), b.begin(), b.end(), [](const TrendRow &x, const TrendRow &y) {
+            return x.name == y.name && equal(x.counts, x.counts + TREND_WINDOW_COUNT, y.counts);
+        });
+    };
+    const IncidentTrends &r = trends[1], &s = trends[0];
+    bool same = equal(r.totals, r.totals + TREND_WINDOW_COUNT, s.totals) &&
+                equal(r.previous, r.previous + TREND_WINDOW_COUNT, s.previous) &&
+                equal(r.hours, r.hours + 24, s.hours) && sameRows(r.types, s.types) &&
+                sameRows(r.locations, s.locations) && months[1].total == months[0].total &&
+                months[1].previousTotal == months[0].previousTotal && months[1].types == months[0].types &&
+                months[1].locations == months[0].locations && months[1].busiestDay == months[0].busiestDay;
 
-        vector<string> titleLines = wrapText(title, titleWidth);
-        vector<string> dateLines = wrapText(date, dateWidth);
-        vector<string> contentLines = wrapText(content, contentWidth);
+    cout << left << setw(28) << "Report" << setw(14) << "rollups ms" << setw(14) << "incidents ms" << "\n"
+         << fixed << setprecision(3)
+         << setw(28) << "trends to " + asOf << setw(14) << trendMs[1] << setw(14) << trendMs[0] << "\n"
+         << setw(28) << "monthly report " + month << setw(14) << monthMs[1] << setw(14) << monthMs[0] << "\n"
+         << defaultfloat << right;
+    cout << "last 30 days: " << r.totals[1] << " incidents, rollups and incidents "
+         << (same ? GREEN "agree" : RED "DISAGREE") << RESET << "\n";
 
-        size_t maxLines = max({titleLines.size(), dateLines.size(), contentLines.size()});
+    double worstMs = max(trendMs[1], monthMs[1]);
+    cout << "\nslowest rollup report " << fixed << setprecision(3) << worstMs << " ms: " << defaultfloat
+         << (worstMs < ROLLUP_TARGET_MS && same ? GREEN "within" : RED "over") << " the 20 ms target" << RESET << "\n";
+    return same ? 0 : 1;
+}
 
-        for (size_t i = 0; i < maxLines; ++i) {
-            cout << "| "
-                 << left << setw(titleWidth) << (i < titleLines.size() ? titleLines[i] : "")
-                 << "| " << setw(dateWidth) << (i < dateLines.size() ? dateLines[i] : "")
-                 << "| " << setw(contentWidth) << (i < contentLines.size() ? contentLines[i] : "")
-                 << "|\n";
-        }
+// ------------------------
+// BITMAP INDEX BENCHMARK
+// ------------------------
+// Fills a scratch incidents table with `rows` incidents over the last three
+// years, entered in roughly the order they happened as at a barangay hall,
+// and loads the bitmap index from it, applies 10000 more incidents the
+// way the triggers hand them over, then counts a set of drill-down filters
+// with the index and with SQL over the composite incident indexes. Both must
+// give the same counts.
+const double BITMAP_COUNT_TARGET_US = 100;
+
+int benchmarkBitmaps(int rows) {
+    const string path = "bench-bitmaps.db";
+    auto removeScratch = [&] {
+        remove(path.c_str());
+        remove((path + "-journal").c_str());
+        remove((path + "-wal").c_str());
+        remove((path + "-shm").c_str());
+    };
+    removeScratch();
 
-        cout << "+" << string(totalWidth - 2, '-') << "+\n";
+    sqlite3* conn;
+    if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK) {
+        cerr << RED << "Cannot create " << path << RESET << endl;
+        sqlite3_close(conn);
+        return 1;
     }
+    auto start = chrono::steady_clock::now();
+    auto elapsedMs = [&start] {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+    map<string, sqlite3_stmt*> statements;
+    auto fail = [&](const string &what) {
+        cerr << RED << what << " failed: " << sqlite3_errmsg(conn) << RESET << endl;
+        for (auto &entry : statements) sqlite3_finalize(entry.second);
+        sqlite3_close(conn);
+        removeScratch();
+        return 1;
+    };
+    auto statement = [&](const string &sql) {
+        sqlite3_stmt* &stmt = statements[sql];
+        if (!stmt) sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr);
+        return stmt;
+    };
 
-    sqlite3_finalize(stmt);
-}
+    // Incident i of n happens i/n of the way through the last 1095 days, give
+    // or take three days
+    const long long now = (long long)time(nullptr), span = 1095 * 86400LL;
+    const int added = 10000;
+    sqlite3_stmt* fill;
+    if (sqlite3_exec(conn, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL; "
+                           "CREATE TABLE incidents (id INTEGER PRIMARY KEY AUTOINCREMENT, type TEXT, location TEXT, "
+                           "occurred_at INTEGER, description TEXT);", nullptr, nullptr, nullptr) != SQLITE_OK ||
+        sqlite3_exec(conn, INCIDENT_INDEXES, nullptr, nullptr, nullptr) != SQLITE_OK ||
+        !(fill = statement("WITH RECURSIVE n(i) AS (SELECT ?1 UNION ALL SELECT i + 1 FROM n WHERE i < ?2) "
+                           "INSERT INTO incidents (type, location, occurred_at, description) "
+                           "SELECT printf('type %d', i * 7 % 12), printf('Purok %d', i * 1103515245 / 65536 % 12 + 1), "
+                           "min(?3, ?3 - ?4 + ?4 * i / ?5 + i * 2654435761 % 518400 - 259200), "
+                           "printf('incident report number %d', i) FROM n;")))
+        return fail("Setup");
+    auto insert = [&](long long first, long long last) {
+        sqlite3_bind_int64(fill, 1, first);
+        sqlite3_bind_int64(fill, 2, last);
+        sqlite3_bind_int64(fill, 3, now);
+        sqlite3_bind_int64(fill, 4, span);
+        sqlite3_bind_int64(fill, 5, rows + added);
+        bool ok = sqlite3_step(fill) == SQLITE_DONE;
+        sqlite3_reset(fill);
+        return ok;
+    };
+    if (!insert(1, rows) || sqlite3_exec(conn, "ANALYZE;", nullptr, nullptr, nullptr) != SQLITE_OK)
+        return fail("Fill");
+    cout << "fill " << rows << " incidents: " << (long long)elapsedMs() << " ms\n";
 
-void addAnnouncement() {
-    char more = 'Y';
-    while (toupper(more) == 'Y') {
-        string title, date, content;
-        clearInput();
-        cout << "Enter Title: ";
-        getline(cin, title);
-        cout << "Enter Date (YYYY-MM-DD): ";
-        getline(cin, date);
-        cout << "Enter Content: ";
-        getline(cin, content);
+    IncidentBitmaps index;
+    start = chrono::steady_clock::now();
+    sqlite3_stmt* load = statement(SQL_INCIDENT_DIMENSIONS);
+    if (!load || !loadIncidentBitmaps(index, load)) return fail("Load");
+    cout << "load bitmaps: " << (long long)elapsedMs() << " ms, " << fixed << setprecision(1)
+         << incidentBitmapBytes(index) / 1048576.0 << " MiB for " << index.values[0].size() << " types, "
+         << index.values[1].size() << " locations, " << index.values[2].size() << " months\n" << defaultfloat;
 
-        const char* sql_insert = "INSERT INTO announcements (title, date, content) VALUES (?,?,?);";
-        sqlite3_stmt* stmt;
-        sqlite3_prepare_v2(db, sql_insert, -1, &stmt, nullptr);
-        sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, date.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, content.c_str(), -1, SQLITE_STATIC);
-
-        if (sqlite3_step(stmt) == SQLITE_DONE)
-            cout << GREEN << "\nAnnouncement posted successfully!\n" << RESET;
-        else
-            cout << RED << "\nError posting announcement.\n" << RESET;
-        sqlite3_finalize(stmt);
+    // More incidents, handed to the index as the triggers would after a commit
+    vector<IncidentChange> changes;
+    sqlite3_stmt* fresh = statement("SELECT id, type, location, strftime('%Y-%m', occurred_at, 'unixepoch', 'localtime') "
+                                    "FROM incidents WHERE id > ?1;");
+    if (!fresh || !insert(rows + 1, rows + added)) return fail("Insert");
+    sqlite3_bind_int64(fresh, 1, rows);
+    while (sqlite3_step(fresh) == SQLITE_ROW) {
+        IncidentChange change;
+        change.hasNew = true;
+        change.newRowid = sqlite3_column_int64(fresh, 0);
+        for (int d = 0; d < INCIDENT_DIMENSIONS; ++d)
+            change.newValues[d] = reinterpret_cast<const char*>(sqlite3_column_text(fresh, 1 + d));
+        changes.push_back(change);
+    }
+    sqlite3_reset(fresh);
+    start = chrono::steady_clock::now();
+    applyIncidentChanges(index, changes);
+    cout << "apply " << changes.size() << " new incidents: " << fixed << setprecision(2)
+         << elapsedMs() * 1000 / max<size_t>(1, changes.size()) << " us each\n\n" << defaultfloat;
 
-        cout << GREEN << "\n===== Updated Announcements =====\n" << RESET;
-        displayAnnouncementsTable();
+    // A month ago and a year ago, and the SQL range of a month's local days
+    auto monthAgo = [now](int days) {
+        time_t t = (time_t)(now - days * 86400LL);
+        char month[8];
+        strftime(month, sizeof(month), "%Y-%m", localtime(&t));
+        return string(month);
+    };
+    auto monthRange = [](const string &month) {
+        int y = stoi(month.substr(0, 4)), m = stoi(month.substr(5, 2));
+        ostringstream next;
+        next << setfill('0') << setw(4) << (m == 12 ? y + 1 : y) << "-" << setw(2) << (m % 12 + 1) << "-01";
+        long long lo = 0, hi = 0;
+        if (!parseIncidentTime(month + "-01", "00:00", lo) || !parseIncidentTime(next.str(), "00:00", hi))
+            return string("0");     // matches nothing, so the counts below disagree
+        return "occurred_at >= " + to_string(lo) + " AND occurred_at < " + to_string(hi);
+    };
+    const string recent = monthAgo(100), earlier = monthAgo(400);
+    auto filterOf = [](vector<string> types, vector<string> locations, vector<string> months) {
+        DrillFilter filter;
+        filter.values[0] = types;
+        filter.values[1] = locations;
+        filter.values[2] = months;
+        return filter;
+    };
+    const vector<pair<string, DrillFilter>> filters = {
+        {"type 3", filterOf({"type 3"}, {}, {})},
+        {"type 3, Purok 3", filterOf({"type 3"}, {"Purok 3"}, {})},
+        {"type 3, Purok 3, " + recent, filterOf({"type 3"}, {"Purok 3"}, {recent})},
+        {"Purok 3, " + recent, filterOf({}, {"Purok 3"}, {recent})},
+        {"type 3|5, Purok 3|7, " + recent + "|" + earlier.substr(5),
+         filterOf({"type 3", "TYPE 5"}, {"Purok 3", "purok 7"}, {recent, earlier})},
+        {"no filter", filterOf({}, {}, {})},
+    };
 
-        cout << "\nAdd another announcement? (Y/N): ";
-        cin >> more;
+    const int runs = 1000;
+    double worstUs = 0;
+    bool same = true;
+    cout << left << setw(34) << "Filter" << setw(10) << "matches" << setw(12) << "bitmap us" << setw(10) << "SQL ms"
+         << "\n";
+    for (auto &entry : filters) {
+        const DrillFilter &filter = entry.second;
+        string where;
+        for (int d = 0; d < 2; ++d) {
+            if (filter.values[d].empty()) continue;
+            string any;
+            for (auto &value : filter.values[d])
+                any += (any.empty() ? "" : " OR ") + string(INCIDENT_DIMENSION_NAMES[d]) + " = '" + value + "' COLLATE NOCASE";
+            where += " AND (" + any + ")";
+        }
+        if (!filter.values[2].empty()) {
+            string any;
+            for (auto &month : filter.values[2]) any += (any.empty() ? "" : " OR ") + monthRange(month);
+            where += " AND (" + any + ")";
+        }
+        sqlite3_stmt* count = statement("SELECT count(*) FROM incidents WHERE 1" + where + ";");
+        if (!count) return fail("Count");
+        long long sqlCount = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < 3; ++r) {
+            if (sqlite3_step(count) == SQLITE_ROW) sqlCount = sqlite3_column_int64(count, 0);
+            sqlite3_reset(count);
+        }
+        double sqlMs = elapsedMs() / 3;
+
+        uint64_t matches = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < runs; ++r) matches = matchIncidents(index, filter);
+        double us = elapsedMs() * 1000 / runs;
+        worstUs = max(worstUs, us);
+        same = same && (long long)matches == sqlCount;
+        cout << left << setw(34) << entry.first << setw(10) << matches << fixed << setprecision(1) << setw(12) << us
+             << setw(10) << sqlMs << ((long long)matches == sqlCount ? "" : RED "SQL counts " + to_string(sqlCount) + RESET)
+             << "\n" << defaultfloat << right;
     }
+
+    const DrillFilter &drill = filters[2].second;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < 100; ++r) incidentFacets(index, drill, 1);
+    double facetUs = elapsedMs() * 10;
+    Roaring matches;
+    start = chrono::steady_clock::now();
+    matchIncidents(index, drill, &matches);
+    vector<uint32_t> newest = roaringLast(matches, INCIDENT_DRILL_ROWS);
+    string ids;
+    for (uint32_t id : newest) ids += (ids.empty() ? "" : ",") + to_string(id);
+    sqlite3_stmt* fetch = statement("SELECT " + INCIDENT_COLUMNS + " FROM incidents "
+                                    "WHERE id IN (SELECT value FROM json_each(?1)) ORDER BY id DESC;");
+    if (!fetch) return fail("Fetch");
+    sqlite3_bind_text(fetch, 1, ("[" + ids + "]").c_str(), -1, SQLITE_TRANSIENT);
+    size_t fetched = 0;
+    while (sqlite3_step(fetch) == SQLITE_ROW) ++fetched;
+    sqlite3_reset(fetch);
+    double fetchMs = elapsedMs();
+    cout << "\nlocation counts for \"" << filters[2].first << "\": " << fixed << setprecision(1) << facetUs << " us\n"
+         << "its newest " << fetched << " incidents by rowid: " << setprecision(2) << fetchMs << " ms\n" << defaultfloat;
+
+    for (auto &entry : statements) sqlite3_finalize(entry.second);
+    sqlite3_close(conn);
+    removeScratch();
+    cout << "bitmaps and SQL " << (same ? GREEN "agree" : RED "DISAGREE") << RESET << "\n";
+    cout << "\nslowest bitmap count " << fixed << setprecision(1) << worstUs << " us: " << defaultfloat
+         << (worstUs < BITMAP_COUNT_TARGET_US && same ? GREEN "within" : RED "over") << " the 100 us target" << RESET
+         << "\n";
+    return same ? 0 : 1;
 }
 
 // ------------------------
@@ -451,10 +7414,18 @@ void displayMenu() {
 
     printLine("[F] Report Incident", YELLOW);
     printLine("[G] View Incidents", YELLOW);
+    printLine("[H] Mirror Database to Standby", YELLOW);
+    printLine("[I] Incident Count by Type", YELLOW);
 
     printLine("[J] Add Announcement", YELLOW);
     printLine("[K] View Announcements", YELLOW);
 
+    printLine("[L] Background Jobs", YELLOW);
+    printLine("[M] Search Incidents", YELLOW);
+    printLine("[N] Full-Text Search", YELLOW);
+    printLine("[O] Incident Trends", YELLOW);
+    printLine("[P] Incident Drill-Down", YELLOW);
+
     printLine("[X] Exit Program", YELLOW);
 
     cout << "+" << string(boxWidth, '-') << "+\n" << RESET;
@@ -467,7 +7438,7 @@ char getUserChoice() {
         cin >> choice;
         choice = toupper(choice);
 
-        if ((choice >= 'A' && choice <= 'K') || choice == 'X') {
+        if ((choice >= 'A' && choice <= 'P') || choice == 'X') {
             cout << "You selected: " << GREEN << choice << RESET;
             cout << "\nProceed? (Y/N): ";
             cin >> confirm;
@@ -477,74 +7448,339 @@ char getUserChoice() {
 
             cout << RED << "\nAction cancelled. Returning to menu...\n\n" << RESET;
         } else {
-            cout << RED << "\nInvalid option! Please enter A–K or X.\n\n" << RESET;
+            cout << RED << "\nInvalid option! Please enter A–P or X.\n\n" << RESET;
         }
     }
 }
 
 // ------------------------
-// MAIN
+// COMMAND LINE
 // ------------------------
-int main() {
-    // Open database
-    if (sqlite3_open("barangay.db", &db)) {
-        cerr << RED << "Can't open database: " << sqlite3_errmsg(db) << RESET << endl;
-        return 1;
+int runCommand(DbContext &ctx, JobPool &pool, Maintenance &maint, int argc, char* argv[]) {
+    string command = argv[1];
+
+    if (command == "mirror" && argc >= 3) {
+        MirrorStats stats;
+        string error;
+        if (!mirrorDatabase(ctx, argv[2], stats, error)) {
+            cerr << "mirror failed: " << error << endl;
+            return 1;
+        }
+        cout << "copied " << stats.pagesCopied << " of " << stats.pageCount << " pages ("
+             << stats.pageSize << " bytes each) to " << argv[2] << endl;
+        return 0;
+    }
+
+    if (command == "changes") {
+        printChangesSince(ctx.changeLog, argc >= 3 ? atoll(argv[2]) : 0);
+        return 0;
+    }
+
+    if (command == "bench-recovery") {
+        int rows = argc >= 3 ? atoi(argv[2]) : 100000;
+        long long cut = argc >= 4 ? atoll(argv[3]) : -1;
+        return benchmarkRecovery(argv[0], rows, cut);
+    }
+
+    if (command == "bench-memory")
+        return benchmarkMemory(argc >= 3 ? atoi(argv[2]) : 1000000);
+
+    if (command == "bench-names")
+        return benchmarkNameSearch(argc >= 3 ? atoi(argv[2]) : 1000000);
+
+    if (command == "bench-rollups")
+        return benchmarkRollups(argc >= 3 ? atoi(argv[2]) : 1000000);
+
+    if (command == "bench-bitmaps")
+        return benchmarkBitmaps(argc >= 3 ? atoi(argv[2]) : 1000000);
+
+    if (command == "bench-suggest")
+        return benchmarkSuggestions(argc >= 3 ? atoi(argv[2]) : 1000000);
+
+    if (command == "suggest" && argc >= 3) {
+        auto start = chrono::steady_clock::now();
+        if (!startNameIndex(ctx, residentNames)) {
+            cerr << RED << "Cannot load the resident names." << RESET << endl;
+            return 1;
+        }
+        cout << "loaded in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms\n";
+        printNameIndex(residentNames);
+        start = chrono::steady_clock::now();
+        vector<string> names = suggestNames(residentNames, argv[2], NAME_SUGGESTIONS);
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        for (auto &name : names) cout << "  " << name << "\n";
+        cout << names.size() << " suggestions in " << us << " us; Tab completes to \""
+             << completeName(residentNames, argv[2]) << "\"\n";
+        return 0;
+    }
+
+    if (command == "bench-writes") {
+        int submitters = argc >= 3 ? atoi(argv[2]) : 8;
+        int rows = argc >= 4 ? atoi(argv[3]) : 200;
+        return benchmarkWrites(submitters, rows);
+    }
+
+    if (command == "report" && argc >= 3) {
+        auto render = tableRenderer(argv[2]);
+        if (render) {
+            bool ok = writeReport(ctx, render, argc >= 4 ? argv[3] : "");
+            if (ok && argc >= 4) cout << "wrote " << argv[3] << endl;
+            return ok ? 0 : 1;
+        }
+    }
+
+    if (command == "job" && argc >= 3) {
+        string kind = argv[2];
+        bool perTable = kind == "export" || kind == "report";
+        string table = perTable && argc >= 4 ? argv[3] : "";
+        int fileArg = perTable ? 4 : 3;
+        auto job = submitNamedJob(ctx, pool, kind, table, argc > fileArg ? argv[fileArg] : "");
+        if (job) return watchJob(*job);
+    }
+
+    if (command == "incidents" && argc >= 3) {
+        // A number is "the last N days"; otherwise from [to] as dates
+        string from = argv[2], to = argc >= 4 ? argv[3] : argv[2];
+        long long lo, hi;
+        if (from.find('-') == string::npos && atoi(from.c_str()) > 0) {
+            hi = (long long)time(nullptr);
+            lo = hi - atoi(from.c_str()) * 86400LL;
+        } else if (!parseIncidentDays(from, to, lo, hi)) {
+            cerr << "incidents: expected a number of days or YYYY-MM-DD [YYYY-MM-DD]" << endl;
+            return 1;
+        }
+        return writeReport(ctx, [lo, hi](DbContext &c, ostream &out) {
+            return renderIncidentsBetween(c, out, lo, hi);
+        }) ? 0 : 1;
+    }
+
+    if (command == "search" && argc >= 3) {
+        string input;
+        for (int i = 2; i < argc; ++i) input += (i > 2 ? " " : "") + string(argv[i]);
+        return writeReport(ctx, [&input](DbContext &c, ostream &out) {
+            return renderFullTextSearch(c, out, input);
+        }) ? 0 : 1;
+    }
+
+    if (command == "check-plans") {
+        sqlite3* schema = openPlanSchema(ctx);
+        bool incidents = schema && checkIncidentPlans(schema);
+        bool names = schema && checkNameLookupPlans(schema);
+        sqlite3_close(schema);
+        return incidents && names ? 0 : 1;
+    }
+
+    if (command == "incident-report") {
+        incidentReport(ctx, argc >= 3 ? max(1, atoi(argv[2])) : defaultScanThreads());
+        return 0;
+    }
+
+    if (command == "drill") {
+        DrillFilter filter;
+        for (int i = 2; i < argc; ++i) {
+            string arg = argv[i];
+            size_t eq = arg.find('=');
+            int d = 0;
+            while (d < INCIDENT_DIMENSIONS && arg.compare(0, eq, INCIDENT_DIMENSION_NAMES[d]) != 0) ++d;
+            if (eq == string::npos || d == INCIDENT_DIMENSIONS) {
+                cerr << "Filters are type=, location= or month= followed by values separated by commas\n";
+                return 1;
+            }
+            istringstream values(arg.substr(eq + 1));
+            for (string value; getline(values, value, ',');) filter.values[d].push_back(value);
+        }
+        if (!startIncidentBitmaps(ctx, incidentBitmaps)) {
+            cerr << RED << "Cannot load the incident bitmap index." << RESET << endl;
+            return 1;
+        }
+        double us;
+        uint64_t count = countDrillMatches(incidentBitmaps, filter, us);
+        cout << count << " incidents, counted in " << fixed << setprecision(1) << us << " us (index "
+             << incidentBitmapBytes(incidentBitmaps) / 1024 << " KiB)\n" << defaultfloat;
+        showDrillMatches(ctx, incidentBitmaps, filter);
+        return 0;
+    }
+
+    if (command == "trends") {
+        incidentTrends(ctx, argc >= 3 ? argv[2] : "");
+        return 0;
+    }
+
+    if (command == "incident-month" && argc >= 3) {
+        incidentMonthReport(ctx, argv[2], argc >= 4 ? argv[3] : "");
+        return 0;
+    }
+
+    if (command == "rebuild-rollups") {
+        bool rebuilt = rebuildIncidentRollups(ctx);
+        cout << (rebuilt ? GREEN "Incident rollups recounted.\n" : RED "Could not recount the incident rollups.\n") << RESET;
+        return rebuilt ? 0 : 1;
+    }
+
+    if (command == "maintenance") {
+        printMaintenance(maint);
+        runMaintenancePass(maint, true);
+        cout << "-- after ANALYZE, incremental vacuum and checkpoint --\n";
+        printMaintenance(maint);
+        return 0;
+    }
+
+    if (command == "serve") {
+        int port = argc >= 3 ? atoi(argv[2]) : 8080;
+        int workers = argc >= 4 ? atoi(argv[3]) : max(2u, thread::hardware_concurrency());
+        return serveBarangay(ctx, port, workers);
     }
 
-    // Create tables if not exist
-    const char* sql_create_residents = R"(
+    cerr << "Usage: " << argv[0] << " [command]\n"
+         << "  (no command)                      interactive menu\n"
+         << "  mirror <standby.db>               copy changed pages to a standby file\n"
+         << "  changes [after-seq]               print change-log batches after a sequence number\n"
+         << "  report <table> [file]             residents, incidents or announcements from one read snapshot\n"
+         << "  incidents <days> | <from> [to]    incidents of the last N days or between two dates\n"
+         << "  incident-report [threads]         incident count by type (parallel scan)\n"
+         << "  trends [YYYY-MM-DD]               incidents over 7, 30 and 365 days, busiest locations and hours\n"
+         << "  drill [type=..] [location=..] [month=YYYY-MM]  count and show incidents from the bitmap index\n"
+         << "                                    (values separated by commas match any of them)\n"
+         << "  incident-month <YYYY-MM> [file]   monthly incident report by type and location\n"
+         << "  rebuild-rollups                   recount the incident rollups (after a time zone change)\n"
+         << "  check-plans                       fail if any incident search or name lookup would scan its table\n"
+         << "  search <words>                    full-text search of incidents and announcements (\"phrase\", prefix*)\n"
+         << "  suggest <prefix>                  resident names the name prompts would suggest, and the index size\n"
+         << "  job export|report <table> <file>  run a background job and show its progress\n"
+         << "  job backup <file>                 online backup as a background job\n"
+         << "  job vacuum                        compact the database as a background job\n"
+         << "  maintenance                       run ANALYZE, incremental vacuum and a WAL checkpoint now\n"
+         << "  serve [port] [workers]            JSON API and viewer on 127.0.0.1 (default port 8080)\n"
+         << "  bench-writes [submitters] [rows]  own connections vs. group-commit queue\n"
+         << "  bench-recovery [rows] [cut]       WAL recovery time after a crash (cut: power cut after N writes)\n"
+         << "  bench-memory [rows]               peak and steady-state memory over a scratch incidents table\n"
+         << "  bench-names [rows]                LIKE vs. trigram resident name search over generated names\n"
+         << "  bench-rollups [rows]              incident trends from the rollups vs. counting the incidents\n"
+         << "  bench-bitmaps [rows]              drill-down counts from the incident bitmaps vs. SQL\n"
+         << "  bench-suggest [rows]              name-prompt suggestion latency and index size over generated names\n"
+         << "  profile                           interactive menu, printing the I/O each action caused\n"
+         << "IO_FAULTS=write=N,sync=N,delay=US,cut=N injects I/O errors and delays.\n";
+    return 1;
+}
+
+// ------------------------
+// MAIN
+// ------------------------
+int main(int argc, char* argv[]) {
+    // Open database, creating the tables if they do not exist
+    const char* sql_create = R"(
         CREATE TABLE IF NOT EXISTS residents (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
             name TEXT UNIQUE,
             address TEXT,
-            contact TEXT
+            contact TEXT,
+            name_sound TEXT
         );
-    )";
-    sqlite3_exec(db, sql_create_residents, nullptr, nullptr, nullptr);
 
-    const char* sql_create_incidents = R"(
         CREATE TABLE IF NOT EXISTS incidents (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
             type TEXT,
             location TEXT,
-            date TEXT,
-            time TEXT,
+            occurred_at INTEGER,
             description TEXT
         );
-    )";
-    sqlite3_exec(db, sql_create_incidents, nullptr, nullptr, nullptr);
 
-    const char* sql_create_announcements = R"(
         CREATE TABLE IF NOT EXISTS announcements (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
             title TEXT UNIQUE,
             content TEXT,
             date TEXT
         );
+
+        CREATE INDEX IF NOT EXISTS idx_residents_name_fold ON residents(name COLLATE FOLD);
+        CREATE INDEX IF NOT EXISTS idx_announcements_title_fold ON announcements(title COLLATE FOLD);
     )";
-    sqlite3_exec(db, sql_create_announcements, nullptr, nullptr, nullptr);
+    // Allocator first: SQLite only accepts it before it initializes. Every
+    // connection below then goes through the I/O accounting VFS and knows FOLD
+    configureSqliteMemory();
+    registerIoShim();
+    registerFoldCollation();
+    if (argc == 5 && string(argv[1]) == "recovery-child")
+        return recoveryChild(argv[2], atoi(argv[3]), atoll(argv[4]));
+
+    DbContext ctx;
+    string error;
+    if (!openDbContext(ctx, "barangay.db", sql_create, error)) {
+        cerr << RED << "Can't open database: " << error << RESET << endl;
+        return 1;
+    }
+    if (!migrateIncidentTimes(ctx)) {
+        cerr << RED << "Can't convert incident dates to occurred_at." << RESET << endl;
+        closeDbContext(ctx);
+        return 1;
+    }
+    if (!migrateResidentSounds(ctx)) {
+        cerr << RED << "Can't add phonetic keys to resident names." << RESET << endl;
+        closeDbContext(ctx);
+        return 1;
+    }
+    if (!setupIncidentRollups(ctx)) {
+        cerr << RED << "Can't set up the incident rollups." << RESET << endl;
+        closeDbContext(ctx);
+        return 1;
+    }
+    if (!setupFullText(ctx))
+        cerr << YELLOW << "Full-text, fuzzy and phonetic name search unavailable (this SQLite has no FTS5).\n" << RESET;
+    JobPool pool;
+    startJobPool(pool, ctx, (int)max(1u, thread::hardware_concurrency() / 2), JOB_CPU_PERCENT);
+    Maintenance maint;
+    const char* walPages = getenv("WAL_CHECKPOINT_PAGES");
+    if (!startMaintenance(maint, ctx, walPages ? max(1, atoi(walPages)) : WAL_CHECKPOINT_PAGES))
+        cerr << YELLOW << "Maintenance scheduler unavailable; relying on auto-checkpoint.\n" << RESET;
+
+    bool profiling = argc > 1 && string(argv[1]) == "profile";
+    if (argc > 1 && !profiling) {
+        int status = runCommand(ctx, pool, maint, argc, argv);
+        stopMaintenance(maint);
+        stopJobPool(pool);
+        closeDbContext(ctx);
+        return status;
+    }
+    if (!startNameIndex(ctx, residentNames))
+        cerr << YELLOW << "Name suggestions unavailable.\n" << RESET;
+    if (!startIncidentBitmaps(ctx, incidentBitmaps))
+        cerr << YELLOW << "Incident drill-down unavailable.\n" << RESET;
 
     char choice;
     do {
         displayMenu();
+        setMenuIdle(maint, true);
         choice = getUserChoice();
+        setMenuIdle(maint, false);
+        IoTotals io = ioTotals();
 
         switch (choice) {
-            case 'A': addResident(); break;
-            case 'B': displayResidentsTable(); break;
-            case 'C': updateResident(); break;
-            case 'D': searchResident(); break;
-            case 'E': deleteResident(); break;
-            case 'F': reportIncident(); break;
-            case 'G': displayIncidentsTable(); break;
-            case 'J': addAnnouncement(); break;
-            case 'K': displayAnnouncementsTable(); break;
+            case 'A': addResident(ctx); break;
+            case 'B': displayResidentsTable(ctx); break;
+            case 'C': updateResident(ctx); break;
+            case 'D': searchResident(ctx); break;
+            case 'E': deleteResident(ctx); break;
+            case 'F': reportIncident(ctx); break;
+            case 'G': viewIncidents(ctx); break;
+            case 'H': mirrorMenu(ctx); break;
+            case 'I': incidentReport(ctx, defaultScanThreads()); break;
+            case 'J': addAnnouncement(ctx); break;
+            case 'K': displayAnnouncementsTable(ctx); break;
+            case 'L': jobsMenu(ctx, pool); break;
+            case 'M': searchIncidents(ctx); break;
+            case 'N': fullTextSearch(ctx); break;
+            case 'O': incidentTrendsMenu(ctx); break;
+            case 'P': incidentDrillDown(ctx, incidentBitmaps); break;
             case 'X':
                 cout << MAGENTA << "\nExiting program... Goodbye!\n" << RESET;
                 break;
         }
 
+        if (profiling && choice != 'X') {
+            cout << "\n";
+            printIoSince(io);
+        }
+
         if (choice != 'X') {
             cout << "\nPress Enter to continue...";
             clearInput();
@@ -554,6 +7790,8 @@ int main() {
 
     } while (choice != 'X');
 
-    sqlite3_close(db);
+    stopMaintenance(maint);
+    stopJobPool(pool);
+    closeDbContext(ctx);
     return 0;
 }
\ No newline at end of file
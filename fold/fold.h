@@ -0,0 +1,90 @@
+// FOLD, the collation both programs index names under. Shared by the
+// programs and by fold_extension.cpp, the loadable extension that lets other
+// SQLite tools open their databases, so all of them sort names the same way;
+// a change here changes the order of existing indexes, which then need
+// REINDEX FOLD.
+//
+// Text is compared after folding it: ASCII and Latin letters lowercased and
+// reduced to their base letter (ñ as n, ß as ss, æ as ae), combining accents
+// dropped, Greek and Cyrillic capitals lowercased; anything else compares by
+// code point. Runs of plain ASCII on both sides, most names, are compared a
+// byte at a time without decoding.
+#pragma once
+
+#include <cstddef>
+
+// Two bytes per code point from U+00C0 to U+017F: the folded letter (or two),
+// padded with a space; two spaces keep the character as it is
+constexpr char FOLD_LATIN[] =
+    "a a a a a a aec e e e e i i i i "   // ÀÁÂÃÄÅÆÇÈÉÊËÌÍÎÏ
+    "d n o o o o o   o u u u u y thss"   // ÐÑÒÓÔÕÖ×ØÙÚÛÜÝÞß
+    "a a a a a a aec e e e e i i i i "   // àáâãäåæçèéêëìíîï
+    "d n o o o o o   o u u u u y thy "   // ðñòóôõö÷øùúûüýþÿ
+    "a a a a a a c c c c c c c c d d "   // ĀāĂăĄąĆćĈĉĊċČčĎď
+    "d d e e e e e e e e e e g g g g "   // ĐđĒēĔĕĖėĘęĚěĜĝĞğ
+    "g g g g h h h h i i i i i i i i "   // ĠġĢģĤĥĦħĨĩĪīĬĭĮį
+    "i i ijijj j k k k l l l l l l l "   // İıĲĳĴĵĶķĸĹĺĻļĽľĿ
+    "l l l n n n n n n n n n o o o o "   // ŀŁłŃńŅņŇňŉŊŋŌōŎŏ
+    "o o oeoer r r r r r s s s s s s "   // ŐőŒœŔŕŖŗŘřŚśŜŝŞş
+    "s s t t t t t t u u u u u u u u "   // ŠšŢţŤťŦŧŨũŪūŬŭŮů
+    "u u u u w w y y y z z z z z z s ";  // ŰűŲųŴŵŶŷŸŹźŻżŽžſ
+
+struct FoldCursor {
+    const unsigned char* at;
+    const unsigned char* end;
+    char32_t pending = 0;           // the second letter of a fold such as ß
+};
+
+// The next folded character, or 0 at the end. A byte that does not start
+// valid UTF-8 stands for itself, apart from every real character.
+inline char32_t nextFolded(FoldCursor &c) {
+    if (char32_t next = c.pending) {
+        c.pending = 0;
+        return next;
+    }
+    while (c.at < c.end) {
+        unsigned char b = *c.at;
+        if (b < 0x80) {
+            ++c.at;
+            return b >= 'A' && b <= 'Z' ? b + ('a' - 'A') : b;
+        }
+        size_t length = (b >> 5) == 6 ? 2 : (b >> 4) == 14 ? 3 : (b >> 3) == 30 ? 4 : 0;
+        char32_t cp = b & (0x7F >> length);
+        size_t k = 1;
+        for (; k < length && c.at + k < c.end && (c.at[k] & 0xC0) == 0x80; ++k)
+            cp = (cp << 6) | (c.at[k] & 0x3F);
+        if (length == 0 || k < length) {
+            ++c.at;
+            return 0xDC00 + b;
+        }
+        c.at += length;
+        if (cp >= 0x300 && cp <= 0x36F) continue;                   // combining accent
+        if (cp >= 0xC0 && cp <= 0x17F) {
+            const char* folded = FOLD_LATIN + 2 * (cp - 0xC0);
+            if (folded[0] == ' ') return cp;
+            if (folded[1] != ' ') c.pending = (unsigned char)folded[1];
+            return (unsigned char)folded[0];
+        }
+        if ((cp >= 0x391 && cp <= 0x3A9) || (cp >= 0x410 && cp <= 0x42F)) return cp + 0x20;
+        if (cp >= 0x400 && cp <= 0x40F) return cp + 0x50;
+        return cp;
+    }
+    return 0;
+}
+
+inline int foldCompare(void*, int lengthA, const void* a, int lengthB, const void* b) {
+    FoldCursor x{static_cast<const unsigned char*>(a), static_cast<const unsigned char*>(a) + lengthA};
+    FoldCursor y{static_cast<const unsigned char*>(b), static_cast<const unsigned char*>(b) + lengthB};
+    for (;;) {
+        while (!x.pending && !y.pending && x.at < x.end && y.at < y.end && *x.at < 0x80 && *y.at < 0x80) {
+            unsigned char p = *x.at >= 'A' && *x.at <= 'Z' ? *x.at + ('a' - 'A') : *x.at;
+            unsigned char q = *y.at >= 'A' && *y.at <= 'Z' ? *y.at + ('a' - 'A') : *y.at;
+            if (p != q) return p < q ? -1 : 1;
+            ++x.at;
+            ++y.at;
+        }
+        char32_t p = nextFolded(x), q = nextFolded(y);
+        if (p != q) return p < q ? -1 : 1;
+        if (!p) return 0;
+    }
+}
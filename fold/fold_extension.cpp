@@ -0,0 +1,24 @@
+// The FOLD collation as a loadable extension, for SQLite tools other than the
+// two programs: without it they cannot write to the tables indexed under FOLD
+// or even run PRAGMA integrity_check on inventory.db, barangay.db or a mirror
+// standby. In the sqlite3 shell:
+//
+//   sqlite> .load build/release/fold
+//   sqlite> PRAGMA integrity_check;
+//
+// `make` builds it as build/<variant>/fold.so. On Windows, next to the
+// bundled sqlite3.exe:
+//
+//   g++ -O2 -shared -I"Project 1" fold/fold_extension.cpp -o fold.dll
+#include <sqlite3ext.h>
+SQLITE_EXTENSION_INIT1
+
+#include "fold.h"
+
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+extern "C" int sqlite3_fold_init(sqlite3* conn, char**, const sqlite3_api_routines* api) {
+    SQLITE_EXTENSION_INIT2(api);
+    return sqlite3_create_collation_v2(conn, "FOLD", SQLITE_UTF8, nullptr, foldCompare, nullptr);
+}